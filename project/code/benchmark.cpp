@@ -0,0 +1,644 @@
+// Benchmark suite
+// Synthetic stress scenes pushed through the real render queue and mesh pool. Each scene flies a looped camera path
+// indexed by frame rather than time, so every run submits identical work whatever the frame rate.
+// Results are written as CSV (one row per scene) and can be compared against a stored baseline - a metric regresses
+// when it grows past its threshold, so renderer changes can be gated on numbers.
+
+#define BENCHMARK_MAX_KEYS          8
+#define BENCHMARK_MAX_RESULTS       16
+#define BENCHMARK_WARMUP_FRAMES     16          // Not recorded - shader and driver first-use costs
+#define BENCHMARK_TEXTURE_SIZE      64
+#define BENCHMARK_FIELD_OF_VIEW     1.0472f     // 60 degrees
+#define BENCHMARK_NEAR              0.1f
+#define BENCHMARK_FAR               512.0f
+
+typedef enum BENCHMARK_SCENE_TYPE
+{
+    BENCHMARK_SMALL_DRAWS,      // Thousands of tiny quads - queue push, sort and submit overhead
+    BENCHMARK_MANY_TEXTURES,    // One texture per draw plus per-frame texture updates - breaks batching, upload bandwidth
+    BENCHMARK_OVERDRAW,         // Stacked screen-covering layers - fill rate
+    BENCHMARK_VERTEX_HEAVY,     // Dense grids - vertex throughput
+    BENCHMARK_LEVEL,            // Compiled level flythrough with PVS culling (only with a level loaded)
+    BENCHMARK_SCENE_COUNT,
+} BENCHMARK_SCENE_TYPE;
+
+static const char *BenchmarkSceneNames[] =
+{
+    "small_draws",
+    "many_textures",
+    "overdraw",
+    "vertex_heavy",
+    "level",
+};
+
+// Every metric is lower-is-better
+typedef enum BENCHMARK_METRIC
+{
+    BENCHMARK_AVG_MS,
+    BENCHMARK_P50_MS,
+    BENCHMARK_P90_MS,
+    BENCHMARK_P99_MS,
+    BENCHMARK_MAX_MS,
+    BENCHMARK_DRAW_CALLS,
+    BENCHMARK_PACKETS,
+    BENCHMARK_SETUP_UPLOAD_BYTES,
+    BENCHMARK_FRAME_UPLOAD_BYTES,
+    BENCHMARK_PEAK_ARENA_BYTES,
+    BENCHMARK_GL_CALLS,
+    BENCHMARK_METRIC_COUNT,
+} BENCHMARK_METRIC;
+
+typedef struct BENCHMARK_METRIC_INFO
+{
+    const char *Name;
+    f64 Threshold;          // Allowed growth over the baseline (0.1 = 10%), negative is reported but never fails
+} BENCHMARK_METRIC_INFO;
+
+// Timing thresholds widen towards the tail, which is noisier run to run
+static BENCHMARK_METRIC_INFO BenchmarkMetrics[] =
+{
+    {"avg_ms",              0.10},
+    {"p50_ms",              0.10},
+    {"p90_ms",              0.15},
+    {"p99_ms",              0.25},
+    {"max_ms",              -1.0},
+    {"draw_calls",          0.0},
+    {"packets",             0.0},
+    {"setup_upload_bytes",  0.0},
+    {"frame_upload_bytes",  0.0},
+    {"peak_arena_bytes",    0.05},
+    {"gl_calls",            0.0},
+};
+
+typedef struct BENCHMARK_CAMERA_PATH
+{
+    V3 Positions[BENCHMARK_MAX_KEYS];
+    V3 Targets[BENCHMARK_MAX_KEYS];
+    u32 KeyCount;
+} BENCHMARK_CAMERA_PATH;
+
+typedef struct BENCHMARK_DRAW
+{
+    MESH Mesh;
+    GLuint Program;
+    GLuint Texture;             // Bound as the lightmap
+    V3 Centre;
+} BENCHMARK_DRAW;
+
+typedef struct BENCHMARK_SCENE
+{
+    u32 Type;
+    BENCHMARK_DRAW *Draws;
+    u32 DrawCount;
+    u32 MaxDraws;
+
+    GLuint *Textures;
+    u32 TextureCount;
+    u32 TexturesPerFrame;
+    u32 *Pixels;                // Staging for per-frame texture updates
+
+    LEVEL *Level;
+    BENCHMARK_CAMERA_PATH Path;
+
+    // Everything the scene itself allocates or uploads
+    u64 ArenaBytes;
+    u64 SetupUploadBytes;
+    u64 FrameUploadBytes;
+} BENCHMARK_SCENE;
+
+typedef struct BENCHMARK_RESULT
+{
+    char Scene[32];
+    u32 Frames;
+    f64 Values[BENCHMARK_METRIC_COUNT];
+} BENCHMARK_RESULT;
+
+void *BenchmarkAlloc(BENCHMARK_SCENE *Scene, MEMORY_ARENA *Arena, size_t Size, size_t Alignment)
+{
+    void *Result = Arena->Alloc(Size, Alignment);
+    Assert(Result, "Benchmark: Scene arena is full!");
+    Scene->ArenaBytes += Size;
+    return Result;
+}
+
+// 0..1
+f32 BenchmarkRandom(u32 *Seed)
+{
+    *Seed = *Seed * 1664525 + 1013904223;
+    return (f32) (*Seed >> 8) / (f32) (1 << 24);
+}
+
+void BenchmarkAddKey(BENCHMARK_SCENE *Scene, V3 Position, V3 Target)
+{
+    BENCHMARK_CAMERA_PATH *Path = &Scene->Path;
+    Assert(Path->KeyCount < BENCHMARK_MAX_KEYS, "Benchmark: Too many camera keys!");
+    Path->Positions[Path->KeyCount] = Position;
+    Path->Targets[Path->KeyCount]   = Target;
+    ++Path->KeyCount;
+}
+
+V3 BenchmarkCatmullRom(V3 P0, V3 P1, V3 P2, V3 P3, f32 T)
+{
+    f32 T2 = T * T;
+    f32 T3 = T2 * T;
+    f32 A = -0.5f * T3 + T2 - 0.5f * T;
+    f32 B = 1.5f * T3 - 2.5f * T2 + 1.0f;
+    f32 C = -1.5f * T3 + 2.0f * T2 + 0.5f * T;
+    f32 D = 0.5f * T3 - 0.5f * T2;
+    V3 Result = {{A * P0.X + B * P1.X + C * P2.X + D * P3.X,
+                  A * P0.Y + B * P1.Y + C * P2.Y + D * P3.Y,
+                  A * P0.Z + B * P1.Z + C * P2.Z + D * P3.Z}};
+    return Result;
+}
+
+// Closed spline through the keys - Frame 0 and FrameCount land on the first key
+void BenchmarkCameraAt(BENCHMARK_CAMERA_PATH *Path, u32 Frame, u32 FrameCount, V3 *Position, V3 *Target)
+{
+    u32 Count   = Path->KeyCount;
+    f32 T       = ((f32) (Frame % FrameCount) / (f32) FrameCount) * (f32) Count;
+    u32 Key     = (u32) T;
+    T -= (f32) Key;
+
+    u32 K0 = (Key + Count - 1) % Count;
+    u32 K1 = Key % Count;
+    u32 K2 = (Key + 1) % Count;
+    u32 K3 = (Key + 2) % Count;
+    *Position   = BenchmarkCatmullRom(Path->Positions[K0], Path->Positions[K1], Path->Positions[K2], Path->Positions[K3], T);
+    *Target     = BenchmarkCatmullRom(Path->Targets[K0], Path->Targets[K1], Path->Targets[K2], Path->Targets[K3], T);
+}
+
+// Quad centred on Centre spanning +-AxisU and +-AxisV
+void BenchmarkAddQuad(BENCHMARK_SCENE *Scene, RENDERER *RenderInfo, V3 Centre, V3 AxisU, V3 AxisV, GLuint Program, GLuint Texture)
+{
+    Assert(Scene->DrawCount < Scene->MaxDraws, "Benchmark: Too many draws!");
+
+    V3 Normal = {{AxisU.Y * AxisV.Z - AxisU.Z * AxisV.Y, AxisU.Z * AxisV.X - AxisU.X * AxisV.Z, AxisU.X * AxisV.Y - AxisU.Y * AxisV.X}};
+    f32 Length = sqrtf(Normal.X * Normal.X + Normal.Y * Normal.Y + Normal.Z * Normal.Z);
+    Normal = {{Normal.X / Length, Normal.Y / Length, Normal.Z / Length}};
+
+    f32 Corners[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+    VERTEX_PACKED Vertices[4];
+    for(u32 i = 0; i < 4; ++i)
+    {
+        f32 U = Corners[i][0];
+        f32 V = Corners[i][1];
+        V3 Position = {{Centre.X + AxisU.X * U + AxisV.X * V, Centre.Y + AxisU.Y * U + AxisV.Y * V, Centre.Z + AxisU.Z * U + AxisV.Z * V}};
+        V2 UV       = {{U * 0.5f + 0.5f, V * 0.5f + 0.5f}};
+        Vertices[i] = PackVertex(&RenderInfo->MeshPool, Position, Normal, UV, UV);
+    }
+    u32 Indices[] = {0, 1, 3, 1, 2, 3};
+
+    BENCHMARK_DRAW *Draw = &Scene->Draws[Scene->DrawCount++];
+    bool Allocated = MeshPoolAlloc(&RenderInfo->MeshPool, ArrayCount(Vertices), ArrayCount(Indices), &Draw->Mesh);
+    Assert(Allocated, "Benchmark: Mesh pool is full!");
+    MeshPoolUpload(&RenderInfo->MeshPool, &Draw->Mesh, Vertices, Indices);
+    Draw->Program   = Program;
+    Draw->Texture   = Texture;
+    Draw->Centre    = Centre;
+}
+
+// Rolling heightfield of Resolution x Resolution vertices over Size x Size units
+void BenchmarkAddGrid(BENCHMARK_SCENE *Scene, MEMORY_ARENA *Arena, RENDERER *RenderInfo, V3 Centre, f32 Size, u32 Resolution, GLuint Program)
+{
+    Assert(Scene->DrawCount < Scene->MaxDraws, "Benchmark: Too many draws!");
+
+    u32 VertexCount = Resolution * Resolution;
+    u32 IndexCount  = (Resolution - 1) * (Resolution - 1) * 6;
+    VERTEX_PACKED *Vertices = (VERTEX_PACKED *) BenchmarkAlloc(Scene, Arena, sizeof(VERTEX_PACKED) * VertexCount, alignof(VERTEX_PACKED));
+    u32 *Indices            = (u32 *) BenchmarkAlloc(Scene, Arena, sizeof(u32) * IndexCount, alignof(u32));
+
+    f32 Step = Size / (f32) (Resolution - 1);
+    for(u32 Z = 0; Z < Resolution; ++Z)
+    {
+        for(u32 X = 0; X < Resolution; ++X)
+        {
+            f32 PX = Centre.X - Size * 0.5f + (f32) X * Step;
+            f32 PZ = Centre.Z - Size * 0.5f + (f32) Z * Step;
+            V3 Position = {{PX, Centre.Y + sinf(PX * 0.5f) * cosf(PZ * 0.5f), PZ}};
+            V3 Normal   = {{0.0f, 1.0f, 0.0f}};
+            V2 UV       = {{(f32) X / (f32) (Resolution - 1), (f32) Z / (f32) (Resolution - 1)}};
+            Vertices[Z * Resolution + X] = PackVertex(&RenderInfo->MeshPool, Position, Normal, UV, UV);
+        }
+    }
+
+    u32 *Index = Indices;
+    for(u32 Z = 0; Z < Resolution - 1; ++Z)
+    {
+        for(u32 X = 0; X < Resolution - 1; ++X)
+        {
+            u32 I = Z * Resolution + X;
+            *Index++ = I;
+            *Index++ = I + Resolution;
+            *Index++ = I + 1;
+            *Index++ = I + 1;
+            *Index++ = I + Resolution;
+            *Index++ = I + Resolution + 1;
+        }
+    }
+
+    BENCHMARK_DRAW *Draw = &Scene->Draws[Scene->DrawCount++];
+    bool Allocated = MeshPoolAlloc(&RenderInfo->MeshPool, VertexCount, IndexCount, &Draw->Mesh);
+    Assert(Allocated, "Benchmark: Mesh pool is full!");
+    MeshPoolUpload(&RenderInfo->MeshPool, &Draw->Mesh, Vertices, Indices);
+    Draw->Program   = Program;
+    Draw->Texture   = 0;
+    Draw->Centre    = Centre;
+}
+
+// Procedural RGBA8 pattern - Variant changes it so per-frame updates upload different pixels
+void BenchmarkFillTexture(u32 *Pixels, u32 Variant)
+{
+    for(u32 Y = 0; Y < BENCHMARK_TEXTURE_SIZE; ++Y)
+    {
+        for(u32 X = 0; X < BENCHMARK_TEXTURE_SIZE; ++X)
+        {
+            u32 Checker = (((X >> 3) ^ (Y >> 3) ^ Variant) & 1) ? 0xFF : 0x40;
+            Pixels[Y * BENCHMARK_TEXTURE_SIZE + X] = 0xFF000000 | (Checker << 16) | ((Variant * 37) & 0xFF) << 8 | ((X + Y + Variant) & 0xFF);
+        }
+    }
+}
+
+// Returns false if the scene can't run (no level loaded)
+bool BenchmarkSceneCreate(BENCHMARK_SCENE *Scene, u32 Type, MEMORY_ARENA *Arena, RENDERER *RenderInfo, LEVEL *Level)
+{
+    PROFILE_SCOPE("BenchmarkSceneCreate");
+
+    *Scene = {};
+    Scene->Type = Type;
+    u64 MeshBytes = RenderInfo->MeshPool.BytesUploaded;
+    u32 Seed = 1;
+
+    switch(Type)
+    {
+        case BENCHMARK_SMALL_DRAWS:
+        {
+            // 4096 quads scattered through a 64 x 16 x 64 volume, cycling every shader permutation
+            Scene->MaxDraws = 4096;
+            Scene->Draws    = (BENCHMARK_DRAW *) BenchmarkAlloc(Scene, Arena, sizeof(BENCHMARK_DRAW) * Scene->MaxDraws, alignof(BENCHMARK_DRAW));
+            for(u32 i = 0; i < Scene->MaxDraws; ++i)
+            {
+                V3 Centre = {{BenchmarkRandom(&Seed) * 64.0f - 32.0f, BenchmarkRandom(&Seed) * 16.0f - 8.0f, BenchmarkRandom(&Seed) * 64.0f - 32.0f}};
+                V3 AxisU  = {{0.25f, 0.0f, 0.0f}};
+                V3 AxisV  = {{0.0f, 0.25f, 0.0f}};
+                BenchmarkAddQuad(Scene, RenderInfo, Centre, AxisU, AxisV, RenderInfo->ShaderPrograms[i % SHADER_PERMUTATION_COUNT], 0);
+            }
+
+            // Orbit outside the volume
+            for(u32 i = 0; i < 4; ++i)
+            {
+                f32 Angle = (f32) i * 1.5708f;
+                BenchmarkAddKey(Scene, V3{{cosf(Angle) * 48.0f, 12.0f, sinf(Angle) * 48.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+            }
+        } break;
+
+        case BENCHMARK_MANY_TEXTURES:
+        {
+            // 32 x 32 wall of quads, each with its own texture, sampled through the lightmap permutation
+            Scene->MaxDraws         = 1024;
+            Scene->TextureCount     = 1024;
+            Scene->TexturesPerFrame = 16;
+            Scene->Draws    = (BENCHMARK_DRAW *) BenchmarkAlloc(Scene, Arena, sizeof(BENCHMARK_DRAW) * Scene->MaxDraws, alignof(BENCHMARK_DRAW));
+            Scene->Textures = (GLuint *) BenchmarkAlloc(Scene, Arena, sizeof(GLuint) * Scene->TextureCount, alignof(GLuint));
+            Scene->Pixels   = (u32 *) BenchmarkAlloc(Scene, Arena, sizeof(u32) * BENCHMARK_TEXTURE_SIZE * BENCHMARK_TEXTURE_SIZE, 64);
+
+            glCreateTextures(GL_TEXTURE_2D, Scene->TextureCount, Scene->Textures);
+            for(u32 i = 0; i < Scene->TextureCount; ++i)
+            {
+                glTextureStorage2D(Scene->Textures[i], 1, GL_RGBA8, BENCHMARK_TEXTURE_SIZE, BENCHMARK_TEXTURE_SIZE);
+                glTextureParameteri(Scene->Textures[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTextureParameteri(Scene->Textures[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                BenchmarkFillTexture(Scene->Pixels, i);
+                glTextureSubImage2D(Scene->Textures[i], 0, 0, 0, BENCHMARK_TEXTURE_SIZE, BENCHMARK_TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, Scene->Pixels);
+                Scene->SetupUploadBytes += sizeof(u32) * BENCHMARK_TEXTURE_SIZE * BENCHMARK_TEXTURE_SIZE;
+
+                V3 Centre = {{((f32) (i % 32) - 15.5f) * 2.5f, ((f32) (i / 32) - 15.5f) * 2.5f, 0.0f}};
+                V3 AxisU  = {{1.0f, 0.0f, 0.0f}};
+                V3 AxisV  = {{0.0f, 1.0f, 0.0f}};
+                BenchmarkAddQuad(Scene, RenderInfo, Centre, AxisU, AxisV, RenderInfo->ShaderPrograms[SHADER_LIGHTMAP], Scene->Textures[i]);
+            }
+
+            // Sweep across the wall, pulling back to take in all of it
+            BenchmarkAddKey(Scene, V3{{-30.0f, -20.0f, 30.0f}}, V3{{-20.0f, -10.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{30.0f, -20.0f, 30.0f}}, V3{{20.0f, -10.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{0.0f, 0.0f, 80.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{30.0f, 20.0f, 30.0f}}, V3{{20.0f, 10.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{-30.0f, 20.0f, 30.0f}}, V3{{-20.0f, 10.0f, 0.0f}});
+        } break;
+
+        case BENCHMARK_OVERDRAW:
+        {
+            // 32 layers, each large enough to cover the screen from anywhere on the path
+            Scene->MaxDraws = 32;
+            Scene->Draws    = (BENCHMARK_DRAW *) BenchmarkAlloc(Scene, Arena, sizeof(BENCHMARK_DRAW) * Scene->MaxDraws, alignof(BENCHMARK_DRAW));
+            for(u32 i = 0; i < Scene->MaxDraws; ++i)
+            {
+                V3 Centre = {{0.0f, 0.0f, -(f32) i}};
+                V3 AxisU  = {{64.0f, 0.0f, 0.0f}};
+                V3 AxisV  = {{0.0f, 64.0f, 0.0f}};
+                GLuint Program = RenderInfo->ShaderPrograms[(i & 1) ? SHADER_FOG : 0];
+                BenchmarkAddQuad(Scene, RenderInfo, Centre, AxisU, AxisV, Program, 0);
+            }
+
+            BenchmarkAddKey(Scene, V3{{-2.0f, 0.0f, 8.0f}}, V3{{0.0f, 0.0f, -16.0f}});
+            BenchmarkAddKey(Scene, V3{{0.0f, 2.0f, 4.0f}}, V3{{0.0f, 0.0f, -16.0f}});
+            BenchmarkAddKey(Scene, V3{{2.0f, 0.0f, 8.0f}}, V3{{0.0f, 0.0f, -16.0f}});
+            BenchmarkAddKey(Scene, V3{{0.0f, -2.0f, 4.0f}}, V3{{0.0f, 0.0f, -16.0f}});
+        } break;
+
+        case BENCHMARK_VERTEX_HEAVY:
+        {
+            // 4 x 4 grids of 128 x 128 vertices (262k vertices, 516k triangles)
+            Scene->MaxDraws = 16;
+            Scene->Draws    = (BENCHMARK_DRAW *) BenchmarkAlloc(Scene, Arena, sizeof(BENCHMARK_DRAW) * Scene->MaxDraws, alignof(BENCHMARK_DRAW));
+            for(u32 i = 0; i < Scene->MaxDraws; ++i)
+            {
+                V3 Centre = {{((f32) (i % 4) - 1.5f) * 32.0f, 0.0f, ((f32) (i / 4) - 1.5f) * 32.0f}};
+                BenchmarkAddGrid(Scene, Arena, RenderInfo, Centre, 32.0f, 128, RenderInfo->ShaderPrograms[i % 2]);
+            }
+
+            // Low flyover
+            BenchmarkAddKey(Scene, V3{{-60.0f, 20.0f, -60.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{60.0f, 10.0f, -60.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{60.0f, 30.0f, 60.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+            BenchmarkAddKey(Scene, V3{{-60.0f, 10.0f, 60.0f}}, V3{{0.0f, 0.0f, 0.0f}});
+        } break;
+
+        case BENCHMARK_LEVEL:
+        {
+            if(!Level || !Level->Header)
+            {
+                return false;
+            }
+            Scene->Level = Level;
+
+            // Keys spread evenly over the empty leaves, each looking towards the next
+            u32 EmptyCount = 0;
+            for(u32 i = 0; i < Level->Header->LeafCount; ++i)
+            {
+                EmptyCount += !(Level->Leaves[i].Flags & LEVEL_LEAF_SOLID);
+            }
+            if(EmptyCount == 0)
+            {
+                return false;
+            }
+
+            V3 Keys[BENCHMARK_MAX_KEYS];
+            u32 KeyCount = (EmptyCount < BENCHMARK_MAX_KEYS) ? EmptyCount : BENCHMARK_MAX_KEYS;
+            u32 Empty = 0;
+            u32 Key = 0;
+            for(u32 i = 0; i < Level->Header->LeafCount && Key < KeyCount; ++i)
+            {
+                LEVEL_LEAF *Leaf = &Level->Leaves[i];
+                if(Leaf->Flags & LEVEL_LEAF_SOLID)
+                {
+                    continue;
+                }
+                if(Empty++ == (Key * EmptyCount) / KeyCount)
+                {
+                    Keys[Key++] = {{(Leaf->Min[0] + Leaf->Max[0]) * 0.5f, (Leaf->Min[1] + Leaf->Max[1]) * 0.5f, (Leaf->Min[2] + Leaf->Max[2]) * 0.5f}};
+                }
+            }
+            for(u32 i = 0; i < Key; ++i)
+            {
+                BenchmarkAddKey(Scene, Keys[i], Keys[(i + 1) % Key]);
+            }
+        } break;
+    }
+
+    Scene->SetupUploadBytes += RenderInfo->MeshPool.BytesUploaded - MeshBytes;
+    return true;
+}
+
+void BenchmarkSceneDestroy(BENCHMARK_SCENE *Scene, RENDERER *RenderInfo)
+{
+    for(u32 i = 0; i < Scene->DrawCount; ++i)
+    {
+        MeshPoolFree(&RenderInfo->MeshPool, &Scene->Draws[i].Mesh);
+    }
+    if(Scene->TextureCount)
+    {
+        glDeleteTextures(Scene->TextureCount, Scene->Textures);
+    }
+    *Scene = {};
+}
+
+// Moves the camera and pushes one frame of the scene into the render queue
+void BenchmarkScenePush(BENCHMARK_SCENE *Scene, RENDERER *RenderInfo, u32 Frame, u32 FrameCount)
+{
+    PROFILE_SCOPE("BenchmarkScenePush");
+
+    V3 Camera = {};
+    V3 Target = {};
+    BenchmarkCameraAt(&Scene->Path, Frame, FrameCount, &Camera, &Target);
+    RendererSetCamera(RenderInfo, Camera, Target, BENCHMARK_FIELD_OF_VIEW, BENCHMARK_NEAR, BENCHMARK_FAR);
+
+    // Rotate through the textures, rewriting a few each frame
+    for(u32 i = 0; i < Scene->TexturesPerFrame; ++i)
+    {
+        u32 Index = (Frame * Scene->TexturesPerFrame + i) % Scene->TextureCount;
+        BenchmarkFillTexture(Scene->Pixels, Index + Frame);
+        glTextureSubImage2D(Scene->Textures[Index], 0, 0, 0, BENCHMARK_TEXTURE_SIZE, BENCHMARK_TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, Scene->Pixels);
+        GLStateCount(GL_CALL_UPLOAD);
+        Scene->FrameUploadBytes += sizeof(u32) * BENCHMARK_TEXTURE_SIZE * BENCHMARK_TEXTURE_SIZE;
+    }
+
+    if(Scene->Level)
+    {
+        LevelPushVisible(Scene->Level, RenderInfo, Camera, LevelProgram(Scene->Level, RenderInfo), Scene->Level->Lightmap);
+        return;
+    }
+
+    for(u32 i = 0; i < Scene->DrawCount; ++i)
+    {
+        BENCHMARK_DRAW *Draw = &Scene->Draws[i];
+        f32 X = Draw->Centre.X - Camera.X;
+        f32 Y = Draw->Centre.Y - Camera.Y;
+        f32 Z = Draw->Centre.Z - Camera.Z;
+        f32 Depth = sqrtf(X * X + Y * Y + Z * Z) / BENCHMARK_FAR;
+        Depth = (Depth > 1.0f) ? 1.0f : Depth;
+
+        u64 SortKey = RenderSortKey(RENDER_PASS_OPAQUE, Draw->Program, Draw->Texture, RenderInfo->MeshPool.VertexArray, Depth);
+        RenderQueuePushMesh(&RenderInfo->Queue, SortKey, Draw->Program, 0, Draw->Texture, &RenderInfo->MeshPool, &Draw->Mesh);
+    }
+}
+
+int BenchmarkCompareFrameTimes(const void *A, const void *B)
+{
+    f32 X = *(const f32 *) A;
+    f32 Y = *(const f32 *) B;
+    return (X > Y) - (X < Y);
+}
+
+// Sorts FrameTimes (seconds) in place. DrawCalls and Packets are totals over the frames
+void BenchmarkResultCreate(BENCHMARK_RESULT *Result, BENCHMARK_SCENE *Scene, f32 *FrameTimes, u32 FrameCount, u64 DrawCalls, u64 Packets, u64 GLCalls)
+{
+    *Result = {};
+    FormatString(sizeof(Result->Scene), Result->Scene, "%s", BenchmarkSceneNames[Scene->Type]);
+    Result->Frames = FrameCount;
+    if(FrameCount == 0)
+    {
+        return;
+    }
+
+    qsort(FrameTimes, FrameCount, sizeof(f32), BenchmarkCompareFrameTimes);
+    f64 Total = 0;
+    for(u32 i = 0; i < FrameCount; ++i)
+    {
+        Total += FrameTimes[i];
+    }
+
+    f64 *Values = Result->Values;
+    Values[BENCHMARK_AVG_MS]                = (Total / (f64) FrameCount) * 1000.0;
+    Values[BENCHMARK_P50_MS]                = FrameTimes[(u32) ((f64) (FrameCount - 1) * 0.50)] * 1000.0;
+    Values[BENCHMARK_P90_MS]                = FrameTimes[(u32) ((f64) (FrameCount - 1) * 0.90)] * 1000.0;
+    Values[BENCHMARK_P99_MS]                = FrameTimes[(u32) ((f64) (FrameCount - 1) * 0.99)] * 1000.0;
+    Values[BENCHMARK_MAX_MS]                = FrameTimes[FrameCount - 1] * 1000.0;
+    Values[BENCHMARK_DRAW_CALLS]            = (f64) DrawCalls / (f64) FrameCount;
+    Values[BENCHMARK_PACKETS]               = (f64) Packets / (f64) FrameCount;
+    Values[BENCHMARK_SETUP_UPLOAD_BYTES]    = (f64) Scene->SetupUploadBytes;
+    Values[BENCHMARK_FRAME_UPLOAD_BYTES]    = (f64) Scene->FrameUploadBytes / (f64) FrameCount;
+    Values[BENCHMARK_PEAK_ARENA_BYTES]      = (f64) Scene->ArenaBytes;
+    Values[BENCHMARK_GL_CALLS]              = (f64) GLCalls / (f64) FrameCount;
+}
+
+void BenchmarkPrintResult(BENCHMARK_RESULT *Result)
+{
+    f64 *Values = Result->Values;
+    printf("suite: %-14s avg %8.3fms  p50 %8.3fms  p90 %8.3fms  p99 %8.3fms  max %8.3fms\t%.0f packets -> %.0f draw calls (%.0f GL calls)\t"
+           "upload %.2fMB + %.1fKB/frame\tarena %.2fMB\n",
+            Result->Scene, Values[BENCHMARK_AVG_MS], Values[BENCHMARK_P50_MS], Values[BENCHMARK_P90_MS], Values[BENCHMARK_P99_MS],
+            Values[BENCHMARK_MAX_MS], Values[BENCHMARK_PACKETS], Values[BENCHMARK_DRAW_CALLS], Values[BENCHMARK_GL_CALLS],
+            Values[BENCHMARK_SETUP_UPLOAD_BYTES] / (f64) Megabytes(1), Values[BENCHMARK_FRAME_UPLOAD_BYTES] / (f64) Kilobytes(1),
+            Values[BENCHMARK_PEAK_ARENA_BYTES] / (f64) Megabytes(1));
+}
+
+bool BenchmarkWriteResults(const char *Path, BENCHMARK_RESULT *Results, u32 Count)
+{
+    FILE *File = fopen(Path, "w");
+    if(!File)
+    {
+        return false;
+    }
+
+    fprintf(File, "scene,frames");
+    for(u32 i = 0; i < BENCHMARK_METRIC_COUNT; ++i)
+    {
+        fprintf(File, ",%s", BenchmarkMetrics[i].Name);
+    }
+    fprintf(File, "\n");
+
+    for(u32 i = 0; i < Count; ++i)
+    {
+        fprintf(File, "%s,%u", Results[i].Scene, Results[i].Frames);
+        for(u32 Metric = 0; Metric < BENCHMARK_METRIC_COUNT; ++Metric)
+        {
+            fprintf(File, ",%.6f", Results[i].Values[Metric]);
+        }
+        fprintf(File, "\n");
+    }
+
+    fclose(File);
+    return true;
+}
+
+// Columns are matched by name from the header, so baselines survive metrics being added or reordered
+u32 BenchmarkReadResults(const char *Path, BENCHMARK_RESULT *Results, u32 MaxResults)
+{
+    FILE *File = fopen(Path, "r");
+    if(!File)
+    {
+        return 0;
+    }
+
+    char Line[1024];
+    i32 Columns[BENCHMARK_METRIC_COUNT + 2];
+    u32 ColumnCount = 0;
+    if(fgets(Line, sizeof(Line), File))
+    {
+        for(char *Token = strtok(Line, ",\r\n"); Token && ColumnCount < ArrayCount(Columns); Token = strtok(0, ",\r\n"))
+        {
+            // -1 scene, -2 frames, -3 unknown
+            i32 Column = -3;
+            Column = (strcmp(Token, "scene") == 0) ? -1 : Column;
+            Column = (strcmp(Token, "frames") == 0) ? -2 : Column;
+            for(u32 Metric = 0; Metric < BENCHMARK_METRIC_COUNT; ++Metric)
+            {
+                Column = (strcmp(Token, BenchmarkMetrics[Metric].Name) == 0) ? (i32) Metric : Column;
+            }
+            Columns[ColumnCount++] = Column;
+        }
+    }
+
+    u32 Count = 0;
+    while(Count < MaxResults && fgets(Line, sizeof(Line), File))
+    {
+        BENCHMARK_RESULT *Result = &Results[Count];
+        *Result = {};
+        for(u32 i = 0; i < BENCHMARK_METRIC_COUNT; ++i)
+        {
+            Result->Values[i] = -1.0;   // Missing from the baseline
+        }
+
+        u32 Column = 0;
+        for(char *Token = strtok(Line, ",\r\n"); Token && Column < ColumnCount; Token = strtok(0, ",\r\n"), ++Column)
+        {
+            if(Columns[Column] == -1)
+            {
+                FormatString(sizeof(Result->Scene), Result->Scene, "%s", Token);
+            }
+            else if(Columns[Column] == -2)
+            {
+                Result->Frames = (u32) atoi(Token);
+            }
+            else if(Columns[Column] >= 0)
+            {
+                Result->Values[Columns[Column]] = atof(Token);
+            }
+        }
+        Count += (Result->Scene[0] != 0);
+    }
+
+    fclose(File);
+    return Count;
+}
+
+// Prints every metric against the baseline, returns how many regressed past their threshold
+u32 BenchmarkCompare(BENCHMARK_RESULT *Results, u32 Count, BENCHMARK_RESULT *Baseline, u32 BaselineCount, f64 *Thresholds)
+{
+    u32 Regressions = 0;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        BENCHMARK_RESULT *Result    = &Results[i];
+        BENCHMARK_RESULT *Base      = 0;
+        for(u32 j = 0; j < BaselineCount && !Base; ++j)
+        {
+            Base = (strcmp(Baseline[j].Scene, Result->Scene) == 0) ? &Baseline[j] : 0;
+        }
+        if(!Base)
+        {
+            printf("suite: %-14s not in baseline\n", Result->Scene);
+            continue;
+        }
+
+        for(u32 Metric = 0; Metric < BENCHMARK_METRIC_COUNT; ++Metric)
+        {
+            f64 Old = Base->Values[Metric];
+            f64 New = Result->Values[Metric];
+            if(Old < 0)
+            {
+                continue;
+            }
+
+            // Counts are compared exactly, with a little room for float formatting
+            f64 Allowed = Old * (1.0 + Thresholds[Metric]) + 1e-6;
+            bool Regressed = (Thresholds[Metric] >= 0) && (New > Allowed);
+            f64 Change = (Old > 0) ? ((New - Old) / Old) * 100.0 : 0.0;
+            Regressions += Regressed;
+            printf("suite: %-14s %-20s %14.3f -> %14.3f\t(%+6.1f%%)%s\n", Result->Scene, BenchmarkMetrics[Metric].Name, Old, New, Change,
+                    Regressed ? "\tREGRESSION" : "");
+        }
+    }
+
+    printf("suite: %u regression%s against baseline\n", Regressions, (Regressions == 1) ? "" : "s");
+    return Regressions;
+}
@@ -37,5 +37,12 @@ set Libs=-lUser32.lib -lGdi32.lib -lWinmm.lib -lopengl32.lib -lglew32.lib
 :: Run Clang compiler
 clang %CompilerFlags% %CommonWarnings% %CompilerOpt% %Libs% %PlatformFiles% -o %Platform%.exe
 
+:: Offline tools (optimised - level compiles, light bakes, texture encoding and pak compression are CPU bound)
+clang %CompilerFlags% %CommonWarnings% -O2 "%~dp0tools\bsp_compiler.cpp" -o bsp_compiler.exe
+clang %CompilerFlags% %CommonWarnings% -O2 "%~dp0tools\texture_cooker.cpp" -o texture_cooker.exe
+clang %CompilerFlags% %CommonWarnings% -O2 "%~dp0tools\lightmap_baker.cpp" -o lightmap_baker.exe
+clang %CompilerFlags% %CommonWarnings% -O2 "%~dp0tools\pak_builder.cpp" -o pak_builder.exe
+clang %CompilerFlags% %CommonWarnings% -O2 "%~dp0tools\world_builder.cpp" -o world_builder.exe
+
 :: Exit
 popd
\ No newline at end of file
@@ -0,0 +1,48 @@
+#!/bin/bash
+# Clang x64
+
+# Set name of the platform .cpp file for unity building
+Platform=linux_dark
+
+# Set build directory relative to this script
+CodeDir="$(cd "$(dirname "$0")" && pwd)"
+BuildDir="$CodeDir/../build/linux"
+
+# Create build path if it doesn't exist
+mkdir -p "$BuildDir"
+
+# Move to build directory
+pushd "$BuildDir" > /dev/null
+
+# Set compiler arguments
+PlatformFiles="$CodeDir/$Platform.cpp"
+
+# Set compiler flags:
+CompilerFlags="-g -pedantic -std=c++17"
+
+# Set warning labels:
+CommonWarnings="-Wall -Werror -Wno-writable-strings -Wno-gnu-anonymous-struct"
+
+# Set Compiler optimsation level
+# CompilerOpt="-O3 -march=native"
+CompilerOpt="-O0"
+
+# Set linux libraries
+Libs="-lEGL -lOpenGL -lpthread -lm"
+
+# Copy shaders next to the executable (loaded relative to the working directory)
+mkdir -p data/shaders
+cp "$CodeDir"/shaders/*.glsl data/shaders/
+
+# Run Clang compiler
+clang++ $CompilerFlags $CommonWarnings $CompilerOpt "$PlatformFiles" -o $Platform $Libs
+
+# Offline tools (optimised - level compiles, light bakes, texture encoding and pak compression are CPU bound)
+clang++ $CompilerFlags $CommonWarnings -O2 "$CodeDir/tools/bsp_compiler.cpp" -o bsp_compiler -lpthread -lm
+clang++ $CompilerFlags $CommonWarnings -O2 "$CodeDir/tools/texture_cooker.cpp" -o texture_cooker -lpthread -lm
+clang++ $CompilerFlags $CommonWarnings -O2 "$CodeDir/tools/lightmap_baker.cpp" -o lightmap_baker -lpthread -lm
+clang++ $CompilerFlags $CommonWarnings -O2 "$CodeDir/tools/pak_builder.cpp" -o pak_builder
+clang++ $CompilerFlags $CommonWarnings -O2 "$CodeDir/tools/world_builder.cpp" -o world_builder -lm
+
+# Exit
+popd > /dev/null
@@ -0,0 +1,71 @@
+// Cooked texture file format
+// Written offline by tools/texture_cooker.cpp, streamed at runtime by textures.cpp. Level data is already in the layout
+// glTexSubImage2D/glCompressedTexSubImage2D expect (bottom row first), so loading is a read and an upload.
+// All offsets are bytes from the start of the data that follows the header.
+#pragma once
+
+#define COOKED_TEXTURE_MAGIC        0x58455444 // 'DTEX'
+#define COOKED_TEXTURE_VERSION      1
+#define COOKED_TEXTURE_MAX_LEVELS   16
+#define COOKED_PALETTE_SIZE         (256 * 4)
+
+typedef enum COOKED_FORMAT
+{
+    COOKED_FORMAT_RGBA8,
+    COOKED_FORMAT_PALETTE8,     // One byte per texel indexing the RGBA8 palette stored after the levels
+    COOKED_FORMAT_BC1,          // 8 bytes per 4x4 block, 1 bit alpha
+    COOKED_FORMAT_BC7,          // 16 bytes per 4x4 block
+    COOKED_FORMAT_COUNT,
+} COOKED_FORMAT;
+
+typedef struct COOKED_TEXTURE_LEVEL
+{
+    u32 Width;
+    u32 Height;
+    u32 Offset;
+    u32 Size;
+} COOKED_TEXTURE_LEVEL;
+
+typedef struct COOKED_TEXTURE_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u32 Format;
+    u32 Width;
+    u32 Height;
+    u32 LevelCount;
+    u32 DataSize;               // Everything after the header, palette included
+    u32 PaletteOffset;          // PALETTE8 only
+    u64 PaletteHash;            // Textures cooked together share a palette (and hash)
+    COOKED_TEXTURE_LEVEL Levels[COOKED_TEXTURE_MAX_LEVELS];
+} COOKED_TEXTURE_HEADER;
+
+// Texel block dimensions and size for a format
+inline u32 CookedBlockSize(u32 Format)
+{
+    return (Format == COOKED_FORMAT_BC1 || Format == COOKED_FORMAT_BC7) ? 4 : 1;
+}
+
+inline u32 CookedBlockBytes(u32 Format)
+{
+    switch(Format)
+    {
+        case COOKED_FORMAT_PALETTE8:    return 1;
+        case COOKED_FORMAT_BC1:         return 8;
+        case COOKED_FORMAT_BC7:         return 16;
+        default:                        return 4;
+    }
+}
+
+// Bytes in one row of blocks
+inline u32 CookedRowBytes(u32 Format, u32 Width)
+{
+    u32 Block = CookedBlockSize(Format);
+    return ((Width + Block - 1) / Block) * CookedBlockBytes(Format);
+}
+
+inline u32 CookedLevelBytes(u32 Format, u32 Width, u32 Height)
+{
+    u32 Block = CookedBlockSize(Format);
+    return CookedRowBytes(Format, Width) * ((Height + Block - 1) / Block);
+}
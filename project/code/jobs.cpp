@@ -0,0 +1,507 @@
+// Job system
+// One worker per hardware thread, the thread that creates the system is worker 0. Each worker owns a fixed-size
+// Chase-Lev deque: it pushes and pops its own jobs at the bottom (LIFO, cache warm) while idle workers steal from the
+// top of a random victim (FIFO, the largest pieces of work). Waiting on a counter runs other jobs instead of blocking.
+// Jobs and their data come from the submitting worker's arena slice, split into a few generations - each frame the
+// worker moves on to a generation with nothing left in flight, so a long job only pins the one it was allocated from.
+// GL calls go through a separate queue that only worker 0 (the thread owning the context) drains, and file I/O through
+// a background queue that every other worker drains - so the frame thread never blocks on a read while it waits.
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define JOB_MAX_WORKERS         64
+#define JOB_DEQUE_SIZE          4096        // Per worker - must be a power of two
+#define JOB_MAIN_QUEUE_SIZE     1024
+#define JOB_BACKGROUND_QUEUE_SIZE 1024
+#define JOB_SPIN_COUNT          256         // Empty steal rounds before a worker sleeps
+#define JOB_ARENA_GENERATIONS   4           // Per worker slice
+#define JOB_NO_WORKER           0xFFFFFFFF
+
+typedef std::atomic<i32> JOB_COUNTER;
+typedef void JOB_FUNCTION(void *Data);
+typedef void JOB_RANGE_FUNCTION(void *Data, u32 Start, u32 End);
+
+typedef struct JOB_ARENA
+{
+    MEMORY_ARENA Arena;
+    std::atomic<i32> InFlight;  // Jobs allocated from here that haven't finished - only reset at zero
+} JOB_ARENA;
+
+typedef struct JOB
+{
+    JOB_FUNCTION *Function;
+    void *Data;
+    JOB_COUNTER *Counter;       // Decremented once the job has run, can be null
+    JOB_ARENA *Arena;           // The generation it was allocated from
+} JOB;
+
+typedef struct JOB_WORKER
+{
+    // Owner and thieves hit different ends - keep them off each other's cache lines
+    alignas(64) std::atomic<i64> Top;
+    alignas(64) std::atomic<i64> Bottom;
+    std::atomic<JOB *> *Jobs;
+
+    // Owner only - allocates from and resets its own generations
+    JOB_ARENA Arenas[JOB_ARENA_GENERATIONS];
+    u32 Current;
+    u64 Generation;
+
+    std::thread Thread;
+    u32 Seed;
+
+    // Stats
+    u64 Executed;
+    u64 Stolen;
+} JOB_WORKER;
+
+typedef struct JOB_SYSTEM
+{
+    JOB_WORKER Workers[JOB_MAX_WORKERS];
+    u32 WorkerCount;
+
+    // Bumped by JobSystemUpdate - workers move to a free arena generation when it changes
+    std::atomic<u64> Generation;
+
+    // Idle workers sleep until something is pushed
+    std::atomic<i32> Queued;
+    std::atomic<u32> Sleeping;
+    std::mutex SleepLock;
+    std::condition_variable Wake;
+    std::atomic<bool> Quit;
+
+    // Main thread only (GL)
+    std::mutex MainLock;
+    JOB *MainJobs[JOB_MAIN_QUEUE_SIZE];
+    u32 MainRead;
+    u32 MainWrite;
+
+    // Every worker but 0, unless it's the only one (I/O)
+    std::mutex BackgroundLock;
+    JOB *BackgroundJobs[JOB_BACKGROUND_QUEUE_SIZE];
+    u32 BackgroundRead;
+    u32 BackgroundWrite;
+} JOB_SYSTEM;
+
+// Index into JOB_SYSTEM::Workers for the calling thread - other threads can't submit jobs
+static thread_local u32 JobWorkerIndex = JOB_NO_WORKER;
+
+bool JobDequePush(JOB_WORKER *Worker, JOB *Job)
+{
+    i64 Bottom  = Worker->Bottom.load(std::memory_order_relaxed);
+    i64 Top     = Worker->Top.load(std::memory_order_acquire);
+    if(Bottom - Top >= JOB_DEQUE_SIZE)
+    {
+        return false;
+    }
+
+    Worker->Jobs[Bottom & (JOB_DEQUE_SIZE - 1)].store(Job, std::memory_order_relaxed);
+    Worker->Bottom.store(Bottom + 1, std::memory_order_release);
+    return true;
+}
+
+// Owner only
+JOB *JobDequePop(JOB_WORKER *Worker)
+{
+    i64 Bottom = Worker->Bottom.load(std::memory_order_relaxed) - 1;
+    Worker->Bottom.store(Bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 Top = Worker->Top.load(std::memory_order_relaxed);
+
+    if(Top > Bottom)
+    {
+        // Empty
+        Worker->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    JOB *Result = Worker->Jobs[Bottom & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if(Top == Bottom)
+    {
+        // Last job - race any thief for it
+        if(!Worker->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            Result = 0;
+        }
+        Worker->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    }
+    return Result;
+}
+
+// Any thread - null when empty or another thief won
+JOB *JobDequeSteal(JOB_WORKER *Worker)
+{
+    i64 Top = Worker->Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 Bottom = Worker->Bottom.load(std::memory_order_acquire);
+    if(Top >= Bottom)
+    {
+        return 0;
+    }
+
+    JOB *Result = Worker->Jobs[Top & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if(!Worker->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return 0;
+    }
+    return Result;
+}
+
+void JobExecute(JOB_SYSTEM *System, JOB *Job)
+{
+    // The job lives in an arena generation that can be reset as soon as its InFlight hits zero - read it first
+    JOB_COUNTER *Counter    = Job->Counter;
+    JOB_ARENA *Arena        = Job->Arena;
+    Job->Function(Job->Data);
+    ++System->Workers[JobWorkerIndex].Executed;
+
+    // Nothing a waiter can see finished is still counted as in flight
+    Arena->InFlight.fetch_sub(1, std::memory_order_release);
+    if(Counter)
+    {
+        Counter->fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// Runs queued GL jobs - worker 0 only
+bool JobRunMainThreadJobs(JOB_SYSTEM *System)
+{
+    bool Ran = false;
+    while(true)
+    {
+        JOB *Job = 0;
+        {
+            std::lock_guard<std::mutex> Guard(System->MainLock);
+            if(System->MainRead == System->MainWrite)
+            {
+                break;
+            }
+            Job = System->MainJobs[System->MainRead++ % JOB_MAIN_QUEUE_SIZE];
+        }
+        JobExecute(System, Job);
+        Ran = true;
+    }
+    return Ran;
+}
+
+// Runs the oldest queued background job. Returns false if there wasn't one
+bool JobRunOneBackground(JOB_SYSTEM *System)
+{
+    JOB *Job = 0;
+    {
+        std::lock_guard<std::mutex> Guard(System->BackgroundLock);
+        if(System->BackgroundRead == System->BackgroundWrite)
+        {
+            return false;
+        }
+        Job = System->BackgroundJobs[System->BackgroundRead++ % JOB_BACKGROUND_QUEUE_SIZE];
+    }
+    System->Queued.fetch_sub(1, std::memory_order_relaxed);
+    JobExecute(System, Job);
+    return true;
+}
+
+// Own deque first, then steal starting from a random victim, then background jobs - never on worker 0 while there
+// are others to take them. Returns false if there was nothing to do
+bool JobRunOne(JOB_SYSTEM *System)
+{
+    u32 Index = JobWorkerIndex;
+    JOB_WORKER *Worker = &System->Workers[Index];
+    JOB *Job = JobDequePop(Worker);
+
+    if(!Job && System->WorkerCount > 1)
+    {
+        Worker->Seed = Worker->Seed * 1664525 + 1013904223;
+        u32 Start = (Worker->Seed >> 8) % System->WorkerCount;
+        for(u32 i = 0; i < System->WorkerCount && !Job; ++i)
+        {
+            u32 Victim = (Start + i) % System->WorkerCount;
+            if(Victim != Index)
+            {
+                Job = JobDequeSteal(&System->Workers[Victim]);
+                Worker->Stolen += (Job != 0);
+            }
+        }
+    }
+
+    if(!Job)
+    {
+        if((Index != 0 || System->WorkerCount == 1) && JobRunOneBackground(System))
+        {
+            return true;
+        }
+        return (Index == 0) ? JobRunMainThreadJobs(System) : false;
+    }
+
+    System->Queued.fetch_sub(1, std::memory_order_relaxed);
+    JobExecute(System, Job);
+    return true;
+}
+
+// Owner only, outside any job - once per generation, moves on to the next arena with nothing in flight and resets it.
+// If every other one is still pinned by a long job, keeps allocating from the current one
+void JobWorkerAdvance(JOB_SYSTEM *System, JOB_WORKER *Worker)
+{
+    u64 Generation = System->Generation.load(std::memory_order_relaxed);
+    if(Worker->Generation == Generation)
+    {
+        return;
+    }
+    Worker->Generation = Generation;
+
+    for(u32 i = 1; i < JOB_ARENA_GENERATIONS; ++i)
+    {
+        u32 Next = (Worker->Current + i) % JOB_ARENA_GENERATIONS;
+        JOB_ARENA *Arena = &Worker->Arenas[Next];
+        if(Arena->InFlight.load(std::memory_order_acquire) == 0)
+        {
+            Arena->Arena.FreeAll();
+            Worker->Current = Next;
+            return;
+        }
+    }
+}
+
+void JobWorkerLoop(JOB_SYSTEM *System, u32 Index)
+{
+    JobWorkerIndex = Index;
+    ProfilerSetThreadName("Job worker");
+
+    u32 Idle = 0;
+    while(!System->Quit.load(std::memory_order_relaxed))
+    {
+        JobWorkerAdvance(System, &System->Workers[Index]);
+        if(JobRunOne(System))
+        {
+            Idle = 0;
+            continue;
+        }
+
+        if(++Idle < JOB_SPIN_COUNT)
+        {
+            _mm_pause();
+            continue;
+        }
+
+        // Queued is raised before the wake-up, so checking it under the lock can't miss one
+        std::unique_lock<std::mutex> Guard(System->SleepLock);
+        System->Sleeping.fetch_add(1, std::memory_order_seq_cst);
+        System->Wake.wait(Guard, [System] { return System->Queued.load(std::memory_order_seq_cst) > 0 || System->Quit.load(std::memory_order_relaxed); });
+        System->Sleeping.fetch_sub(1, std::memory_order_relaxed);
+        Idle = 0;
+    }
+}
+
+// WorkerCount = 0 uses every hardware thread. Each worker gets ArenaSlice bytes of Arena for job allocations, split
+// evenly between its generations
+void JobSystemCreate(JOB_SYSTEM *System, MEMORY_ARENA *Arena, u32 WorkerCount, size_t ArenaSlice)
+{
+    if(WorkerCount == 0)
+    {
+        WorkerCount = std::thread::hardware_concurrency();
+    }
+    WorkerCount = (WorkerCount < 1) ? 1 : ((WorkerCount > JOB_MAX_WORKERS) ? JOB_MAX_WORKERS : WorkerCount);
+    System->WorkerCount = WorkerCount;
+
+    for(u32 i = 0; i < WorkerCount; ++i)
+    {
+        JOB_WORKER *Worker = &System->Workers[i];
+        Worker->Jobs = (std::atomic<JOB *> *) Arena->Alloc(sizeof(std::atomic<JOB *>) * JOB_DEQUE_SIZE, 64);
+        Assert(Worker->Jobs, "Jobs: Failed to allocate worker memory!");
+        size_t GenerationSize = (ArenaSlice / JOB_ARENA_GENERATIONS) & ~(size_t) 63;
+        for(u32 Generation = 0; Generation < JOB_ARENA_GENERATIONS; ++Generation)
+        {
+            void *Slice = Arena->Alloc(GenerationSize, 64);
+            Assert(Slice, "Jobs: Failed to allocate worker memory!");
+            Worker->Arenas[Generation].Arena.Init(Slice, GenerationSize);
+        }
+        Worker->Seed = i + 1;
+    }
+
+    // The creating thread is worker 0
+    JobWorkerIndex = 0;
+    for(u32 i = 1; i < WorkerCount; ++i)
+    {
+        System->Workers[i].Thread = std::thread(JobWorkerLoop, System, i);
+    }
+}
+
+// Waits for every worker to exit - jobs still queued are dropped
+void JobSystemDestroy(JOB_SYSTEM *System)
+{
+    {
+        std::lock_guard<std::mutex> Guard(System->SleepLock);
+        System->Quit.store(true);
+    }
+    System->Wake.notify_all();
+
+    for(u32 i = 1; i < System->WorkerCount; ++i)
+    {
+        System->Workers[i].Thread.join();
+    }
+}
+
+// From the calling worker's current arena generation - lives as long as a job created right after it, so submit the
+// job that uses it before waiting on anything
+void *JobAlloc(JOB_SYSTEM *System, size_t Size)
+{
+    Assert(JobWorkerIndex < System->WorkerCount, "Jobs: Submitted from a thread that isn't a worker!");
+    JOB_WORKER *Worker = &System->Workers[JobWorkerIndex];
+    void *Result = Worker->Arenas[Worker->Current].Arena.Alloc(Size, 16);
+    Assert(Result, "Jobs: Worker arena slice is full!");
+    return Result;
+}
+
+JOB *JobCreate(JOB_SYSTEM *System, JOB_FUNCTION *Function, void *Data, JOB_COUNTER *Counter)
+{
+    JOB_WORKER *Worker = &System->Workers[JobWorkerIndex];
+    JOB *Job        = (JOB *) JobAlloc(System, sizeof(JOB));
+    Job->Function   = Function;
+    Job->Data       = Data;
+    Job->Counter    = Counter;
+    Job->Arena      = &Worker->Arenas[Worker->Current];
+    if(Counter)
+    {
+        Counter->fetch_add(1, std::memory_order_relaxed);
+    }
+    Job->Arena->InFlight.fetch_add(1, std::memory_order_relaxed);
+    return Job;
+}
+
+// After a job is queued - raises Queued and wakes a sleeping worker for it
+void JobWake(JOB_SYSTEM *System)
+{
+    System->Queued.fetch_add(1, std::memory_order_seq_cst);
+    if(System->Sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> Guard(System->SleepLock);
+        }
+        System->Wake.notify_one();
+    }
+}
+
+// Callable from worker threads and jobs. Counter (if any) reaches zero once every job run against it has finished
+void JobRun(JOB_SYSTEM *System, JOB_FUNCTION *Function, void *Data, JOB_COUNTER *Counter)
+{
+    JOB *Job = JobCreate(System, Function, Data, Counter);
+
+    // Full deque - run it here rather than fail
+    if(!JobDequePush(&System->Workers[JobWorkerIndex], Job))
+    {
+        JobExecute(System, Job);
+        return;
+    }
+    JobWake(System);
+}
+
+// For jobs that block on I/O. Only workers other than 0 run them, so the frame thread never ends up reading a file
+// while it waits on a counter - with a single worker they run from JobSystemUpdate (or a wait) instead
+void JobRunBackground(JOB_SYSTEM *System, JOB_FUNCTION *Function, void *Data, JOB_COUNTER *Counter)
+{
+    JOB *Job = JobCreate(System, Function, Data, Counter);
+    {
+        std::lock_guard<std::mutex> Guard(System->BackgroundLock);
+        Assert(System->BackgroundWrite - System->BackgroundRead < JOB_BACKGROUND_QUEUE_SIZE, "Jobs: Background queue is full!");
+        System->BackgroundJobs[System->BackgroundWrite++ % JOB_BACKGROUND_QUEUE_SIZE] = Job;
+    }
+    JobWake(System);
+}
+
+// Queues a job that only runs on worker 0 - from JobSystemUpdate or while it waits on a counter
+void JobRunMainThread(JOB_SYSTEM *System, JOB_FUNCTION *Function, void *Data, JOB_COUNTER *Counter)
+{
+    JOB *Job = JobCreate(System, Function, Data, Counter);
+
+    std::lock_guard<std::mutex> Guard(System->MainLock);
+    Assert(System->MainWrite - System->MainRead < JOB_MAIN_QUEUE_SIZE, "Jobs: Main thread queue is full!");
+    System->MainJobs[System->MainWrite++ % JOB_MAIN_QUEUE_SIZE] = Job;
+}
+
+// Helps run jobs until Counter reaches zero
+void JobWait(JOB_SYSTEM *System, JOB_COUNTER *Counter)
+{
+    PROFILE_SCOPE("JobWait");
+    while(Counter->load(std::memory_order_acquire) > 0)
+    {
+        if(!JobRunOne(System))
+        {
+            _mm_pause();
+        }
+    }
+}
+
+typedef struct JOB_RANGE
+{
+    JOB_SYSTEM *System;
+    JOB_RANGE_FUNCTION *Function;
+    void *Data;
+    u32 Start;
+    u32 End;
+    u32 BatchSize;
+    JOB_COUNTER *Counter;
+} JOB_RANGE;
+
+// Splits in half until a batch is small enough, pushing the top half each time - thieves take the biggest pieces
+void JobRangeSplit(void *Data)
+{
+    JOB_RANGE *Range = (JOB_RANGE *) Data;
+    u32 Start = Range->Start;
+    u32 End = Range->End;
+    while(End - Start > Range->BatchSize)
+    {
+        u32 Middle = Start + (End - Start) / 2;
+        JOB_RANGE *Half = (JOB_RANGE *) JobAlloc(Range->System, sizeof(JOB_RANGE));
+        *Half       = *Range;
+        Half->Start = Middle;
+        Half->End   = End;
+        JobRun(Range->System, JobRangeSplit, Half, Range->Counter);
+        End = Middle;
+    }
+    Range->Function(Range->Data, Start, End);
+}
+
+// Calls Function over [0, Count) in batches of at most BatchSize across every worker, returns once all have run
+void JobParallelFor(JOB_SYSTEM *System, u32 Count, u32 BatchSize, JOB_RANGE_FUNCTION *Function, void *Data)
+{
+    if(Count == 0)
+    {
+        return;
+    }
+
+    BatchSize = (BatchSize > 0) ? BatchSize : 1;
+    if(Count <= BatchSize || System->WorkerCount == 1)
+    {
+        Function(Data, 0, Count);
+        return;
+    }
+
+    JOB_COUNTER Counter(0);
+    JOB_RANGE *Range    = (JOB_RANGE *) JobAlloc(System, sizeof(JOB_RANGE));
+    Range->System       = System;
+    Range->Function     = Function;
+    Range->Data         = Data;
+    Range->Start        = 0;
+    Range->End          = Count;
+    Range->BatchSize    = BatchSize;
+    Range->Counter      = &Counter;
+    JobRun(System, JobRangeSplit, Range, &Counter);
+    JobWait(System, &Counter);
+}
+
+// Worker 0, once per frame outside any job - runs GL jobs and starts a new arena generation
+void JobSystemUpdate(JOB_SYSTEM *System)
+{
+    JobRunMainThreadJobs(System);
+
+    // No other worker to steal what worker 0 queued
+    if(System->WorkerCount == 1)
+    {
+        while(JobRunOne(System));
+    }
+
+    System->Generation.fetch_add(1, std::memory_order_relaxed);
+    JobWorkerAdvance(System, &System->Workers[0]);
+}
@@ -0,0 +1,377 @@
+// BSP levels
+// Loads a level compiled by tools/bsp_compiler.cpp into the mesh pool, then each frame finds the camera's leaf
+// and submits only the leaves in its potentially visible set - one packet per leaf, batched by the render queue.
+// With occlusion enabled the large triangles of those leaves are rasterized as occluders first, and leaves hidden
+// behind them are skipped.
+#include "level.h"
+
+#define LEVEL_SORT_DISTANCE     1024.0f
+#define LEVEL_OCCLUDER_AREA     0.5f        // Smallest triangle (world units squared) used as an occluder
+
+typedef struct LEVEL_STATS
+{
+    u32 VisibleLeaves;
+    u32 DrawnLeaves;
+    u32 TrianglesDrawn;
+    u32 TrianglesTotal;
+    u32 OccludedLeaves;     // Visible by the PVS, hidden or off screen by the occlusion test
+} LEVEL_STATS;
+
+// Bounds of a leaf's triangles - the leaf's own bounds come from its portals and needn't contain them
+typedef struct LEVEL_BOUNDS
+{
+    f32 Min[3];
+    f32 Max[3];
+} LEVEL_BOUNDS;
+
+typedef struct LEVEL
+{
+    LEVEL_HEADER    *Header;
+    LEVEL_PLANE     *Planes;
+    LEVEL_NODE      *Nodes;
+    LEVEL_LEAF      *Leaves;
+    u8              *Visibility;
+
+    // Decompressed row for the camera leaf - only rebuilt when the camera changes leaf
+    u8              *VisibleRow;
+    u32             RowBytes;
+    u32             CameraLeaf;
+
+    MESH            Mesh;
+    GLuint          Lightmap;       // 0 until the level is baked
+    LEVEL_STATS     Stats;
+
+    // Optional - set by LevelEnableOcclusion. Occluders are 9 floats per triangle, grouped by leaf
+    OCCLUSION_CULLER *Occlusion;
+    LEVEL_BOUNDS    *LeafBounds;
+    f32             *Occluders;
+    u32             *LeafOccluders; // First occluder of each leaf, LeafCount + 1
+} LEVEL;
+
+bool LevelLoad(LEVEL *Level, MEMORY_ARENA *Arena, RENDERER *RenderInfo, const char *Path)
+{
+    *Level = {};
+
+    ASSET File = {};
+    if(!AssetOpen(&File, Path))
+    {
+        printf("Level: Failed to open %s\n", Path);
+        return false;
+    }
+    size_t Size = File.Size;
+
+    // The file stays resident - the tree, leaves and visibility are used in place, straight from the archive mapping when
+    // it's stored uncompressed there (nothing below writes to it)
+    u8 *Data = (u8 *) File.Mapped;
+    bool Read = Size >= sizeof(LEVEL_HEADER);
+    if(Read && !Data)
+    {
+        Data = (u8 *) Arena->Alloc(Size, 16);
+        Read = Data && AssetRead(&File, Data);
+    }
+    AssetClose(&File);
+    if(!Read)
+    {
+        printf("Level: Failed to read %s\n", Path);
+        return false;
+    }
+
+    LEVEL_HEADER *Header = (LEVEL_HEADER *) Data;
+    if(Header->Magic != LEVEL_MAGIC || Header->Version != LEVEL_VERSION)
+    {
+        printf("Level: %s is not a version %u level\n", Path, LEVEL_VERSION);
+        return false;
+    }
+
+    u32 Offsets[]   = {Header->PlaneOffset, Header->NodeOffset, Header->LeafOffset, Header->VertexOffset, Header->IndexOffset, Header->VisibilityOffset,
+                       Header->LightmapOffset};
+    u64 Sizes[]     = {(u64) sizeof(LEVEL_PLANE) * Header->PlaneCount, (u64) sizeof(LEVEL_NODE) * Header->NodeCount, (u64) sizeof(LEVEL_LEAF) * Header->LeafCount,
+                       (u64) sizeof(LEVEL_VERTEX) * Header->VertexCount, (u64) sizeof(u32) * Header->IndexCount, Header->VisibilityBytes,
+                       (u64) Header->LightmapWidth * Header->LightmapHeight * 4};
+    for(u32 i = 0; i < ArrayCount(Offsets); ++i)
+    {
+        if((u64) Offsets[i] + Sizes[i] > Size)
+        {
+            printf("Level: %s is truncated\n", Path);
+            return false;
+        }
+    }
+    if(Header->NodeCount == 0 || Header->LeafCount == 0)
+    {
+        printf("Level: %s has no tree\n", Path);
+        return false;
+    }
+
+    LEVEL_NODE *Nodes   = (LEVEL_NODE *) (Data + Header->NodeOffset);
+    LEVEL_LEAF *Leaves  = (LEVEL_LEAF *) (Data + Header->LeafOffset);
+    u32 *Indices        = (u32 *) (Data + Header->IndexOffset);
+    u8 *Visibility      = Data + Header->VisibilityOffset;
+    u32 RowBytes        = (Header->LeafCount + 7) / 8;
+    u8 *VisibleRow      = (u8 *) Arena->Alloc(RowBytes, 16);
+    Assert(VisibleRow, "Level: Failed to allocate visibility row!");
+
+    // Everything the tree walk, the PVS and the draws index with is checked here, so a corrupt file can't read out of
+    // bounds later. The compiler numbers children after their parent, so requiring that means the walk always ends
+    for(u32 i = 0; i < Header->NodeCount; ++i)
+    {
+        bool Valid = Nodes[i].Plane < Header->PlaneCount;
+        for(u32 Side = 0; Side < 2; ++Side)
+        {
+            i32 Child = Nodes[i].Children[Side];
+            Valid = Valid && ((Child >= 0) ? ((u32) Child > i && (u32) Child < Header->NodeCount) : ((u32) (-(Child + 1)) < Header->LeafCount));
+        }
+        if(!Valid)
+        {
+            printf("Level: %s has a corrupt node %u\n", Path, i);
+            return false;
+        }
+    }
+    for(u32 i = 0; i < Header->IndexCount; ++i)
+    {
+        if(Indices[i] >= Header->VertexCount)
+        {
+            printf("Level: %s has an index past its %u vertices\n", Path, Header->VertexCount);
+            return false;
+        }
+    }
+    for(u32 i = 0; i < Header->LeafCount; ++i)
+    {
+        u32 Offset = Leaves[i].VisibilityOffset;
+        bool Valid = (u64) Leaves[i].FirstIndex + Leaves[i].IndexCount <= Header->IndexCount;
+        Valid = Valid && (Offset == LEVEL_NO_VISIBILITY ||
+                          (Offset < Header->VisibilityBytes && LevelDecompressRow(Visibility + Offset, Header->VisibilityBytes - Offset, VisibleRow, RowBytes)));
+        if(!Valid)
+        {
+            printf("Level: %s has a corrupt leaf %u\n", Path, i);
+            return false;
+        }
+    }
+
+    Level->Header       = Header;
+    Level->Planes       = (LEVEL_PLANE *) (Data + Header->PlaneOffset);
+    Level->Nodes        = Nodes;
+    Level->Leaves       = Leaves;
+    Level->Visibility   = Visibility;
+    Level->RowBytes     = RowBytes;
+    Level->VisibleRow   = VisibleRow;
+    Level->CameraLeaf   = LEVEL_NO_VISIBILITY;
+
+    // One mesh for the whole level - leaves draw sub-ranges of its indices
+    if(!MeshPoolAlloc(&RenderInfo->MeshPool, Header->VertexCount, Header->IndexCount, &Level->Mesh))
+    {
+        printf("Level: %s does not fit in the mesh pool (%u vertices, %u indices)\n", Path, Header->VertexCount, Header->IndexCount);
+        return false;
+    }
+
+    LEVEL_VERTEX *Vertices  = (LEVEL_VERTEX *) (Data + Header->VertexOffset);
+    MEMORY_SCRATCH Scratch;
+    VERTEX_PACKED *Packed   = (VERTEX_PACKED *) VirtualArenaAlloc(Scratch.Arena, sizeof(VERTEX_PACKED) * Header->VertexCount, 16);
+    Assert(Packed, "Level: Failed to allocate packed vertices!");
+    for(u32 i = 0; i < Header->VertexCount; ++i)
+    {
+        V3 Position = {{Vertices[i].Position[0], Vertices[i].Position[1], Vertices[i].Position[2]}};
+        V3 Normal   = {{Vertices[i].Normal[0], Vertices[i].Normal[1], Vertices[i].Normal[2]}};
+        V2 UV       = {{Vertices[i].UV[0], Vertices[i].UV[1]}};
+        V2 Lightmap = {{Vertices[i].LightmapUV[0], Vertices[i].LightmapUV[1]}};
+        Packed[i] = PackVertex(&RenderInfo->MeshPool, Position, Normal, UV, Lightmap);
+    }
+    MeshPoolUpload(&RenderInfo->MeshPool, &Level->Mesh, Packed, Indices);
+
+    // Baked light - filtered, and clamped so chart borders don't wrap across the atlas
+    if(Header->LightmapWidth && Header->LightmapHeight)
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &Level->Lightmap);
+        glTextureStorage2D(Level->Lightmap, 1, GL_RGBA8, Header->LightmapWidth, Header->LightmapHeight);
+        glTextureParameteri(Level->Lightmap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(Level->Lightmap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(Level->Lightmap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(Level->Lightmap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureSubImage2D(Level->Lightmap, 0, 0, 0, Header->LightmapWidth, Header->LightmapHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                            Data + Header->LightmapOffset);
+    }
+
+    return true;
+}
+
+// Picks each leaf's occluders (its larger triangles) and bounds once, straight from the resident file
+void LevelEnableOcclusion(LEVEL *Level, MEMORY_ARENA *Arena, OCCLUSION_CULLER *Occlusion)
+{
+    LEVEL_HEADER *Header    = Level->Header;
+    LEVEL_VERTEX *Vertices  = (LEVEL_VERTEX *) ((u8 *) Header + Header->VertexOffset);
+    u32 *Indices            = (u32 *) ((u8 *) Header + Header->IndexOffset);
+
+    Level->LeafBounds       = (LEVEL_BOUNDS *) Arena->Alloc(sizeof(LEVEL_BOUNDS) * Header->LeafCount, 16);
+    Level->LeafOccluders    = (u32 *) Arena->Alloc(sizeof(u32) * (Header->LeafCount + 1), 16);
+    Assert(Level->LeafBounds && Level->LeafOccluders, "Level: Failed to allocate occlusion bounds!");
+
+    // Counted first, then filled
+    u32 Total = 0;
+    for(u32 Pass = 0; Pass < 2; ++Pass)
+    {
+        u32 Count = 0;
+        for(u32 i = 0; i < Header->LeafCount; ++i)
+        {
+            LEVEL_LEAF *Leaf        = &Level->Leaves[i];
+            LEVEL_BOUNDS *Bounds    = &Level->LeafBounds[i];
+            Level->LeafOccluders[i] = Count;
+            for(u32 Axis = 0; Axis < 3; ++Axis)
+            {
+                Bounds->Min[Axis] = FLT_MAX;
+                Bounds->Max[Axis] = -FLT_MAX;
+            }
+
+            for(u32 Index = Leaf->FirstIndex; Index + 2 < Leaf->FirstIndex + Leaf->IndexCount; Index += 3)
+            {
+                const f32 *P[3] = {Vertices[Indices[Index]].Position, Vertices[Indices[Index + 1]].Position, Vertices[Indices[Index + 2]].Position};
+                for(u32 Corner = 0; Corner < 3; ++Corner)
+                {
+                    for(u32 Axis = 0; Axis < 3; ++Axis)
+                    {
+                        Bounds->Min[Axis] = fminf(Bounds->Min[Axis], P[Corner][Axis]);
+                        Bounds->Max[Axis] = fmaxf(Bounds->Max[Axis], P[Corner][Axis]);
+                    }
+                }
+
+                f32 A[3] = {P[1][0] - P[0][0], P[1][1] - P[0][1], P[1][2] - P[0][2]};
+                f32 B[3] = {P[2][0] - P[0][0], P[2][1] - P[0][1], P[2][2] - P[0][2]};
+                f32 N[3] = {A[1] * B[2] - A[2] * B[1], A[2] * B[0] - A[0] * B[2], A[0] * B[1] - A[1] * B[0]};
+                if(sqrtf(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]) * 0.5f < LEVEL_OCCLUDER_AREA)
+                {
+                    continue;
+                }
+                if(Pass == 1)
+                {
+                    f32 *Occluder = Level->Occluders + (size_t) Count * 9;
+                    memcpy(Occluder, P[0], sizeof(f32) * 3);
+                    memcpy(Occluder + 3, P[1], sizeof(f32) * 3);
+                    memcpy(Occluder + 6, P[2], sizeof(f32) * 3);
+                }
+                ++Count;
+            }
+        }
+        Level->LeafOccluders[Header->LeafCount] = Count;
+
+        if(Pass == 0)
+        {
+            Total = Count;
+            Level->Occluders = (f32 *) Arena->Alloc(sizeof(f32) * 9 * (Total ? Total : 1), 16);
+            Assert(Level->Occluders, "Level: Failed to allocate occluders!");
+        }
+    }
+
+    Level->Occlusion = Occlusion;
+    printf("Level: %u of %u triangles are occluders\n", Total, Header->IndexCount / 3);
+}
+
+void LevelUnload(LEVEL *Level, RENDERER *RenderInfo)
+{
+    if(Level->Header)
+    {
+        MeshPoolFree(&RenderInfo->MeshPool, &Level->Mesh);
+        glDeleteTextures(1, &Level->Lightmap);
+    }
+    *Level = {};
+}
+
+u32 LevelFindLeaf(LEVEL *Level, V3 Position)
+{
+    i32 Child = 0;
+    while(Child >= 0)
+    {
+        LEVEL_NODE *Node    = &Level->Nodes[Child];
+        LEVEL_PLANE *Plane  = &Level->Planes[Node->Plane];
+        f32 Distance = Plane->Normal[0] * Position.X + Plane->Normal[1] * Position.Y + Plane->Normal[2] * Position.Z - Plane->Distance;
+        Child = Node->Children[(Distance >= 0) ? 0 : 1];
+    }
+    return (u32) (-Child - 1);
+}
+
+// Outside the world (noclip) everything is potentially visible
+void LevelUpdateVisibility(LEVEL *Level, V3 Camera)
+{
+    u32 Leaf = LevelFindLeaf(Level, Camera);
+    if(Leaf == Level->CameraLeaf)
+    {
+        return;
+    }
+
+    Level->CameraLeaf = Leaf;
+    u32 Offset = Level->Leaves[Leaf].VisibilityOffset;
+    if(Offset == LEVEL_NO_VISIBILITY)
+    {
+        memset(Level->VisibleRow, 0xFF, Level->RowBytes);
+        return;
+    }
+    LevelDecompressRow(Level->Visibility + Offset, Level->Header->VisibilityBytes - Offset, Level->VisibleRow, Level->RowBytes);
+}
+
+// Baked levels draw with the lightmap permutation, unbaked ones fall back to the default program
+GLuint LevelProgram(LEVEL *Level, RENDERER *RenderInfo)
+{
+    return Level->Lightmap ? RenderInfo->ShaderPrograms[SHADER_LIGHTMAP] : RenderInfo->ShaderProgram;
+}
+
+void LevelPushVisible(LEVEL *Level, RENDERER *RenderInfo, V3 Camera, GLuint Program, GLuint Lightmap)
+{
+    PROFILE_SCOPE("LevelPushVisible");
+
+    LevelUpdateVisibility(Level, Camera);
+
+    // Everything the PVS lets through can occlude everything else it lets through
+    OCCLUSION_CULLER *Occlusion = Level->Occlusion;
+    if(Occlusion)
+    {
+        OcclusionBegin(Occlusion, RenderInfo->ViewProjection);
+        for(u32 i = 0; i < Level->Header->LeafCount; ++i)
+        {
+            if(Level->VisibleRow[i >> 3] & (1 << (i & 7)))
+            {
+                u32 First = Level->LeafOccluders[i];
+                OcclusionPushTriangles(Occlusion, Level->Occluders + (size_t) First * 9, Level->LeafOccluders[i + 1] - First);
+            }
+        }
+        OcclusionRasterize(Occlusion);
+    }
+
+    LEVEL_STATS Stats       = {};
+    Stats.TrianglesTotal    = Level->Header->IndexCount / 3;
+    for(u32 i = 0; i < Level->Header->LeafCount; ++i)
+    {
+        if(!(Level->VisibleRow[i >> 3] & (1 << (i & 7))))
+        {
+            continue;
+        }
+        ++Stats.VisibleLeaves;
+
+        LEVEL_LEAF *Leaf = &Level->Leaves[i];
+        if(Leaf->IndexCount == 0)
+        {
+            continue;
+        }
+        if(Occlusion && !OcclusionTestBox(Occlusion, Level->LeafBounds[i].Min, Level->LeafBounds[i].Max))
+        {
+            ++Stats.OccludedLeaves;
+            continue;
+        }
+
+        // Front to back by leaf centre
+        f32 X = (Leaf->Min[0] + Leaf->Max[0]) * 0.5f - Camera.X;
+        f32 Y = (Leaf->Min[1] + Leaf->Max[1]) * 0.5f - Camera.Y;
+        f32 Z = (Leaf->Min[2] + Leaf->Max[2]) * 0.5f - Camera.Z;
+        f32 Depth = sqrtf(X * X + Y * Y + Z * Z) / LEVEL_SORT_DISTANCE;
+        Depth = (Depth > 1.0f) ? 1.0f : Depth;
+
+        u64 SortKey = RenderSortKey(RENDER_PASS_OPAQUE, Program, Lightmap, RenderInfo->MeshPool.VertexArray, Depth);
+        RenderQueuePush(&RenderInfo->Queue, SortKey, Program, 0, Lightmap, RenderInfo->MeshPool.VertexArray,
+                        Leaf->IndexCount, Level->Mesh.FirstIndex + Leaf->FirstIndex, (i32) Level->Mesh.BaseVertex);
+
+        ++Stats.DrawnLeaves;
+        Stats.TrianglesDrawn += Leaf->IndexCount / 3;
+    }
+    if(Occlusion)
+    {
+        OcclusionEnd(Occlusion);
+    }
+
+    Level->Stats = Stats;
+}
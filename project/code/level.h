@@ -0,0 +1,99 @@
+// BSP level file format
+// Written offline by tools/bsp_compiler.cpp, lit by tools/lightmap_baker.cpp and loaded at runtime by level.cpp.
+// All offsets are bytes from the start of the file.
+#pragma once
+
+#define LEVEL_MAGIC         0x4C56454C // 'LEVL'
+#define LEVEL_VERSION       2
+
+#define LEVEL_LEAF_SOLID    (1 << 0)    // Inside a brush, or outside the sealed map
+#define LEVEL_NO_VISIBILITY 0xFFFFFFFF
+
+typedef struct LEVEL_HEADER
+{
+    u32 Magic;
+    u32 Version;
+
+    u32 PlaneCount;
+    u32 NodeCount;
+    u32 LeafCount;
+    u32 VertexCount;
+    u32 IndexCount;
+    u32 VisibilityBytes;
+
+    u32 PlaneOffset;
+    u32 NodeOffset;
+    u32 LeafOffset;
+    u32 VertexOffset;
+    u32 IndexOffset;
+    u32 VisibilityOffset;
+
+    // RGBA8 lightmap atlas, bottom row first - zero size until the level is baked
+    u32 LightmapWidth;
+    u32 LightmapHeight;
+    u32 LightmapOffset;
+} LEVEL_HEADER;
+
+// Dot(Normal, Point) = Distance
+typedef struct LEVEL_PLANE
+{
+    f32 Normal[3];
+    f32 Distance;
+} LEVEL_PLANE;
+
+// Children >= 0 are nodes, < 0 are leaves (-(Child + 1))
+typedef struct LEVEL_NODE
+{
+    u32 Plane;
+    i32 Children[2];
+} LEVEL_NODE;
+
+typedef struct LEVEL_LEAF
+{
+    u32 Flags;
+    u32 FirstIndex;             // Triangles bordering this leaf
+    u32 IndexCount;
+    u32 VisibilityOffset;       // Compressed PVS row (LEVEL_NO_VISIBILITY for solid leaves)
+    f32 Min[3];
+    f32 Max[3];
+} LEVEL_LEAF;
+
+typedef struct LEVEL_VERTEX
+{
+    f32 Position[3];
+    f32 Normal[3];
+    f32 UV[2];
+    f32 LightmapUV[2];          // Atlas coordinates
+} LEVEL_VERTEX;
+
+// PVS rows are one bit per leaf, with runs of zero bytes stored as (0, count) pairs like Quake. Returns false if the
+// row runs past SourceBytes
+inline bool LevelDecompressRow(const u8 *Source, u32 SourceBytes, u8 *Destination, u32 RowBytes)
+{
+    const u8 *End = Source + SourceBytes;
+    u32 Written = 0;
+    while(Written < RowBytes)
+    {
+        if(Source == End)
+        {
+            return false;
+        }
+        if(*Source)
+        {
+            Destination[Written++] = *Source++;
+            continue;
+        }
+
+        if(End - Source < 2)
+        {
+            return false;
+        }
+        u32 Run = Source[1];
+        Source += 2;
+        while(Run-- && Written < RowBytes)
+        {
+            Destination[Written++] = 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,1579 @@
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+#define DEFAULT_HZ 120
+
+// Mesa's llvmpipe only exposes a 4.5 core context on older releases, so shaders target 450 here
+#define OPENGL_VERSION 450
+
+#include "core/core.h"
+
+// Linux
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <x86intrin.h>
+
+// OpenGL
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// 3rd Party (heap hooks are in memory.cpp)
+void *MemoryHeapAlloc(size_t Size);
+void *MemoryHeapReAlloc(void *Pointer, size_t Size);
+void MemoryHeapFree(void *Pointer);
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(Size)               MemoryHeapAlloc(Size)
+#define STBI_REALLOC(Pointer, Size)     MemoryHeapReAlloc(Pointer, Size)
+#define STBI_FREE(Pointer)              MemoryHeapFree(Pointer)
+#include "external/stb_image.h"
+
+// Source
+#include "profiler.cpp"
+#include "memory.cpp"
+#include "pak.cpp"
+#include "jobs.cpp"
+#include "maths.cpp"
+#include "renderer.cpp"
+#include "tga.cpp"
+#include "textures.cpp"
+#include "particles.cpp"
+#include "software_renderer.cpp"
+#include "occlusion.cpp"
+#include "level.cpp"
+#include "world.cpp"
+#include "benchmark.cpp"
+#include "scheduler.cpp"
+#include "simulation.cpp"
+#include "replay.cpp"
+
+//Globals
+static volatile sig_atomic_t    GlobalRunning = false;
+static bool                     GlobalWireframe = false;
+
+// Structs
+typedef struct LINUX_OPENGL
+{
+    EGLDisplay Display;
+    EGLContext Context;
+
+    // Offscreen target (there is no window surface when running headless)
+    GLuint Framebuffer;
+    GLuint ColourBuffer;
+    GLuint DepthBuffer;
+    i16 Width;
+    i16 Height;
+} LINUX_OPENGL;
+
+
+u64 linux_WallClock()
+{
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    u64 Result = ((u64) Time.tv_sec * 1000000000ULL) + (u64) Time.tv_nsec;
+    return Result;
+}
+
+f32 linux_SecondsElapsed(u64 Start, u64 End)
+{
+    f32 Result = ((f32) (End - Start) / 1000000000.0f);
+    return Result;
+}
+
+// Process CPU time across all threads
+f64 linux_CpuSeconds()
+{
+    timespec Time = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+    return (f64) Time.tv_sec + (f64) Time.tv_nsec / 1000000000.0;
+}
+
+// Read syscalls so far (from /proc, so it counts the CRT's and the driver's too) and page faults - loose files cost
+// reads, the archive costs faults
+typedef struct LINUX_IO_COUNTERS
+{
+    u64 ReadCalls;
+    u64 MinorFaults;
+    u64 MajorFaults;
+} LINUX_IO_COUNTERS;
+
+LINUX_IO_COUNTERS linux_IoCounters()
+{
+    LINUX_IO_COUNTERS Result = {};
+    FILE *File = fopen("/proc/self/io", "r");
+    if(File)
+    {
+        char Line[128];
+        while(fgets(Line, sizeof(Line), File))
+        {
+            if(sscanf(Line, "syscr: %llu", (unsigned long long *) &Result.ReadCalls) == 1)
+            {
+                break;
+            }
+        }
+        fclose(File);
+    }
+    struct rusage Usage = {};
+    getrusage(RUSAGE_SELF, &Usage);
+    Result.MinorFaults = (u64) Usage.ru_minflt;
+    Result.MajorFaults = (u64) Usage.ru_majflt;
+    return Result;
+}
+
+// Sleeps until just before the deadline, then spins the rest - returns seconds spent spinning
+f64 linux_WaitForDeadline(FRAME_SCHEDULER *Scheduler, u64 Deadline)
+{
+    PROFILE_SCOPE("linux_WaitForDeadline");
+
+    u64 Now = linux_WallClock();
+    if(Now >= Deadline)
+    {
+        return 0;
+    }
+
+    f64 SleepSeconds = FrameSchedulerSleepSeconds(Scheduler, (f64) (Deadline - Now) / 1000000000.0);
+    if(SleepSeconds > 0)
+    {
+        timespec SleepTime = {};
+        SleepTime.tv_sec    = (time_t) SleepSeconds;
+        SleepTime.tv_nsec   = (long) ((SleepSeconds - (f64) SleepTime.tv_sec) * 1000000000.0);
+        nanosleep(&SleepTime, 0);
+
+        u64 Woken = linux_WallClock();
+        FrameSchedulerRecordSleep(Scheduler, SleepSeconds, (f64) (Woken - Now) / 1000000000.0);
+        Now = Woken;
+    }
+
+    u64 SpinStart = Now;
+    while(Now < Deadline)
+    {
+        _mm_pause();
+        Now = linux_WallClock();
+    }
+    return (f64) (Now - SpinStart) / 1000000000.0;
+}
+
+void linux_SignalHandler(int Signal)
+{
+    GlobalRunning = false;
+}
+
+bool linux_InitOpenGL(LINUX_OPENGL *OpenGL, i16 Width, i16 Height)
+{
+    // Surfaceless display - works without a window system or GPU (Mesa llvmpipe)
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(!eglGetPlatformDisplayEXT)
+    {
+        printf("linux: EGL_EXT_platform_base is not supported!\n");
+        return false;
+    }
+
+    OpenGL->Display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    EGLint Major = 0;
+    EGLint Minor = 0;
+    if(OpenGL->Display == EGL_NO_DISPLAY || !eglInitialize(OpenGL->Display, &Major, &Minor))
+    {
+        printf("linux: Failed to initialise surfaceless EGL display!\n");
+        return false;
+    }
+
+    // Select config
+    EGLint ConfigAttributes[] =
+    {
+        EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,    EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig Config;
+    EGLint ConfigCount = 0;
+    eglChooseConfig(OpenGL->Display, ConfigAttributes, &Config, 1, &ConfigCount);
+    if(ConfigCount < 1)
+    {
+        printf("linux: Failed to find an EGL config!\n");
+        return false;
+    }
+
+    // Create core context, falling back from 4.6 to 4.5
+    eglBindAPI(EGL_OPENGL_API);
+    EGLint Versions[][2] = {{4, 6}, {4, 5}};
+    for(u32 i = 0; i < ArrayCount(Versions) && !OpenGL->Context; ++i)
+    {
+        EGLint ContextAttributes[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION,          Versions[i][0],
+            EGL_CONTEXT_MINOR_VERSION,          Versions[i][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        OpenGL->Context = eglCreateContext(OpenGL->Display, Config, EGL_NO_CONTEXT, ContextAttributes);
+    }
+
+    if(!OpenGL->Context || !eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, OpenGL->Context))
+    {
+        printf("linux: Failed to set OpenGL context!\n");
+        return false;
+    }
+
+    printf("OpenGL: %s | %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    // Create offscreen framebuffer to render into
+    OpenGL->Width   = Width;
+    OpenGL->Height  = Height;
+    glGenFramebuffers(1, &OpenGL->Framebuffer);
+    glGenRenderbuffers(1, &OpenGL->ColourBuffer);
+    glGenRenderbuffers(1, &OpenGL->DepthBuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, OpenGL->ColourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Width, Height);
+    glBindRenderbuffer(GL_RENDERBUFFER, OpenGL->DepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->Framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, OpenGL->ColourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, OpenGL->DepthBuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("OpenGL: Offscreen framebuffer is incomplete!\n");
+        return false;
+    }
+
+    return true;
+}
+
+void linux_DestroyOpenGL(LINUX_OPENGL *OpenGL)
+{
+    glDeleteFramebuffers(1, &OpenGL->Framebuffer);
+    glDeleteRenderbuffers(1, &OpenGL->ColourBuffer);
+    glDeleteRenderbuffers(1, &OpenGL->DepthBuffer);
+
+    eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(OpenGL->Display, OpenGL->Context);
+    eglTerminate(OpenGL->Display);
+}
+
+void linux_PushScene(RENDERER *RenderInfo, MESH *Mesh, u32 DrawCount)
+{
+    // Spread draws across the shader permutations and a depth range so sorting and batching have work to do
+    for(u32 i = 0; i < DrawCount; ++i)
+    {
+        GLuint Program  = RenderInfo->ShaderPrograms[i % SHADER_PERMUTATION_COUNT];
+        f32 Depth       = (f32) (i % 1024) / 1024.0f;
+        u64 SortKey     = RenderSortKey(RENDER_PASS_OPAQUE, Program, 0, RenderInfo->VertexArrayObject, Depth);
+        RenderQueuePushMesh(&RenderInfo->Queue, SortKey, Program, 0, 0, &RenderInfo->MeshPool, Mesh);
+    }
+}
+
+// Streamed textures on the quad, each through the permutation its format needs
+void linux_PushStreamedTextures(RENDERER *RenderInfo, MESH *Mesh, TEXTURE_STREAMER *Streamer, TEXTURE_HANDLE *Handles, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        GLuint Texture  = TextureStreamerGetHandle(Streamer, Handles[i]);
+        GLuint Program  = RenderInfo->ShaderPrograms[TextureStreamerPermutation(Streamer, Handles[i])];
+        u64 SortKey     = RenderSortKey(RENDER_PASS_OPAQUE, Program, Texture, RenderInfo->VertexArrayObject, 0.0f);
+        RenderQueuePushMesh(&RenderInfo->Queue, SortKey, Program, Texture, 0, &RenderInfo->MeshPool, Mesh);
+    }
+}
+
+// Ring of fountains sharing ParticleCount between them, alternating between two materials
+bool linux_CreateParticles(PARTICLE_SYSTEM *Particles, MEMORY_ARENA *Arena, RENDERER *RenderInfo, JOB_SYSTEM *Jobs, MESH *Quad, u32 ParticleCount)
+{
+    u32 EmitterCount = 8;
+    f32 Lifetime = 2.0f;
+    ParticleSystemCreate(Particles, Arena, RenderInfo, Jobs, Quad, ParticleCount + EmitterCount * PARTICLE_LANES * 2);
+    ParticleMaterialCreate(Particles, 0);
+    ParticleMaterialCreate(Particles, 0);
+
+    for(u32 i = 0; i < EmitterCount; ++i)
+    {
+        f32 Angle = (f32) i * (6.2831853f / (f32) EmitterCount);
+        PARTICLE_EMITTER_SETTINGS Settings = {};
+        Settings.Position       = {{cosf(Angle) * 6.0f, 0.0f, sinf(Angle) * 6.0f}};
+        Settings.Velocity       = {{0.0f, 9.0f, 0.0f}};
+        Settings.Spread         = 2.0f;
+        Settings.Gravity        = 9.8f;
+        Settings.Drag           = 0.1f;
+        Settings.Lifetime       = Lifetime;
+        Settings.Rate           = (f32) ParticleCount / ((f32) EmitterCount * Lifetime);
+        Settings.SizeStart      = 0.05f;
+        Settings.SizeEnd        = 0.01f;
+        Settings.ColourStart    = (i & 1) ? 0xFFFFC040 : 0xFF40C0FF;
+        Settings.ColourEnd      = 0x00202020;
+        Settings.Material       = i & 1;
+        if(!ParticleEmitterCreate(Particles, Arena, &Settings, i + 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Flies the camera through the level's empty leaves, one leaf centre per frame, looking at the next one
+V3 linux_LevelFlythrough(LEVEL *Level, u32 FrameIndex, V3 *Target)
+{
+    u32 EmptyCount = 0;
+    for(u32 i = 0; i < Level->Header->LeafCount; ++i)
+    {
+        EmptyCount += !(Level->Leaves[i].Flags & LEVEL_LEAF_SOLID);
+    }
+
+    V3 Centres[2] = {};
+    for(u32 Step = 0; Step < 2; ++Step)
+    {
+        u32 Empty = EmptyCount ? ((FrameIndex + Step) % EmptyCount) : 0;
+        for(u32 i = 0; i < Level->Header->LeafCount; ++i)
+        {
+            LEVEL_LEAF *Leaf = &Level->Leaves[i];
+            if(!(Leaf->Flags & LEVEL_LEAF_SOLID) && Empty-- == 0)
+            {
+                Centres[Step] = {{(Leaf->Min[0] + Leaf->Max[0]) * 0.5f, (Leaf->Min[1] + Leaf->Max[1]) * 0.5f, (Leaf->Min[2] + Leaf->Max[2]) * 0.5f}};
+                break;
+            }
+        }
+    }
+
+    *Target = Centres[1];
+    return Centres[0];
+}
+
+// Laps the world once over the run at mid height, looking along the path - so chunks stream in ahead of the camera
+// and out behind it the whole way round
+V3 linux_WorldFlythrough(WORLD *World, u32 FrameIndex, u32 FrameCount, V3 *Target)
+{
+    WORLD_HEADER *Header = World->Header;
+    f32 CentreX = (Header->Min[0] + Header->Max[0]) * 0.5f;
+    f32 CentreZ = (Header->Min[2] + Header->Max[2]) * 0.5f;
+    f32 RadiusX = (Header->Max[0] - Header->Min[0]) * 0.35f;
+    f32 RadiusZ = (Header->Max[2] - Header->Min[2]) * 0.35f;
+    f32 Height  = (Header->Min[1] + Header->Max[1]) * 0.5f;
+    f32 Angle   = 6.2831853f * (f32) FrameIndex / (f32) (FrameCount ? FrameCount : 1);
+    f32 Ahead   = Angle + 0.1f;
+
+    *Target = {{CentreX + cosf(Ahead) * RadiusX, Height, CentreZ + sinf(Ahead) * RadiusZ}};
+    V3 Result = {{CentreX + cosf(Angle) * RadiusX, Height, CentreZ + sinf(Angle) * RadiusZ}};
+    return Result;
+}
+
+// Returns CPU seconds spent submitting (excludes waiting on the GPU)
+f32 linux_DisplayBuffer(LINUX_OPENGL *OpenGL, RENDERER *RenderInfo)
+{
+    u64 StartCounter = linux_WallClock();
+
+    // Set polygonial mode - only reaches GL when it toggles
+    GLStateSetPolygonMode(GlobalWireframe ? GL_LINE : GL_FILL);
+
+    // Sort and draw everything pushed this frame at the internal resolution, then upscale into the offscreen framebuffer
+    RendererBeginFrame(RenderInfo);
+    RenderQueueSubmit(&RenderInfo->Queue);
+    RendererEndFrame(RenderInfo, OpenGL->Framebuffer, OpenGL->Width, OpenGL->Height);
+    f32 Result = linux_SecondsElapsed(StartCounter, linux_WallClock());
+
+    // No swap chain - wait for the GPU so frame timings include the actual rendering work
+    {
+        PROFILE_SCOPE("glFinish");
+        glFinish();
+    }
+
+    return Result;
+}
+
+int linux_CompareFrameTimes(const void *A, const void *B)
+{
+    f32 Left    = *(const f32 *) A;
+    f32 Right   = *(const f32 *) B;
+    return (Left > Right) - (Left < Right);
+}
+
+void linux_PrintBenchmark(f32 *FrameTimes, u32 FrameCount)
+{
+    // Sorted in place so min/p99 can be read directly by index - callers are done with the samples
+    qsort(FrameTimes, FrameCount, sizeof(f32), linux_CompareFrameTimes);
+
+    f64 Total = 0;
+    for(u32 i = 0; i < FrameCount; ++i)
+    {
+        Total += FrameTimes[i];
+    }
+
+    u32 P99Index = (u32) ((f64) (FrameCount - 1) * 0.99);
+    f64 Average = Total / (f64) FrameCount;
+
+    printf("bench: %u frames\n", FrameCount);
+    printf("bench: min %.3fms\tavg %.3fms\tp99 %.3fms\tmax %.3fms\t(%.1f fps avg)\n",
+            FrameTimes[0] * 1000.0f, Average * 1000.0, FrameTimes[P99Index] * 1000.0f, FrameTimes[FrameCount - 1] * 1000.0f, 1.0 / Average);
+}
+
+void linux_EmptyJob(void *Data)
+{
+}
+
+typedef struct LINUX_JOB_KERNEL
+{
+    f32 *Output;
+} LINUX_JOB_KERNEL;
+
+void linux_JobKernel(void *Data, u32 Start, u32 End)
+{
+    f32 *Output = ((LINUX_JOB_KERNEL *) Data)->Output;
+    for(u32 i = Start; i < End; ++i)
+    {
+        f32 X = (f32) i;
+        Output[i] = sqrtf(X) * sinf(X * 0.001f) + cosf(X * 0.0001f);
+    }
+}
+
+// Empty job throughput and parallel-for scaling at 1..MaxWorkers workers (0 for every hardware thread)
+void linux_JobBenchmark(MEMORY_ARENA *Arena, u32 Rounds, u32 MaxWorkers)
+{
+    const u32 JobsPerRound  = 4000;     // Fits one worker's deque
+    const u32 KernelCount   = 1 << 23;
+    f32 *Output = (f32 *) Arena->Alloc(sizeof(f32) * KernelCount, 64);
+    Assert(Output, "linux: Failed to allocate job benchmark output!");
+    LINUX_JOB_KERNEL Kernel = {Output};
+
+    // Worker 0 allocates a whole round from one generation - twice that per generation, whatever the worker count
+    size_t JobSize  = (sizeof(JOB) + 15) & ~(size_t) 15;
+    size_t Slice    = 2 * JobsPerRound * JobSize * JOB_ARENA_GENERATIONS;
+    size_t Deque    = sizeof(std::atomic<JOB *>) * JOB_DEQUE_SIZE;
+
+    u32 Workers = (MaxWorkers > 0) ? MaxWorkers : std::thread::hardware_concurrency();
+    Workers = (Workers < 1) ? 1 : ((Workers > JOB_MAX_WORKERS) ? JOB_MAX_WORKERS : Workers);
+
+    // Reused for every worker count
+    MEMORY_ARENA JobArena = {};
+    size_t JobArenaSize = Workers * (Slice + Deque + 64 * (JOB_ARENA_GENERATIONS + 1));
+    void *JobBlock = Arena->Alloc(JobArenaSize, 64);
+    JOB_SYSTEM *Jobs = (JOB_SYSTEM *) Arena->Alloc(sizeof(JOB_SYSTEM), alignof(JOB_SYSTEM));
+    Assert(JobBlock && Jobs, "linux: Failed to allocate job benchmark memory!");
+
+    f64 SingleSeconds = 0;
+    for(u32 Threads = 1; ; Threads *= 2)
+    {
+        if(Threads > Workers)
+        {
+            Threads = Workers;
+        }
+
+        JobArena.Init(JobBlock, JobArenaSize);
+        new (Jobs) JOB_SYSTEM();
+        JobSystemCreate(Jobs, &JobArena, Threads, Slice);
+
+        // Empty jobs - pushed from worker 0, popped and stolen by everyone
+        u64 StartCounter = linux_WallClock();
+        for(u32 Round = 0; Round < Rounds; ++Round)
+        {
+            JOB_COUNTER Counter(0);
+            for(u32 i = 0; i < JobsPerRound; ++i)
+            {
+                JobRun(Jobs, linux_EmptyJob, 0, &Counter);
+            }
+            JobWait(Jobs, &Counter);
+            JobSystemUpdate(Jobs);
+        }
+        f64 EmptySeconds = (f64) (linux_WallClock() - StartCounter) / 1000000000.0;
+
+        u64 Stolen = 0;
+        for(u32 i = 0; i < Threads; ++i)
+        {
+            Stolen += Jobs->Workers[i].Stolen;
+        }
+
+        // Parallel for over an ALU bound kernel
+        StartCounter = linux_WallClock();
+        for(u32 Round = 0; Round < 4; ++Round)
+        {
+            JobParallelFor(Jobs, KernelCount, 16384, linux_JobKernel, &Kernel);
+            JobSystemUpdate(Jobs);
+        }
+        f64 KernelSeconds = (f64) (linux_WallClock() - StartCounter) / 4.0 / 1000000000.0;
+        SingleSeconds = (Threads == 1) ? KernelSeconds : SingleSeconds;
+
+        printf("jobs: %2u workers\tempty %.2f Mjobs/s (%.1f%% stolen)\tparallel for %.3fms (%.2fx)\n", Threads,
+                ((f64) Rounds * JobsPerRound / EmptySeconds) / 1000000.0, 100.0 * (f64) Stolen / ((f64) Rounds * JobsPerRound),
+                KernelSeconds * 1000.0, SingleSeconds / KernelSeconds);
+
+        JobSystemDestroy(Jobs);
+        Jobs->~JOB_SYSTEM();
+        if(Threads == Workers)
+        {
+            break;
+        }
+    }
+}
+
+// Separate arrays per component, filled with -Range..Range
+V3_STREAM linux_MathStream(VIRTUAL_ARENA *Arena, u32 Count, f32 Range, u32 *Seed)
+{
+    V3_STREAM Result = {};
+    f32 **Components[] = {&Result.X, &Result.Y, &Result.Z};
+    for(u32 i = 0; i < ArrayCount(Components); ++i)
+    {
+        f32 *Values = (f32 *) VirtualArenaAlloc(Arena, sizeof(f32) * Count, 64);
+        Assert(Values, "linux: Failed to allocate maths benchmark stream!");
+        for(u32 j = 0; j < Count; ++j)
+        {
+            Values[j] = ParticleRandomSigned(Seed) * Range;
+        }
+        *Components[i] = Values;
+    }
+    return Result;
+}
+
+// Batch maths throughput for every kernel this CPU runs, checked bit for bit against the scalar references
+void linux_MathBenchmark(u32 Rounds)
+{
+    const u32 Count         = (1 << 16) + 3;    // Odd, so every kernel's tail runs too
+    const u32 ObjectCount   = (1 << 12) + 1;
+    MEMORY_SCRATCH Scratch;
+    u32 Seed = 1;
+
+    // Inputs
+    M4X4 ViewProjection = M4X4Transform({{1.0f, -2.0f, 3.0f}}, 0.7f, 1.5f);
+    ViewProjection.E[3] = 0.25f;
+    ViewProjection.E[11] = -1.0f;
+    V3_STREAM Points    = linux_MathStream(Scratch.Arena, Count, 100.0f, &Seed);
+    V3_STREAM Normals   = linux_MathStream(Scratch.Arena, Count, 1.0f, &Seed);
+    V3_STREAM Tangents  = linux_MathStream(Scratch.Arena, Count, 1.0f, &Seed);
+    BOUNDS_STREAM Bounds = {linux_MathStream(Scratch.Arena, Count, 100.0f, &Seed), linux_MathStream(Scratch.Arena, Count, 100.0f, &Seed)};
+    M4X4 *Models = (M4X4 *) VirtualArenaAlloc(Scratch.Arena, sizeof(M4X4) * ObjectCount, 64);
+    Assert(Models, "linux: Failed to allocate maths benchmark models!");
+    for(u32 i = 0; i < ObjectCount; ++i)
+    {
+        V3 Position = {{ParticleRandomSigned(&Seed) * 100.0f, ParticleRandomSigned(&Seed) * 100.0f, ParticleRandomSigned(&Seed) * 100.0f}};
+        Models[i] = M4X4Transform(Position, ParticleRandomSigned(&Seed) * 3.14159f, 1.0f + ParticleRandomSigned(&Seed) * 0.5f);
+    }
+    for(u32 i = 0; i < Count; ++i)
+    {
+        // Keep bounds the right way round
+        f32 *Min[] = {Bounds.Min.X, Bounds.Min.Y, Bounds.Min.Z};
+        f32 *Max[] = {Bounds.Max.X, Bounds.Max.Y, Bounds.Max.Z};
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            f32 Low = (Min[Axis][i] < Max[Axis][i]) ? Min[Axis][i] : Max[Axis][i];
+            Max[Axis][i] = (Min[Axis][i] < Max[Axis][i]) ? Max[Axis][i] : Min[Axis][i];
+            Min[Axis][i] = Low;
+        }
+    }
+
+    // Outputs, scalar references first - each test's streams are contiguous so one compare covers them
+    const u32 OutputStreams = 16;
+    f32 *Outputs[2];
+    M4X4 *Products[2];
+    V4_STREAM Clip[2];
+    V3_STREAM NormalsOut[2];
+    V3_STREAM TangentsOut[2];
+    BOUNDS_STREAM BoundsOut[2];
+    for(u32 i = 0; i < 2; ++i)
+    {
+        f32 *S = (f32 *) VirtualArenaAlloc(Scratch.Arena, sizeof(f32) * Count * OutputStreams, 64);
+        Products[i] = (M4X4 *) VirtualArenaAlloc(Scratch.Arena, sizeof(M4X4) * ObjectCount, 64);
+        Assert(S && Products[i], "linux: Failed to allocate maths benchmark output!");
+        Outputs[i]      = S;
+        Clip[i]         = {S, S + Count, S + Count * 2, S + Count * 3};
+        NormalsOut[i]   = {S + Count * 4, S + Count * 5, S + Count * 6};
+        TangentsOut[i]  = {S + Count * 7, S + Count * 8, S + Count * 9};
+        BoundsOut[i]    = {{S + Count * 10, S + Count * 11, S + Count * 12}, {S + Count * 13, S + Count * 14, S + Count * 15}};
+    }
+
+    const char *Names[]     = {"points", "normals", "tangents", "bounds", "matrices"};
+    u32 Elements[]          = {Count, Count, Count, Count, ObjectCount};
+    u32 FirstStream[]       = {0, 4, 7, 10};
+    u32 StreamCount[]       = {4, 3, 3, 6};
+    f64 ScalarRates[ArrayCount(Names)] = {};
+    printf("math: %u vectors, %u matrices, %u rounds\n", Count, ObjectCount, Rounds);
+
+    MATH_KERNELS *Kernels = MathGetKernels();
+    MATH_KERNELS Detected = *Kernels;
+    for(u32 Kernel = MATH_KERNEL_SCALAR; Kernel <= (u32) Detected.Kernel; ++Kernel)
+    {
+        MATH_KERNELS K = MathSelectKernels((MATH_KERNEL) Kernel);
+        u32 Output = (Kernel == MATH_KERNEL_SCALAR) ? 0 : 1;
+        for(u32 Test = 0; Test < ArrayCount(Names); ++Test)
+        {
+            // Tangents are updated in place - every kernel starts from the same values and runs the same rounds
+            if(Test == 2)
+            {
+                memcpy(TangentsOut[Output].X, Tangents.X, sizeof(f32) * Count);
+                memcpy(TangentsOut[Output].Y, Tangents.Y, sizeof(f32) * Count);
+                memcpy(TangentsOut[Output].Z, Tangents.Z, sizeof(f32) * Count);
+            }
+
+            u64 StartCounter = linux_WallClock();
+            for(u32 Round = 0; Round < Rounds; ++Round)
+            {
+                switch(Test)
+                {
+                    case 0: K.TransformPoints(&ViewProjection, Points, Clip[Output], Count); break;
+                    case 1: K.TransformNormals(&ViewProjection, Normals, NormalsOut[Output], Count); break;
+                    case 2: K.OrthonormaliseTangents(NormalsOut[Output], TangentsOut[Output], Count); break;
+                    case 3: K.TransformBounds(&ViewProjection, Bounds, BoundsOut[Output], Count); break;
+                    case 4: K.MultiplyMatrices(&ViewProjection, Models, Products[Output], ObjectCount); break;
+                }
+            }
+            f64 Seconds = linux_SecondsElapsed(StartCounter, linux_WallClock());
+            f64 Rate = ((f64) Elements[Test] * Rounds / 1000000.0) / Seconds;
+            ScalarRates[Test] = (Kernel == MATH_KERNEL_SCALAR) ? Rate : ScalarRates[Test];
+
+            bool Match = true;
+            if(Kernel != MATH_KERNEL_SCALAR)
+            {
+                Match = (Test < ArrayCount(FirstStream)) ?
+                        !memcmp(Outputs[0] + Count * FirstStream[Test], Outputs[1] + Count * FirstStream[Test], sizeof(f32) * Count * StreamCount[Test]) :
+                        !memcmp(Products[0], Products[1], sizeof(M4X4) * ObjectCount);
+            }
+            printf("math: %-8s %-8s %10.1f M/s (%.2fx scalar)%s\n", MathKernelNames[Kernel], Names[Test], Rate, Rate / ScalarRates[Test], Match ? "" : "\tMISMATCH");
+        }
+    }
+}
+
+// TGA decode throughput for every kernel this CPU runs, against stb_image decoding the same files from memory
+void linux_DecodeBenchmark(const char **Paths, u32 PathCount, u32 Rounds)
+{
+    MEMORY_SCRATCH Scratch;
+    u8 **Files          = (u8 **) VirtualArenaAlloc(Scratch.Arena, sizeof(u8 *) * PathCount, alignof(u8 *));
+    size_t *FileSizes   = (size_t *) VirtualArenaAlloc(Scratch.Arena, sizeof(size_t) * PathCount, alignof(size_t));
+    u32 **References    = (u32 **) VirtualArenaAlloc(Scratch.Arena, sizeof(u32 *) * PathCount, alignof(u32 *));
+    Assert(Files && FileSizes && References, "linux: Failed to allocate decode benchmark corpus!");
+
+    // Load the corpus and decode each file once with stb as the reference (flipped to bottom-up like the streamer)
+    u64 PixelBytes = 0;
+    u32 Count = 0;
+    size_t MaxImage = 0;
+    for(u32 i = 0; i < PathCount; ++i)
+    {
+        size_t Size = 0;
+        u8 *File = VirtualArenaLoadFile(Scratch.Arena, Paths[i], &Size);
+        TGA_INFO Info = {};
+        i32 Width = 0;
+        i32 Height = 0;
+        i32 Channels = 0;
+        u8 *Pixels = File ? stbi_load_from_memory(File, (i32) Size, &Width, &Height, &Channels, 4) : 0;
+        if(!Pixels || !TgaParseHeader(File, Size, &Info))
+        {
+            printf("decode: Skipping %s (not a supported TGA)\n", Paths[i]);
+            stbi_image_free(Pixels);
+            continue;
+        }
+
+        size_t RowSize = (size_t) Width * 4;
+        u32 *Reference = (u32 *) VirtualArenaAlloc(Scratch.Arena, RowSize * Height, 64);
+        Assert(Reference, "linux: Failed to allocate decode benchmark reference!");
+        for(i32 Row = 0; Row < Height; ++Row)
+        {
+            memcpy((u8 *) Reference + Row * RowSize, Pixels + (Height - 1 - Row) * RowSize, RowSize);
+        }
+        stbi_image_free(Pixels);
+
+        Files[Count]        = File;
+        FileSizes[Count]    = Size;
+        References[Count]   = Reference;
+        PixelBytes          += RowSize * Height;
+        MaxImage            = (RowSize * Height > MaxImage) ? RowSize * Height : MaxImage;
+        ++Count;
+    }
+    if(Count == 0)
+    {
+        return;
+    }
+    u32 *Output = (u32 *) VirtualArenaAlloc(Scratch.Arena, MaxImage, 64);
+    Assert(Output, "linux: Failed to allocate decode benchmark output!");
+    printf("decode: %u files, %.2fMB of pixels, %u rounds\n", Count, (f64) PixelBytes / (f64) Megabytes(1), Rounds);
+
+    // stb_image, including the flip the streamer used to do
+    u64 StartCounter = linux_WallClock();
+    for(u32 Round = 0; Round < Rounds; ++Round)
+    {
+        for(u32 i = 0; i < Count; ++i)
+        {
+            i32 Width = 0;
+            i32 Height = 0;
+            i32 Channels = 0;
+            u8 *Pixels = stbi_load_from_memory(Files[i], (i32) FileSizes[i], &Width, &Height, &Channels, 4);
+            size_t RowSize = (size_t) Width * 4;
+            for(i32 Row = 0; Row < Height; ++Row)
+            {
+                memcpy((u8 *) Output + Row * RowSize, Pixels + (Height - 1 - Row) * RowSize, RowSize);
+            }
+            stbi_image_free(Pixels);
+        }
+    }
+    f64 StbSeconds = linux_SecondsElapsed(StartCounter, linux_WallClock());
+    f64 StbRate = ((f64) PixelBytes * Rounds / (f64) Megabytes(1)) / StbSeconds;
+    printf("decode: %-8s %10.1f MB/s\n", "stb", StbRate);
+
+    TGA_KERNELS *Kernels = TgaGetKernels();
+    TGA_KERNELS Detected = *Kernels;
+    for(u32 Kernel = TGA_KERNEL_SCALAR; Kernel <= (u32) Detected.Kernel; ++Kernel)
+    {
+        *Kernels = TgaSelectKernels((TGA_KERNEL) Kernel);
+
+        u32 Mismatches = 0;
+        StartCounter = linux_WallClock();
+        for(u32 Round = 0; Round < Rounds; ++Round)
+        {
+            for(u32 i = 0; i < Count; ++i)
+            {
+                TGA_INFO Info = {};
+                TgaParseHeader(Files[i], FileSizes[i], &Info);
+                TgaDecode(Files[i], FileSizes[i], &Info, Output);
+                if(Round == 0)
+                {
+                    Mismatches += (memcmp(Output, References[i], (size_t) Info.Width * Info.Height * 4) != 0);
+                }
+            }
+        }
+        f64 Seconds = linux_SecondsElapsed(StartCounter, linux_WallClock());
+        f64 Rate = ((f64) PixelBytes * Rounds / (f64) Megabytes(1)) / Seconds;
+        printf("decode: %-8s %10.1f MB/s (%.2fx stb)%s\n", TgaKernelNames[Kernel], Rate, Rate / StbRate, Mismatches ? "\tMISMATCH" : "");
+    }
+    *Kernels = Detected;
+}
+
+// Clears and queues the bench scene - same scatter as the GL scene but scaled down so draws land all over the screen
+void linux_PushSoftwareScene(SOFTWARE_RENDERER *Software, MESH *Mesh, const SOFTWARE_TEXTURE *Texture, u32 DrawCount)
+{
+    SoftwareRendererClear(Software, 0xFF4C4C33);
+
+    u32 Seed = 1;
+    for(u32 i = 0; i < DrawCount; ++i)
+    {
+        Seed = Seed * 1664525 + 1013904223;
+        f32 X = ((f32) (Seed >> 8) / (f32) (1 << 24)) * 2.0f - 1.0f;
+        Seed = Seed * 1664525 + 1013904223;
+        f32 Y = ((f32) (Seed >> 8) / (f32) (1 << 24)) * 2.0f - 1.0f;
+        f32 Transform[16] =
+        {
+            0.2f, 0, 0, 0,
+            0, 0.2f, 0, 0,
+            0, 0, 1, 0,
+            X, Y, (f32) (i % 1024) / 1024.0f, 1,
+        };
+        u32 Mode = (i & 1) ? SOFTWARE_TEXTURE_PERSPECTIVE : SOFTWARE_TEXTURE_AFFINE;
+        SoftwareRendererDraw(Software, Mesh, Transform, Texture, 0xFF000080, Mode);
+    }
+}
+
+// Renders the bench scene on the CPU at 1..N threads and reports throughput scaling, then checks every supported
+// span kernel writes the same colour and depth as the scalar one
+void linux_SoftwareBenchmark(MEMORY_ARENA *Arena, RENDERER *RenderInfo, MESH *Mesh, u32 DrawCount, u32 Frames)
+{
+    SOFTWARE_RENDERER *Software = (SOFTWARE_RENDERER *) Arena->Alloc(sizeof(SOFTWARE_RENDERER), alignof(SOFTWARE_RENDERER));
+    Assert(Software, "linux: Failed to allocate software renderer!");
+    new (Software) SOFTWARE_RENDERER();
+    SoftwareRendererCreate(Software, Arena, &RenderInfo->MeshPool, DEFAULT_WIDTH, DEFAULT_HEIGHT, DrawCount * 2 + 1024, 0);
+
+    // 64x64 checkerboard
+    SOFTWARE_TEXTURE Checker = {};
+    Checker.Width   = 64;
+    Checker.Height  = 64;
+    Checker.Texels  = (u32 *) Arena->Alloc(sizeof(u32) * 64 * 64, 64);
+    for(i32 i = 0; i < 64 * 64; ++i)
+    {
+        Checker.Texels[i] = (((i / 64) / 8 + (i % 64) / 8) & 1) ? 0xFFE0E0E0 : 0xFF402020;
+    }
+
+    printf("software: %s kernel, %u draws (%u triangles), %ux%u\n", SoftwareKernelNames[Software->Kernel], DrawCount, DrawCount * 2, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+
+    for(u32 Threads = 1; ; Threads *= 2)
+    {
+        if(Threads > Software->WorkerCount)
+        {
+            Threads = Software->WorkerCount;
+        }
+        SoftwareRendererSetThreadCount(Software, Threads);
+
+        u64 Pixels      = 0;
+        u64 Triangles   = 0;
+        u32 Overflows   = 0;
+        f64 Seconds     = 0;
+        for(u32 Frame = 0; Frame < Frames; ++Frame)
+        {
+            linux_PushSoftwareScene(Software, Mesh, &Checker, DrawCount);
+
+            u64 StartCounter = linux_WallClock();
+            SoftwareRendererFlush(Software);
+            Seconds += linux_SecondsElapsed(StartCounter, linux_WallClock());
+            Pixels      += Software->Stats.Pixels;
+            Triangles   += Software->Stats.Triangles;
+            Overflows   += Software->Stats.BinOverflows;
+            ProfilerFrameEnd();
+        }
+
+        printf("software: %2u threads\t%.3fms/frame\t%.1f Mpixels/s\t%.2f Mtriangles/s\t%u bin overflows\n",
+                Threads, (Seconds / Frames) * 1000.0, ((f64) Pixels / Seconds) / 1000000.0, ((f64) Triangles / Seconds) / 1000000.0, Overflows);
+
+        if(Threads == Software->WorkerCount)
+        {
+            break;
+        }
+    }
+
+    SoftwareRendererWriteTGA(Software, "software.tga");
+
+    // Scalar reference, then every wider kernel the CPU supports
+    size_t PixelCount = (size_t) Software->Pitch * (Software->TilesY * SOFTWARE_TILE_SIZE);
+    u32 *ReferenceColour = (u32 *) Arena->Alloc(sizeof(u32) * PixelCount, 64);
+    f32 *ReferenceDepth = (f32 *) Arena->Alloc(sizeof(f32) * PixelCount, 64);
+    Assert(ReferenceColour && ReferenceDepth, "linux: Failed to allocate software reference framebuffer!");
+
+    SOFTWARE_KERNEL Detected = Software->Kernel;
+    for(u32 Kernel = SOFTWARE_KERNEL_SCALAR; Kernel <= (u32) Detected; ++Kernel)
+    {
+        Software->Kernel = (SOFTWARE_KERNEL) Kernel;
+        linux_PushSoftwareScene(Software, Mesh, &Checker, DrawCount);
+        SoftwareRendererFlush(Software);
+        if(Kernel == SOFTWARE_KERNEL_SCALAR)
+        {
+            memcpy(ReferenceColour, Software->Colour, sizeof(u32) * PixelCount);
+            memcpy(ReferenceDepth, Software->Depth, sizeof(f32) * PixelCount);
+            continue;
+        }
+
+        u64 Mismatches = 0;
+        for(size_t i = 0; i < PixelCount; ++i)
+        {
+            Mismatches += (Software->Colour[i] != ReferenceColour[i]) || (memcmp(&Software->Depth[i], &ReferenceDepth[i], sizeof(f32)) != 0);
+        }
+        printf("software: %s kernel\t%llu pixels differ from scalar%s\n", SoftwareKernelNames[Kernel], (unsigned long long) Mismatches, Mismatches ? "\tMISMATCH" : "");
+    }
+    Software->Kernel = Detected;
+
+    SoftwareRendererDestroy(Software);
+    Software->~SOFTWARE_RENDERER();
+}
+
+// Runs every scene for Frames uncapped frames, writes the results and compares them to Baseline if given
+// Returns the number of regressions
+u32 linux_RunBenchmarkSuite(LINUX_OPENGL *OpenGL, RENDERER *RenderInfo, JOB_SYSTEM *Jobs, MEMORY_ARENA *Arena, LEVEL *Level, u32 Frames,
+                            const char *ResultsPath, const char *BaselinePath, f64 *Thresholds)
+{
+    BENCHMARK_RESULT *Results = (BENCHMARK_RESULT *) Arena->Alloc(sizeof(BENCHMARK_RESULT) * BENCHMARK_MAX_RESULTS * 2, alignof(BENCHMARK_RESULT));
+    f32 *FrameTimes = (f32 *) Arena->Alloc(sizeof(f32) * Frames, alignof(f32));
+    Assert(Results && FrameTimes, "linux: Failed to allocate benchmark results!");
+
+    // Scene data goes after the results so it can be freed between scenes
+    MEMORY_ARENA SceneArena = {};
+    size_t SceneSize = Megabytes(60);
+    void *SceneBlock = Arena->Alloc(SceneSize, 64);
+    Assert(SceneBlock, "linux: Failed to allocate benchmark scene arena!");
+
+    u32 ResultCount = 0;
+    GlobalRunning = true;
+    for(u32 Type = 0; Type < BENCHMARK_SCENE_COUNT && GlobalRunning; ++Type)
+    {
+        SceneArena.Init(SceneBlock, SceneSize);
+        BENCHMARK_SCENE Scene = {};
+        if(!BenchmarkSceneCreate(&Scene, Type, &SceneArena, RenderInfo, Level))
+        {
+            continue;
+        }
+
+        u64 DrawCalls = 0;
+        u64 Packets = 0;
+        u64 GLCalls = 0;
+        u32 FrameCount = 0;
+        for(u32 Frame = 0; Frame < BENCHMARK_WARMUP_FRAMES + Frames && GlobalRunning; ++Frame)
+        {
+            // Warm-up frames fly the start of the path and are thrown away
+            u64 StartCounter = linux_WallClock();
+            MemoryFrameBegin();
+            BenchmarkScenePush(&Scene, RenderInfo, (Frame < BENCHMARK_WARMUP_FRAMES) ? Frame : Frame - BENCHMARK_WARMUP_FRAMES, Frames);
+            linux_DisplayBuffer(OpenGL, RenderInfo);
+            MemoryFrameEnd();
+            JobSystemUpdate(Jobs);
+            ProfilerFrameEnd();
+            f32 Seconds = linux_SecondsElapsed(StartCounter, linux_WallClock());
+
+            if(Frame == BENCHMARK_WARMUP_FRAMES - 1)
+            {
+                Scene.FrameUploadBytes = 0;
+            }
+            if(Frame >= BENCHMARK_WARMUP_FRAMES)
+            {
+                FrameTimes[FrameCount++] = Seconds;
+                DrawCalls   += RenderInfo->Queue.Stats.DrawCalls;
+                Packets     += RenderInfo->Queue.Stats.Packets;
+                GLCalls     += GLCallTotal(RenderInfo->GLCalls.Issued);
+            }
+        }
+
+        BenchmarkResultCreate(&Results[ResultCount], &Scene, FrameTimes, FrameCount, DrawCalls, Packets, GLCalls);
+        BenchmarkPrintResult(&Results[ResultCount]);
+        ++ResultCount;
+        BenchmarkSceneDestroy(&Scene, RenderInfo);
+    }
+
+    if(!BenchmarkWriteResults(ResultsPath, Results, ResultCount))
+    {
+        printf("suite: Failed to write %s\n", ResultsPath);
+    }
+    if(!BaselinePath)
+    {
+        return 0;
+    }
+
+    BENCHMARK_RESULT *Baseline = Results + BENCHMARK_MAX_RESULTS;
+    u32 BaselineCount = BenchmarkReadResults(BaselinePath, Baseline, BENCHMARK_MAX_RESULTS);
+    if(BaselineCount == 0)
+    {
+        printf("suite: Failed to read baseline %s\n", BaselinePath);
+        return 0;
+    }
+    return BenchmarkCompare(Results, ResultCount, Baseline, BaselineCount, Thresholds);
+}
+
+int main(int argc, char **argv)
+{
+    u64 StartupCounter = linux_WallClock();
+
+    // Parse arguments
+    u32 BenchFrames = 0;
+    u32 DrawCount = 1;
+    u32 SoftwareFrames = 0;
+    u32 JobRounds = 0;
+    u32 JobWorkers = 0;
+    u32 MathRounds = 0;
+    u32 DecodeRounds = 0;
+    const char **DecodePaths = 0;
+    u32 DecodeCount = 0;
+    const char *StreamPath = 0;
+    u32 StreamCount = 0;
+    const char *LevelPath = 0;
+    bool Occlusion = false;
+    const char *WorldPath = 0;
+    u32 WorldGpuMegabytes = 64;
+    u32 WorldCpuMegabytes = 4;
+    u32 PacedFrames = 0;
+    const char *RecordPath = 0;
+    const char *ReplayPath = 0;
+    const char *TimingsPath = 0;
+    u32 ProfileFrames = 0;
+    const char *ProfilePath = 0;
+    const char *SuitePath = 0;
+    const char *BaselinePath = 0;
+    u32 ParticleCount = 0;
+    V2U RenderDimensions = {{DEFAULT_WIDTH, DEFAULT_HEIGHT}};
+    const char *PakPath = 0;
+    bool LooseOverride = true;
+    f64 Thresholds[BENCHMARK_METRIC_COUNT];
+    for(u32 i = 0; i < BENCHMARK_METRIC_COUNT; ++i)
+    {
+        Thresholds[i] = BenchmarkMetrics[i].Threshold;
+    }
+    for(i32 i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--bench") == 0 && (i + 1) < argc)
+        {
+            BenchFrames = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--draws") == 0 && (i + 1) < argc)
+        {
+            DrawCount = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--software") == 0 && (i + 1) < argc)
+        {
+            SoftwareFrames = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--jobs") == 0 && (i + 1) < argc)
+        {
+            JobRounds = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--job-workers") == 0 && (i + 1) < argc)
+        {
+            // Past the hardware thread count to check scaling limits on smaller machines
+            JobWorkers = (u32) atoi(argv[++i]);
+            if(JobWorkers < 1 || JobWorkers > JOB_MAX_WORKERS)
+            {
+                printf("linux: --job-workers needs 1 to %u workers, not %s\n", JOB_MAX_WORKERS, argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--math") == 0 && (i + 1) < argc)
+        {
+            MathRounds = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--decode") == 0 && (i + 2) < argc)
+        {
+            // Every following argument up to the next option is a file
+            DecodeRounds    = (u32) atoi(argv[++i]);
+            DecodePaths     = (const char **) &argv[i + 1];
+            while((i + 1) < argc && strncmp(argv[i + 1], "--", 2) != 0)
+            {
+                ++DecodeCount;
+                ++i;
+            }
+        }
+        else if(strcmp(argv[i], "--textures") == 0 && (i + 2) < argc)
+        {
+            StreamPath  = argv[++i];
+            StreamCount = (u32) atoi(argv[++i]);
+            if(StreamCount > TEXTURE_STREAMER_MAX_TEXTURES)
+            {
+                printf("linux: --textures streams at most %u textures, clamping %u\n", TEXTURE_STREAMER_MAX_TEXTURES, StreamCount);
+                StreamCount = TEXTURE_STREAMER_MAX_TEXTURES;
+            }
+        }
+        else if(strcmp(argv[i], "--particles") == 0 && (i + 1) < argc)
+        {
+            ParticleCount = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--resolution") == 0 && (i + 2) < argc)
+        {
+            i32 Width   = atoi(argv[++i]);
+            i32 Height  = atoi(argv[++i]);
+            if(Width <= 0 || Height <= 0)
+            {
+                printf("linux: --resolution needs a positive width and height, not %s %s\n", argv[i - 1], argv[i]);
+                return 1;
+            }
+            RenderDimensions = {{(u32) Width, (u32) Height}};
+        }
+        else if(strcmp(argv[i], "--pak") == 0 && (i + 1) < argc)
+        {
+            PakPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--no-loose") == 0)
+        {
+            LooseOverride = false;
+        }
+        else if(strcmp(argv[i], "--level") == 0 && (i + 1) < argc)
+        {
+            LevelPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--occlusion") == 0)
+        {
+            Occlusion = true;
+        }
+        else if(strcmp(argv[i], "--world") == 0 && (i + 1) < argc)
+        {
+            WorldPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--world-budget") == 0 && (i + 2) < argc)
+        {
+            WorldGpuMegabytes = (u32) atoi(argv[++i]);
+            WorldCpuMegabytes = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--frames") == 0 && (i + 1) < argc)
+        {
+            PacedFrames = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--record") == 0 && (i + 1) < argc)
+        {
+            RecordPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--replay") == 0 && (i + 1) < argc)
+        {
+            ReplayPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--timings") == 0 && (i + 1) < argc)
+        {
+            TimingsPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--profile") == 0 && (i + 2) < argc)
+        {
+            ProfileFrames   = (u32) atoi(argv[++i]);
+            ProfilePath     = argv[++i];
+        }
+        else if(strcmp(argv[i], "--suite") == 0 && (i + 1) < argc)
+        {
+            SuitePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--baseline") == 0 && (i + 1) < argc)
+        {
+            BaselinePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--threshold") == 0 && (i + 2) < argc)
+        {
+            // Percentage growth allowed for one metric, negative to only report it
+            const char *Name = argv[++i];
+            f64 Percent = atof(argv[++i]);
+            u32 Metric = 0;
+            while(Metric < BENCHMARK_METRIC_COUNT && strcmp(Name, BenchmarkMetrics[Metric].Name) != 0)
+            {
+                ++Metric;
+            }
+            if(Metric == BENCHMARK_METRIC_COUNT)
+            {
+                printf("linux: Unknown benchmark metric %s\n", Name);
+                return 1;
+            }
+            Thresholds[Metric] = Percent / 100.0;
+        }
+        else
+        {
+            printf("usage: %s [--bench N] [--draws N] [--software N] [--jobs N] [--job-workers N] [--math N] [--decode N FILES...] [--textures PATH COUNT] [--level PATH] [--occlusion] [--world PATH] [--world-budget GPU_MB CPU_MB] [--particles N] [--resolution W H] [--pak PATH] [--no-loose] [--frames N] [--record PATH]\n"
+                   "       [--replay PATH] [--timings PATH] [--profile N PATH] [--suite RESULTS.csv] [--baseline BASELINE.csv] [--threshold METRIC PERCENT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if(ReplayPath && RecordPath)
+    {
+        printf("linux: --record and --replay can't be used together\n");
+        return 1;
+    }
+
+    ProfilerInit();
+    ProfilerSetThreadName("Main");
+
+    // Permanent, frame and scratch tiers - reservations only commit what gets used
+    MemoryInit(Megabytes(1024), Megabytes(64));
+
+    // Subsystem arenas - each reserves far more than it needs, pages are only backed once they're used
+    MEMORY_ARENA EngineArena = {};
+    MEMORY_ARENA TextureArena = {};
+    MEMORY_ARENA SoftwareArena = {};
+    MEMORY_ARENA LevelArena = {};
+    MEMORY_ARENA BenchmarkArena = {};
+    MEMORY_ARENA JobArena = {};
+    MEMORY_ARENA ParticleArena = {};
+    MEMORY_ARENA WorldArena = {};
+    bool Allocated = MemoryReserveArena(&EngineArena, "Engine", Megabytes(1024)) &&
+                     MemoryReserveArena(&TextureArena, "Texture", Megabytes(1024)) &&
+                     MemoryReserveArena(&SoftwareArena, "Software", Megabytes(1024)) &&
+                     MemoryReserveArena(&LevelArena, "Level", Megabytes(1024)) &&
+                     MemoryReserveArena(&BenchmarkArena, "Benchmark", Megabytes(1024)) &&
+                     MemoryReserveArena(&JobArena, "Jobs", Megabytes(256));
+    if(ParticleCount > 0)
+    {
+        // Seven f32 streams per particle, with room for ring padding and batches
+        Allocated = Allocated && MemoryReserveArena(&ParticleArena, "Particles", Megabytes(1) + sizeof(f32) * 8 * (size_t) ParticleCount);
+    }
+    if(WorldPath)
+    {
+        // Load slots plus the chunk table - the whole CPU side of a world, however large it is
+        Allocated = Allocated && MemoryReserveArena(&WorldArena, "World", Megabytes(4) + Megabytes((size_t) WorldCpuMegabytes));
+    }
+    Assert(Allocated, "linux: Failed to create memory arenas!");
+
+    // Mount before anything loads - loose files under data/ still win unless --no-loose
+    if(PakPath)
+    {
+        u64 MountCounter = linux_WallClock();
+        if(!AssetsMount(PakPath, LooseOverride))
+        {
+            return 1;
+        }
+        printf("linux: Mounted %s in %.3fms\t[%u entries, %.2fMB, loose overrides %s]\n", PakPath, linux_SecondsElapsed(MountCounter, linux_WallClock()) * 1000.0f,
+                GlobalAssets.Pak.Header->EntryCount, (f64) GlobalAssets.Pak.Size / (f64) Megabytes(1), LooseOverride ? "on" : "off");
+    }
+
+    // Every hardware thread, this one is worker 0
+    JOB_SYSTEM Jobs = {};
+    JobSystemCreate(&Jobs, &JobArena, 0, Kilobytes(256));
+
+    // Initialise OpenGL
+    LINUX_OPENGL OpenGL = {};
+    if(!linux_InitOpenGL(&OpenGL, DEFAULT_WIDTH, DEFAULT_HEIGHT))
+    {
+        printf("linux: Failed to initialise OpenGL!\n");
+        return 1;
+    }
+    ProfilerInitGpu();
+
+    // The internal target is a pair of renderbuffers, so it can't be bigger than the driver allows for one
+    GLint MaxRenderbufferSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &MaxRenderbufferSize);
+    if(RenderDimensions.X > (u32) MaxRenderbufferSize || RenderDimensions.Y > (u32) MaxRenderbufferSize)
+    {
+        printf("linux: --resolution %ux%u is larger than the %d pixel renderbuffer limit\n", RenderDimensions.X, RenderDimensions.Y, MaxRenderbufferSize);
+        return 1;
+    }
+
+    // Create and link OpenGL renderer (compile shaders, or load cached program binaries)
+    mkdir("data/shaders/cache", 0755);
+    u64 RendererCounter = linux_WallClock();
+    RENDERER RenderInfo = InitialiseRenderer(&EngineArena, RenderDimensions, "data/shaders/cache");
+    printf("linux: Renderer initialised in %.3fms\t[%u programs: %u cached, %u compiled, %u rejected, %ux%u internal]\n",
+            linux_SecondsElapsed(RendererCounter, linux_WallClock()) * 1000.0f, SHADER_PERMUTATION_COUNT + 1,
+            RenderInfo.ShaderCache.Hits, RenderInfo.ShaderCache.Misses, RenderInfo.ShaderCache.Rejected, RenderDimensions.X, RenderDimensions.Y);
+    if(SoftwareFrames > 0)
+    {
+        // Keep a CPU copy of geometry for the software renderer
+        MeshPoolCreateCpuCopy(&RenderInfo.MeshPool, &SoftwareArena);
+    }
+    MESH Quad = ConstructQuad(&RenderInfo);
+
+    // Particles share the quad, expanded per instance
+    PARTICLE_SYSTEM Particles = {};
+    if(ParticleCount > 0 && !linux_CreateParticles(&Particles, &ParticleArena, &RenderInfo, &Jobs, &Quad, ParticleCount))
+    {
+        return 1;
+    }
+
+    // Level geometry, tree and visibility
+    LEVEL Level = {};
+    if(LevelPath)
+    {
+        u64 LevelCounter = linux_WallClock();
+        if(!LevelLoad(&Level, &LevelArena, &RenderInfo, LevelPath))
+        {
+            return 1;
+        }
+        printf("linux: Level loaded in %.3fms\t[%u leaves, %u triangles, %ux%u lightmap]\n", linux_SecondsElapsed(LevelCounter, linux_WallClock()) * 1000.0f,
+                Level.Header->LeafCount, Level.Header->IndexCount / 3, Level.Header->LightmapWidth, Level.Header->LightmapHeight);
+    }
+
+    // Leaves the PVS lets through are tested against the large triangles of the same leaves
+    OCCLUSION_CULLER Occluder = {};
+    if(Occlusion && Level.Header)
+    {
+        LevelEnableOcclusion(&Level, &LevelArena, &Occluder);
+        OcclusionCullerCreate(&Occluder, &LevelArena, &Jobs, Level.LeafOccluders[Level.Header->LeafCount]);
+        printf("linux: Occlusion culling at %ux%u (%s)\n", OCCLUSION_WIDTH, OCCLUSION_HEIGHT, OcclusionKernelNames[Occluder.Kernel]);
+    }
+
+    // Streamed world - only the chunk table loads here, chunks stream in around the camera
+    WORLD World = {};
+    if(WorldPath)
+    {
+        WORLD_SETTINGS WorldSettings    = {};
+        WorldSettings.CpuBudget         = Megabytes((size_t) WorldCpuMegabytes);
+        WorldSettings.GpuBudget         = Megabytes((u64) WorldGpuMegabytes);
+        WorldSettings.UploadBudget      = Megabytes(2);
+        WorldSettings.StreamDistance    = 64.0f;
+        u64 WorldCounter = linux_WallClock();
+        if(!WorldLoad(&World, &WorldArena, &RenderInfo, &Jobs, WorldPath, WorldSettings))
+        {
+            return 1;
+        }
+        printf("linux: World opened in %.3fms\t[%u chunks, %.0fx%.0f units, %u x %.2fMB load slots, %uMB GPU budget]\n",
+                linux_SecondsElapsed(WorldCounter, linux_WallClock()) * 1000.0f, World.Header->ChunkCount, World.Header->Max[0] - World.Header->Min[0],
+                World.Header->Max[2] - World.Header->Min[2], World.SlotCount, (f64) World.SlotSize / (f64) Megabytes(1), WorldGpuMegabytes);
+    }
+
+    // Assets
+    // Start texture streaming (12 staging slots - a 1024x1024 RGBA8 image or cooked mip chain each, 2MB uploaded per frame)
+    TEXTURE_STREAMER_SETTINGS StreamerSettings = {};
+    StreamerSettings.StagingSlotCount   = 12;
+    StreamerSettings.StagingSlotSize    = Megabytes(6);
+    StreamerSettings.UploadBudget       = Megabytes(2);
+    TEXTURE_STREAMER TextureStreamer = {};
+    TextureStreamerCreate(&TextureStreamer, &TextureArena, &Jobs, StreamerSettings);
+    TEXTURE_HANDLE *StreamHandles = 0;
+    if(StreamCount > 0)
+    {
+        StreamHandles = (TEXTURE_HANDLE *) TextureArena.Alloc(sizeof(TEXTURE_HANDLE) * StreamCount, alignof(TEXTURE_HANDLE));
+        Assert(StreamHandles, "linux: Failed to allocate texture handles!");
+    }
+    for(u32 i = 0; i < StreamCount; ++i)
+    {
+        StreamHandles[i] = TextureStreamerRequest(&TextureStreamer, StreamPath);
+    }
+
+    // Trace the first N frames (startup zones recorded before this are only in the summary)
+    if(ProfilePath && !ProfilerCapture(ProfilePath, ProfileFrames))
+    {
+        printf("linux: Failed to open profile capture %s\n", ProfilePath);
+    }
+
+    // Exit cleanly on Ctrl+C / kill
+    signal(SIGINT, linux_SignalHandler);
+    signal(SIGTERM, linux_SignalHandler);
+
+    i32 ExitCode = 0;
+    if(SuitePath)
+    {
+        u32 Frames = (BenchFrames > 0) ? BenchFrames : 240;
+        u32 Regressions = linux_RunBenchmarkSuite(&OpenGL, &RenderInfo, &Jobs, &BenchmarkArena, &Level, Frames, SuitePath, BaselinePath, Thresholds);
+        ExitCode = (Regressions > 0) ? 1 : 0;
+    }
+    else if(MathRounds > 0)
+    {
+        linux_MathBenchmark(MathRounds);
+    }
+    else if(DecodeRounds > 0)
+    {
+        linux_DecodeBenchmark(DecodePaths, DecodeCount, DecodeRounds);
+    }
+    else if(JobRounds > 0)
+    {
+        linux_JobBenchmark(&SoftwareArena, JobRounds, JobWorkers);
+    }
+    else if(SoftwareFrames > 0)
+    {
+        linux_SoftwareBenchmark(&SoftwareArena, &RenderInfo, &Quad, DrawCount, SoftwareFrames);
+    }
+    else if(BenchFrames > 0)
+    {
+        // Benchmark - run uncapped (no vsync or sleep) and record every frame
+        f32 *FrameTimes = (f32 *) VirtualArenaAlloc(MemoryPermanent(), sizeof(f32) * BenchFrames, alignof(f32));
+        Assert(FrameTimes, "linux: Failed to allocate benchmark frame times!");
+
+        u32 FrameCount = 0;
+        u32 StreamedFrame = 0;
+        f64 SubmitSeconds = 0;
+        u64 LevelVisibleLeaves = 0;
+        u64 LevelTrianglesDrawn = 0;
+        u64 LevelOccludedLeaves = 0;
+        u64 OcclusionTested = 0;
+        u64 OcclusionOccluders = 0;
+        f64 OcclusionRasterMicroseconds = 0;
+        f64 OcclusionTestMicroseconds = 0;
+        f64 GpuSeconds = 0;
+        u64 WorldTrianglesDrawn = 0;
+        u64 ParticlesAlive = 0;
+        f64 ParticleEmitMicroseconds = 0;
+        f64 ParticleSimulateMicroseconds = 0;
+        f64 ParticleSubmitMicroseconds = 0;
+        GL_CALL_COUNTS GLCalls = {};
+        GlobalRunning = true;
+        while(GlobalRunning && FrameCount < BenchFrames)
+        {
+            u64 StartCounter = linux_WallClock();
+            MemoryFrameBegin();
+            TextureStreamerUpdate(&TextureStreamer);
+            linux_PushScene(&RenderInfo, &Quad, DrawCount);
+            linux_PushStreamedTextures(&RenderInfo, &Quad, &TextureStreamer, StreamHandles, StreamCount);
+            if(Level.Header)
+            {
+                V3 Target = {};
+                V3 Camera = linux_LevelFlythrough(&Level, FrameCount, &Target);
+                RendererSetCamera(&RenderInfo, Camera, Target, 1.0f, 0.1f, 1024.0f);
+                LevelPushVisible(&Level, &RenderInfo, Camera, LevelProgram(&Level, &RenderInfo), Level.Lightmap);
+                LevelVisibleLeaves  += Level.Stats.VisibleLeaves;
+                LevelTrianglesDrawn += Level.Stats.TrianglesDrawn;
+                LevelOccludedLeaves += Level.Stats.OccludedLeaves;
+                if(Level.Occlusion)
+                {
+                    OcclusionTested             += Occluder.Stats.Tested;
+                    OcclusionOccluders          += Occluder.Stats.OccludersDrawn;
+                    OcclusionRasterMicroseconds += Occluder.Stats.RasterMicroseconds;
+                    OcclusionTestMicroseconds   += Occluder.Stats.TestMicroseconds;
+                }
+            }
+            if(World.Header)
+            {
+                V3 Target = {};
+                V3 Camera = linux_WorldFlythrough(&World, FrameCount, BenchFrames, &Target);
+                RendererSetCamera(&RenderInfo, Camera, Target, 1.0f, 0.1f, World.Settings.StreamDistance);
+                WorldUpdate(&World, &RenderInfo, Camera);
+                WorldTrianglesDrawn += World.Stats.TrianglesDrawn;
+            }
+            if(ParticleCount > 0)
+            {
+                // Fixed step so every run simulates the same particles
+                if(!Level.Header && !World.Header)
+                {
+                    RendererSetCamera(&RenderInfo, {{0.0f, 8.0f, 20.0f}}, {{0.0f, 4.0f, 0.0f}}, 1.0f, 0.1f, 100.0f);
+                }
+                ParticleSystemUpdate(&Particles, &RenderInfo, 1.0f / 60.0f);
+                ParticlesAlive                  += Particles.Stats.Alive;
+                ParticleEmitMicroseconds        += Particles.Stats.EmitMicroseconds;
+                ParticleSimulateMicroseconds    += Particles.Stats.SimulateMicroseconds;
+                ParticleSubmitMicroseconds      += Particles.Stats.SubmitMicroseconds;
+            }
+            SubmitSeconds += linux_DisplayBuffer(&OpenGL, &RenderInfo);
+
+            // Dynamic resolution is off here, this only reads the GPU timer back
+            RendererUpdateResolution(&RenderInfo, 0.0);
+            GpuSeconds += RenderInfo.Resolution.GpuSeconds;
+            for(u32 i = 0; i < GL_CALL_CATEGORY_COUNT; ++i)
+            {
+                GLCalls.Requested[i]    += RenderInfo.GLCalls.Requested[i];
+                GLCalls.Issued[i]       += RenderInfo.GLCalls.Issued[i];
+            }
+            MemoryFrameEnd();
+            JobSystemUpdate(&Jobs);
+            ProfilerFrameEnd();
+            u64 EndCounter = linux_WallClock();
+            FrameTimes[FrameCount++] = linux_SecondsElapsed(StartCounter, EndCounter);
+
+            if(FrameCount == 1)
+            {
+                LINUX_IO_COUNTERS Io = linux_IoCounters();
+                printf("bench: time to first frame %.3fms\t[%llu read syscalls, %llu minor / %llu major page faults]\n", linux_SecondsElapsed(StartupCounter, EndCounter) * 1000.0f,
+                        (unsigned long long) Io.ReadCalls, (unsigned long long) Io.MinorFaults, (unsigned long long) Io.MajorFaults);
+                AssetsPrintStats();
+            }
+            if(StreamCount > 0 && StreamedFrame == 0 && TextureStreamer.PendingCount == 0)
+            {
+                StreamedFrame = FrameCount;
+                printf("bench: %u/%u textures resident after %u frames (%.3fms, %.2fMB uploaded, %.2fMB VRAM)\n",
+                        TextureStreamer.ResidentCount, StreamCount, FrameCount, linux_SecondsElapsed(StartupCounter, EndCounter) * 1000.0f,
+                        (f64) TextureStreamer.BytesUploaded / (f64) Megabytes(1), (f64) TextureStreamer.VramBytes / (f64) Megabytes(1));
+            }
+        }
+
+        if(FrameCount > 0)
+        {
+            RENDER_STATS *Stats = &RenderInfo.Queue.Stats;
+            printf("bench: %u packets -> %u draw calls\t[state changes: %u program, %u texture, %u vertex array]\tsubmit avg %.3fus\n",
+                    Stats->Packets, Stats->DrawCalls, Stats->ProgramChanges, Stats->TextureChanges, Stats->VertexArrayChanges,
+                    (SubmitSeconds / (f64) FrameCount) * 1000000.0);
+
+            // Per frame, issued of requested - the difference never reached the driver
+            printf("bench: GL calls %.1f issued of %.1f requested per frame\t[", (f64) GLCallTotal(GLCalls.Issued) / (f64) FrameCount,
+                    (f64) GLCallTotal(GLCalls.Requested) / (f64) FrameCount);
+            for(u32 i = 0; i < GL_CALL_CATEGORY_COUNT; ++i)
+            {
+                printf("%s%s %.1f/%.1f", (i > 0) ? ", " : "", GLCallCategoryNames[i], (f64) GLCalls.Issued[i] / (f64) FrameCount,
+                        (f64) GLCalls.Requested[i] / (f64) FrameCount);
+            }
+            printf("]\n");
+            if(Level.Header)
+            {
+                f64 AverageTriangles = (f64) LevelTrianglesDrawn / (f64) FrameCount;
+                printf("bench: level %.1f leaves visible, %.0f of %u triangles drawn (%.1f%% culled by PVS%s)\tGPU %.3fms avg\n",
+                        (f64) LevelVisibleLeaves / (f64) FrameCount, AverageTriangles, Level.Stats.TrianglesTotal,
+                        100.0 * (1.0 - AverageTriangles / (f64) Level.Stats.TrianglesTotal), Level.Occlusion ? " and occlusion" : "",
+                        (GpuSeconds / (f64) FrameCount) * 1000.0);
+                if(Level.Occlusion)
+                {
+                    // Worth it while the cost stays under the GPU time it saves - compare GPU avg against a run without
+                    printf("bench: occlusion %.1f%% of %.1f tested leaves culled, %.0f occluders (%s)\traster %.3fms\ttest %.3fms\n",
+                            OcclusionTested ? 100.0 * (f64) LevelOccludedLeaves / (f64) OcclusionTested : 0.0, (f64) OcclusionTested / (f64) FrameCount,
+                            (f64) OcclusionOccluders / (f64) FrameCount, OcclusionKernelNames[Occluder.Kernel],
+                            OcclusionRasterMicroseconds / (f64) FrameCount / 1000.0, OcclusionTestMicroseconds / (f64) FrameCount / 1000.0);
+                }
+            }
+            if(World.Header)
+            {
+                printf("bench: world %.0f triangles drawn avg\n", (f64) WorldTrianglesDrawn / (f64) FrameCount);
+                WorldPrintStats(&World);
+            }
+            if(ParticleCount > 0)
+            {
+                printf("bench: particles %.0f alive avg (%s, %u batches, %u draws)\temit %.3fms\tsimulate %.3fms\tsubmit %.3fms\n",
+                        (f64) ParticlesAlive / (f64) FrameCount, ParticleKernelNames[Particles.Kernel], Particles.Stats.Batches, Particles.Stats.DrawCalls,
+                        ParticleEmitMicroseconds / (f64) FrameCount / 1000.0, ParticleSimulateMicroseconds / (f64) FrameCount / 1000.0,
+                        ParticleSubmitMicroseconds / (f64) FrameCount / 1000.0);
+            }
+            linux_PrintBenchmark(FrameTimes, FrameCount);
+        }
+    }
+    else
+    {
+        // Frame intervals and input come from the log when replaying, and the run goes uncapped
+        REPLAY Replay = {};
+        if((ReplayPath && !ReplayOpen(&Replay, ReplayPath)) || (RecordPath && !ReplayRecord(&Replay, RecordPath, 60, DEFAULT_HZ)) ||
+           (TimingsPath && !ReplayWriteTimings(&Replay, TimingsPath)))
+        {
+            return 1;
+        }
+        bool Replaying = (Replay.Mode == REPLAY_PLAY);
+
+        // Fixed 60Hz simulation, rendering paced from DEFAULT_HZ down - or at the recording's rates
+        FRAME_SCHEDULER Scheduler = {};
+        FrameSchedulerCreate(&Scheduler, Replaying ? Replay.Header.TickHz : 60, Replaying ? Replay.Header.RenderHz : DEFAULT_HZ);
+
+        // Orbit the first open leaf of the level
+        V3 Centre = {};
+        for(u32 i = 0; Level.Header && i < Level.Header->LeafCount; ++i)
+        {
+            LEVEL_LEAF *Leaf = &Level.Leaves[i];
+            if(!(Leaf->Flags & LEVEL_LEAF_SOLID))
+            {
+                Centre = {{(Leaf->Min[0] + Leaf->Max[0]) * 0.5f, (Leaf->Min[1] + Leaf->Max[1]) * 0.5f, (Leaf->Min[2] + Leaf->Max[2]) * 0.5f}};
+                break;
+            }
+        }
+        if(!Level.Header && World.Header)
+        {
+            Centre = {{(World.Header->Min[0] + World.Header->Max[0]) * 0.5f, (World.Header->Min[1] + World.Header->Max[1]) * 0.5f,
+                       (World.Header->Min[2] + World.Header->Max[2]) * 0.5f}};
+        }
+        SIMULATION_STATE Previous = {};
+        SIMULATION_STATE Current = {};
+        SimulationCreate(&Current, Centre);
+        Previous = Current;
+
+        // Trade internal resolution for the full render rate before the scheduler has to drop it - not when replaying,
+        // where every run has to render the same pixels to be comparable
+        RendererSetDynamicResolution(&RenderInfo, !Replaying);
+
+        //Start timings
+        u64 StartCounter = linux_WallClock();
+        f64 StartCpuSeconds = linux_CpuSeconds();
+        u64 LastCounter = StartCounter;
+        u64 Deadline = StartCounter;
+
+        //Loop
+        GlobalRunning = true;
+        while(GlobalRunning && (PacedFrames == 0 || Scheduler.Stats.Frames < PacedFrames))
+        {
+            // There's no window to take input from here - replays bring theirs
+            u64 FrameCounter = linux_WallClock();
+            INPUT_FRAME Input = {};
+            InputSetInterval(&Input, FrameCounter - LastCounter);
+            LastCounter = FrameCounter;
+            if(!ReplayBeginFrame(&Replay, &Input))
+            {
+                break;
+            }
+            if(InputKeyReleased(&Input, 'W'))
+            {
+                GlobalWireframe = !GlobalWireframe;
+            }
+            u32 Ticks = FrameSchedulerAdvance(&Scheduler, InputSeconds(&Input));
+
+            // Simulate
+            for(u32 i = 0; i < Ticks; ++i)
+            {
+                Previous = Current;
+                SimulationStep(&Current, (f32) Scheduler.TickSeconds);
+            }
+            SIMULATION_STATE Interpolated = SimulationInterpolate(&Previous, &Current, FrameSchedulerAlpha(&Scheduler));
+
+            // Render
+            MemoryFrameBegin();
+            TextureStreamerUpdate(&TextureStreamer);
+            linux_PushScene(&RenderInfo, &Quad, DrawCount);
+            linux_PushStreamedTextures(&RenderInfo, &Quad, &TextureStreamer, StreamHandles, StreamCount);
+            if(Level.Header)
+            {
+                RendererSetCamera(&RenderInfo, Interpolated.CameraPosition, Centre, 1.0f, 0.1f, 1024.0f);
+                LevelPushVisible(&Level, &RenderInfo, Interpolated.CameraPosition, LevelProgram(&Level, &RenderInfo), Level.Lightmap);
+            }
+            if(World.Header)
+            {
+                RendererSetCamera(&RenderInfo, Interpolated.CameraPosition, Centre, 1.0f, 0.1f, World.Settings.StreamDistance);
+                WorldUpdate(&World, &RenderInfo, Interpolated.CameraPosition);
+            }
+            linux_DisplayBuffer(&OpenGL, &RenderInfo);
+            RendererUpdateResolution(&RenderInfo, Scheduler.BaseSeconds);
+            MemoryFrameEnd();
+            f64 WorkSeconds = (f64) (linux_WallClock() - FrameCounter) / 1000000000.0;
+
+            // Wait against an absolute deadline so error doesn't accumulate - restart it after a long stall
+            f64 SpinSeconds = 0;
+            if(!Replaying)
+            {
+                u64 TargetNanoseconds = (u64) (Scheduler.TargetSeconds * 1000000000.0);
+                Deadline += TargetNanoseconds;
+                if(linux_WallClock() > Deadline + TargetNanoseconds)
+                {
+                    Deadline = linux_WallClock();
+                }
+                SpinSeconds = linux_WaitForDeadline(&Scheduler, Deadline);
+            }
+            FrameSchedulerEndFrame(&Scheduler, WorkSeconds, SpinSeconds);
+            ReplayEndFrame(&Replay, &Input, SimulationChecksum(&Current), Ticks, WorkSeconds, (f64) (linux_WallClock() - FrameCounter) / 1000000000.0 - WorkSeconds);
+            JobSystemUpdate(&Jobs);
+            ProfilerFrameEnd();
+        }
+        ReplayClose(&Replay);
+
+        FrameSchedulerPrintStats(&Scheduler, (f64) (linux_WallClock() - StartCounter) / 1000000000.0, linux_CpuSeconds() - StartCpuSeconds);
+        printf("linux: Internal resolution %ux%u (%.2f scale, %u changes, GPU %.3fms)\n", RenderInfo.Target.Dimensions.X, RenderInfo.Target.Dimensions.Y,
+                RenderInfo.Resolution.Scale, RenderInfo.Resolution.Changes, RenderInfo.Resolution.GpuSeconds * 1000.0);
+    }
+
+    ProfilerPrintSummary(16);
+    ProfilerDestroy();
+
+    LevelUnload(&Level, &RenderInfo);
+    WorldUnload(&World);
+    TextureStreamerDestroy(&TextureStreamer);
+    AssetsUnmount();
+    JobSystemDestroy(&Jobs);
+    MemoryPrintSummary();
+    MemoryDestroy();
+    linux_DestroyOpenGL(&OpenGL);
+    return ExitCode;
+}
@@ -0,0 +1,605 @@
+// Batch maths
+// 4x4 matrices and SoA streams of the core vector types, transformed a packet (4 or 8 values) at a time. Every kernel
+// has a scalar reference and SSE2/AVX2 versions picked at runtime like the TGA swizzles. The vector kernels do the same
+// operations in the same order as the scalar ones (no FMA, IEEE divide and square root), so all three agree to the bit.
+// Matrices are column major - the layout GL and SoftwareRendererDraw take.
+#include <immintrin.h>
+
+typedef struct M4X4
+{
+    f32 E[16];
+} M4X4;
+
+// Packets - one component of 4 or 8 values per register
+typedef struct V3_4X
+{
+    __m128 X, Y, Z;
+} V3_4X;
+
+typedef struct V4_4X
+{
+    __m128 X, Y, Z, W;
+} V4_4X;
+
+typedef struct V3_8X
+{
+    __m256 X, Y, Z;
+} V3_8X;
+
+typedef struct V4_8X
+{
+    __m256 X, Y, Z, W;
+} V4_8X;
+
+// Streams - one array per component
+typedef struct V3_STREAM
+{
+    f32 *X;
+    f32 *Y;
+    f32 *Z;
+} V3_STREAM;
+
+typedef struct V4_STREAM
+{
+    f32 *X;
+    f32 *Y;
+    f32 *Z;
+    f32 *W;
+} V4_STREAM;
+
+typedef struct BOUNDS_STREAM
+{
+    V3_STREAM Min;
+    V3_STREAM Max;
+} BOUNDS_STREAM;
+
+typedef enum MATH_KERNEL
+{
+    MATH_KERNEL_SCALAR,
+    MATH_KERNEL_SSE2,
+    MATH_KERNEL_AVX2,
+} MATH_KERNEL;
+
+// Points get W = 1 and keep all four clip space components
+typedef void MATH_TRANSFORM_POINTS(const M4X4 *Matrix, V3_STREAM In, V4_STREAM Out, u32 Count);
+// Upper 3x3 only, then normalised - pass the inverse transpose for non-uniform scales
+typedef void MATH_TRANSFORM_NORMALS(const M4X4 *Matrix, V3_STREAM In, V3_STREAM Out, u32 Count);
+// Makes each tangent unit length and perpendicular to its normal, in place
+typedef void MATH_ORTHONORMALISE_TANGENTS(V3_STREAM Normals, V3_STREAM Tangents, u32 Count);
+// Tight world space box of each transformed box (centre and extents, Arvo's method)
+typedef void MATH_TRANSFORM_BOUNDS(const M4X4 *Matrix, BOUNDS_STREAM In, BOUNDS_STREAM Out, u32 Count);
+// Out[i] = Left * Right[i] - model-view-projection for every object from one view-projection
+typedef void MATH_MULTIPLY_MATRICES(const M4X4 *Left, const M4X4 *Right, M4X4 *Out, u32 Count);
+
+typedef struct MATH_KERNELS
+{
+    MATH_KERNEL Kernel;
+    MATH_TRANSFORM_POINTS *TransformPoints;
+    MATH_TRANSFORM_NORMALS *TransformNormals;
+    MATH_ORTHONORMALISE_TANGENTS *OrthonormaliseTangents;
+    MATH_TRANSFORM_BOUNDS *TransformBounds;
+    MATH_MULTIPLY_MATRICES *MultiplyMatrices;
+} MATH_KERNELS;
+
+static const char *MathKernelNames[] = {"scalar", "SSE2", "AVX2"};
+
+M4X4 M4X4Identity()
+{
+    M4X4 Result = {};
+    Result.E[0]     = 1.0f;
+    Result.E[5]     = 1.0f;
+    Result.E[10]    = 1.0f;
+    Result.E[15]    = 1.0f;
+    return Result;
+}
+
+// Scale, then rotate around Y, then translate
+M4X4 M4X4Transform(V3 Position, f32 Yaw, f32 Scale)
+{
+    f32 Cos = cosf(Yaw) * Scale;
+    f32 Sin = sinf(Yaw) * Scale;
+    M4X4 Result = M4X4Identity();
+    Result.E[0]     = Cos;
+    Result.E[2]     = -Sin;
+    Result.E[5]     = Scale;
+    Result.E[8]     = Sin;
+    Result.E[10]    = Cos;
+    Result.E[12]    = Position.X;
+    Result.E[13]    = Position.Y;
+    Result.E[14]    = Position.Z;
+    return Result;
+}
+
+M4X4 M4X4Multiply(const M4X4 *Left, const M4X4 *Right)
+{
+    M4X4 Result;
+    for(u32 Column = 0; Column < 4; ++Column)
+    {
+        const f32 *R = Right->E + Column * 4;
+        for(u32 Row = 0; Row < 4; ++Row)
+        {
+            Result.E[Column * 4 + Row] = Left->E[Row] * R[0] + Left->E[4 + Row] * R[1] + Left->E[8 + Row] * R[2] + Left->E[12 + Row] * R[3];
+        }
+    }
+    return Result;
+}
+
+inline V3_STREAM V3StreamOffset(V3_STREAM Stream, u32 Offset)
+{
+    V3_STREAM Result = {Stream.X + Offset, Stream.Y + Offset, Stream.Z + Offset};
+    return Result;
+}
+
+inline V4_STREAM V4StreamOffset(V4_STREAM Stream, u32 Offset)
+{
+    V4_STREAM Result = {Stream.X + Offset, Stream.Y + Offset, Stream.Z + Offset, Stream.W + Offset};
+    return Result;
+}
+
+inline BOUNDS_STREAM BoundsStreamOffset(BOUNDS_STREAM Stream, u32 Offset)
+{
+    BOUNDS_STREAM Result = {V3StreamOffset(Stream.Min, Offset), V3StreamOffset(Stream.Max, Offset)};
+    return Result;
+}
+
+// Scalar references
+void MathTransformPointsScalar(const M4X4 *Matrix, V3_STREAM In, V4_STREAM Out, u32 Count)
+{
+    const f32 *M = Matrix->E;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        f32 X = In.X[i];
+        f32 Y = In.Y[i];
+        f32 Z = In.Z[i];
+        Out.X[i] = M[0] * X + M[4] * Y + M[8] * Z + M[12];
+        Out.Y[i] = M[1] * X + M[5] * Y + M[9] * Z + M[13];
+        Out.Z[i] = M[2] * X + M[6] * Y + M[10] * Z + M[14];
+        Out.W[i] = M[3] * X + M[7] * Y + M[11] * Z + M[15];
+    }
+}
+
+// Zero vectors stay zero rather than becoming NaNs
+inline f32 MathInverseLength(f32 X, f32 Y, f32 Z)
+{
+    f32 Length = sqrtf(X * X + Y * Y + Z * Z);
+    return (Length > 0.0f) ? 1.0f / Length : 0.0f;
+}
+
+void MathTransformNormalsScalar(const M4X4 *Matrix, V3_STREAM In, V3_STREAM Out, u32 Count)
+{
+    const f32 *M = Matrix->E;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        f32 X = M[0] * In.X[i] + M[4] * In.Y[i] + M[8] * In.Z[i];
+        f32 Y = M[1] * In.X[i] + M[5] * In.Y[i] + M[9] * In.Z[i];
+        f32 Z = M[2] * In.X[i] + M[6] * In.Y[i] + M[10] * In.Z[i];
+        f32 Inverse = MathInverseLength(X, Y, Z);
+        Out.X[i] = X * Inverse;
+        Out.Y[i] = Y * Inverse;
+        Out.Z[i] = Z * Inverse;
+    }
+}
+
+void MathOrthonormaliseTangentsScalar(V3_STREAM Normals, V3_STREAM Tangents, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        // Gram-Schmidt - remove the part along the normal
+        f32 Dot = Normals.X[i] * Tangents.X[i] + Normals.Y[i] * Tangents.Y[i] + Normals.Z[i] * Tangents.Z[i];
+        f32 X = Tangents.X[i] - Normals.X[i] * Dot;
+        f32 Y = Tangents.Y[i] - Normals.Y[i] * Dot;
+        f32 Z = Tangents.Z[i] - Normals.Z[i] * Dot;
+        f32 Inverse = MathInverseLength(X, Y, Z);
+        Tangents.X[i] = X * Inverse;
+        Tangents.Y[i] = Y * Inverse;
+        Tangents.Z[i] = Z * Inverse;
+    }
+}
+
+void MathTransformBoundsScalar(const M4X4 *Matrix, BOUNDS_STREAM In, BOUNDS_STREAM Out, u32 Count)
+{
+    const f32 *M = Matrix->E;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        f32 CX = (In.Min.X[i] + In.Max.X[i]) * 0.5f;
+        f32 CY = (In.Min.Y[i] + In.Max.Y[i]) * 0.5f;
+        f32 CZ = (In.Min.Z[i] + In.Max.Z[i]) * 0.5f;
+        f32 EX = (In.Max.X[i] - In.Min.X[i]) * 0.5f;
+        f32 EY = (In.Max.Y[i] - In.Min.Y[i]) * 0.5f;
+        f32 EZ = (In.Max.Z[i] - In.Min.Z[i]) * 0.5f;
+
+        f32 X = M[0] * CX + M[4] * CY + M[8] * CZ + M[12];
+        f32 Y = M[1] * CX + M[5] * CY + M[9] * CZ + M[13];
+        f32 Z = M[2] * CX + M[6] * CY + M[10] * CZ + M[14];
+        f32 ExtentX = fabsf(M[0]) * EX + fabsf(M[4]) * EY + fabsf(M[8]) * EZ;
+        f32 ExtentY = fabsf(M[1]) * EX + fabsf(M[5]) * EY + fabsf(M[9]) * EZ;
+        f32 ExtentZ = fabsf(M[2]) * EX + fabsf(M[6]) * EY + fabsf(M[10]) * EZ;
+
+        Out.Min.X[i] = X - ExtentX;
+        Out.Min.Y[i] = Y - ExtentY;
+        Out.Min.Z[i] = Z - ExtentZ;
+        Out.Max.X[i] = X + ExtentX;
+        Out.Max.Y[i] = Y + ExtentY;
+        Out.Max.Z[i] = Z + ExtentZ;
+    }
+}
+
+void MathMultiplyMatricesScalar(const M4X4 *Left, const M4X4 *Right, M4X4 *Out, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Out[i] = M4X4Multiply(Left, &Right[i]);
+    }
+}
+
+// SSE2 - always there on x64
+inline V3_4X V3Load4(V3_STREAM Stream, u32 Index)
+{
+    V3_4X Result = {_mm_loadu_ps(Stream.X + Index), _mm_loadu_ps(Stream.Y + Index), _mm_loadu_ps(Stream.Z + Index)};
+    return Result;
+}
+
+inline void V3Store4(V3_STREAM Stream, u32 Index, V3_4X Value)
+{
+    _mm_storeu_ps(Stream.X + Index, Value.X);
+    _mm_storeu_ps(Stream.Y + Index, Value.Y);
+    _mm_storeu_ps(Stream.Z + Index, Value.Z);
+}
+
+inline __m128 MathDot4(__m128 AX, __m128 AY, __m128 AZ, __m128 BX, __m128 BY, __m128 BZ)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(AX, BX), _mm_mul_ps(AY, BY)), _mm_mul_ps(AZ, BZ));
+}
+
+inline __m128 MathInverseLength4(__m128 X, __m128 Y, __m128 Z)
+{
+    __m128 Length = _mm_sqrt_ps(MathDot4(X, Y, Z, X, Y, Z));
+    __m128 Valid = _mm_cmpgt_ps(Length, _mm_setzero_ps());
+    return _mm_and_ps(Valid, _mm_div_ps(_mm_set1_ps(1.0f), Length));
+}
+
+// Row R of the matrix times (X, Y, Z), in the scalar order
+inline __m128 MathRow4(const __m128 *M, u32 Row, __m128 X, __m128 Y, __m128 Z)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(M[Row], X), _mm_mul_ps(M[4 + Row], Y)), _mm_mul_ps(M[8 + Row], Z));
+}
+
+inline void MathBroadcast4(const M4X4 *Matrix, __m128 *M)
+{
+    for(u32 i = 0; i < 16; ++i)
+    {
+        M[i] = _mm_set1_ps(Matrix->E[i]);
+    }
+}
+
+void MathTransformPointsSSE2(const M4X4 *Matrix, V3_STREAM In, V4_STREAM Out, u32 Count)
+{
+    __m128 M[16];
+    MathBroadcast4(Matrix, M);
+
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        V3_4X P = V3Load4(In, i);
+        _mm_storeu_ps(Out.X + i, _mm_add_ps(MathRow4(M, 0, P.X, P.Y, P.Z), M[12]));
+        _mm_storeu_ps(Out.Y + i, _mm_add_ps(MathRow4(M, 1, P.X, P.Y, P.Z), M[13]));
+        _mm_storeu_ps(Out.Z + i, _mm_add_ps(MathRow4(M, 2, P.X, P.Y, P.Z), M[14]));
+        _mm_storeu_ps(Out.W + i, _mm_add_ps(MathRow4(M, 3, P.X, P.Y, P.Z), M[15]));
+    }
+    MathTransformPointsScalar(Matrix, V3StreamOffset(In, i), V4StreamOffset(Out, i), Count - i);
+}
+
+void MathTransformNormalsSSE2(const M4X4 *Matrix, V3_STREAM In, V3_STREAM Out, u32 Count)
+{
+    __m128 M[16];
+    MathBroadcast4(Matrix, M);
+
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        V3_4X N = V3Load4(In, i);
+        __m128 X = MathRow4(M, 0, N.X, N.Y, N.Z);
+        __m128 Y = MathRow4(M, 1, N.X, N.Y, N.Z);
+        __m128 Z = MathRow4(M, 2, N.X, N.Y, N.Z);
+        __m128 Inverse = MathInverseLength4(X, Y, Z);
+        V3_4X Result = {_mm_mul_ps(X, Inverse), _mm_mul_ps(Y, Inverse), _mm_mul_ps(Z, Inverse)};
+        V3Store4(Out, i, Result);
+    }
+    MathTransformNormalsScalar(Matrix, V3StreamOffset(In, i), V3StreamOffset(Out, i), Count - i);
+}
+
+void MathOrthonormaliseTangentsSSE2(V3_STREAM Normals, V3_STREAM Tangents, u32 Count)
+{
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        V3_4X N = V3Load4(Normals, i);
+        V3_4X T = V3Load4(Tangents, i);
+        __m128 Dot = MathDot4(N.X, N.Y, N.Z, T.X, T.Y, T.Z);
+        __m128 X = _mm_sub_ps(T.X, _mm_mul_ps(N.X, Dot));
+        __m128 Y = _mm_sub_ps(T.Y, _mm_mul_ps(N.Y, Dot));
+        __m128 Z = _mm_sub_ps(T.Z, _mm_mul_ps(N.Z, Dot));
+        __m128 Inverse = MathInverseLength4(X, Y, Z);
+        V3_4X Result = {_mm_mul_ps(X, Inverse), _mm_mul_ps(Y, Inverse), _mm_mul_ps(Z, Inverse)};
+        V3Store4(Tangents, i, Result);
+    }
+    MathOrthonormaliseTangentsScalar(V3StreamOffset(Normals, i), V3StreamOffset(Tangents, i), Count - i);
+}
+
+void MathTransformBoundsSSE2(const M4X4 *Matrix, BOUNDS_STREAM In, BOUNDS_STREAM Out, u32 Count)
+{
+    __m128 M[16];
+    __m128 A[16];
+    MathBroadcast4(Matrix, M);
+    __m128 SignMask = _mm_set1_ps(-0.0f);
+    for(u32 j = 0; j < 16; ++j)
+    {
+        A[j] = _mm_andnot_ps(SignMask, M[j]);
+    }
+
+    __m128 Half = _mm_set1_ps(0.5f);
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        V3_4X Min = V3Load4(In.Min, i);
+        V3_4X Max = V3Load4(In.Max, i);
+        __m128 CX = _mm_mul_ps(_mm_add_ps(Min.X, Max.X), Half);
+        __m128 CY = _mm_mul_ps(_mm_add_ps(Min.Y, Max.Y), Half);
+        __m128 CZ = _mm_mul_ps(_mm_add_ps(Min.Z, Max.Z), Half);
+        __m128 EX = _mm_mul_ps(_mm_sub_ps(Max.X, Min.X), Half);
+        __m128 EY = _mm_mul_ps(_mm_sub_ps(Max.Y, Min.Y), Half);
+        __m128 EZ = _mm_mul_ps(_mm_sub_ps(Max.Z, Min.Z), Half);
+
+        __m128 X = _mm_add_ps(MathRow4(M, 0, CX, CY, CZ), M[12]);
+        __m128 Y = _mm_add_ps(MathRow4(M, 1, CX, CY, CZ), M[13]);
+        __m128 Z = _mm_add_ps(MathRow4(M, 2, CX, CY, CZ), M[14]);
+        __m128 ExtentX = MathRow4(A, 0, EX, EY, EZ);
+        __m128 ExtentY = MathRow4(A, 1, EX, EY, EZ);
+        __m128 ExtentZ = MathRow4(A, 2, EX, EY, EZ);
+
+        V3_4X OutMin = {_mm_sub_ps(X, ExtentX), _mm_sub_ps(Y, ExtentY), _mm_sub_ps(Z, ExtentZ)};
+        V3_4X OutMax = {_mm_add_ps(X, ExtentX), _mm_add_ps(Y, ExtentY), _mm_add_ps(Z, ExtentZ)};
+        V3Store4(Out.Min, i, OutMin);
+        V3Store4(Out.Max, i, OutMax);
+    }
+    MathTransformBoundsScalar(Matrix, BoundsStreamOffset(In, i), BoundsStreamOffset(Out, i), Count - i);
+}
+
+// Matrices are already four wide - each result column is the left columns scaled by one right column
+void MathMultiplyMatricesSSE2(const M4X4 *Left, const M4X4 *Right, M4X4 *Out, u32 Count)
+{
+    __m128 L0 = _mm_loadu_ps(Left->E + 0);
+    __m128 L1 = _mm_loadu_ps(Left->E + 4);
+    __m128 L2 = _mm_loadu_ps(Left->E + 8);
+    __m128 L3 = _mm_loadu_ps(Left->E + 12);
+    for(u32 i = 0; i < Count; ++i)
+    {
+        for(u32 Column = 0; Column < 4; ++Column)
+        {
+            __m128 R = _mm_loadu_ps(Right[i].E + Column * 4);
+            __m128 Result = _mm_mul_ps(L0, _mm_shuffle_ps(R, R, 0x00));
+            Result = _mm_add_ps(Result, _mm_mul_ps(L1, _mm_shuffle_ps(R, R, 0x55)));
+            Result = _mm_add_ps(Result, _mm_mul_ps(L2, _mm_shuffle_ps(R, R, 0xAA)));
+            Result = _mm_add_ps(Result, _mm_mul_ps(L3, _mm_shuffle_ps(R, R, 0xFF)));
+            _mm_storeu_ps(Out[i].E + Column * 4, Result);
+        }
+    }
+}
+
+// AVX2 - plain multiplies and adds, FMA would round differently to the scalar references
+__attribute__((target("avx2")))
+inline V3_8X V3Load8(V3_STREAM Stream, u32 Index)
+{
+    V3_8X Result = {_mm256_loadu_ps(Stream.X + Index), _mm256_loadu_ps(Stream.Y + Index), _mm256_loadu_ps(Stream.Z + Index)};
+    return Result;
+}
+
+__attribute__((target("avx2")))
+inline void V3Store8(V3_STREAM Stream, u32 Index, V3_8X Value)
+{
+    _mm256_storeu_ps(Stream.X + Index, Value.X);
+    _mm256_storeu_ps(Stream.Y + Index, Value.Y);
+    _mm256_storeu_ps(Stream.Z + Index, Value.Z);
+}
+
+__attribute__((target("avx2")))
+inline __m256 MathDot8(__m256 AX, __m256 AY, __m256 AZ, __m256 BX, __m256 BY, __m256 BZ)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(AX, BX), _mm256_mul_ps(AY, BY)), _mm256_mul_ps(AZ, BZ));
+}
+
+__attribute__((target("avx2")))
+inline __m256 MathInverseLength8(__m256 X, __m256 Y, __m256 Z)
+{
+    __m256 Length = _mm256_sqrt_ps(MathDot8(X, Y, Z, X, Y, Z));
+    __m256 Valid = _mm256_cmp_ps(Length, _mm256_setzero_ps(), _CMP_GT_OQ);
+    return _mm256_and_ps(Valid, _mm256_div_ps(_mm256_set1_ps(1.0f), Length));
+}
+
+__attribute__((target("avx2")))
+inline __m256 MathRow8(const __m256 *M, u32 Row, __m256 X, __m256 Y, __m256 Z)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M[Row], X), _mm256_mul_ps(M[4 + Row], Y)), _mm256_mul_ps(M[8 + Row], Z));
+}
+
+__attribute__((target("avx2")))
+inline void MathBroadcast8(const M4X4 *Matrix, __m256 *M)
+{
+    for(u32 i = 0; i < 16; ++i)
+    {
+        M[i] = _mm256_set1_ps(Matrix->E[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+void MathTransformPointsAVX2(const M4X4 *Matrix, V3_STREAM In, V4_STREAM Out, u32 Count)
+{
+    __m256 M[16];
+    MathBroadcast8(Matrix, M);
+
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        V3_8X P = V3Load8(In, i);
+        _mm256_storeu_ps(Out.X + i, _mm256_add_ps(MathRow8(M, 0, P.X, P.Y, P.Z), M[12]));
+        _mm256_storeu_ps(Out.Y + i, _mm256_add_ps(MathRow8(M, 1, P.X, P.Y, P.Z), M[13]));
+        _mm256_storeu_ps(Out.Z + i, _mm256_add_ps(MathRow8(M, 2, P.X, P.Y, P.Z), M[14]));
+        _mm256_storeu_ps(Out.W + i, _mm256_add_ps(MathRow8(M, 3, P.X, P.Y, P.Z), M[15]));
+    }
+    MathTransformPointsSSE2(Matrix, V3StreamOffset(In, i), V4StreamOffset(Out, i), Count - i);
+}
+
+__attribute__((target("avx2")))
+void MathTransformNormalsAVX2(const M4X4 *Matrix, V3_STREAM In, V3_STREAM Out, u32 Count)
+{
+    __m256 M[16];
+    MathBroadcast8(Matrix, M);
+
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        V3_8X N = V3Load8(In, i);
+        __m256 X = MathRow8(M, 0, N.X, N.Y, N.Z);
+        __m256 Y = MathRow8(M, 1, N.X, N.Y, N.Z);
+        __m256 Z = MathRow8(M, 2, N.X, N.Y, N.Z);
+        __m256 Inverse = MathInverseLength8(X, Y, Z);
+        V3_8X Result = {_mm256_mul_ps(X, Inverse), _mm256_mul_ps(Y, Inverse), _mm256_mul_ps(Z, Inverse)};
+        V3Store8(Out, i, Result);
+    }
+    MathTransformNormalsSSE2(Matrix, V3StreamOffset(In, i), V3StreamOffset(Out, i), Count - i);
+}
+
+__attribute__((target("avx2")))
+void MathOrthonormaliseTangentsAVX2(V3_STREAM Normals, V3_STREAM Tangents, u32 Count)
+{
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        V3_8X N = V3Load8(Normals, i);
+        V3_8X T = V3Load8(Tangents, i);
+        __m256 Dot = MathDot8(N.X, N.Y, N.Z, T.X, T.Y, T.Z);
+        __m256 X = _mm256_sub_ps(T.X, _mm256_mul_ps(N.X, Dot));
+        __m256 Y = _mm256_sub_ps(T.Y, _mm256_mul_ps(N.Y, Dot));
+        __m256 Z = _mm256_sub_ps(T.Z, _mm256_mul_ps(N.Z, Dot));
+        __m256 Inverse = MathInverseLength8(X, Y, Z);
+        V3_8X Result = {_mm256_mul_ps(X, Inverse), _mm256_mul_ps(Y, Inverse), _mm256_mul_ps(Z, Inverse)};
+        V3Store8(Tangents, i, Result);
+    }
+    MathOrthonormaliseTangentsSSE2(V3StreamOffset(Normals, i), V3StreamOffset(Tangents, i), Count - i);
+}
+
+__attribute__((target("avx2")))
+void MathTransformBoundsAVX2(const M4X4 *Matrix, BOUNDS_STREAM In, BOUNDS_STREAM Out, u32 Count)
+{
+    __m256 M[16];
+    __m256 A[16];
+    MathBroadcast8(Matrix, M);
+    __m256 SignMask = _mm256_set1_ps(-0.0f);
+    for(u32 j = 0; j < 16; ++j)
+    {
+        A[j] = _mm256_andnot_ps(SignMask, M[j]);
+    }
+
+    __m256 Half = _mm256_set1_ps(0.5f);
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        V3_8X Min = V3Load8(In.Min, i);
+        V3_8X Max = V3Load8(In.Max, i);
+        __m256 CX = _mm256_mul_ps(_mm256_add_ps(Min.X, Max.X), Half);
+        __m256 CY = _mm256_mul_ps(_mm256_add_ps(Min.Y, Max.Y), Half);
+        __m256 CZ = _mm256_mul_ps(_mm256_add_ps(Min.Z, Max.Z), Half);
+        __m256 EX = _mm256_mul_ps(_mm256_sub_ps(Max.X, Min.X), Half);
+        __m256 EY = _mm256_mul_ps(_mm256_sub_ps(Max.Y, Min.Y), Half);
+        __m256 EZ = _mm256_mul_ps(_mm256_sub_ps(Max.Z, Min.Z), Half);
+
+        __m256 X = _mm256_add_ps(MathRow8(M, 0, CX, CY, CZ), M[12]);
+        __m256 Y = _mm256_add_ps(MathRow8(M, 1, CX, CY, CZ), M[13]);
+        __m256 Z = _mm256_add_ps(MathRow8(M, 2, CX, CY, CZ), M[14]);
+        __m256 ExtentX = MathRow8(A, 0, EX, EY, EZ);
+        __m256 ExtentY = MathRow8(A, 1, EX, EY, EZ);
+        __m256 ExtentZ = MathRow8(A, 2, EX, EY, EZ);
+
+        V3_8X OutMin = {_mm256_sub_ps(X, ExtentX), _mm256_sub_ps(Y, ExtentY), _mm256_sub_ps(Z, ExtentZ)};
+        V3_8X OutMax = {_mm256_add_ps(X, ExtentX), _mm256_add_ps(Y, ExtentY), _mm256_add_ps(Z, ExtentZ)};
+        V3Store8(Out.Min, i, OutMin);
+        V3Store8(Out.Max, i, OutMax);
+    }
+    MathTransformBoundsSSE2(Matrix, BoundsStreamOffset(In, i), BoundsStreamOffset(Out, i), Count - i);
+}
+
+// Two result columns per register - the left matrix is repeated in both halves, shuffles broadcast within each half
+__attribute__((target("avx2")))
+void MathMultiplyMatricesAVX2(const M4X4 *Left, const M4X4 *Right, M4X4 *Out, u32 Count)
+{
+    __m256 L0 = _mm256_broadcast_ps((const __m128 *) (Left->E + 0));
+    __m256 L1 = _mm256_broadcast_ps((const __m128 *) (Left->E + 4));
+    __m256 L2 = _mm256_broadcast_ps((const __m128 *) (Left->E + 8));
+    __m256 L3 = _mm256_broadcast_ps((const __m128 *) (Left->E + 12));
+    for(u32 i = 0; i < Count; ++i)
+    {
+        for(u32 Column = 0; Column < 4; Column += 2)
+        {
+            __m256 R = _mm256_loadu_ps(Right[i].E + Column * 4);
+            __m256 Result = _mm256_mul_ps(L0, _mm256_shuffle_ps(R, R, 0x00));
+            Result = _mm256_add_ps(Result, _mm256_mul_ps(L1, _mm256_shuffle_ps(R, R, 0x55)));
+            Result = _mm256_add_ps(Result, _mm256_mul_ps(L2, _mm256_shuffle_ps(R, R, 0xAA)));
+            Result = _mm256_add_ps(Result, _mm256_mul_ps(L3, _mm256_shuffle_ps(R, R, 0xFF)));
+            _mm256_storeu_ps(Out[i].E + Column * 4, Result);
+        }
+    }
+}
+
+MATH_KERNELS MathSelectKernels(MATH_KERNEL Kernel)
+{
+    MATH_KERNELS Result = {};
+    Result.Kernel = Kernel;
+    switch(Kernel)
+    {
+        case MATH_KERNEL_AVX2:
+        {
+            Result.TransformPoints          = MathTransformPointsAVX2;
+            Result.TransformNormals         = MathTransformNormalsAVX2;
+            Result.OrthonormaliseTangents   = MathOrthonormaliseTangentsAVX2;
+            Result.TransformBounds          = MathTransformBoundsAVX2;
+            Result.MultiplyMatrices         = MathMultiplyMatricesAVX2;
+            break;
+        }
+        case MATH_KERNEL_SSE2:
+        {
+            Result.TransformPoints          = MathTransformPointsSSE2;
+            Result.TransformNormals         = MathTransformNormalsSSE2;
+            Result.OrthonormaliseTangents   = MathOrthonormaliseTangentsSSE2;
+            Result.TransformBounds          = MathTransformBoundsSSE2;
+            Result.MultiplyMatrices         = MathMultiplyMatricesSSE2;
+            break;
+        }
+        default:
+        {
+            Result.TransformPoints          = MathTransformPointsScalar;
+            Result.TransformNormals         = MathTransformNormalsScalar;
+            Result.OrthonormaliseTangents   = MathOrthonormaliseTangentsScalar;
+            Result.TransformBounds          = MathTransformBoundsScalar;
+            Result.MultiplyMatrices         = MathMultiplyMatricesScalar;
+            break;
+        }
+    }
+    return Result;
+}
+
+MATH_KERNEL MathDetectKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return MATH_KERNEL_AVX2;
+    }
+    return MATH_KERNEL_SSE2;
+}
+
+// Detected once, on first use from any thread
+MATH_KERNELS *MathGetKernels()
+{
+    static MATH_KERNELS Kernels = MathSelectKernels(MathDetectKernel());
+    return &Kernels;
+}
@@ -0,0 +1,554 @@
+// Memory
+// Arenas over reserved address space that commit pages as they grow, in three tiers:
+//   Permanent  - lives for the whole run. Subsystems that take a MEMORY_ARENA get their own large reservation instead,
+//                backed page by page on first touch, so a budget only costs what is actually used
+//   Frame      - MEMORY_FRAME_COUNT arenas cycled at frame boundaries. One is only reset once the GPU has finished the
+//                frame that last used it, so it can hold data the GPU reads (upload sources, per-frame constants)
+//   Scratch    - per-thread stack, MEMORY_SCRATCH pops everything allocated in its scope
+// Every arena records its high-water mark and allocation rate, and engine heap allocations go through counted hooks,
+// so steady-state frames can be shown to make no heap allocations at all.
+#include <atomic>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define MEMORY_FRAME_COUNT          3
+#define MEMORY_MAX_THREADS          64
+#define MEMORY_MAX_BUDGETS          16
+#define MEMORY_COMMIT_GRANULARITY   Kilobytes(64)
+#define MEMORY_SCRATCH_RESERVE      Megabytes(1024)
+
+typedef struct VIRTUAL_ARENA
+{
+    const char *Name;
+    u8 *Base;
+    size_t Reserved;
+    size_t Committed;
+    size_t Used;
+
+    // Telemetry
+    size_t HighWater;
+    u64 AllocCount;
+    u64 AllocBytes;
+    u64 FrameAllocCount;        // Since the last MemoryFrameEnd
+    u64 FrameAllocBytes;
+    u64 FramesAllocCount;       // Summed over completed frames - startup isn't counted
+    u64 FramesAllocBytes;
+    u64 PeakFrameAllocBytes;
+} VIRTUAL_ARENA;
+
+// A MEMORY_ARENA's reservation - the arena writes to it directly, so pages are committed when first touched: by the
+// kernel on Linux, by MemoryCommitOnFault on Windows
+typedef struct MEMORY_BUDGET
+{
+    const char *Name;
+    u8 *Base;
+    size_t Reserved;
+    std::atomic<size_t> Committed;  // Windows only - Linux counts resident pages when printing
+} MEMORY_BUDGET;
+
+typedef struct MEMORY
+{
+    bool Initialised;
+    VIRTUAL_ARENA Permanent;
+
+    // Written before the arenas are handed out, read from any thread that faults
+    MEMORY_BUDGET Budgets[MEMORY_MAX_BUDGETS];
+    std::atomic<u32> BudgetCount;
+
+    // Frame tier - GPU fence per arena, inserted when its frame ends
+    VIRTUAL_ARENA Frames[MEMORY_FRAME_COUNT];
+    GLsync Fences[MEMORY_FRAME_COUNT];
+    u32 Frame;
+    u64 FrameCount;
+    u64 FenceWaits;
+
+    // Scratch tier - reserved on first use, a slot goes back to the pool (keeping its reservation) when its thread exits
+    VIRTUAL_ARENA Scratch[MEMORY_MAX_THREADS];
+    std::atomic<bool> ScratchClaimed[MEMORY_MAX_THREADS];
+
+    // Heap hooks
+    std::atomic<u64> HeapAllocs;
+    std::atomic<u64> HeapFrees;
+    std::atomic<i64> HeapBytes;
+    u64 HeapAllocsAtFrameEnd;
+    u64 HeapFrames;             // Frames that made at least one heap allocation
+    u64 LastHeapFrame;
+} MEMORY;
+
+static MEMORY GlobalMemory;
+
+// Hands the calling thread's scratch slot back when it exits
+typedef struct MEMORY_THREAD_SCRATCH
+{
+    VIRTUAL_ARENA *Arena;
+    u32 Index;
+
+    ~MEMORY_THREAD_SCRATCH()
+    {
+        if(Arena)
+        {
+            Arena->Used = 0;
+            GlobalMemory.ScratchClaimed[Index].store(false, std::memory_order_release);
+            Arena = 0;
+        }
+    }
+} MEMORY_THREAD_SCRATCH;
+
+static thread_local MEMORY_THREAD_SCRATCH MemoryThreadScratch;
+
+// Address space only - nothing is backed until committed
+u8 *MemoryReserve(size_t Size)
+{
+#if defined(_WIN32)
+    return (u8 *) VirtualAlloc(0, Size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *Result = mmap(0, Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (Result == MAP_FAILED) ? 0 : (u8 *) Result;
+#endif
+}
+
+bool MemoryCommit(u8 *Address, size_t Size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(Address, Size, MEM_COMMIT, PAGE_READWRITE) != 0;
+#else
+    return mprotect(Address, Size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void MemoryRelease(u8 *Address, size_t Size)
+{
+#if defined(_WIN32)
+    VirtualFree(Address, 0, MEM_RELEASE);
+#else
+    munmap(Address, Size);
+#endif
+}
+
+#if defined(_WIN32)
+// First touch of a reserved budget page - commits the granule around it and retries the access
+LONG CALLBACK MemoryCommitOnFault(EXCEPTION_POINTERS *Exception)
+{
+    EXCEPTION_RECORD *Record = Exception->ExceptionRecord;
+    if(Record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || Record->NumberParameters < 2)
+    {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    u8 *Address = (u8 *) Record->ExceptionInformation[1];
+    u32 BudgetCount = GlobalMemory.BudgetCount.load(std::memory_order_acquire);
+    for(u32 i = 0; i < BudgetCount; ++i)
+    {
+        MEMORY_BUDGET *Budget = &GlobalMemory.Budgets[i];
+        if(Address >= Budget->Base && Address < Budget->Base + Budget->Reserved)
+        {
+            size_t Offset = (size_t) (Address - Budget->Base) & ~(size_t) (MEMORY_COMMIT_GRANULARITY - 1);
+            size_t Size = (Budget->Reserved - Offset < MEMORY_COMMIT_GRANULARITY) ? Budget->Reserved - Offset : MEMORY_COMMIT_GRANULARITY;
+            if(!MemoryCommit(Budget->Base + Offset, Size))
+            {
+                return EXCEPTION_CONTINUE_SEARCH;
+            }
+            Budget->Committed.fetch_add(Size, std::memory_order_relaxed);
+            return EXCEPTION_CONTINUE_EXECUTION;
+        }
+    }
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+
+// Committed bytes of a budget - on Linux the pages the kernel has backed so far
+size_t MemoryBudgetCommitted(MEMORY_BUDGET *Budget)
+{
+#if defined(_WIN32)
+    return Budget->Committed.load(std::memory_order_relaxed);
+#else
+    size_t PageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t PageCount = (Budget->Reserved + PageSize - 1) / PageSize;
+    size_t Result = 0;
+    u8 Resident[4096];
+    for(size_t Page = 0; Page < PageCount; Page += sizeof(Resident))
+    {
+        size_t Count = (PageCount - Page < sizeof(Resident)) ? PageCount - Page : sizeof(Resident);
+        if(mincore(Budget->Base + Page * PageSize, Count * PageSize, Resident) != 0)
+        {
+            return 0;
+        }
+        for(size_t i = 0; i < Count; ++i)
+        {
+            Result += (Resident[i] & 1) ? PageSize : 0;
+        }
+    }
+    return Result;
+#endif
+}
+
+void VirtualArenaCreate(VIRTUAL_ARENA *Arena, const char *Name, size_t Reserve)
+{
+    *Arena          = {};
+    Arena->Name     = Name;
+    Arena->Reserved = (Reserve + MEMORY_COMMIT_GRANULARITY - 1) & ~(size_t) (MEMORY_COMMIT_GRANULARITY - 1);
+    Arena->Base     = MemoryReserve(Arena->Reserved);
+    Assert(Arena->Base, "Memory: Failed to reserve address space!");
+}
+
+void VirtualArenaDestroy(VIRTUAL_ARENA *Arena)
+{
+    if(Arena->Base)
+    {
+        MemoryRelease(Arena->Base, Arena->Reserved);
+    }
+    *Arena = {};
+}
+
+// Memory is not cleared - committed pages start zeroed, reused ones keep their old contents
+void *VirtualArenaAlloc(VIRTUAL_ARENA *Arena, size_t Size, size_t Alignment)
+{
+    size_t Offset   = (Arena->Used + (Alignment - 1)) & ~(Alignment - 1);
+    size_t End      = Offset + Size;
+    if(End > Arena->Reserved)
+    {
+        return 0;
+    }
+
+    if(End > Arena->Committed)
+    {
+        size_t Commit = (End + MEMORY_COMMIT_GRANULARITY - 1) & ~(size_t) (MEMORY_COMMIT_GRANULARITY - 1);
+        Commit = (Commit > Arena->Reserved) ? Arena->Reserved : Commit;
+        if(!MemoryCommit(Arena->Base + Arena->Committed, Commit - Arena->Committed))
+        {
+            return 0;
+        }
+        Arena->Committed = Commit;
+    }
+
+    Arena->Used         = End;
+    Arena->HighWater    = (End > Arena->HighWater) ? End : Arena->HighWater;
+    ++Arena->AllocCount;
+    ++Arena->FrameAllocCount;
+    Arena->AllocBytes       += Size;
+    Arena->FrameAllocBytes  += Size;
+    return Arena->Base + Offset;
+}
+
+// O(1) - pages stay committed for the next use
+void VirtualArenaReset(VIRTUAL_ARENA *Arena)
+{
+    Arena->Used = 0;
+}
+
+// Reserves address space for a subsystem that takes a MEMORY_ARENA - nothing is committed until the arena touches it,
+// so reservations can be generous. Main thread, before the arena is used
+bool MemoryReserveArena(MEMORY_ARENA *Arena, const char *Name, size_t Reserve)
+{
+    u32 Index = GlobalMemory.BudgetCount.load(std::memory_order_relaxed);
+    if(Index == MEMORY_MAX_BUDGETS)
+    {
+        return false;
+    }
+
+    MEMORY_BUDGET *Budget = &GlobalMemory.Budgets[Index];
+    Budget->Name        = Name;
+    Budget->Reserved    = (Reserve + MEMORY_COMMIT_GRANULARITY - 1) & ~(size_t) (MEMORY_COMMIT_GRANULARITY - 1);
+#if defined(_WIN32)
+    Budget->Base        = MemoryReserve(Budget->Reserved);
+#else
+    // Writable but not accounted - the kernel backs each page on first touch
+    void *Base          = mmap(0, Budget->Reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    Budget->Base        = (Base == MAP_FAILED) ? 0 : (u8 *) Base;
+#endif
+    if(!Budget->Base)
+    {
+        return false;
+    }
+    Budget->Committed   = 0;
+    GlobalMemory.BudgetCount.store(Index + 1, std::memory_order_release);
+
+    Arena->Init(Budget->Base, Budget->Reserved);
+    return true;
+}
+
+// Whole file, with a null after the last byte so text can be used in place. Null if the file can't be read
+u8 *VirtualArenaLoadFile(VIRTUAL_ARENA *Arena, const char *Path, size_t *Size)
+{
+    FILE *File = fopen(Path, "rb");
+    if(!File)
+    {
+        return 0;
+    }
+    fseek(File, 0, SEEK_END);
+    size_t Length = (size_t) ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    u8 *Result = (u8 *) VirtualArenaAlloc(Arena, Length + 1, 64);
+    if(Result && fread(Result, 1, Length, File) == Length)
+    {
+        Result[Length] = 0;
+        *Size = Length;
+    }
+    else
+    {
+        Result = 0;
+    }
+    fclose(File);
+    return Result;
+}
+
+char *VirtualArenaLoadText(VIRTUAL_ARENA *Arena, const char *Path)
+{
+    size_t Size = 0;
+    return (char *) VirtualArenaLoadFile(Arena, Path, &Size);
+}
+
+void MemoryInit(size_t PermanentReserve, size_t FrameReserve)
+{
+    VirtualArenaCreate(&GlobalMemory.Permanent, "Permanent", PermanentReserve);
+    for(u32 i = 0; i < MEMORY_FRAME_COUNT; ++i)
+    {
+        VirtualArenaCreate(&GlobalMemory.Frames[i], "Frame", FrameReserve);
+    }
+#if defined(_WIN32)
+    AddVectoredExceptionHandler(1, MemoryCommitOnFault);
+#endif
+    GlobalMemory.Initialised = true;
+}
+
+// Threads that used scratch memory must have exited or be done with it
+void MemoryDestroy()
+{
+    for(u32 i = 0; i < MEMORY_FRAME_COUNT; ++i)
+    {
+        if(GlobalMemory.Fences[i])
+        {
+            glDeleteSync(GlobalMemory.Fences[i]);
+            GlobalMemory.Fences[i] = 0;
+        }
+        VirtualArenaDestroy(&GlobalMemory.Frames[i]);
+    }
+
+    for(u32 i = 0; i < MEMORY_MAX_THREADS; ++i)
+    {
+        VirtualArenaDestroy(&GlobalMemory.Scratch[i]);
+    }
+
+#if defined(_WIN32)
+    RemoveVectoredExceptionHandler(MemoryCommitOnFault);
+#endif
+    u32 BudgetCount = GlobalMemory.BudgetCount.load(std::memory_order_relaxed);
+    for(u32 i = 0; i < BudgetCount; ++i)
+    {
+        MemoryRelease(GlobalMemory.Budgets[i].Base, GlobalMemory.Budgets[i].Reserved);
+        GlobalMemory.Budgets[i].Base = 0;
+    }
+    GlobalMemory.BudgetCount = 0;
+
+    VirtualArenaDestroy(&GlobalMemory.Permanent);
+    GlobalMemory.Initialised = false;
+}
+
+VIRTUAL_ARENA *MemoryPermanent()
+{
+    return &GlobalMemory.Permanent;
+}
+
+// Main thread only - valid until MEMORY_FRAME_COUNT frames later
+VIRTUAL_ARENA *MemoryFrame()
+{
+    return &GlobalMemory.Frames[GlobalMemory.Frame];
+}
+
+// Main thread arenas - scratch arenas belong to other threads, so they only report lifetime totals
+u32 MemoryFrameArenas(VIRTUAL_ARENA **Arenas)
+{
+    Arenas[0] = &GlobalMemory.Permanent;
+    for(u32 i = 0; i < MEMORY_FRAME_COUNT; ++i)
+    {
+        Arenas[i + 1] = &GlobalMemory.Frames[i];
+    }
+    return MEMORY_FRAME_COUNT + 1;
+}
+
+// Call before anything allocates from the frame arena. Only waits if the GPU is MEMORY_FRAME_COUNT frames behind
+void MemoryFrameBegin()
+{
+    PROFILE_SCOPE("MemoryFrameBegin");
+
+    // Rates start at the first frame - everything before it is startup
+    if(GlobalMemory.FrameCount == 0)
+    {
+        VIRTUAL_ARENA *Arenas[MEMORY_FRAME_COUNT + 1];
+        u32 ArenaCount = MemoryFrameArenas(Arenas);
+        for(u32 i = 0; i < ArenaCount; ++i)
+        {
+            Arenas[i]->FrameAllocCount = 0;
+            Arenas[i]->FrameAllocBytes = 0;
+        }
+        GlobalMemory.HeapAllocsAtFrameEnd = GlobalMemory.HeapAllocs.load(std::memory_order_relaxed);
+    }
+
+    // The GPU may still be reading the arena until its fence signals, so this stalls for as long as it takes rather
+    // than reset it early - a wait only fails outright once the context is gone, and then nothing reads it
+    u32 Frame = GlobalMemory.Frame;
+    if(GlobalMemory.Fences[Frame])
+    {
+        GLenum Status = glClientWaitSync(GlobalMemory.Fences[Frame], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(Status == GL_TIMEOUT_EXPIRED)
+        {
+            ++GlobalMemory.FenceWaits;
+            while(glClientWaitSync(GlobalMemory.Fences[Frame], 0, 1000000000) == GL_TIMEOUT_EXPIRED)
+            {
+                printf("Memory: Still waiting on the GPU for frame arena %u\n", Frame);
+            }
+        }
+        glDeleteSync(GlobalMemory.Fences[Frame]);
+        GlobalMemory.Fences[Frame] = 0;
+    }
+    VirtualArenaReset(&GlobalMemory.Frames[Frame]);
+}
+
+// Call after the frame's GL commands have been issued
+void MemoryFrameEnd()
+{
+    GlobalMemory.Fences[GlobalMemory.Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    GlobalMemory.Frame = (GlobalMemory.Frame + 1) % MEMORY_FRAME_COUNT;
+    ++GlobalMemory.FrameCount;
+
+    // Frame to frame, so work that finishes after this (jobs, streaming) still counts against a frame
+    u64 HeapAllocs = GlobalMemory.HeapAllocs.load(std::memory_order_relaxed);
+    if(HeapAllocs != GlobalMemory.HeapAllocsAtFrameEnd)
+    {
+        ++GlobalMemory.HeapFrames;
+        GlobalMemory.LastHeapFrame = GlobalMemory.FrameCount;
+    }
+    GlobalMemory.HeapAllocsAtFrameEnd = HeapAllocs;
+
+    VIRTUAL_ARENA *Arenas[MEMORY_FRAME_COUNT + 1];
+    u32 ArenaCount = MemoryFrameArenas(Arenas);
+    for(u32 i = 0; i < ArenaCount; ++i)
+    {
+        VIRTUAL_ARENA *Arena = Arenas[i];
+        Arena->FramesAllocCount     += Arena->FrameAllocCount;
+        Arena->FramesAllocBytes     += Arena->FrameAllocBytes;
+        Arena->PeakFrameAllocBytes  = (Arena->FrameAllocBytes > Arena->PeakFrameAllocBytes) ? Arena->FrameAllocBytes : Arena->PeakFrameAllocBytes;
+        Arena->FrameAllocCount      = 0;
+        Arena->FrameAllocBytes      = 0;
+    }
+}
+
+// The calling thread's scratch stack - a slot freed by an exited thread is reused, otherwise one is reserved on first use
+VIRTUAL_ARENA *MemoryScratch()
+{
+    if(!MemoryThreadScratch.Arena)
+    {
+        for(u32 Index = 0; Index < MEMORY_MAX_THREADS; ++Index)
+        {
+            bool Expected = false;
+            if(GlobalMemory.ScratchClaimed[Index].compare_exchange_strong(Expected, true, std::memory_order_acquire))
+            {
+                VIRTUAL_ARENA *Arena = &GlobalMemory.Scratch[Index];
+                if(!Arena->Base)
+                {
+                    VirtualArenaCreate(Arena, "Scratch", MEMORY_SCRATCH_RESERVE);
+                }
+                MemoryThreadScratch.Arena = Arena;
+                MemoryThreadScratch.Index = Index;
+                break;
+            }
+        }
+        Assert(MemoryThreadScratch.Arena, "Memory: Too many threads with scratch arenas!");
+    }
+    return MemoryThreadScratch.Arena;
+}
+
+// Everything allocated from Arena while this is in scope is popped when it ends - scopes nest
+typedef struct MEMORY_SCRATCH
+{
+    VIRTUAL_ARENA *Arena;
+    size_t Mark;
+
+    MEMORY_SCRATCH()
+    {
+        Arena   = MemoryScratch();
+        Mark    = Arena->Used;
+    }
+
+    ~MEMORY_SCRATCH()
+    {
+        Arena->Used = Mark;
+    }
+} MEMORY_SCRATCH;
+
+// Engine heap hooks (stb_image, one-off driver blobs) - counted so steady-state frames can be checked for allocations
+void *MemoryHeapAlloc(size_t Size)
+{
+    GlobalMemory.HeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    GlobalMemory.HeapBytes.fetch_add((i64) Size, std::memory_order_relaxed);
+    return malloc(Size);
+}
+
+void *MemoryHeapReAlloc(void *Pointer, size_t Size)
+{
+    GlobalMemory.HeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    return realloc(Pointer, Size);
+}
+
+void MemoryHeapFree(void *Pointer)
+{
+    if(Pointer)
+    {
+        GlobalMemory.HeapFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+    free(Pointer);
+}
+
+void MemoryPrintArena(VIRTUAL_ARENA *Arena, u32 Index, bool PerFrame)
+{
+    printf("memory: %-10s %2u %10.2fKB %10.2fKB %10.2fMB", Arena->Name, Index,
+            (f64) Arena->HighWater / 1024.0, (f64) Arena->Committed / 1024.0, (f64) Arena->Reserved / (f64) Megabytes(1));
+    if(PerFrame)
+    {
+        f64 Frames = (GlobalMemory.FrameCount > 0) ? (f64) GlobalMemory.FrameCount : 1.0;
+        printf(" %10.1f %10.2fKB %10.2fKB\n", (f64) Arena->FramesAllocCount / Frames, (f64) Arena->FramesAllocBytes / Frames / 1024.0,
+                (f64) Arena->PeakFrameAllocBytes / 1024.0);
+    }
+    else
+    {
+        printf(" %10llu allocations in total\n", (unsigned long long) Arena->AllocCount);
+    }
+}
+
+void MemoryPrintSummary()
+{
+    printf("memory: %-10s %2s %12s %12s %12s %10s %12s %12s\n", "Arena", "", "High water", "Committed", "Reserved", "Allocs/fr", "Bytes/fr", "Peak/fr");
+    VIRTUAL_ARENA *Arenas[MEMORY_FRAME_COUNT + 1];
+    u32 ArenaCount = MemoryFrameArenas(Arenas);
+    for(u32 i = 0; i < ArenaCount; ++i)
+    {
+        MemoryPrintArena(Arenas[i], (i > 0) ? i - 1 : 0, true);
+    }
+    for(u32 i = 0; i < MEMORY_MAX_THREADS; ++i)
+    {
+        if(GlobalMemory.Scratch[i].Base)
+        {
+            MemoryPrintArena(&GlobalMemory.Scratch[i], i, false);
+        }
+    }
+
+    // The arenas themselves live in core and don't report a high water mark - committed pages are the closest thing
+    u32 BudgetCount = GlobalMemory.BudgetCount.load(std::memory_order_relaxed);
+    for(u32 i = 0; i < BudgetCount; ++i)
+    {
+        MEMORY_BUDGET *Budget = &GlobalMemory.Budgets[i];
+        printf("memory: %-10s %2u %12s %10.2fKB %10.2fMB\n", Budget->Name, i, "-", (f64) MemoryBudgetCommitted(Budget) / 1024.0,
+                (f64) Budget->Reserved / (f64) Megabytes(1));
+    }
+
+    printf("memory: heap %llu allocations, %llu frees, %.2fMB requested\t%llu/%llu frames allocated (last frame %llu)\t%llu frame fence waits\n",
+            (unsigned long long) GlobalMemory.HeapAllocs.load(), (unsigned long long) GlobalMemory.HeapFrees.load(),
+            (f64) GlobalMemory.HeapBytes.load() / (f64) Megabytes(1), (unsigned long long) GlobalMemory.HeapFrames,
+            (unsigned long long) GlobalMemory.FrameCount, (unsigned long long) GlobalMemory.LastHeapFrame,
+            (unsigned long long) GlobalMemory.FenceWaits);
+}
@@ -0,0 +1,622 @@
+// Occlusion culling
+// A small CPU depth buffer that a few large occluder triangles are rasterized into each frame, then reduced into a
+// min/max depth pyramid that object bounding boxes are tested against before they're submitted. Depth is the GL path's
+// window depth (0 near, 1 far) at OCCLUSION_WIDTH x OCCLUSION_HEIGHT whatever the render resolution.
+//  1. Setup  - occluders are transformed and turned into edge/depth planes, in batches across the job system
+//  2. Raster - one job per tile walks every occluder overlapping it, then reduces the tile's share of the pyramid
+//  3. Test   - a box is occluded when its nearest depth is behind the farthest occluder over every texel it covers
+// Sampling is at texel centres like the GL path, so a gap between occluders narrower than a texel can be closed.
+// Row kernels are AVX2 (8 wide) or scalar, selected at runtime.
+#include <immintrin.h>
+#include <float.h>
+
+#define OCCLUSION_WIDTH         256
+#define OCCLUSION_HEIGHT        128
+#define OCCLUSION_TILE_WIDTH    64
+#define OCCLUSION_TILE_HEIGHT   32
+#define OCCLUSION_TILES_X       (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y       (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT)
+#define OCCLUSION_LEVELS        8           // 256x128 down to 2x1
+#define OCCLUSION_TILE_LEVELS   6           // Levels a tile reduces itself (64x32 down to 2x1), the rest are done after
+#define OCCLUSION_SETUP_BATCH   256
+#define OCCLUSION_MIN_AREA      1.0f        // Twice the area in texels - anything smaller barely covers a sample
+
+typedef enum OCCLUSION_KERNEL
+{
+    OCCLUSION_KERNEL_SCALAR,
+    OCCLUSION_KERNEL_AVX2,
+} OCCLUSION_KERNEL;
+
+static const char *OcclusionKernelNames[] =
+{
+    "scalar",
+    "avx2",
+};
+
+// Value(x, y) = X * x + Y * y + C in texels
+typedef struct OCCLUSION_PLANE
+{
+    f32 X;
+    f32 Y;
+    f32 C;
+} OCCLUSION_PLANE;
+
+typedef struct OCCLUSION_TRIANGLE
+{
+    OCCLUSION_PLANE Edges[3];       // Positive inside
+    OCCLUSION_PLANE Depth;          // Farthest depth across each texel, not the centre
+    i32 MinX;
+    i32 MinY;
+    i32 MaxX;                       // Exclusive, equal to MinX when setup rejected it
+    i32 MaxY;
+} OCCLUSION_TRIANGLE;
+
+typedef struct OCCLUSION_STATS
+{
+    u32 Occluders;                  // Submitted
+    u32 OccludersDrawn;             // Survived setup
+    u32 OccludersDropped;           // Past MaxOccluders
+    u32 Tested;
+    u32 Occluded;
+    u32 Outside;                    // Off screen or past the far plane
+    f64 RasterMicroseconds;         // Setup, raster and pyramid
+    f64 TestMicroseconds;
+} OCCLUSION_STATS;
+
+typedef struct OCCLUSION_CULLER
+{
+    JOB_SYSTEM *Jobs;
+    OCCLUSION_KERNEL Kernel;
+    f32 ViewProjection[16];         // Column major, the frame's camera
+
+    // Occluders for the frame, 9 floats (three world space positions) each
+    f32 *Vertices;
+    OCCLUSION_TRIANGLE *Triangles;
+    u32 *Drawn;                     // Triangles that survived setup, in submission order
+    u32 OccluderCount;
+    u32 MaxOccluders;
+
+    // Level 0 is the depth buffer itself (min and max are the same texels), each level after halves both axes
+    f32 *MinDepth[OCCLUSION_LEVELS];
+    f32 *MaxDepth[OCCLUSION_LEVELS];
+
+    u64 TestTicks;
+    OCCLUSION_STATS Stats;
+} OCCLUSION_CULLER;
+
+
+OCCLUSION_KERNEL OcclusionDetectKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return OCCLUSION_KERNEL_AVX2;
+    }
+    return OCCLUSION_KERNEL_SCALAR;
+}
+
+void OcclusionCullerCreate(OCCLUSION_CULLER *Culler, MEMORY_ARENA *Arena, JOB_SYSTEM *Jobs, u32 MaxOccluders)
+{
+    *Culler = {};
+    Culler->Jobs            = Jobs;
+    Culler->Kernel          = OcclusionDetectKernel();
+    Culler->MaxOccluders    = MaxOccluders;
+    Culler->Vertices        = (f32 *) Arena->Alloc(sizeof(f32) * 9 * MaxOccluders, 64);
+    Culler->Triangles       = (OCCLUSION_TRIANGLE *) Arena->Alloc(sizeof(OCCLUSION_TRIANGLE) * MaxOccluders, 64);
+    Culler->Drawn           = (u32 *) Arena->Alloc(sizeof(u32) * MaxOccluders, 64);
+    Assert(Culler->Vertices && Culler->Triangles && Culler->Drawn, "Occlusion: Failed to allocate occluders!");
+
+    for(u32 Level = 0; Level < OCCLUSION_LEVELS; ++Level)
+    {
+        size_t Texels = (size_t) (OCCLUSION_WIDTH >> Level) * (OCCLUSION_HEIGHT >> Level);
+        Culler->MaxDepth[Level] = (f32 *) Arena->Alloc(sizeof(f32) * Texels, 64);
+        Culler->MinDepth[Level] = (Level == 0) ? Culler->MaxDepth[0] : (f32 *) Arena->Alloc(sizeof(f32) * Texels, 64);
+        Assert(Culler->MaxDepth[Level] && Culler->MinDepth[Level], "Occlusion: Failed to allocate depth pyramid!");
+    }
+}
+
+// Starts a frame - ViewProjection is column major, the same matrix the GL path draws with
+void OcclusionBegin(OCCLUSION_CULLER *Culler, const f32 *ViewProjection)
+{
+    memcpy(Culler->ViewProjection, ViewProjection, sizeof(Culler->ViewProjection));
+    Culler->OccluderCount   = 0;
+    Culler->TestTicks       = 0;
+    Culler->Stats           = {};
+}
+
+// Positions are 9 floats per triangle - anything past MaxOccluders is dropped (less culling, never wrong culling)
+void OcclusionPushTriangles(OCCLUSION_CULLER *Culler, const f32 *Positions, u32 TriangleCount)
+{
+    u32 Free = Culler->MaxOccluders - Culler->OccluderCount;
+    u32 Count = (TriangleCount < Free) ? TriangleCount : Free;
+    memcpy(Culler->Vertices + (size_t) Culler->OccluderCount * 9, Positions, sizeof(f32) * 9 * Count);
+    Culler->OccluderCount           += Count;
+    Culler->Stats.Occluders         += TriangleCount;
+    Culler->Stats.OccludersDropped  += TriangleCount - Count;
+}
+
+OCCLUSION_PLANE OcclusionPlane(OCCLUSION_PLANE *Edges, f32 InverseArea, f32 A0, f32 A1, f32 A2)
+{
+    // A = A0 + (E1 * (A1 - A0) + E2 * (A2 - A0)) / Area, expanded into x/y/constant terms
+    f32 D1 = (A1 - A0) * InverseArea;
+    f32 D2 = (A2 - A0) * InverseArea;
+
+    OCCLUSION_PLANE Result = {};
+    Result.X = (Edges[1].X * D1) + (Edges[2].X * D2);
+    Result.Y = (Edges[1].Y * D1) + (Edges[2].Y * D2);
+    Result.C = A0 + (Edges[1].C * D1) + (Edges[2].C * D2);
+    return Result;
+}
+
+// Returns false for rejected triangles. Anything the GL path would clip at the near plane is rejected outright - a
+// clipped away part must never hide what's behind it
+bool OcclusionSetupTriangle(OCCLUSION_CULLER *Culler, const f32 *Positions, OCCLUSION_TRIANGLE *Result)
+{
+    const f32 *M = Culler->ViewProjection;
+
+    f32 X[3], Y[3], Z[3];
+    for(u32 i = 0; i < 3; ++i)
+    {
+        const f32 *P = Positions + (i * 3);
+        f32 Cx = M[0] * P[0] + M[4] * P[1] + M[8] * P[2] + M[12];
+        f32 Cy = M[1] * P[0] + M[5] * P[1] + M[9] * P[2] + M[13];
+        f32 Cz = M[2] * P[0] + M[6] * P[1] + M[10] * P[2] + M[14];
+        f32 Cw = M[3] * P[0] + M[7] * P[1] + M[11] * P[2] + M[15];
+        if(Cw <= 1e-5f || Cz < -Cw)
+        {
+            return false;
+        }
+
+        // Rows bottom-up like the GL viewport, texel centres at +0.5
+        f32 InverseW = 1.0f / Cw;
+        X[i] = ((Cx * InverseW) * 0.5f + 0.5f) * (f32) OCCLUSION_WIDTH;
+        Y[i] = ((Cy * InverseW) * 0.5f + 0.5f) * (f32) OCCLUSION_HEIGHT;
+        Z[i] = (Cz * InverseW) * 0.5f + 0.5f;
+    }
+
+    // Edge functions, each opposite its vertex
+    OCCLUSION_PLANE *Edges = Result->Edges;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        u32 A = (i + 1) % 3;
+        u32 B = (i + 2) % 3;
+        Edges[i].X = Y[A] - Y[B];
+        Edges[i].Y = X[B] - X[A];
+        Edges[i].C = (X[A] * Y[B]) - (X[B] * Y[A]);
+    }
+
+    // Both facings occlude - the GL path doesn't cull back faces either
+    f32 Area = Edges[0].C + Edges[1].C + Edges[2].C;
+    if(fabsf(Area) < OCCLUSION_MIN_AREA)
+    {
+        return false;
+    }
+    if(Area < 0)
+    {
+        for(u32 i = 0; i < 3; ++i)
+        {
+            Edges[i].X = -Edges[i].X;
+            Edges[i].Y = -Edges[i].Y;
+            Edges[i].C = -Edges[i].C;
+        }
+        Area = -Area;
+    }
+
+    f32 MinX = fminf(X[0], fminf(X[1], X[2]));
+    f32 MinY = fminf(Y[0], fminf(Y[1], Y[2]));
+    f32 MaxX = fmaxf(X[0], fmaxf(X[1], X[2]));
+    f32 MaxY = fmaxf(Y[0], fmaxf(Y[1], Y[2]));
+    if(MaxX < 0 || MaxY < 0 || MinX >= (f32) OCCLUSION_WIDTH || MinY >= (f32) OCCLUSION_HEIGHT)
+    {
+        return false;
+    }
+    Result->MinX = (MinX < 0) ? 0 : (i32) MinX;
+    Result->MinY = (MinY < 0) ? 0 : (i32) MinY;
+    Result->MaxX = (MaxX >= (f32) OCCLUSION_WIDTH) ? OCCLUSION_WIDTH : (i32) MaxX + 1;
+    Result->MaxY = (MaxY >= (f32) OCCLUSION_HEIGHT) ? OCCLUSION_HEIGHT : (i32) MaxY + 1;
+
+    // Pushed back to the far corner of each texel, so a texel never claims to be nearer than any part of it is
+    Result->Depth = OcclusionPlane(Edges, 1.0f / Area, Z[0], Z[1], Z[2]);
+    Result->Depth.C += 0.5f * (fabsf(Result->Depth.X) + fabsf(Result->Depth.Y));
+
+    return true;
+}
+
+void OcclusionSetupTriangles(void *Data, u32 Start, u32 End)
+{
+    PROFILE_SCOPE("OcclusionSetup");
+    OCCLUSION_CULLER *Culler = (OCCLUSION_CULLER *) Data;
+    for(u32 i = Start; i < End; ++i)
+    {
+        OCCLUSION_TRIANGLE *Triangle = &Culler->Triangles[i];
+        if(!OcclusionSetupTriangle(Culler, Culler->Vertices + (size_t) i * 9, Triangle))
+        {
+            Triangle->MinX = Triangle->MaxX = 0;
+        }
+    }
+}
+
+// Where each edge crosses a row, as x = Slope * Py + Offset - worked out once per triangle so rows don't divide
+typedef struct OCCLUSION_SPAN
+{
+    f32 Slope[3];
+    f32 Offset[3];
+    i32 Side[3];                    // 1 inside to the right of the crossing, -1 to the left, 0 to leave the row alone
+} OCCLUSION_SPAN;
+
+OCCLUSION_SPAN OcclusionSpan(OCCLUSION_PLANE *Edges)
+{
+    // Near horizontal edges cross so far out that the crossing isn't worth trusting - the kernels test those anyway
+    OCCLUSION_SPAN Result = {};
+    for(u32 i = 0; i < 3; ++i)
+    {
+        if(fabsf(Edges[i].X) * 1024.0f > fabsf(Edges[i].Y))
+        {
+            Result.Slope[i]     = -Edges[i].Y / Edges[i].X;
+            Result.Offset[i]    = -Edges[i].C / Edges[i].X;
+            Result.Side[i]      = (Edges[i].X > 0) ? 1 : -1;
+        }
+    }
+    return Result;
+}
+
+// Narrows [X0, X1) to the texels of row Py the edges can cover, a texel wider each side so rounding never loses one.
+// The kernels still test every texel - this only saves walking the empty half of a triangle's bounds
+inline bool OcclusionRowSpan(OCCLUSION_SPAN *Span, f32 Py, i32 *X0, i32 *X1)
+{
+    f32 Left    = (f32) *X0;
+    f32 Right   = (f32) *X1;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        f32 Crossing = Span->Slope[i] * Py + Span->Offset[i];
+        if(Span->Side[i] > 0)
+        {
+            Left = (Crossing - 1.5f > Left) ? Crossing - 1.5f : Left;
+        }
+        else if(Span->Side[i] < 0)
+        {
+            Right = (Crossing + 1.5f < Right) ? Crossing + 1.5f : Right;
+        }
+    }
+    if(Left >= Right)
+    {
+        return false;
+    }
+    *X0 = (i32) Left;
+    *X1 = (Right < (f32) *X1) ? (i32) Right : *X1;
+    return *X0 < *X1;
+}
+
+// Reference kernel - one texel at a time
+void OcclusionRasterScalar(OCCLUSION_CULLER *Culler, OCCLUSION_TRIANGLE *Triangle, i32 X0, i32 Y0, i32 X1, i32 Y1)
+{
+    OCCLUSION_PLANE *E = Triangle->Edges;
+    OCCLUSION_SPAN Span = OcclusionSpan(E);
+    for(i32 Y = Y0; Y < Y1; ++Y)
+    {
+        f32 *DepthRow   = Culler->MaxDepth[0] + (Y * OCCLUSION_WIDTH);
+        f32 Py          = (f32) Y + 0.5f;
+        i32 SpanX0      = X0;
+        i32 SpanX1      = X1;
+        if(!OcclusionRowSpan(&Span, Py, &SpanX0, &SpanX1))
+        {
+            continue;
+        }
+
+        // Row constants, summed in the same order as the AVX2 kernel so both write the same depths
+        f32 E0Row   = E[0].Y * Py + E[0].C;
+        f32 E1Row   = E[1].Y * Py + E[1].C;
+        f32 E2Row   = E[2].Y * Py + E[2].C;
+        f32 ZRow    = Triangle->Depth.Y * Py + Triangle->Depth.C;
+        for(i32 X = SpanX0; X < SpanX1; ++X)
+        {
+            f32 Px = (f32) X + 0.5f;
+            if((E[0].X * Px + E0Row) < 0 || (E[1].X * Px + E1Row) < 0 || (E[2].X * Px + E2Row) < 0)
+            {
+                continue;
+            }
+
+            f32 Z = Triangle->Depth.X * Px + ZRow;
+            DepthRow[X] = (Z < DepthRow[X]) ? Z : DepthRow[X];
+        }
+    }
+}
+
+// Tiles are whole multiples of 8 texels wide, so aligning a span down never leaves the tile
+__attribute__((target("avx2")))
+void OcclusionRasterAVX2(OCCLUSION_CULLER *Culler, OCCLUSION_TRIANGLE *Triangle, i32 X0, i32 Y0, i32 X1, i32 Y1)
+{
+    OCCLUSION_PLANE *E = Triangle->Edges;
+    OCCLUSION_SPAN Span = OcclusionSpan(E);
+    __m256 Offsets  = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    __m256 Zero     = _mm256_setzero_ps();
+    for(i32 Y = Y0; Y < Y1; ++Y)
+    {
+        f32 *DepthRow   = Culler->MaxDepth[0] + (Y * OCCLUSION_WIDTH);
+        f32 Py          = (f32) Y + 0.5f;
+        i32 SpanX0      = X0;
+        i32 SpanX1      = X1;
+        if(!OcclusionRowSpan(&Span, Py, &SpanX0, &SpanX1))
+        {
+            continue;
+        }
+
+        // Row constants
+        __m256 E0Row    = _mm256_set1_ps(E[0].Y * Py + E[0].C);
+        __m256 E1Row    = _mm256_set1_ps(E[1].Y * Py + E[1].C);
+        __m256 E2Row    = _mm256_set1_ps(E[2].Y * Py + E[2].C);
+        __m256 ZRow     = _mm256_set1_ps(Triangle->Depth.Y * Py + Triangle->Depth.C);
+
+        for(i32 X = SpanX0 & ~7; X < SpanX1; X += 8)
+        {
+            __m256 Px = _mm256_add_ps(_mm256_set1_ps((f32) X), Offsets);
+            __m256 E0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[0].X), Px), E0Row);
+            __m256 E1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[1].X), Px), E1Row);
+            __m256 E2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[2].X), Px), E2Row);
+            __m256 Inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(E0, Zero, _CMP_GE_OQ), _mm256_cmp_ps(E1, Zero, _CMP_GE_OQ)), _mm256_cmp_ps(E2, Zero, _CMP_GE_OQ));
+            if(!_mm256_movemask_ps(Inside))
+            {
+                continue;
+            }
+
+            __m256 Z        = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Triangle->Depth.X), Px), ZRow);
+            __m256 Depth    = _mm256_load_ps(DepthRow + X);
+            _mm256_store_ps(DepthRow + X, _mm256_blendv_ps(Depth, _mm256_min_ps(Depth, Z), Inside));
+        }
+    }
+}
+
+// Halves the region (X, Y, Width, Height, in Level's texels) into Level + 1
+void OcclusionReduce(OCCLUSION_CULLER *Culler, u32 Level, i32 X, i32 Y, i32 Width, i32 Height)
+{
+    i32 SourceWidth     = OCCLUSION_WIDTH >> Level;
+    i32 TargetWidth     = SourceWidth >> 1;
+    const f32 *SourceMin = Culler->MinDepth[Level];
+    const f32 *SourceMax = Culler->MaxDepth[Level];
+    f32 *TargetMin      = Culler->MinDepth[Level + 1];
+    f32 *TargetMax      = Culler->MaxDepth[Level + 1];
+    for(i32 Row = Y / 2; Row < (Y + Height) / 2; ++Row)
+    {
+        const f32 *Min0 = SourceMin + (Row * 2) * SourceWidth;
+        const f32 *Min1 = Min0 + SourceWidth;
+        const f32 *Max0 = SourceMax + (Row * 2) * SourceWidth;
+        const f32 *Max1 = Max0 + SourceWidth;
+        // Plain compares rather than fminf/fmaxf, which keep NaN rules the compiler won't vectorize around
+        for(i32 Column = X / 2; Column < (X + Width) / 2; ++Column)
+        {
+            i32 S = Column * 2;
+            f32 MinA = (Min0[S] < Min0[S + 1]) ? Min0[S] : Min0[S + 1];
+            f32 MinB = (Min1[S] < Min1[S + 1]) ? Min1[S] : Min1[S + 1];
+            f32 MaxA = (Max0[S] > Max0[S + 1]) ? Max0[S] : Max0[S + 1];
+            f32 MaxB = (Max1[S] > Max1[S + 1]) ? Max1[S] : Max1[S + 1];
+            TargetMin[Row * TargetWidth + Column] = (MinA < MinB) ? MinA : MinB;
+            TargetMax[Row * TargetWidth + Column] = (MaxA > MaxB) ? MaxA : MaxB;
+        }
+    }
+}
+
+void OcclusionRasterTiles(void *Data, u32 Start, u32 End)
+{
+    PROFILE_SCOPE("OcclusionRasterTiles");
+    OCCLUSION_CULLER *Culler = (OCCLUSION_CULLER *) Data;
+    for(u32 Tile = Start; Tile < End; ++Tile)
+    {
+        i32 TileX0 = (Tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+        i32 TileY0 = (Tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+        i32 TileX1 = TileX0 + OCCLUSION_TILE_WIDTH;
+        i32 TileY1 = TileY0 + OCCLUSION_TILE_HEIGHT;
+
+        for(i32 Y = TileY0; Y < TileY1; ++Y)
+        {
+            f32 *DepthRow = Culler->MaxDepth[0] + (Y * OCCLUSION_WIDTH);
+            for(i32 X = TileX0; X < TileX1; ++X)
+            {
+                DepthRow[X] = 1.0f;
+            }
+        }
+
+        for(u32 i = 0; i < Culler->Stats.OccludersDrawn; ++i)
+        {
+            OCCLUSION_TRIANGLE *Triangle = &Culler->Triangles[Culler->Drawn[i]];
+            i32 X0 = (Triangle->MinX > TileX0) ? Triangle->MinX : TileX0;
+            i32 Y0 = (Triangle->MinY > TileY0) ? Triangle->MinY : TileY0;
+            i32 X1 = (Triangle->MaxX < TileX1) ? Triangle->MaxX : TileX1;
+            i32 Y1 = (Triangle->MaxY < TileY1) ? Triangle->MaxY : TileY1;
+            if(X0 >= X1 || Y0 >= Y1)
+            {
+                continue;
+            }
+
+            switch(Culler->Kernel)
+            {
+                case OCCLUSION_KERNEL_AVX2:   OcclusionRasterAVX2(Culler, Triangle, X0, Y0, X1, Y1); break;
+                default:                      OcclusionRasterScalar(Culler, Triangle, X0, Y0, X1, Y1); break;
+            }
+        }
+
+        // This tile's share of the pyramid - the levels above it need every tile
+        for(u32 Level = 0; Level + 1 < OCCLUSION_TILE_LEVELS; ++Level)
+        {
+            OcclusionReduce(Culler, Level, TileX0 >> Level, TileY0 >> Level, OCCLUSION_TILE_WIDTH >> Level, OCCLUSION_TILE_HEIGHT >> Level);
+        }
+    }
+}
+
+// Call once all of the frame's occluders are pushed, before any tests
+void OcclusionRasterize(OCCLUSION_CULLER *Culler)
+{
+    PROFILE_SCOPE("OcclusionRasterize");
+    u64 Start = __rdtsc();
+
+    JobParallelFor(Culler->Jobs, Culler->OccluderCount, OCCLUSION_SETUP_BATCH, OcclusionSetupTriangles, Culler);
+
+    u32 Drawn = 0;
+    for(u32 i = 0; i < Culler->OccluderCount; ++i)
+    {
+        if(Culler->Triangles[i].MinX < Culler->Triangles[i].MaxX)
+        {
+            Culler->Drawn[Drawn++] = i;
+        }
+    }
+    Culler->Stats.OccludersDrawn = Drawn;
+
+    JobParallelFor(Culler->Jobs, OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1, OcclusionRasterTiles, Culler);
+    for(u32 Level = OCCLUSION_TILE_LEVELS - 1; Level + 1 < OCCLUSION_LEVELS; ++Level)
+    {
+        OcclusionReduce(Culler, Level, 0, 0, OCCLUSION_WIDTH >> Level, OCCLUSION_HEIGHT >> Level);
+    }
+
+    Culler->Stats.RasterMicroseconds = ProfilerTicksToMicroseconds(__rdtsc() - Start);
+}
+
+// True if any texel's farthest occluder in the rows is at or behind Depth. Rows are at most 8 texels wide
+bool OcclusionAnyBehindScalar(const f32 *Texels, i32 Pitch, i32 X0, i32 Y0, i32 X1, i32 Y1, f32 Depth)
+{
+    for(i32 Y = Y0; Y <= Y1; ++Y)
+    {
+        const f32 *Row = Texels + (Y * Pitch);
+        for(i32 X = X0; X <= X1; ++X)
+        {
+            if(Row[X] >= Depth)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Masked lanes aren't read, so a row at the edge of a level never reads past it
+__attribute__((target("avx2")))
+bool OcclusionAnyBehindAVX2(const f32 *Texels, i32 Pitch, i32 X0, i32 Y0, i32 X1, i32 Y1, f32 Depth)
+{
+    __m256i Lanes   = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i Mask    = _mm256_cmpgt_epi32(_mm256_set1_epi32(X1 - X0 + 1), Lanes);
+    __m256 Nearest  = _mm256_set1_ps(Depth);
+    for(i32 Y = Y0; Y <= Y1; ++Y)
+    {
+        __m256 Farthest = _mm256_maskload_ps(Texels + (Y * Pitch) + X0, Mask);
+        __m256 Behind   = _mm256_and_ps(_mm256_cmp_ps(Farthest, Nearest, _CMP_GE_OQ), _mm256_castsi256_ps(Mask));
+        if(_mm256_movemask_ps(Behind))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns false when the box can't be seen - hidden behind the occluders, off screen or past the far plane.
+// Boxes reaching behind the near plane are always visible
+bool OcclusionTestBox(OCCLUSION_CULLER *Culler, const f32 *Min, const f32 *Max)
+{
+    u64 Start = __rdtsc();
+    ++Culler->Stats.Tested;
+
+    // Screen bounds and nearest depth of the eight corners
+    const f32 *M = Culler->ViewProjection;
+    f32 MinX = FLT_MAX, MinY = FLT_MAX, MaxX = -FLT_MAX, MaxY = -FLT_MAX, Nearest = FLT_MAX;
+    bool Crossing = false;
+    for(u32 Corner = 0; Corner < 8; ++Corner)
+    {
+        f32 Px = (Corner & 1) ? Max[0] : Min[0];
+        f32 Py = (Corner & 2) ? Max[1] : Min[1];
+        f32 Pz = (Corner & 4) ? Max[2] : Min[2];
+        f32 Cx = M[0] * Px + M[4] * Py + M[8] * Pz + M[12];
+        f32 Cy = M[1] * Px + M[5] * Py + M[9] * Pz + M[13];
+        f32 Cz = M[2] * Px + M[6] * Py + M[10] * Pz + M[14];
+        f32 Cw = M[3] * Px + M[7] * Py + M[11] * Pz + M[15];
+        if(Cw <= 1e-5f || Cz < -Cw)
+        {
+            Crossing = true;
+            break;
+        }
+
+        f32 InverseW = 1.0f / Cw;
+        f32 X = ((Cx * InverseW) * 0.5f + 0.5f) * (f32) OCCLUSION_WIDTH;
+        f32 Y = ((Cy * InverseW) * 0.5f + 0.5f) * (f32) OCCLUSION_HEIGHT;
+        f32 Z = (Cz * InverseW) * 0.5f + 0.5f;
+        MinX = fminf(MinX, X);
+        MinY = fminf(MinY, Y);
+        MaxX = fmaxf(MaxX, X);
+        MaxY = fmaxf(MaxY, Y);
+        Nearest = fminf(Nearest, Z);
+    }
+
+    bool Visible = true;
+    if(Crossing)
+    {
+        // Left to the GL path to clip
+    }
+    else if(MaxX < 0 || MaxY < 0 || MinX >= (f32) OCCLUSION_WIDTH || MinY >= (f32) OCCLUSION_HEIGHT || Nearest > 1.0f)
+    {
+        Visible = false;
+        ++Culler->Stats.Outside;
+    }
+    else
+    {
+        // Every texel the box touches, inclusive
+        i32 X0 = (MinX < 0) ? 0 : (i32) MinX;
+        i32 Y0 = (MinY < 0) ? 0 : (i32) MinY;
+        i32 X1 = (MaxX >= (f32) OCCLUSION_WIDTH) ? OCCLUSION_WIDTH - 1 : (i32) MaxX;
+        i32 Y1 = (MaxY >= (f32) OCCLUSION_HEIGHT) ? OCCLUSION_HEIGHT - 1 : (i32) MaxY;
+
+        // Coarse level - where the box covers at most 2x2 texels
+        u32 Level = 0;
+        while(Level + 1 < OCCLUSION_LEVELS && (((X1 >> Level) - (X0 >> Level)) > 1 || ((Y1 >> Level) - (Y0 >> Level)) > 1))
+        {
+            ++Level;
+        }
+        i32 Pitch = OCCLUSION_WIDTH >> Level;
+        f32 Nearer = 1.0f;
+        f32 Farther = 0.0f;
+        for(i32 Y = Y0 >> Level; Y <= (Y1 >> Level); ++Y)
+        {
+            for(i32 X = X0 >> Level; X <= (X1 >> Level); ++X)
+            {
+                Nearer  = fminf(Nearer, Culler->MinDepth[Level][Y * Pitch + X]);
+                Farther = fmaxf(Farther, Culler->MaxDepth[Level][Y * Pitch + X]);
+            }
+        }
+
+        // In front of every occluder there is visible, behind the farthest is hidden - otherwise look closer, two levels
+        // down where the same area is at most 8x8 texels
+        if(Nearest <= Nearer)
+        {
+            Visible = true;
+        }
+        else if(Nearest > Farther)
+        {
+            Visible = false;
+        }
+        else
+        {
+            u32 Fine = (Level > 2) ? Level - 2 : 0;
+            i32 FinePitch = OCCLUSION_WIDTH >> Fine;
+            switch(Culler->Kernel)
+            {
+                case OCCLUSION_KERNEL_AVX2:
+                    Visible = OcclusionAnyBehindAVX2(Culler->MaxDepth[Fine], FinePitch, X0 >> Fine, Y0 >> Fine, X1 >> Fine, Y1 >> Fine, Nearest);
+                    break;
+                default:
+                    Visible = OcclusionAnyBehindScalar(Culler->MaxDepth[Fine], FinePitch, X0 >> Fine, Y0 >> Fine, X1 >> Fine, Y1 >> Fine, Nearest);
+                    break;
+            }
+        }
+        Culler->Stats.Occluded += !Visible;
+    }
+
+    Culler->TestTicks += __rdtsc() - Start;
+    return Visible;
+}
+
+// Call after the frame's tests
+void OcclusionEnd(OCCLUSION_CULLER *Culler)
+{
+    OCCLUSION_STATS *Stats = &Culler->Stats;
+    Stats->TestMicroseconds = ProfilerTicksToMicroseconds(Culler->TestTicks);
+
+    const char *Series[]    = {"tested", "occluded", "outside", "occluders"};
+    u32 Values[]            = {Stats->Tested, Stats->Occluded, Stats->Outside, Stats->OccludersDrawn};
+    ProfilerWriteCounters("Occlusion", Series, Values, ArrayCount(Values));
+    ProfilerWriteCounter("Occlusion cost us", Stats->RasterMicroseconds + Stats->TestMicroseconds);
+}
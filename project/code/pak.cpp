@@ -0,0 +1,341 @@
+// Assets
+// Every asset load goes through here. With an archive mounted, paths are looked up in its hashed table of contents:
+// stored entries come back as pointers into the mapping (no open, read or copy), compressed ones are decompressed
+// into the caller's memory. Loose files still override the archive when overrides are on, so assets can be edited
+// without rebuilding it, and with nothing mounted every load is a loose file as before.
+#include "pak.h"
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct PAK_ARCHIVE
+{
+    u8 *Base;
+    size_t Size;
+    PAK_HEADER *Header;
+    PAK_ENTRY *Entries;
+    u32 *Slots;
+    const char *Names;
+#if defined(_WIN32)
+    HANDLE File;
+    HANDLE Mapping;
+#endif
+} PAK_ARCHIVE;
+
+typedef struct ASSET_STATS
+{
+    std::atomic<u32> LooseFiles;
+    std::atomic<u32> PakEntries;
+    std::atomic<u32> Missing;
+    std::atomic<u64> LooseBytes;        // Read through the CRT
+    std::atomic<u64> MappedBytes;       // Served straight from the mapping, in place or copied
+    std::atomic<u64> DecompressedBytes;
+} ASSET_STATS;
+
+typedef struct ASSETS
+{
+    PAK_ARCHIVE Pak;
+    bool Mounted;
+    bool LooseOverride;
+    ASSET_STATS Stats;
+} ASSETS;
+
+// One open asset - either a loose file or an archive entry
+typedef struct ASSET
+{
+    size_t Size;
+    const u8 *Mapped;           // Set when the bytes can be used in place
+    PAK_ENTRY *Entry;
+    FILE *Loose;
+} ASSET;
+
+static ASSETS GlobalAssets;
+
+void PakClose(PAK_ARCHIVE *Pak)
+{
+#if defined(_WIN32)
+    if(Pak->Base)
+    {
+        UnmapViewOfFile(Pak->Base);
+    }
+    if(Pak->Mapping)
+    {
+        CloseHandle(Pak->Mapping);
+    }
+    if(Pak->File && Pak->File != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(Pak->File);
+    }
+#else
+    if(Pak->Base)
+    {
+        munmap(Pak->Base, Pak->Size);
+    }
+#endif
+    *Pak = {};
+}
+
+bool PakOpen(PAK_ARCHIVE *Pak, const char *Path)
+{
+    *Pak = {};
+
+    // Read only mapping - pages are faulted in as entries are touched and shared with the page cache
+#if defined(_WIN32)
+    Pak->File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    LARGE_INTEGER FileSize = {};
+    if(Pak->File == INVALID_HANDLE_VALUE || !GetFileSizeEx(Pak->File, &FileSize))
+    {
+        printf("Pak: Failed to open %s\n", Path);
+        PakClose(Pak);
+        return false;
+    }
+    Pak->Size       = (size_t) FileSize.QuadPart;
+    Pak->Mapping    = CreateFileMappingA(Pak->File, 0, PAGE_READONLY, 0, 0, 0);
+    Pak->Base       = Pak->Mapping ? (u8 *) MapViewOfFile(Pak->Mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+#else
+    i32 File = open(Path, O_RDONLY);
+    struct stat Info = {};
+    if(File < 0 || fstat(File, &Info) != 0)
+    {
+        printf("Pak: Failed to open %s\n", Path);
+        if(File >= 0)
+        {
+            close(File);
+        }
+        return false;
+    }
+    Pak->Size = (size_t) Info.st_size;
+    void *Base = (Pak->Size > 0) ? mmap(0, Pak->Size, PROT_READ, MAP_PRIVATE, File, 0) : MAP_FAILED;
+    Pak->Base = (Base != MAP_FAILED) ? (u8 *) Base : 0;
+    close(File);
+#endif
+    if(!Pak->Base)
+    {
+        printf("Pak: Failed to map %s\n", Path);
+        PakClose(Pak);
+        return false;
+    }
+
+    // Validate the table of contents once so lookups can trust it
+    PAK_HEADER *Header = (PAK_HEADER *) Pak->Base;
+    bool Valid = Pak->Size >= sizeof(PAK_HEADER) && Header->Magic == PAK_MAGIC && Header->Version == PAK_VERSION && Header->FileSize == Pak->Size &&
+                 Header->SlotCount > 0 && (Header->SlotCount & (Header->SlotCount - 1)) == 0 && Header->SlotCount >= Header->EntryCount &&
+                 Header->EntryOffset + (u64) sizeof(PAK_ENTRY) * Header->EntryCount <= Pak->Size &&
+                 Header->SlotOffset + (u64) sizeof(u32) * Header->SlotCount <= Pak->Size &&
+                 Header->NameOffset + Header->NameBytes <= Pak->Size && Header->NameBytes > 0 && Pak->Base[Header->NameOffset + Header->NameBytes - 1] == 0;
+    PAK_ENTRY *Entries = (PAK_ENTRY *) (Pak->Base + Header->EntryOffset);
+    for(u32 i = 0; Valid && i < Header->EntryCount; ++i)
+    {
+        // Stored entries need their trailing zero inside the file too
+        u64 End = Entries[i].Offset + Entries[i].StoredSize + ((Entries[i].Flags & PAK_ENTRY_COMPRESSED) ? 0 : 1);
+        Valid = End <= Pak->Size && Entries[i].NameOffset < Header->NameBytes &&
+                ((Entries[i].Flags & PAK_ENTRY_COMPRESSED) || Entries[i].StoredSize == Entries[i].Size);
+    }
+    if(!Valid)
+    {
+        printf("Pak: %s is not a version %u archive, or is truncated\n", Path, PAK_VERSION);
+        PakClose(Pak);
+        return false;
+    }
+
+    Pak->Header     = Header;
+    Pak->Entries    = Entries;
+    Pak->Slots      = (u32 *) (Pak->Base + Header->SlotOffset);
+    Pak->Names      = (const char *) (Pak->Base + Header->NameOffset);
+    return true;
+}
+
+PAK_ENTRY *PakFind(PAK_ARCHIVE *Pak, const char *Path)
+{
+    u64 Hash = PakHashPath(Path);
+    u32 Mask = Pak->Header->SlotCount - 1;
+    for(u32 Probe = 0; Probe <= Mask; ++Probe)
+    {
+        u32 Index = Pak->Slots[(Hash + Probe) & Mask];
+        if(Index == PAK_EMPTY_SLOT || Index >= Pak->Header->EntryCount)
+        {
+            break;
+        }
+        PAK_ENTRY *Entry = &Pak->Entries[Index];
+        if(Entry->Hash == Hash && PakPathsMatch(Pak->Names + Entry->NameOffset, Path))
+        {
+            return Entry;
+        }
+    }
+    return 0;
+}
+
+// Overrides only cost an open attempt per load, and can be turned off for shipping
+bool AssetsMount(const char *PakPath, bool LooseOverride)
+{
+    if(!PakOpen(&GlobalAssets.Pak, PakPath))
+    {
+        return false;
+    }
+    GlobalAssets.Mounted        = true;
+    GlobalAssets.LooseOverride  = LooseOverride;
+    return true;
+}
+
+void AssetsUnmount()
+{
+    if(GlobalAssets.Mounted)
+    {
+        PakClose(&GlobalAssets.Pak);
+        GlobalAssets.Mounted = false;
+    }
+}
+
+bool AssetOpen(ASSET *Asset, const char *Path)
+{
+    *Asset = {};
+    if(!GlobalAssets.Mounted || GlobalAssets.LooseOverride)
+    {
+        Asset->Loose = fopen(Path, "rb");
+        if(Asset->Loose)
+        {
+            fseek(Asset->Loose, 0, SEEK_END);
+            Asset->Size = (size_t) ftell(Asset->Loose);
+            fseek(Asset->Loose, 0, SEEK_SET);
+            ++GlobalAssets.Stats.LooseFiles;
+            return true;
+        }
+    }
+
+    PAK_ENTRY *Entry = GlobalAssets.Mounted ? PakFind(&GlobalAssets.Pak, Path) : 0;
+    if(!Entry)
+    {
+        ++GlobalAssets.Stats.Missing;
+        return false;
+    }
+    Asset->Entry    = Entry;
+    Asset->Size     = (size_t) Entry->Size;
+    Asset->Mapped   = (Entry->Flags & PAK_ENTRY_COMPRESSED) ? 0 : GlobalAssets.Pak.Base + Entry->Offset;
+    GlobalAssets.Stats.MappedBytes += Asset->Mapped ? Asset->Size : 0;
+    ++GlobalAssets.Stats.PakEntries;
+    return true;
+}
+
+// Copies, reads or decompresses all Size bytes
+bool AssetRead(ASSET *Asset, void *Dest)
+{
+    if(Asset->Loose)
+    {
+        bool Result = fread(Dest, 1, Asset->Size, Asset->Loose) == Asset->Size;
+        GlobalAssets.Stats.LooseBytes += Asset->Size;
+        return Result;
+    }
+    if(Asset->Mapped)
+    {
+        memcpy(Dest, Asset->Mapped, Asset->Size);
+        return true;
+    }
+
+    PROFILE_SCOPE("AssetDecompress");
+    PAK_ENTRY *Entry = Asset->Entry;
+    GlobalAssets.Stats.DecompressedBytes += Entry->Size;
+    return PakDecompressEntry(GlobalAssets.Pak.Base + Entry->Offset, Entry->StoredSize, (u8 *) Dest, Entry->Size);
+}
+
+// The first Size bytes, leaving the asset to be read in full afterwards. Compressed entries decompress their whole
+// first chunk into Dest, so Capacity has to cover PAK_CHUNK_SIZE bytes (or the asset, if it's smaller)
+bool AssetPeek(ASSET *Asset, void *Dest, size_t Size, size_t Capacity)
+{
+    if(Size > Asset->Size || Size > Capacity)
+    {
+        return false;
+    }
+    if(Asset->Loose)
+    {
+        bool Result = fread(Dest, 1, Size, Asset->Loose) == Size;
+        fseek(Asset->Loose, 0, SEEK_SET);
+        GlobalAssets.Stats.LooseBytes += Size;
+        return Result;
+    }
+    if(Asset->Mapped)
+    {
+        memcpy(Dest, Asset->Mapped, Size);
+        return true;
+    }
+
+    PAK_ENTRY *Entry    = Asset->Entry;
+    u64 ChunkSize       = (Entry->Size < PAK_CHUNK_SIZE) ? Entry->Size : PAK_CHUNK_SIZE;
+    u64 TableSize       = (u64) PakChunkCount(Entry->Size) * sizeof(u32);
+    if(Size > ChunkSize || ChunkSize > Capacity || TableSize > Entry->StoredSize)
+    {
+        return false;
+    }
+
+    const u8 *Stored    = GlobalAssets.Pak.Base + Entry->Offset;
+    u32 Chunk           = *(const u32 *) Stored;
+    u32 Bytes           = Chunk & ~PAK_CHUNK_STORED;
+    if(Bytes > Entry->StoredSize - TableSize)
+    {
+        return false;
+    }
+    GlobalAssets.Stats.DecompressedBytes += ChunkSize;
+    if(Chunk & PAK_CHUNK_STORED)
+    {
+        if(Bytes != ChunkSize)
+        {
+            return false;
+        }
+        memcpy(Dest, Stored + TableSize, Size);
+        return true;
+    }
+    return PakDecompressLZ4(Stored + TableSize, Bytes, (u8 *) Dest, ChunkSize) == (i64) ChunkSize;
+}
+
+void AssetClose(ASSET *Asset)
+{
+    if(Asset->Loose)
+    {
+        fclose(Asset->Loose);
+    }
+    *Asset = {};
+}
+
+// Whole asset with a null after the last byte, like VirtualArenaLoadFile - in place when the archive stores it uncompressed.
+// Mapped memory is read only. Null if the asset can't be found or read
+u8 *AssetLoad(VIRTUAL_ARENA *Arena, const char *Path, size_t *Size)
+{
+    ASSET Asset = {};
+    if(!AssetOpen(&Asset, Path))
+    {
+        return 0;
+    }
+
+    u8 *Result = (u8 *) Asset.Mapped;
+    if(!Result)
+    {
+        Result = (u8 *) VirtualArenaAlloc(Arena, Asset.Size + 1, 64);
+        if(Result && AssetRead(&Asset, Result))
+        {
+            Result[Asset.Size] = 0;
+        }
+        else
+        {
+            printf("Assets: Failed to read %s\n", Path);
+            Result = 0;
+        }
+    }
+    *Size = Asset.Size;
+    AssetClose(&Asset);
+    return Result;
+}
+
+char *AssetLoadText(VIRTUAL_ARENA *Arena, const char *Path)
+{
+    size_t Size = 0;
+    return (char *) AssetLoad(Arena, Path, &Size);
+}
+
+void AssetsPrintStats()
+{
+    ASSET_STATS *Stats = &GlobalAssets.Stats;
+    printf("assets: %u loose files (%.2fMB read), %u pak entries (%.2fMB mapped, %.2fMB decompressed), %u missing\n",
+            Stats->LooseFiles.load(), (f64) Stats->LooseBytes.load() / (f64) Megabytes(1), Stats->PakEntries.load(),
+            (f64) Stats->MappedBytes.load() / (f64) Megabytes(1), (f64) Stats->DecompressedBytes.load() / (f64) Megabytes(1), Stats->Missing.load());
+}
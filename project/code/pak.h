@@ -0,0 +1,190 @@
+// Pak archive format
+// Written offline by tools/pak_builder.cpp, memory mapped at runtime by pak.cpp. Entry data is 64 byte aligned and
+// always followed by at least one zero byte, so stored entries (text included) can be used in place. Compressed entries
+// are a table of chunk sizes then independent LZ4 blocks of PAK_CHUNK_SIZE bytes each (the last one shorter).
+// Paths are found through an open addressed hash table of entry indices. All offsets are bytes from the start of the file.
+#pragma once
+
+#define PAK_MAGIC           0x4B415044 // 'DPAK'
+#define PAK_VERSION         1
+#define PAK_ALIGNMENT       64
+#define PAK_CHUNK_SIZE      (64 * 1024)
+#define PAK_CHUNK_STORED    0x80000000  // Chunk size flag - didn't compress, copied as is
+#define PAK_EMPTY_SLOT      0xFFFFFFFF
+#define PAK_MAX_PATH        256
+
+#define PAK_ENTRY_COMPRESSED (1 << 0)
+
+typedef struct PAK_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u32 EntryCount;
+    u32 SlotCount;              // Hash table size, a power of two
+    u64 EntryOffset;
+    u64 SlotOffset;
+    u64 NameOffset;
+    u64 NameBytes;
+    u64 FileSize;
+} PAK_HEADER;
+
+typedef struct PAK_ENTRY
+{
+    u64 Hash;
+    u64 Offset;
+    u64 Size;                   // Uncompressed
+    u64 StoredSize;             // In the archive, chunk table included
+    u32 NameOffset;             // From NameOffset in the header, null terminated
+    u32 Flags;
+} PAK_ENTRY;
+
+// FNV-1a over the path with '\' folded to '/', so both platforms' spellings find the same entry
+inline u64 PakHashPath(const char *Path)
+{
+    u64 Hash = 0xCBF29CE484222325ull;
+    for(const char *C = Path; *C; ++C)
+    {
+        u8 Byte = (*C == '\\') ? '/' : (u8) *C;
+        Hash = (Hash ^ Byte) * 0x100000001B3ull;
+    }
+    return Hash;
+}
+
+inline bool PakPathsMatch(const char *A, const char *B)
+{
+    for(; *A && *B; ++A, ++B)
+    {
+        char X = (*A == '\\') ? '/' : *A;
+        char Y = (*B == '\\') ? '/' : *B;
+        if(X != Y)
+        {
+            return false;
+        }
+    }
+    return *A == *B;
+}
+
+inline u32 PakChunkCount(u64 Size)
+{
+    return (u32) ((Size + PAK_CHUNK_SIZE - 1) / PAK_CHUNK_SIZE);
+}
+
+// LZ4 block decoder - every read and write is bounds checked, so a corrupt archive fails instead of overrunning.
+// Returns the decoded size, or -1
+inline i64 PakDecompressLZ4(const u8 *Source, u64 SourceSize, u8 *Dest, u64 DestSize)
+{
+    const u8 *In        = Source;
+    const u8 *InEnd     = Source + SourceSize;
+    u8 *Out             = Dest;
+    u8 *OutEnd          = Dest + DestSize;
+    while(In < InEnd)
+    {
+        u32 Token = *In++;
+
+        // Literals - lengths of 15 carry on in following bytes
+        u64 Length = Token >> 4;
+        if(Length == 15)
+        {
+            u8 Byte = 255;
+            while(Byte == 255 && In < InEnd)
+            {
+                Byte = *In++;
+                Length += Byte;
+            }
+        }
+        if(Length > (u64) (InEnd - In) || Length > (u64) (OutEnd - Out))
+        {
+            return -1;
+        }
+        memcpy(Out, In, Length);
+        In  += Length;
+        Out += Length;
+
+        // The last sequence is literals only
+        if(In == InEnd)
+        {
+            break;
+        }
+
+        if(InEnd - In < 2)
+        {
+            return -1;
+        }
+        u32 Offset = In[0] | (In[1] << 8);
+        In += 2;
+        if(Offset == 0 || Offset > (u64) (Out - Dest))
+        {
+            return -1;
+        }
+
+        Length = (Token & 15) + 4;
+        if((Token & 15) == 15)
+        {
+            u8 Byte = 255;
+            while(Byte == 255 && In < InEnd)
+            {
+                Byte = *In++;
+                Length += Byte;
+            }
+        }
+        if(Length > (u64) (OutEnd - Out))
+        {
+            return -1;
+        }
+
+        // Matches can overlap their own output (run lengths), so copy forwards a byte at a time when they do
+        const u8 *Match = Out - Offset;
+        if(Offset >= Length)
+        {
+            memcpy(Out, Match, Length);
+            Out += Length;
+        }
+        else
+        {
+            for(u64 i = 0; i < Length; ++i)
+            {
+                *Out++ = *Match++;
+            }
+        }
+    }
+    return (i64) (Out - Dest);
+}
+
+// Chunk table then blocks. Dest must hold Size bytes
+inline bool PakDecompressEntry(const u8 *Stored, u64 StoredSize, u8 *Dest, u64 Size)
+{
+    u32 ChunkCount = PakChunkCount(Size);
+    if((u64) ChunkCount * sizeof(u32) > StoredSize)
+    {
+        return false;
+    }
+
+    const u32 *Chunks = (const u32 *) Stored;
+    const u8 *Data = Stored + (u64) ChunkCount * sizeof(u32);
+    const u8 *End = Stored + StoredSize;
+    for(u32 i = 0; i < ChunkCount; ++i)
+    {
+        u64 ChunkSize = (i + 1 < ChunkCount) ? PAK_CHUNK_SIZE : Size - (u64) i * PAK_CHUNK_SIZE;
+        u32 Bytes = Chunks[i] & ~PAK_CHUNK_STORED;
+        if(Bytes > (u64) (End - Data))
+        {
+            return false;
+        }
+
+        u8 *Out = Dest + (u64) i * PAK_CHUNK_SIZE;
+        if(Chunks[i] & PAK_CHUNK_STORED)
+        {
+            if(Bytes != ChunkSize)
+            {
+                return false;
+            }
+            memcpy(Out, Data, Bytes);
+        }
+        else if(PakDecompressLZ4(Data, Bytes, Out, ChunkSize) != (i64) ChunkSize)
+        {
+            return false;
+        }
+        Data += Bytes;
+    }
+    return true;
+}
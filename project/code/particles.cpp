@@ -0,0 +1,562 @@
+// Particles
+// Emitters keep their particles in structure-of-arrays buffers stepped by SSE2 or AVX2 kernels (picked at runtime like
+// the TGA swizzles), split across the job system in fixed size batches. Every particle of an emitter shares its lifetime,
+// so they die in the order they were born - the live particles are a ring and nothing is ever compacted.
+// Kernels write straight into a persistently mapped instance buffer (one region per frame in flight, fenced by the
+// render queue) and each material is one instanced packet: ConstructQuad's corners expanded to face the camera, alpha
+// blended in the translucent pass.
+
+#define PARTICLE_MAX_EMITTERS       64
+#define PARTICLE_MAX_MATERIALS      16
+#define PARTICLE_BATCH_SIZE         8192        // Particles per job
+#define PARTICLE_LANES              8           // Widest kernel - ring capacities are padded to it
+#define PARTICLE_ATTRIBUTE_INSTANCE 4           // Must match the PARTICLE inputs in vertex.glsl
+#define PARTICLE_ATTRIBUTE_COLOUR   5
+
+typedef enum PARTICLE_KERNEL
+{
+    PARTICLE_KERNEL_SSE2,
+    PARTICLE_KERNEL_AVX2,
+} PARTICLE_KERNEL;
+
+static const char *ParticleKernelNames[] = {"SSE2", "AVX2"};
+
+typedef struct PARTICLE_EMITTER_SETTINGS
+{
+    V3 Position;
+    V3 Velocity;
+    f32 Spread;                 // Random velocity added on every axis, +-
+    f32 Gravity;                // Units per second squared, along -Y
+    f32 Drag;                   // Fraction of velocity lost per second
+    f32 Lifetime;               // Seconds, the same for every particle
+    f32 Rate;                   // Particles per second
+    f32 SizeStart;
+    f32 SizeEnd;
+    u32 ColourStart;            // RGBA8, faded to ColourEnd over the lifetime
+    u32 ColourEnd;
+    u32 Material;
+} PARTICLE_EMITTER_SETTINGS;
+
+typedef struct PARTICLE_EMITTER
+{
+    PARTICLE_EMITTER_SETTINGS Settings;
+
+    // SoA ring - [Head, Head + Count) modulo Capacity is alive, oldest first
+    f32 *PositionX;
+    f32 *PositionY;
+    f32 *PositionZ;
+    f32 *VelocityX;
+    f32 *VelocityY;
+    f32 *VelocityZ;
+    f32 *Age;                   // 0 at birth, 1 at death
+    u32 Head;
+    u32 Count;
+    u32 Capacity;
+
+    f32 EmitRemainder;
+    u32 Seed;
+    u32 InstanceOffset;         // This frame, from the start of its material's instances
+} PARTICLE_EMITTER;
+
+typedef struct PARTICLE_MATERIAL
+{
+    GLuint Texture;
+    u32 InstanceCount;          // This frame
+    u32 FirstInstance;
+} PARTICLE_MATERIAL;
+
+// One contiguous, non-wrapping run of a ring
+typedef struct PARTICLE_BATCH
+{
+    PARTICLE_EMITTER *Emitter;
+    u32 First;
+    u32 Count;
+    u32 Instance;               // Absolute index in the instance buffer
+} PARTICLE_BATCH;
+
+// Per-frame constants shared by every batch of an emitter
+typedef struct PARTICLE_STEP
+{
+    f32 Seconds;
+    f32 Gravity;                // Already scaled by Seconds
+    f32 Drag;                   // Velocity multiplier
+    f32 Age;                    // Age added this step
+    f32 SizeStart;
+    f32 SizeDelta;
+    f32 ColourStart[4];
+    f32 ColourDelta[4];
+} PARTICLE_STEP;
+
+typedef void PARTICLE_KERNEL_FUNCTION(PARTICLE_EMITTER *Emitter, PARTICLE_STEP *Step, u32 First, u32 Count, f32 *Instances, u32 *Colours);
+
+typedef struct PARTICLE_STATS
+{
+    u32 Alive;
+    u32 Emitted;
+    u32 Retired;
+    u32 Dropped;                // Wanted to emit into a full ring
+    u32 Batches;
+    u32 DrawCalls;
+    f64 EmitMicroseconds;
+    f64 SimulateMicroseconds;
+    f64 SubmitMicroseconds;
+} PARTICLE_STATS;
+
+typedef struct PARTICLE_SYSTEM
+{
+    JOB_SYSTEM *Jobs;
+    PARTICLE_KERNEL Kernel;
+    PARTICLE_KERNEL_FUNCTION *Update;
+
+    PARTICLE_EMITTER Emitters[PARTICLE_MAX_EMITTERS];
+    u32 EmitterCount;
+    PARTICLE_MATERIAL Materials[PARTICLE_MAX_MATERIALS];
+    u32 MaterialCount;
+    u32 MaxParticles;           // Per frame, across every emitter
+
+    PARTICLE_BATCH *Batches;
+    u32 BatchCount;
+    u32 MaxBatches;
+    f32 StepSeconds;
+    PARTICLE_STEP Steps[PARTICLE_MAX_EMITTERS];
+
+    // Instance buffer - positions and sizes for every region, then colours for every region
+    GLuint InstanceBuffer;
+    GLuint VertexArray;
+    f32 *Instances;
+    u32 *Colours;
+    MESH Quad;
+
+    PARTICLE_STATS Stats;
+} PARTICLE_SYSTEM;
+
+inline u32 ParticleRandom(u32 *Seed)
+{
+    // xorshift32
+    u32 X = *Seed;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    *Seed = X;
+    return X;
+}
+
+inline f32 ParticleRandomSigned(u32 *Seed)
+{
+    return (f32) (ParticleRandom(Seed) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+inline u32 ParticlePackColour(f32 R, f32 G, f32 B, f32 A)
+{
+    return (u32) lrintf(R) | ((u32) lrintf(G) << 8) | ((u32) lrintf(B) << 16) | ((u32) lrintf(A) << 24);
+}
+
+// Tails, and particles the vector kernels can't cover
+void ParticleUpdateScalar(PARTICLE_EMITTER *Emitter, PARTICLE_STEP *Step, u32 First, u32 Count, f32 *Instances, u32 *Colours)
+{
+    for(u32 i = First; i < First + Count; ++i)
+    {
+        Emitter->VelocityX[i] = Emitter->VelocityX[i] * Step->Drag;
+        Emitter->VelocityY[i] = (Emitter->VelocityY[i] - Step->Gravity) * Step->Drag;
+        Emitter->VelocityZ[i] = Emitter->VelocityZ[i] * Step->Drag;
+        Emitter->PositionX[i] += Emitter->VelocityX[i] * Step->Seconds;
+        Emitter->PositionY[i] += Emitter->VelocityY[i] * Step->Seconds;
+        Emitter->PositionZ[i] += Emitter->VelocityZ[i] * Step->Seconds;
+        f32 Age = Emitter->Age[i] + Step->Age;
+        Emitter->Age[i] = Age;
+
+        f32 *Instance = Instances + (i - First) * 4;
+        Instance[0] = Emitter->PositionX[i];
+        Instance[1] = Emitter->PositionY[i];
+        Instance[2] = Emitter->PositionZ[i];
+        Instance[3] = Step->SizeStart + Step->SizeDelta * Age;
+        Colours[i - First] = ParticlePackColour(Step->ColourStart[0] + Step->ColourDelta[0] * Age, Step->ColourStart[1] + Step->ColourDelta[1] * Age,
+                                                Step->ColourStart[2] + Step->ColourDelta[2] * Age, Step->ColourStart[3] + Step->ColourDelta[3] * Age);
+    }
+}
+
+// SSE2 is always there on x64
+void ParticleUpdateSSE2(PARTICLE_EMITTER *Emitter, PARTICLE_STEP *Step, u32 First, u32 Count, f32 *Instances, u32 *Colours)
+{
+    __m128 Seconds      = _mm_set1_ps(Step->Seconds);
+    __m128 Gravity      = _mm_set1_ps(Step->Gravity);
+    __m128 Drag         = _mm_set1_ps(Step->Drag);
+    __m128 AgeStep      = _mm_set1_ps(Step->Age);
+    __m128 SizeStart    = _mm_set1_ps(Step->SizeStart);
+    __m128 SizeDelta    = _mm_set1_ps(Step->SizeDelta);
+    __m128 ColourStart[4], ColourDelta[4];
+    for(u32 Channel = 0; Channel < 4; ++Channel)
+    {
+        ColourStart[Channel] = _mm_set1_ps(Step->ColourStart[Channel]);
+        ColourDelta[Channel] = _mm_set1_ps(Step->ColourDelta[Channel]);
+    }
+
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        u32 Index = First + i;
+        __m128 VelocityX = _mm_mul_ps(_mm_loadu_ps(Emitter->VelocityX + Index), Drag);
+        __m128 VelocityY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Emitter->VelocityY + Index), Gravity), Drag);
+        __m128 VelocityZ = _mm_mul_ps(_mm_loadu_ps(Emitter->VelocityZ + Index), Drag);
+        __m128 PositionX = _mm_add_ps(_mm_loadu_ps(Emitter->PositionX + Index), _mm_mul_ps(VelocityX, Seconds));
+        __m128 PositionY = _mm_add_ps(_mm_loadu_ps(Emitter->PositionY + Index), _mm_mul_ps(VelocityY, Seconds));
+        __m128 PositionZ = _mm_add_ps(_mm_loadu_ps(Emitter->PositionZ + Index), _mm_mul_ps(VelocityZ, Seconds));
+        __m128 Age       = _mm_add_ps(_mm_loadu_ps(Emitter->Age + Index), AgeStep);
+        _mm_storeu_ps(Emitter->VelocityX + Index, VelocityX);
+        _mm_storeu_ps(Emitter->VelocityY + Index, VelocityY);
+        _mm_storeu_ps(Emitter->VelocityZ + Index, VelocityZ);
+        _mm_storeu_ps(Emitter->PositionX + Index, PositionX);
+        _mm_storeu_ps(Emitter->PositionY + Index, PositionY);
+        _mm_storeu_ps(Emitter->PositionZ + Index, PositionZ);
+        _mm_storeu_ps(Emitter->Age + Index, Age);
+
+        // SoA -> one (X, Y, Z, Size) vector per instance
+        __m128 Size = _mm_add_ps(SizeStart, _mm_mul_ps(SizeDelta, Age));
+        _MM_TRANSPOSE4_PS(PositionX, PositionY, PositionZ, Size);
+        _mm_storeu_ps(Instances + i * 4 + 0, PositionX);
+        _mm_storeu_ps(Instances + i * 4 + 4, PositionY);
+        _mm_storeu_ps(Instances + i * 4 + 8, PositionZ);
+        _mm_storeu_ps(Instances + i * 4 + 12, Size);
+
+        __m128i Colour = _mm_setzero_si128();
+        for(u32 Channel = 0; Channel < 4; ++Channel)
+        {
+            __m128i Value = _mm_cvtps_epi32(_mm_add_ps(ColourStart[Channel], _mm_mul_ps(ColourDelta[Channel], Age)));
+            Colour = _mm_or_si128(Colour, _mm_slli_epi32(Value, Channel * 8));
+        }
+        _mm_storeu_si128((__m128i *) (Colours + i), Colour);
+    }
+    ParticleUpdateScalar(Emitter, Step, First + i, Count - i, Instances + i * 4, Colours + i);
+}
+
+__attribute__((target("avx2,fma")))
+void ParticleUpdateAVX2(PARTICLE_EMITTER *Emitter, PARTICLE_STEP *Step, u32 First, u32 Count, f32 *Instances, u32 *Colours)
+{
+    __m256 Seconds      = _mm256_set1_ps(Step->Seconds);
+    __m256 Gravity      = _mm256_set1_ps(Step->Gravity);
+    __m256 Drag         = _mm256_set1_ps(Step->Drag);
+    __m256 AgeStep      = _mm256_set1_ps(Step->Age);
+    __m256 SizeStart    = _mm256_set1_ps(Step->SizeStart);
+    __m256 SizeDelta    = _mm256_set1_ps(Step->SizeDelta);
+    __m256 ColourStart[4], ColourDelta[4];
+    for(u32 Channel = 0; Channel < 4; ++Channel)
+    {
+        ColourStart[Channel] = _mm256_set1_ps(Step->ColourStart[Channel]);
+        ColourDelta[Channel] = _mm256_set1_ps(Step->ColourDelta[Channel]);
+    }
+
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        u32 Index = First + i;
+        __m256 VelocityX = _mm256_mul_ps(_mm256_loadu_ps(Emitter->VelocityX + Index), Drag);
+        __m256 VelocityY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(Emitter->VelocityY + Index), Gravity), Drag);
+        __m256 VelocityZ = _mm256_mul_ps(_mm256_loadu_ps(Emitter->VelocityZ + Index), Drag);
+        __m256 PositionX = _mm256_fmadd_ps(VelocityX, Seconds, _mm256_loadu_ps(Emitter->PositionX + Index));
+        __m256 PositionY = _mm256_fmadd_ps(VelocityY, Seconds, _mm256_loadu_ps(Emitter->PositionY + Index));
+        __m256 PositionZ = _mm256_fmadd_ps(VelocityZ, Seconds, _mm256_loadu_ps(Emitter->PositionZ + Index));
+        __m256 Age       = _mm256_add_ps(_mm256_loadu_ps(Emitter->Age + Index), AgeStep);
+        _mm256_storeu_ps(Emitter->VelocityX + Index, VelocityX);
+        _mm256_storeu_ps(Emitter->VelocityY + Index, VelocityY);
+        _mm256_storeu_ps(Emitter->VelocityZ + Index, VelocityZ);
+        _mm256_storeu_ps(Emitter->PositionX + Index, PositionX);
+        _mm256_storeu_ps(Emitter->PositionY + Index, PositionY);
+        _mm256_storeu_ps(Emitter->PositionZ + Index, PositionZ);
+        _mm256_storeu_ps(Emitter->Age + Index, Age);
+
+        // 4x8 transpose - each 128 bit lane holds one (X, Y, Z, Size) instance, lanes pair up instances N and N + 4
+        __m256 Size = _mm256_fmadd_ps(SizeDelta, Age, SizeStart);
+        __m256 XYLow    = _mm256_unpacklo_ps(PositionX, PositionY);
+        __m256 XYHigh   = _mm256_unpackhi_ps(PositionX, PositionY);
+        __m256 ZSLow    = _mm256_unpacklo_ps(PositionZ, Size);
+        __m256 ZSHigh   = _mm256_unpackhi_ps(PositionZ, Size);
+        __m256 Instance0 = _mm256_shuffle_ps(XYLow, ZSLow, 0x44);
+        __m256 Instance1 = _mm256_shuffle_ps(XYLow, ZSLow, 0xEE);
+        __m256 Instance2 = _mm256_shuffle_ps(XYHigh, ZSHigh, 0x44);
+        __m256 Instance3 = _mm256_shuffle_ps(XYHigh, ZSHigh, 0xEE);
+        _mm256_storeu_ps(Instances + i * 4 + 0, _mm256_permute2f128_ps(Instance0, Instance1, 0x20));
+        _mm256_storeu_ps(Instances + i * 4 + 8, _mm256_permute2f128_ps(Instance2, Instance3, 0x20));
+        _mm256_storeu_ps(Instances + i * 4 + 16, _mm256_permute2f128_ps(Instance0, Instance1, 0x31));
+        _mm256_storeu_ps(Instances + i * 4 + 24, _mm256_permute2f128_ps(Instance2, Instance3, 0x31));
+
+        __m256i Colour = _mm256_setzero_si256();
+        for(u32 Channel = 0; Channel < 4; ++Channel)
+        {
+            __m256i Value = _mm256_cvtps_epi32(_mm256_fmadd_ps(ColourDelta[Channel], Age, ColourStart[Channel]));
+            Colour = _mm256_or_si256(Colour, _mm256_slli_epi32(Value, Channel * 8));
+        }
+        _mm256_storeu_si256((__m256i *) (Colours + i), Colour);
+    }
+    ParticleUpdateSSE2(Emitter, Step, First + i, Count - i, Instances + i * 4, Colours + i);
+}
+
+PARTICLE_KERNEL ParticleDetectKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return PARTICLE_KERNEL_AVX2;
+    }
+    return PARTICLE_KERNEL_SSE2;
+}
+
+void ParticleSystemCreate(PARTICLE_SYSTEM *System, MEMORY_ARENA *Arena, RENDERER *RenderInfo, JOB_SYSTEM *Jobs, MESH *Quad, u32 MaxParticles)
+{
+    *System = {};
+    System->Jobs            = Jobs;
+    System->Kernel          = ParticleDetectKernel();
+    System->Update          = (System->Kernel == PARTICLE_KERNEL_AVX2) ? ParticleUpdateAVX2 : ParticleUpdateSSE2;
+    System->MaxParticles    = MaxParticles;
+    System->Quad            = *Quad;
+
+    // Every emitter can leave a partial batch at each end of its ring
+    System->MaxBatches  = MaxParticles / PARTICLE_BATCH_SIZE + PARTICLE_MAX_EMITTERS * 3;
+    System->Batches     = (PARTICLE_BATCH *) Arena->Alloc(sizeof(PARTICLE_BATCH) * System->MaxBatches, alignof(PARTICLE_BATCH));
+    Assert(System->Batches, "Particles: Failed to allocate batches!");
+
+    // Written by the CPU every frame, read once by the GPU - persistently mapped, one region per frame in flight
+    GLsizeiptr InstanceBytes    = (GLsizeiptr) sizeof(f32) * 4 * MaxParticles * RENDER_QUEUE_FRAMES_IN_FLIGHT;
+    GLsizeiptr ColourBytes      = (GLsizeiptr) sizeof(u32) * MaxParticles * RENDER_QUEUE_FRAMES_IN_FLIGHT;
+    GLbitfield MapFlags         = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &System->InstanceBuffer);
+    glNamedBufferStorage(System->InstanceBuffer, InstanceBytes + ColourBytes, 0, MapFlags);
+    System->Instances   = (f32 *) glMapNamedBufferRange(System->InstanceBuffer, 0, InstanceBytes + ColourBytes, MapFlags);
+    System->Colours     = (u32 *) ((u8 *) System->Instances + InstanceBytes);
+    Assert(System->Instances, "Particles: Failed to map instance buffer!");
+
+    // Quad corners and UVs come from the mesh pool buffers, centres, sizes and colours from the instance streams
+    MESH_POOL *Pool = &RenderInfo->MeshPool;
+    glCreateVertexArrays(1, &System->VertexArray);
+    glVertexArrayVertexBuffer(System->VertexArray, 0, Pool->VertexBuffer, 0, sizeof(VERTEX_PACKED));
+    glVertexArrayElementBuffer(System->VertexArray, Pool->IndexBuffer);
+    glVertexArrayAttribFormat(System->VertexArray, 0, 3, GL_SHORT, GL_TRUE, offsetof(VERTEX_PACKED, Position));
+    glVertexArrayAttribFormat(System->VertexArray, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(VERTEX_PACKED, UV));
+    glVertexArrayAttribBinding(System->VertexArray, 0, 0);
+    glVertexArrayAttribBinding(System->VertexArray, 2, 0);
+    glEnableVertexArrayAttrib(System->VertexArray, 0);
+    glEnableVertexArrayAttrib(System->VertexArray, 2);
+    glVertexArrayVertexBuffer(System->VertexArray, 1, System->InstanceBuffer, 0, sizeof(f32) * 4);
+    glVertexArrayVertexBuffer(System->VertexArray, 2, System->InstanceBuffer, InstanceBytes, sizeof(u32));
+    glVertexArrayBindingDivisor(System->VertexArray, 1, 1);
+    glVertexArrayBindingDivisor(System->VertexArray, 2, 1);
+    glVertexArrayAttribFormat(System->VertexArray, PARTICLE_ATTRIBUTE_INSTANCE, 4, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribFormat(System->VertexArray, PARTICLE_ATTRIBUTE_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0);
+    glVertexArrayAttribBinding(System->VertexArray, PARTICLE_ATTRIBUTE_INSTANCE, 1);
+    glVertexArrayAttribBinding(System->VertexArray, PARTICLE_ATTRIBUTE_COLOUR, 2);
+    glEnableVertexArrayAttrib(System->VertexArray, PARTICLE_ATTRIBUTE_INSTANCE);
+    glEnableVertexArrayAttrib(System->VertexArray, PARTICLE_ATTRIBUTE_COLOUR);
+}
+
+u32 ParticleMaterialCreate(PARTICLE_SYSTEM *System, GLuint Texture)
+{
+    Assert(System->MaterialCount < PARTICLE_MAX_MATERIALS, "Particles: Too many materials!");
+    u32 Result = System->MaterialCount++;
+    System->Materials[Result].Texture = Texture;
+    return Result;
+}
+
+// Ring capacity is fixed by the rate and lifetime - returns false once MaxParticles would be exceeded
+bool ParticleEmitterCreate(PARTICLE_SYSTEM *System, MEMORY_ARENA *Arena, PARTICLE_EMITTER_SETTINGS *Settings, u32 Seed)
+{
+    if(System->EmitterCount >= PARTICLE_MAX_EMITTERS || Settings->Material >= System->MaterialCount || Settings->Lifetime <= 0.0f)
+    {
+        printf("Particles: Invalid emitter settings!\n");
+        return false;
+    }
+
+    u32 Reserved = 0;
+    for(u32 i = 0; i < System->EmitterCount; ++i)
+    {
+        Reserved += System->Emitters[i].Capacity;
+    }
+
+    // One step's worth of slack since retiring and emitting happen on whole steps
+    u32 Capacity = (u32) ceilf(Settings->Rate * Settings->Lifetime) + PARTICLE_LANES;
+    Capacity = (Capacity + PARTICLE_LANES - 1) & ~(PARTICLE_LANES - 1);
+    if(Reserved + Capacity > System->MaxParticles)
+    {
+        printf("Particles: Emitter needs %u particles, %u left!\n", Capacity, System->MaxParticles - Reserved);
+        return false;
+    }
+
+    PARTICLE_EMITTER *Emitter = &System->Emitters[System->EmitterCount++];
+    *Emitter = {};
+    Emitter->Settings   = *Settings;
+    Emitter->Capacity   = Capacity;
+    Emitter->Seed       = Seed ? Seed : 0x9E3779B9;
+
+    f32 **Streams[] = {&Emitter->PositionX, &Emitter->PositionY, &Emitter->PositionZ, &Emitter->VelocityX, &Emitter->VelocityY, &Emitter->VelocityZ, &Emitter->Age};
+    for(u32 i = 0; i < ArrayCount(Streams); ++i)
+    {
+        *Streams[i] = (f32 *) Arena->Alloc(sizeof(f32) * Capacity, 32);
+        Assert(*Streams[i], "Particles: Failed to allocate emitter!");
+    }
+
+    // Batches split at the ring wrap as well as every PARTICLE_BATCH_SIZE
+    u32 Batches = 0;
+    for(u32 i = 0; i < System->EmitterCount; ++i)
+    {
+        Batches += System->Emitters[i].Capacity / PARTICLE_BATCH_SIZE + 2;
+    }
+    Assert(Batches <= System->MaxBatches, "Particles: Too many batches!");
+
+    return true;
+}
+
+// Oldest particles die first, so retiring is just moving the head; new ones are appended at the tail
+void ParticleEmit(PARTICLE_SYSTEM *System, PARTICLE_EMITTER *Emitter, f32 Step)
+{
+    PARTICLE_EMITTER_SETTINGS *Settings = &Emitter->Settings;
+    f32 AgeStep = Step / Settings->Lifetime;
+    while(Emitter->Count > 0 && Emitter->Age[Emitter->Head] + AgeStep >= 1.0f)
+    {
+        Emitter->Head = (Emitter->Head + 1 == Emitter->Capacity) ? 0 : Emitter->Head + 1;
+        --Emitter->Count;
+        ++System->Stats.Retired;
+    }
+
+    f32 Wanted = Settings->Rate * Step + Emitter->EmitRemainder;
+    u32 Emit = (u32) Wanted;
+    Emitter->EmitRemainder = Wanted - (f32) Emit;
+    if(Emit > Emitter->Capacity - Emitter->Count)
+    {
+        System->Stats.Dropped += Emit - (Emitter->Capacity - Emitter->Count);
+        Emit = Emitter->Capacity - Emitter->Count;
+    }
+
+    // New particles are stepped with everything else this frame, so they start one step behind
+    u32 Tail = (Emitter->Head + Emitter->Count) % Emitter->Capacity;
+    for(u32 i = 0; i < Emit; ++i)
+    {
+        Emitter->PositionX[Tail] = Settings->Position.X;
+        Emitter->PositionY[Tail] = Settings->Position.Y;
+        Emitter->PositionZ[Tail] = Settings->Position.Z;
+        Emitter->VelocityX[Tail] = Settings->Velocity.X + ParticleRandomSigned(&Emitter->Seed) * Settings->Spread;
+        Emitter->VelocityY[Tail] = Settings->Velocity.Y + ParticleRandomSigned(&Emitter->Seed) * Settings->Spread;
+        Emitter->VelocityZ[Tail] = Settings->Velocity.Z + ParticleRandomSigned(&Emitter->Seed) * Settings->Spread;
+        Emitter->Age[Tail] = 0.0f;
+        Tail = (Tail + 1 == Emitter->Capacity) ? 0 : Tail + 1;
+    }
+    Emitter->Count += Emit;
+    System->Stats.Emitted += Emit;
+}
+
+void ParticleUpdateBatches(void *Data, u32 Start, u32 End)
+{
+    PARTICLE_SYSTEM *System = (PARTICLE_SYSTEM *) Data;
+    for(u32 i = Start; i < End; ++i)
+    {
+        PARTICLE_BATCH *Batch = &System->Batches[i];
+        PARTICLE_STEP *Step = &System->Steps[Batch->Emitter - System->Emitters];
+        System->Update(Batch->Emitter, Step, Batch->First, Batch->Count, System->Instances + (u64) Batch->Instance * 4, System->Colours + Batch->Instance);
+    }
+}
+
+// Emit, step every particle into this frame's instance region, then queue one instanced draw per material
+void ParticleSystemUpdate(PARTICLE_SYSTEM *System, RENDERER *RenderInfo, f32 Step)
+{
+    PROFILE_SCOPE("ParticleSystemUpdate");
+    u32 Region = RenderQueueAcquireRegion(&RenderInfo->Queue);
+
+    PARTICLE_STATS Stats = {};
+    System->Stats = Stats;
+
+    u64 Start = __rdtsc();
+    {
+        PROFILE_SCOPE("ParticleEmit");
+        for(u32 i = 0; i < System->EmitterCount; ++i)
+        {
+            ParticleEmit(System, &System->Emitters[i], Step);
+        }
+    }
+    u64 Emitted = __rdtsc();
+
+    // Instances are grouped by material, then split into non-wrapping batches
+    for(u32 i = 0; i < System->MaterialCount; ++i)
+    {
+        System->Materials[i].InstanceCount = 0;
+    }
+    for(u32 i = 0; i < System->EmitterCount; ++i)
+    {
+        PARTICLE_EMITTER *Emitter = &System->Emitters[i];
+        PARTICLE_MATERIAL *Material = &System->Materials[Emitter->Settings.Material];
+        Emitter->InstanceOffset = Material->InstanceCount;
+        Material->InstanceCount += Emitter->Count;
+    }
+    u32 FirstInstance = Region * System->MaxParticles;
+    for(u32 i = 0; i < System->MaterialCount; ++i)
+    {
+        System->Materials[i].FirstInstance = FirstInstance;
+        FirstInstance += System->Materials[i].InstanceCount;
+    }
+
+    System->BatchCount = 0;
+    for(u32 i = 0; i < System->EmitterCount; ++i)
+    {
+        PARTICLE_EMITTER *Emitter = &System->Emitters[i];
+        PARTICLE_EMITTER_SETTINGS *Settings = &Emitter->Settings;
+        PARTICLE_STEP *Constants = &System->Steps[i];
+        Constants->Seconds      = Step;
+        Constants->Gravity      = Settings->Gravity * Step;
+        Constants->Drag         = (Settings->Drag * Step < 1.0f) ? 1.0f - Settings->Drag * Step : 0.0f;
+        Constants->Age          = Step / Settings->Lifetime;
+        Constants->SizeStart    = Settings->SizeStart;
+        Constants->SizeDelta    = Settings->SizeEnd - Settings->SizeStart;
+        for(u32 Channel = 0; Channel < 4; ++Channel)
+        {
+            f32 From = (f32) ((Settings->ColourStart >> (Channel * 8)) & 0xFF);
+            f32 To = (f32) ((Settings->ColourEnd >> (Channel * 8)) & 0xFF);
+            Constants->ColourStart[Channel] = From;
+            Constants->ColourDelta[Channel] = To - From;
+        }
+
+        u32 Instance = System->Materials[Settings->Material].FirstInstance + Emitter->InstanceOffset;
+        u32 First = Emitter->Head;
+        u32 Remaining = Emitter->Count;
+        while(Remaining > 0)
+        {
+            u32 Count = Emitter->Capacity - First;
+            Count = (Count < Remaining) ? Count : Remaining;
+            Count = (Count < PARTICLE_BATCH_SIZE) ? Count : PARTICLE_BATCH_SIZE;
+
+            PARTICLE_BATCH *Batch = &System->Batches[System->BatchCount++];
+            Batch->Emitter  = Emitter;
+            Batch->First    = First;
+            Batch->Count    = Count;
+            Batch->Instance = Instance;
+
+            First = (First + Count == Emitter->Capacity) ? 0 : First + Count;
+            Instance += Count;
+            Remaining -= Count;
+        }
+        System->Stats.Alive += Emitter->Count;
+    }
+
+    {
+        PROFILE_SCOPE("ParticleSimulate");
+        JobParallelFor(System->Jobs, System->BatchCount, 1, ParticleUpdateBatches, System);
+    }
+    u64 Simulated = __rdtsc();
+
+    // Particle quads are tiny and overlapping - depth is left out of the key so each material stays one draw. The
+    // translucent pass blends them and doesn't write depth, so the alpha fade shows and sprites never cut into each other
+    for(u32 i = 0; i < System->MaterialCount; ++i)
+    {
+        PARTICLE_MATERIAL *Material = &System->Materials[i];
+        if(Material->InstanceCount == 0)
+        {
+            continue;
+        }
+
+        u64 SortKey = RenderSortKey(RENDER_PASS_TRANSLUCENT, RenderInfo->ParticleProgram, Material->Texture, System->VertexArray, 0.0f);
+        RenderQueuePushInstanced(&RenderInfo->Queue, SortKey, RenderInfo->ParticleProgram, Material->Texture, 0, System->VertexArray,
+                                 System->Quad.IndexCount, System->Quad.FirstIndex, (i32) System->Quad.BaseVertex, Material->InstanceCount, Material->FirstInstance);
+        ++System->Stats.DrawCalls;
+    }
+    u64 Submitted = __rdtsc();
+
+    System->Stats.Batches               = System->BatchCount;
+    System->Stats.EmitMicroseconds      = ProfilerTicksToMicroseconds(Emitted - Start);
+    System->Stats.SimulateMicroseconds  = ProfilerTicksToMicroseconds(Simulated - Emitted);
+    System->Stats.SubmitMicroseconds    = ProfilerTicksToMicroseconds(Submitted - Simulated);
+}
@@ -0,0 +1,587 @@
+// Profiler
+// CPU zones are scoped rdtsc pairs pushed into a per-thread single producer ring - no locks on the hot path,
+// the main thread drains every ring once per frame. GPU zones are GL_TIMESTAMP query pairs from a pool cycled
+// over several frames and only read back once their results are available, so the GPU is never waited on.
+// Drained zones feed a running per-zone summary, and optionally a Chrome trace (chrome://tracing, Perfetto) capture.
+//
+// PROFILE_SCOPE("Name")        - CPU zone until the end of the enclosing scope
+// PROFILE_GPU_SCOPE("Name")    - GPU zone around the GL commands issued in the enclosing scope (main thread only)
+// Build with PROFILER_ENABLED 0 to compile every zone out.
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_MAX_THREADS        16
+#define PROFILER_RING_SIZE          16384       // Events per thread per frame - must be a power of two
+#define PROFILER_MAX_ZONES          256
+#define PROFILER_GPU_FRAMES         4           // Frames of query latency before readback
+#define PROFILER_GPU_MAX_ZONES      64          // Per frame
+#define PROFILER_GPU_THREAD         1000        // Trace track for GPU zones
+
+typedef struct PROFILER_EVENT
+{
+    u64 Begin;
+    u32 Ticks;
+    u32 Zone;
+} PROFILER_EVENT;
+
+typedef enum PROFILER_SLOT_STATE
+{
+    PROFILER_SLOT_FREE,
+    PROFILER_SLOT_CLAIMED,      // Owner is setting its ring up
+    PROFILER_SLOT_LIVE,
+    PROFILER_SLOT_EXITED,       // Owner has gone - drained once more, then free again
+} PROFILER_SLOT_STATE;
+
+typedef struct PROFILER_THREAD
+{
+    PROFILER_EVENT          *Events;    // Kept when the slot is freed, for its next owner
+    std::atomic<u32>        State;
+    std::atomic<u32>        Write;
+    std::atomic<u32>        Read;
+    u32                     Dropped;
+    bool                    Traced;     // Main thread only - has events in the capture, so it needs a track name
+    char                    Name[32];
+} PROFILER_THREAD;
+
+// Releases the thread's slot when it exits
+typedef struct PROFILER_THREAD_SLOT
+{
+    PROFILER_THREAD *Thread;
+    bool            Full;       // Every slot was taken on first use - this thread is never recorded
+
+    ~PROFILER_THREAD_SLOT()
+    {
+        if(Thread)
+        {
+            Thread->State.store(PROFILER_SLOT_EXITED, std::memory_order_release);
+        }
+        Thread  = 0;
+        Full    = true;
+    }
+} PROFILER_THREAD_SLOT;
+
+typedef struct PROFILER_ZONE
+{
+    const char  *Name;
+
+    // Accumulated since the last summary
+    u64         CpuTicks;
+    u64         CpuMaxTicks;
+    u64         GpuNanoseconds;
+    u64         GpuMaxNanoseconds;
+    u32         Calls;
+} PROFILER_ZONE;
+
+typedef struct PROFILER_GPU_FRAME
+{
+    u64 Frame;
+    u32 Count;
+    u32 Zones[PROFILER_GPU_MAX_ZONES];
+} PROFILER_GPU_FRAME;
+
+typedef struct PROFILER
+{
+    bool                Initialised;
+
+    PROFILER_THREAD     Threads[PROFILER_MAX_THREADS];
+
+    std::mutex          ZoneLock;
+    PROFILER_ZONE       Zones[PROFILER_MAX_ZONES];
+    std::atomic<u32>    ZoneCount;
+
+    // rdtsc calibration against the monotonic clock, refined every frame
+    u64                 BaseTicks;
+    std::chrono::steady_clock::time_point BaseTime;
+    f64                 TicksPerMicrosecond;
+
+    // GPU queries - [frame][zone][begin, end]
+    bool                GpuEnabled;
+    GLuint              Queries[PROFILER_GPU_FRAMES * PROFILER_GPU_MAX_ZONES * 2];
+    PROFILER_GPU_FRAME  GpuFrames[PROFILER_GPU_FRAMES];
+    u64                 GpuBaseNanoseconds;     // GPU clock at GpuBaseTicks
+    u64                 GpuBaseTicks;
+    u32                 GpuDropped;
+
+    // Frame counters
+    u64                 Frame;
+    u64                 SummaryFrames;
+    u64                 FrameBeginTicks;
+
+    // Chrome trace capture
+    FILE                *Capture;
+    u64                 CaptureBegin;
+    u64                 CaptureEnd;
+    bool                CaptureFirstEvent;
+} PROFILER;
+
+static PROFILER GlobalProfiler;
+static thread_local PROFILER_THREAD_SLOT ProfilerThread;
+
+void ProfilerInit()
+{
+    GlobalProfiler.BaseTicks            = __rdtsc();
+    GlobalProfiler.BaseTime             = std::chrono::steady_clock::now();
+    GlobalProfiler.TicksPerMicrosecond  = 3000.0;
+    GlobalProfiler.FrameBeginTicks      = GlobalProfiler.BaseTicks;
+    GlobalProfiler.Initialised          = true;
+}
+
+// Needs a current GL context - without it only CPU zones are recorded
+void ProfilerInitGpu()
+{
+    GLint Bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &Bits);
+    if(Bits == 0)
+    {
+        return;
+    }
+
+    glGenQueries(ArrayCount(GlobalProfiler.Queries), GlobalProfiler.Queries);
+    GLint64 GpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &GpuTime);
+    GlobalProfiler.GpuBaseTicks         = __rdtsc();
+    GlobalProfiler.GpuBaseNanoseconds   = (u64) GpuTime;
+    GlobalProfiler.GpuEnabled           = true;
+}
+
+void ProfilerDestroy()
+{
+    if(GlobalProfiler.Capture)
+    {
+        fprintf(GlobalProfiler.Capture, "\n]}\n");
+        fclose(GlobalProfiler.Capture);
+        GlobalProfiler.Capture = 0;
+    }
+    if(GlobalProfiler.GpuEnabled)
+    {
+        glDeleteQueries(ArrayCount(GlobalProfiler.Queries), GlobalProfiler.Queries);
+        GlobalProfiler.GpuEnabled = false;
+    }
+}
+
+// Called once per call site through the macros (function statics are initialised thread-safely)
+u32 ProfilerRegisterZone(const char *Name)
+{
+    std::lock_guard<std::mutex> Lock(GlobalProfiler.ZoneLock);
+    u32 Count = GlobalProfiler.ZoneCount.load(std::memory_order_relaxed);
+    for(u32 i = 0; i < Count; ++i)
+    {
+        if(strcmp(GlobalProfiler.Zones[i].Name, Name) == 0)
+        {
+            return i;
+        }
+    }
+
+    Assert(Count < PROFILER_MAX_ZONES, "Profiler: Too many zones!");
+    GlobalProfiler.Zones[Count].Name = Name;
+    GlobalProfiler.ZoneCount.store(Count + 1, std::memory_order_release);
+    return Count;
+}
+
+PROFILER_THREAD *ProfilerGetThread()
+{
+    if(!ProfilerThread.Thread && !ProfilerThread.Full)
+    {
+        // Claim a free slot and set its ring up before publishing it to the drain - threads past the limit are not recorded
+        for(u32 Index = 0; Index < PROFILER_MAX_THREADS; ++Index)
+        {
+            PROFILER_THREAD *Thread = &GlobalProfiler.Threads[Index];
+            u32 Expected = PROFILER_SLOT_FREE;
+            if(!Thread->State.compare_exchange_strong(Expected, PROFILER_SLOT_CLAIMED, std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            if(!Thread->Events)
+            {
+                Thread->Events = (PROFILER_EVENT *) MemoryHeapAlloc(sizeof(PROFILER_EVENT) * PROFILER_RING_SIZE);
+                Assert(Thread->Events, "Profiler: Failed to allocate event ring!");
+            }
+            Thread->Write.store(0, std::memory_order_relaxed);
+            Thread->Read.store(0, std::memory_order_relaxed);
+            snprintf(Thread->Name, sizeof(Thread->Name), "Thread %u", Index);
+            Thread->State.store(PROFILER_SLOT_LIVE, std::memory_order_release);
+            ProfilerThread.Thread = Thread;
+            break;
+        }
+        ProfilerThread.Full = !ProfilerThread.Thread;
+    }
+    return ProfilerThread.Thread;
+}
+
+void ProfilerSetThreadName(const char *Name)
+{
+    PROFILER_THREAD *Thread = ProfilerGetThread();
+    if(Thread)
+    {
+        snprintf(Thread->Name, sizeof(Thread->Name), "%s", Name);
+    }
+}
+
+inline void ProfilerPushEvent(u32 Zone, u64 Begin, u64 End)
+{
+    PROFILER_THREAD *Thread = ProfilerGetThread();
+    if(!Thread)
+    {
+        return;
+    }
+
+    // Single producer - only this thread moves Write, the main thread moves Read
+    u32 Write = Thread->Write.load(std::memory_order_relaxed);
+    if(Write - Thread->Read.load(std::memory_order_acquire) >= PROFILER_RING_SIZE)
+    {
+        ++Thread->Dropped;
+        return;
+    }
+
+    u64 Ticks = End - Begin;
+    PROFILER_EVENT *Event   = &Thread->Events[Write & (PROFILER_RING_SIZE - 1)];
+    Event->Begin            = Begin;
+    Event->Ticks            = (Ticks > 0xFFFFFFFF) ? 0xFFFFFFFF : (u32) Ticks;
+    Event->Zone             = Zone;
+    Thread->Write.store(Write + 1, std::memory_order_release);
+}
+
+typedef struct PROFILER_SCOPE
+{
+    u32 Zone;
+    u64 Begin;
+
+    PROFILER_SCOPE(u32 ZoneIndex)
+    {
+        Zone    = ZoneIndex;
+        Begin   = __rdtsc();
+    }
+
+    ~PROFILER_SCOPE()
+    {
+        ProfilerPushEvent(Zone, Begin, __rdtsc());
+    }
+} PROFILER_SCOPE;
+
+u32 ProfilerGpuBegin(u32 Zone)
+{
+    if(!GlobalProfiler.GpuEnabled)
+    {
+        return 0xFFFFFFFF;
+    }
+
+    u32 Slot = (u32) (GlobalProfiler.Frame % PROFILER_GPU_FRAMES);
+    PROFILER_GPU_FRAME *Frame = &GlobalProfiler.GpuFrames[Slot];
+    if(Frame->Count >= PROFILER_GPU_MAX_ZONES)
+    {
+        ++GlobalProfiler.GpuDropped;
+        return 0xFFFFFFFF;
+    }
+
+    u32 Index = Frame->Count++;
+    Frame->Zones[Index] = Zone;
+    glQueryCounter(GlobalProfiler.Queries[(Slot * PROFILER_GPU_MAX_ZONES + Index) * 2], GL_TIMESTAMP);
+    return Index;
+}
+
+void ProfilerGpuEnd(u32 Index)
+{
+    if(Index == 0xFFFFFFFF)
+    {
+        return;
+    }
+
+    u32 Slot = (u32) (GlobalProfiler.Frame % PROFILER_GPU_FRAMES);
+    glQueryCounter(GlobalProfiler.Queries[(Slot * PROFILER_GPU_MAX_ZONES + Index) * 2 + 1], GL_TIMESTAMP);
+}
+
+typedef struct PROFILER_GPU_SCOPE
+{
+    u32 Index;
+
+    PROFILER_GPU_SCOPE(u32 Zone)
+    {
+        Index = ProfilerGpuBegin(Zone);
+    }
+
+    ~PROFILER_GPU_SCOPE()
+    {
+        ProfilerGpuEnd(Index);
+    }
+} PROFILER_GPU_SCOPE;
+
+#define PROFILER_CONCAT_(A, B) A##B
+#define PROFILER_CONCAT(A, B) PROFILER_CONCAT_(A, B)
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(Name) \
+    static u32 PROFILER_CONCAT(ProfilerZone, __LINE__) = ProfilerRegisterZone(Name); \
+    PROFILER_SCOPE PROFILER_CONCAT(ProfilerScope, __LINE__)(PROFILER_CONCAT(ProfilerZone, __LINE__))
+#define PROFILE_GPU_SCOPE(Name) \
+    static u32 PROFILER_CONCAT(ProfilerGpuZone, __LINE__) = ProfilerRegisterZone(Name); \
+    PROFILER_GPU_SCOPE PROFILER_CONCAT(ProfilerGpuScope, __LINE__)(PROFILER_CONCAT(ProfilerGpuZone, __LINE__))
+#else
+#define PROFILE_SCOPE(Name)
+#define PROFILE_GPU_SCOPE(Name)
+#endif
+
+f64 ProfilerTicksToMicroseconds(u64 Ticks)
+{
+    return (f64) Ticks / GlobalProfiler.TicksPerMicrosecond;
+}
+
+void ProfilerWriteTraceEvent(const char *Name, u32 Thread, f64 Begin, f64 Duration)
+{
+    fprintf(GlobalProfiler.Capture, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            GlobalProfiler.CaptureFirstEvent ? "" : ",", Name, Thread, Begin, Duration);
+    GlobalProfiler.CaptureFirstEvent = false;
+}
+
+// Starts writing the next FrameCount frames to a Chrome trace file
+bool ProfilerCapture(const char *Path, u32 FrameCount)
+{
+    if(GlobalProfiler.Capture)
+    {
+        return false;
+    }
+
+    GlobalProfiler.Capture = fopen(Path, "w");
+    if(!GlobalProfiler.Capture)
+    {
+        return false;
+    }
+
+    GlobalProfiler.CaptureBegin         = GlobalProfiler.Frame;
+    GlobalProfiler.CaptureEnd           = GlobalProfiler.Frame + FrameCount;
+    GlobalProfiler.CaptureFirstEvent    = true;
+    fprintf(GlobalProfiler.Capture, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    return true;
+}
+
+bool ProfilerCapturing(u64 Frame)
+{
+    return GlobalProfiler.Capture && Frame >= GlobalProfiler.CaptureBegin && Frame < GlobalProfiler.CaptureEnd;
+}
+
+// Counter tracks (one series per name) at the current time - only written while capturing
+void ProfilerWriteCounters(const char *Name, const char **Series, const u32 *Values, u32 Count)
+{
+    if(!ProfilerCapturing(GlobalProfiler.Frame))
+    {
+        return;
+    }
+
+    fprintf(GlobalProfiler.Capture, "%s\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{", GlobalProfiler.CaptureFirstEvent ? "" : ",",
+            Name, ProfilerTicksToMicroseconds(__rdtsc() - GlobalProfiler.BaseTicks));
+    for(u32 i = 0; i < Count; ++i)
+    {
+        fprintf(GlobalProfiler.Capture, "%s\"%s\":%u", (i > 0) ? "," : "", Series[i], Values[i]);
+    }
+    fprintf(GlobalProfiler.Capture, "}}");
+    GlobalProfiler.CaptureFirstEvent = false;
+}
+
+void ProfilerWriteCounter(const char *Name, f64 Value)
+{
+    if(!ProfilerCapturing(GlobalProfiler.Frame))
+    {
+        return;
+    }
+
+    fprintf(GlobalProfiler.Capture, "%s\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%.3f}}", GlobalProfiler.CaptureFirstEvent ? "" : ",",
+            Name, ProfilerTicksToMicroseconds(__rdtsc() - GlobalProfiler.BaseTicks), Value);
+    GlobalProfiler.CaptureFirstEvent = false;
+}
+
+void ProfilerReadGpuFrame(u32 Slot)
+{
+    PROFILER_GPU_FRAME *Frame = &GlobalProfiler.GpuFrames[Slot];
+    if(Frame->Count == 0)
+    {
+        return;
+    }
+
+    // Only the last query needs checking - they complete in order
+    GLuint Last = GlobalProfiler.Queries[(Slot * PROFILER_GPU_MAX_ZONES + Frame->Count - 1) * 2 + 1];
+    GLuint Available = 0;
+    glGetQueryObjectuiv(Last, GL_QUERY_RESULT_AVAILABLE, &Available);
+    if(!Available)
+    {
+        GlobalProfiler.GpuDropped += Frame->Count;
+        Frame->Count = 0;
+        return;
+    }
+
+    bool Capturing = ProfilerCapturing(Frame->Frame);
+    for(u32 i = 0; i < Frame->Count; ++i)
+    {
+        GLuint64 Begin = 0, End = 0;
+        glGetQueryObjectui64v(GlobalProfiler.Queries[(Slot * PROFILER_GPU_MAX_ZONES + i) * 2], GL_QUERY_RESULT, &Begin);
+        glGetQueryObjectui64v(GlobalProfiler.Queries[(Slot * PROFILER_GPU_MAX_ZONES + i) * 2 + 1], GL_QUERY_RESULT, &End);
+        u64 Nanoseconds = (End > Begin) ? End - Begin : 0;
+
+        PROFILER_ZONE *Zone = &GlobalProfiler.Zones[Frame->Zones[i]];
+        Zone->GpuNanoseconds    += Nanoseconds;
+        Zone->GpuMaxNanoseconds = (Nanoseconds > Zone->GpuMaxNanoseconds) ? Nanoseconds : Zone->GpuMaxNanoseconds;
+
+        if(Capturing)
+        {
+            // GPU clock mapped onto the CPU timeline through the sample taken at init
+            f64 GpuBase = ProfilerTicksToMicroseconds(GlobalProfiler.GpuBaseTicks - GlobalProfiler.BaseTicks);
+            f64 Start   = GpuBase + ((f64) Begin - (f64) GlobalProfiler.GpuBaseNanoseconds) / 1000.0;
+            ProfilerWriteTraceEvent(Zone->Name, PROFILER_GPU_THREAD, Start, (f64) Nanoseconds / 1000.0);
+        }
+    }
+    Frame->Count = 0;
+}
+
+// Drains every thread's ring and collects GPU results from PROFILER_GPU_FRAMES ago - call once per frame on the main thread
+void ProfilerFrameEnd()
+{
+    PROFILE_SCOPE("ProfilerFrameEnd");
+
+    // Refine the tick rate over the whole run
+    f64 Elapsed = std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - GlobalProfiler.BaseTime).count();
+    u64 Now = __rdtsc();
+    if(Elapsed > 1000.0)
+    {
+        GlobalProfiler.TicksPerMicrosecond = (f64) (Now - GlobalProfiler.BaseTicks) / Elapsed;
+    }
+
+    bool Capturing = ProfilerCapturing(GlobalProfiler.Frame);
+    for(u32 ThreadIndex = 0; ThreadIndex < PROFILER_MAX_THREADS; ++ThreadIndex)
+    {
+        PROFILER_THREAD *Thread = &GlobalProfiler.Threads[ThreadIndex];
+        u32 State = Thread->State.load(std::memory_order_acquire);
+        if(State != PROFILER_SLOT_LIVE && State != PROFILER_SLOT_EXITED)
+        {
+            continue;
+        }
+
+        u32 Read    = Thread->Read.load(std::memory_order_relaxed);
+        u32 Write   = Thread->Write.load(std::memory_order_acquire);
+        for(; Read != Write; ++Read)
+        {
+            PROFILER_EVENT *Event   = &Thread->Events[Read & (PROFILER_RING_SIZE - 1)];
+            PROFILER_ZONE *Zone     = &GlobalProfiler.Zones[Event->Zone];
+            Zone->CpuTicks      += Event->Ticks;
+            Zone->CpuMaxTicks   = (Event->Ticks > Zone->CpuMaxTicks) ? Event->Ticks : Zone->CpuMaxTicks;
+            ++Zone->Calls;
+
+            if(Capturing)
+            {
+                ProfilerWriteTraceEvent(Zone->Name, ThreadIndex, ProfilerTicksToMicroseconds(Event->Begin - GlobalProfiler.BaseTicks),
+                                        ProfilerTicksToMicroseconds(Event->Ticks));
+                Thread->Traced = true;
+            }
+        }
+        Thread->Read.store(Read, std::memory_order_release);
+
+        // Its owner wrote nothing after exiting, so the ring is empty now - hand the slot to the next new thread
+        if(State == PROFILER_SLOT_EXITED)
+        {
+            Thread->State.store(PROFILER_SLOT_FREE, std::memory_order_release);
+        }
+    }
+
+    if(Capturing)
+    {
+        ProfilerWriteTraceEvent("Frame", PROFILER_GPU_THREAD + 1, ProfilerTicksToMicroseconds(GlobalProfiler.FrameBeginTicks - GlobalProfiler.BaseTicks),
+                                ProfilerTicksToMicroseconds(Now - GlobalProfiler.FrameBeginTicks));
+    }
+
+    // The slot the next frame reuses was issued PROFILER_GPU_FRAMES - 1 frames ago
+    if(GlobalProfiler.GpuEnabled)
+    {
+        u32 Next = (u32) ((GlobalProfiler.Frame + 1) % PROFILER_GPU_FRAMES);
+        ProfilerReadGpuFrame(Next);
+        GlobalProfiler.GpuFrames[Next].Frame = GlobalProfiler.Frame + 1;
+    }
+
+    // Close the capture once the last captured frame's GPU results are in
+    if(GlobalProfiler.Capture && GlobalProfiler.Frame + 1 >= GlobalProfiler.CaptureEnd + (GlobalProfiler.GpuEnabled ? PROFILER_GPU_FRAMES : 0))
+    {
+        // Track names
+        for(u32 i = 0; i < PROFILER_MAX_THREADS + 2; ++i)
+        {
+            if(i < PROFILER_MAX_THREADS && !GlobalProfiler.Threads[i].Traced)
+            {
+                continue;
+            }
+            u32 Track           = (i < PROFILER_MAX_THREADS) ? i : PROFILER_GPU_THREAD + (i - PROFILER_MAX_THREADS);
+            const char *Name    = (i < PROFILER_MAX_THREADS) ? GlobalProfiler.Threads[i].Name : ((i == PROFILER_MAX_THREADS) ? "GPU" : "Frames");
+            fprintf(GlobalProfiler.Capture, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    GlobalProfiler.CaptureFirstEvent ? "" : ",", Track, Name);
+            GlobalProfiler.CaptureFirstEvent = false;
+        }
+        fprintf(GlobalProfiler.Capture, "\n]}\n");
+        fclose(GlobalProfiler.Capture);
+        GlobalProfiler.Capture = 0;
+    }
+
+    ++GlobalProfiler.Frame;
+    ++GlobalProfiler.SummaryFrames;
+    GlobalProfiler.FrameBeginTicks = __rdtsc();
+}
+
+int ProfilerCompareZones(const void *A, const void *B)
+{
+    const PROFILER_ZONE *X = *(const PROFILER_ZONE **) A;
+    const PROFILER_ZONE *Y = *(const PROFILER_ZONE **) B;
+    f64 TimeX = ProfilerTicksToMicroseconds(X->CpuTicks) + (f64) X->GpuNanoseconds / 1000.0;
+    f64 TimeY = ProfilerTicksToMicroseconds(Y->CpuTicks) + (f64) Y->GpuNanoseconds / 1000.0;
+    return (TimeX < TimeY) - (TimeX > TimeY);
+}
+
+// Top zones by total time since the last summary (CPU zones include their children), then resets the counters
+void ProfilerPrintSummary(u32 Count)
+{
+    u32 ZoneCount = GlobalProfiler.ZoneCount.load(std::memory_order_acquire);
+    PROFILER_ZONE *Sorted[PROFILER_MAX_ZONES];
+    for(u32 i = 0; i < ZoneCount; ++i)
+    {
+        Sorted[i] = &GlobalProfiler.Zones[i];
+    }
+    qsort(Sorted, ZoneCount, sizeof(PROFILER_ZONE *), ProfilerCompareZones);
+
+    f64 Frames = (GlobalProfiler.SummaryFrames > 0) ? (f64) GlobalProfiler.SummaryFrames : 1.0;
+    printf("profiler: top zones over %llu frames (%.0f ticks/us)\n", (unsigned long long) GlobalProfiler.SummaryFrames, GlobalProfiler.TicksPerMicrosecond);
+    printf("profiler: %-28s %12s %12s %12s %12s %10s\n", "zone", "cpu ms/frm", "cpu max ms", "gpu ms/frm", "gpu max ms", "calls/frm");
+    for(u32 i = 0; i < ZoneCount && i < Count; ++i)
+    {
+        PROFILER_ZONE *Zone = Sorted[i];
+        if(Zone->Calls == 0 && Zone->GpuNanoseconds == 0)
+        {
+            break;
+        }
+        printf("profiler: %-28s %12.4f %12.4f %12.4f %12.4f %10.1f\n", Zone->Name,
+                ProfilerTicksToMicroseconds(Zone->CpuTicks) / 1000.0 / Frames, ProfilerTicksToMicroseconds(Zone->CpuMaxTicks) / 1000.0,
+                (f64) Zone->GpuNanoseconds / 1000000.0 / Frames, (f64) Zone->GpuMaxNanoseconds / 1000000.0, (f64) Zone->Calls / Frames);
+    }
+
+    u32 Dropped = GlobalProfiler.GpuDropped;
+    for(u32 i = 0; i < PROFILER_MAX_THREADS; ++i)
+    {
+        Dropped += GlobalProfiler.Threads[i].Dropped;
+    }
+    if(Dropped)
+    {
+        printf("profiler: %u events dropped (ring full or GPU results late)\n", Dropped);
+    }
+
+    for(u32 i = 0; i < ZoneCount; ++i)
+    {
+        PROFILER_ZONE *Zone     = &GlobalProfiler.Zones[i];
+        Zone->CpuTicks          = 0;
+        Zone->CpuMaxTicks       = 0;
+        Zone->GpuNanoseconds    = 0;
+        Zone->GpuMaxNanoseconds = 0;
+        Zone->Calls             = 0;
+    }
+    GlobalProfiler.SummaryFrames = 0;
+}
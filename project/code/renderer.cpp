@@ -1,9 +1,302 @@
 
+// Shader permutations - each bit adds a #define to the shared vertex/fragment source
+typedef enum SHADER_PERMUTATION
+{
+    SHADER_FOG          = (1 << 0),
+    SHADER_LIGHTMAP     = (1 << 1),
+    SHADER_ALPHA_TEST   = (1 << 2),
+    SHADER_PALETTE      = (1 << 3),
+    SHADER_PERMUTATION_COUNT = (1 << 4),
+    SHADER_PARTICLE     = (1 << 4),     // Instanced camera facing sprites - built on its own, outside the permutation set
+} SHADER_PERMUTATION;
+
+static const char *ShaderPermutationDefines[] =
+{
+    "FOG",
+    "LIGHTMAP",
+    "ALPHA_TEST",
+    "PALETTE",
+    "PARTICLE",
+};
+
+// Texture units - must match the layout bindings in fragment.glsl
+#define TEXTURE_UNIT_ALBEDO     0
+#define TEXTURE_UNIT_PALETTE    1
+#define TEXTURE_UNIT_LIGHTMAP   2
+
+#define SHADER_BINARY_MAGIC     0x4B524144 // 'DARK'
+#define SHADER_BINARY_VERSION   1
+
+typedef struct SHADER_BINARY_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u64 Hash;
+    GLenum Format;
+    u32 Length;
+} SHADER_BINARY_HEADER;
+
+typedef struct SHADER_CACHE
+{
+    const char *Directory;  // Null disables the cache
+    bool Enabled;           // Driver exposes at least one program binary format
+    u32 Hits;
+    u32 Misses;
+    u32 Rejected;           // Binary on disk that the driver refused (driver update etc.)
+} SHADER_CACHE;
+
+// GL state cache
+// Shadows the state the renderer touches so redundant calls never reach the driver. Draw state (program, vertex array,
+// texture units, raster state, viewport) is only recorded when set and applied by GLStateFlush right before a draw, so
+// state set and then changed again before anything is drawn costs nothing. Binds that take effect immediately (buffers
+// for uploads, the draw framebuffer for clears) are filtered as they're made.
+#define GL_STATE_TEXTURE_UNITS  4
+#define GL_STATE_UNKNOWN        0xFFFFFFFF  // Shadow value after GLStateInvalidate - matches nothing GL could hold
+
+// Per frame call counts, for finding driver overhead
+typedef enum GL_CALL_CATEGORY
+{
+    GL_CALL_PROGRAM,
+    GL_CALL_VERTEX_ARRAY,
+    GL_CALL_TEXTURE,
+    GL_CALL_BUFFER,
+    GL_CALL_FRAMEBUFFER,
+    GL_CALL_RASTER,         // Polygon mode, depth, blend, cull, viewport, clear colour
+    GL_CALL_UNIFORM,
+    GL_CALL_UPLOAD,         // Texture uploads and pixel store
+    GL_CALL_DRAW,           // Draws, clears and blits
+    GL_CALL_CATEGORY_COUNT,
+} GL_CALL_CATEGORY;
+
+static const char *GLCallCategoryNames[GL_CALL_CATEGORY_COUNT] =
+{
+    "program",
+    "vertex_array",
+    "texture",
+    "buffer",
+    "framebuffer",
+    "raster",
+    "uniform",
+    "upload",
+    "draw",
+};
+
+typedef struct GL_CALL_COUNTS
+{
+    u32 Requested[GL_CALL_CATEGORY_COUNT];
+    u32 Issued[GL_CALL_CATEGORY_COUNT];     // The rest were redundant
+} GL_CALL_COUNTS;
+
+// Buffer targets the cache follows - anything else goes straight through
+typedef enum GL_BUFFER_SLOT
+{
+    GL_BUFFER_SLOT_DRAW_INDIRECT,
+    GL_BUFFER_SLOT_PIXEL_UNPACK,
+    GL_BUFFER_SLOT_ARRAY,
+    GL_BUFFER_SLOT_COUNT,
+} GL_BUFFER_SLOT;
+
+typedef struct GL_RASTER_STATE
+{
+    GLenum PolygonMode;
+    GLenum CullFace;        // GL_NONE for no culling
+    GLenum DepthFunc;       // GL_NONE for no depth test
+    GLboolean DepthWrite;
+    GLenum BlendSource;     // GL_NONE for no blending
+    GLenum BlendDest;
+    GLint Viewport[4];
+} GL_RASTER_STATE;
+
+typedef struct GL_DRAW_STATE
+{
+    GLuint Program;
+    GLuint VertexArray;
+    GLuint Textures[GL_STATE_TEXTURE_UNITS];
+    GL_RASTER_STATE Raster;
+} GL_DRAW_STATE;
+
+typedef struct GL_STATE
+{
+    GL_DRAW_STATE Current;  // What GL has
+    GL_DRAW_STATE Pending;  // What the next draw needs
+    GLuint Buffers[GL_BUFFER_SLOT_COUNT];
+    GLuint ReadFramebuffer;
+    GLuint DrawFramebuffer;
+    GLfloat ClearColour[4];
+    GLint UnpackAlignment;
+
+    GL_CALL_COUNTS Frame;   // Since the last GLStateFrameEnd
+} GL_STATE;
+
+static GL_STATE GlobalGLState;
+
+// Render queue
+#define RENDER_QUEUE_MAX_PACKETS        16384
+#define RENDER_QUEUE_FRAMES_IN_FLIGHT   3
+
+typedef enum RENDER_PASS
+{
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_ALPHA_TEST,
+    RENDER_PASS_TRANSLUCENT,    // Sorted back to front
+    RENDER_PASS_COUNT,
+} RENDER_PASS;
+
+// Layout matches the GL indirect draw command
+typedef struct DRAW_ELEMENTS_INDIRECT_COMMAND
+{
+    u32 Count;
+    u32 InstanceCount;
+    u32 FirstIndex;
+    i32 BaseVertex;
+    u32 BaseInstance;
+} DRAW_ELEMENTS_INDIRECT_COMMAND;
+
+typedef struct RENDER_PACKET
+{
+    u64 SortKey;
+    GLuint Program;
+    GLuint Texture;             // TEXTURE_UNIT_ALBEDO
+    GLuint Lightmap;            // TEXTURE_UNIT_LIGHTMAP
+    GLuint VertexArray;
+    u32 IndexCount;
+    u32 FirstIndex;
+    i32 BaseVertex;
+    u32 InstanceCount;
+    u32 BaseInstance;
+} RENDER_PACKET;
+
+typedef struct RENDER_SORT_ENTRY
+{
+    u64 Key;
+    u32 Index;
+} RENDER_SORT_ENTRY;
+
+typedef struct RENDER_STATS
+{
+    u32 Packets;
+    u32 DrawCalls;
+    u32 ProgramChanges;
+    u32 TextureChanges;
+    u32 VertexArrayChanges;
+} RENDER_STATS;
+
+typedef struct RENDER_QUEUE
+{
+    RENDER_PACKET *Packets;
+    u32 PacketCount;
+
+    // Radix sort ping-pong buffers - from the frame arena, only valid until the queue is submitted
+    RENDER_SORT_ENTRY *SortEntries;
+    RENDER_SORT_ENTRY *SortScratch;
+
+    // Persistently mapped indirect commands, one region per frame in flight
+    GLuint IndirectBuffer;
+    DRAW_ELEMENTS_INDIRECT_COMMAND *IndirectCommands;
+    GLsync Fences[RENDER_QUEUE_FRAMES_IN_FLIGHT];
+    u32 Frame;
+
+    RENDER_STATS Stats;
+} RENDER_QUEUE;
+
+// Mesh pool
+#define MESH_POOL_MAX_FREE_BLOCKS   4096
+
+// Packed vertex - 20 bytes instead of 40 for f32 position/normal/uv/lightmap uv
+typedef struct VERTEX_PACKED
+{
+    i16 Position[4];        // snorm16, scaled by MESH_POOL::PositionScale (4th is padding)
+    u32 Normal;             // snorm 2_10_10_10
+    u16 UV[2];              // half float
+    u16 LightmapUV[2];      // unorm16 - atlas coordinates need more precision than half floats have near 1
+} VERTEX_PACKED;
+
+typedef struct FREE_LIST_BLOCK
+{
+    u32 Offset;
+    u32 Count;
+} FREE_LIST_BLOCK;
+
+// First-fit free list over a range of elements, blocks kept sorted by offset so frees can coalesce
+typedef struct FREE_LIST
+{
+    FREE_LIST_BLOCK *Blocks;
+    u32 BlockCount;
+    u32 MaxBlocks;
+    u32 Capacity;
+    u32 Used;
+} FREE_LIST;
+
+// Sub-allocated range of the shared buffers
+typedef struct MESH
+{
+    u32 BaseVertex;
+    u32 VertexCount;
+    u32 FirstIndex;
+    u32 IndexCount;
+} MESH;
+
+typedef struct MESH_POOL
+{
+    GLuint VertexArray;
+    GLuint VertexBuffer;
+    GLuint IndexBuffer;
+    FREE_LIST Vertices;
+    FREE_LIST Indices;
+    f32 PositionScale;      // World units that map to snorm16 -1..1
+    u64 BytesUploaded;
+
+    // Optional CPU copy of both buffers for the software renderer
+    VERTEX_PACKED *CpuVertices;
+    u32 *CpuIndices;
+} MESH_POOL;
+
+// Internal render target
+#define RENDER_TIMER_FRAMES             4           // Frames of GPU timer latency before readback
+#define RENDER_RESOLUTION_MIN_SCALE     0.25f
+#define RENDER_RESOLUTION_HEADROOM      0.9         // Fraction of the frame budget the GPU is allowed
+#define RENDER_RESOLUTION_RAISE_FRAMES  30          // Frames under budget before scaling back up
+
+// Allocated once at RenderDimensions - dynamic resolution only renders into a smaller corner of it
+typedef struct RENDER_TARGET
+{
+    GLuint Framebuffer;
+    GLuint ColourBuffer;
+    GLuint DepthBuffer;
+    V2U Dimensions;         // This frame
+} RENDER_TARGET;
+
+typedef struct RENDER_RESOLUTION
+{
+    bool Dynamic;
+    f32 Scale;              // Of RenderDimensions, per axis
+    f64 GpuSeconds;         // Smoothed frame time from the timer queries
+    u32 Cooldown;           // Frames left before the last change shows up in the timings
+    u32 UnderBudget;
+    u32 Changes;
+
+    GLuint Queries[RENDER_TIMER_FRAMES * 2];
+    u64 Frame;
+} RENDER_RESOLUTION;
+
 typedef struct RENDERER_SETTINGS
 {
     V2U RenderDimensions;
-    GLuint ShaderProgram;
-    GLuint VertexArrayObject; // Simply stores the state of the VertexArrayObject after each gen/bind
+    GLuint ShaderProgram;   // Default permutation (ShaderPrograms[0])
+    GLuint ShaderPrograms[SHADER_PERMUTATION_COUNT];
+    GLint ViewProjectionLocations[SHADER_PERMUTATION_COUNT];
+    SHADER_CACHE ShaderCache;
+    GLuint VertexArrayObject; // Shared by every mesh in the pool
+    GLuint ParticleProgram;
+    GLint ParticleViewProjectionLocation;
+    GLint ParticleCameraRightLocation;
+    GLint ParticleCameraUpLocation;
+    MESH_POOL MeshPool;
+    RENDER_QUEUE Queue;
+    RENDER_TARGET Target;
+    RENDER_RESOLUTION Resolution;
+    f32 ViewProjection[16];     // Last uploaded, to skip unchanged cameras
+    GL_CALL_COUNTS GLCalls;     // Last frame
 } RENDERER;
 
 void CheckCompilerLogs(GLuint ShaderID)
@@ -19,25 +312,51 @@ void CheckCompilerLogs(GLuint ShaderID)
     }
 }
 
-GLuint CreateShaderProgram(MEMORY_ARENA *Arena)
+u64 HashFNV1a(u64 Hash, const void *Data, size_t Size)
+{
+    const u8 *Bytes = (const u8 *) Data;
+    for(size_t i = 0; i < Size; ++i)
+    {
+        Hash ^= Bytes[i];
+        Hash *= 0x100000001B3ULL;
+    }
+    return Hash;
+}
+
+u64 HashString(u64 Hash, const char *String)
+{
+    return String ? HashFNV1a(Hash, String, strlen(String)) : Hash;
+}
+
+void BuildShaderDefines(GLchar *Defines, size_t Size, u32 Permutation)
 {
-    // Compiling
     // General defines
-    GLchar Defines[1024];
-    FormatString(sizeof(Defines), Defines,
+    FormatString(Size, Defines,
                 "#version %d\n"
                 "#define f32 float\n"
                 "#define i32 int\n"
                 "#define u32 int unsigned\n"
                 "#define v2 vec2\n"
+                "#define M4 mat4\n"
                 "#define V4 vec4\n"
                 "#define V3 vec3\n"
                 "#define V2 vec2\n",
                 OPENGL_VERSION);
 
-    // Vertex shader
-    // Load from text file
-    GLchar *VertexCode = (GLchar *) FileLoadText(Arena, "data/shaders/vertex.glsl");
+    // Permutation defines
+    for(u32 i = 0; i < ArrayCount(ShaderPermutationDefines); ++i)
+    {
+        if(Permutation & (1 << i))
+        {
+            size_t Length = strlen(Defines);
+            FormatString(Size - Length, Defines + Length, "#define %s 1\n", ShaderPermutationDefines[i]);
+        }
+    }
+}
+
+GLuint CompileShaderProgram(GLchar *Defines, GLchar *VertexCode, GLchar *FragmentCode, bool Retrievable)
+{
+    PROFILE_SCOPE("CompileShaderProgram");
 
     // Compile
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -48,12 +367,7 @@ GLuint CreateShaderProgram(MEMORY_ARENA *Arena)
     };
     glShaderSource(VertexShaderID, ArrayCount(VertexShaderCode), VertexShaderCode, 0);
     glCompileShader(VertexShaderID);
-    
-    // Fragment shader
-    // Load from text file
-    GLchar *FragmentCode = (GLchar *) FileLoadText(Arena, "data/shaders/fragment.glsl");
 
-    // Compile
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
     GLchar *FragmentShaderCode[] =
     {
@@ -66,6 +380,10 @@ GLuint CreateShaderProgram(MEMORY_ARENA *Arena)
     // Linking
     // Attach and link compiled shaders to the program object
     GLuint ShaderProgramID = glCreateProgram();
+    if(Retrievable)
+    {
+        glProgramParameteri(ShaderProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(ShaderProgramID, VertexShaderID);
     glAttachShader(ShaderProgramID, FragmentShaderID);
     glLinkProgram(ShaderProgramID);
@@ -95,101 +413,1233 @@ GLuint CreateShaderProgram(MEMORY_ARENA *Arena)
     }
 
     // Free compiled shaders
+    glDetachShader(ShaderProgramID, VertexShaderID);
+    glDetachShader(ShaderProgramID, FragmentShaderID);
     glDeleteShader(VertexShaderID);
     glDeleteShader(FragmentShaderID);
 
     return ShaderProgramID;
 }
 
-RENDERER InitialiseRenderer(MEMORY_ARENA *Arena, V2U Dimensions)
+GLuint LoadShaderBinary(SHADER_CACHE *Cache, const char *Path, u64 Hash)
+{
+    FILE *File = fopen(Path, "rb");
+    if(!File)
+    {
+        return 0;
+    }
+
+    GLuint Result = 0;
+    SHADER_BINARY_HEADER Header = {};
+    if(fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == SHADER_BINARY_MAGIC && Header.Version == SHADER_BINARY_VERSION && Header.Hash == Hash)
+    {
+        // Blob is transient - only needed until the driver has consumed it
+        MEMORY_SCRATCH Scratch;
+        void *Binary = VirtualArenaAlloc(Scratch.Arena, Header.Length, 16);
+        if(Binary && fread(Binary, Header.Length, 1, File) == 1)
+        {
+            Result = glCreateProgram();
+            glProgramBinary(Result, Header.Format, Binary, Header.Length);
+
+            // Drivers may reject binaries at any time (driver/GPU change) - fall back to compiling
+            GLint Linked = 0;
+            glGetProgramiv(Result, GL_LINK_STATUS, &Linked);
+            if(!Linked)
+            {
+                glDeleteProgram(Result);
+                Result = 0;
+                ++Cache->Rejected;
+            }
+        }
+    }
+
+    fclose(File);
+    return Result;
+}
+
+void SaveShaderBinary(const char *Path, u64 Hash, GLuint Program)
+{
+    GLint Length = 0;
+    glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &Length);
+    if(Length <= 0)
+    {
+        return;
+    }
+
+    SHADER_BINARY_HEADER Header = {};
+    Header.Magic    = SHADER_BINARY_MAGIC;
+    Header.Version  = SHADER_BINARY_VERSION;
+    Header.Hash     = Hash;
+
+    MEMORY_SCRATCH Scratch;
+    void *Binary = VirtualArenaAlloc(Scratch.Arena, Length, 16);
+    Assert(Binary, "Shader: Failed to allocate program binary!");
+    GLsizei Written = 0;
+    glGetProgramBinary(Program, Length, &Written, &Header.Format, Binary);
+    Header.Length = (u32) Written;
+
+    // Written beside the old blob and swapped in whole, so a crash or a second instance never sees half a binary
+    char TempPath[520];
+    FormatString(sizeof(TempPath), TempPath, "%s.tmp", Path);
+
+    FILE *File = fopen(TempPath, "wb");
+    if(!File)
+    {
+        printf("Shader: Failed to write program binary %s!\n", Path);
+        return;
+    }
+
+    bool Success = (fwrite(&Header, sizeof(Header), 1, File) == 1) &&
+                   (fwrite(Binary, Written, 1, File) == 1);
+    Success = (fclose(File) == 0) && Success;
+
+#if defined(_WIN32)
+    Success = Success && MoveFileExA(TempPath, Path, MOVEFILE_REPLACE_EXISTING);
+#else
+    Success = Success && (rename(TempPath, Path) == 0);
+#endif
+
+    if(!Success)
+    {
+        remove(TempPath);
+        printf("Shader: Failed to write program binary %s!\n", Path);
+    }
+}
+
+GLuint CreateShaderProgram(SHADER_CACHE *Cache, u32 Permutation, GLchar *VertexCode, GLchar *FragmentCode)
+{
+    PROFILE_SCOPE("CreateShaderProgram");
+    GLchar Defines[1024];
+    BuildShaderDefines(Defines, sizeof(Defines), Permutation);
+
+    if(!Cache->Enabled)
+    {
+        ++Cache->Misses;
+        return CompileShaderProgram(Defines, VertexCode, FragmentCode, false);
+    }
+
+    // Key on everything that affects the binary - sources, defines and the driver that produced it
+    u64 Hash = 0xCBF29CE484222325ULL;
+    Hash = HashString(Hash, Defines);
+    Hash = HashString(Hash, VertexCode);
+    Hash = HashString(Hash, FragmentCode);
+    Hash = HashString(Hash, (const char *) glGetString(GL_VENDOR));
+    Hash = HashString(Hash, (const char *) glGetString(GL_RENDERER));
+    Hash = HashString(Hash, (const char *) glGetString(GL_VERSION));
+
+    char Path[512];
+    FormatString(sizeof(Path), Path, "%s/%016llx.bin", Cache->Directory, (unsigned long long) Hash);
+
+    GLuint Result = LoadShaderBinary(Cache, Path, Hash);
+    if(Result)
+    {
+        ++Cache->Hits;
+        return Result;
+    }
+
+    // Cold - compile and regenerate the binary
+    ++Cache->Misses;
+    Result = CompileShaderProgram(Defines, VertexCode, FragmentCode, true);
+    SaveShaderBinary(Path, Hash, Result);
+    return Result;
+}
+
+// Forgets everything the cache knows - every shadow becomes GL_STATE_UNKNOWN (NaN for floats, -1 for ints), so the next
+// set of each reaches GL. Call after anything outside the cache has touched state. Pending draw state goes back to GL's
+// defaults, with texture units and the viewport left alone until something sets them
+void GLStateInvalidate()
+{
+    GL_CALL_COUNTS Frame = GlobalGLState.Frame;
+    memset(&GlobalGLState, 0xFF, sizeof(GlobalGLState));
+    GlobalGLState.Frame = Frame;
+
+    GL_DRAW_STATE *Pending = &GlobalGLState.Pending;
+    *Pending = {};
+    memset(Pending->Textures, 0xFF, sizeof(Pending->Textures));
+    Pending->Raster.PolygonMode = GL_FILL;
+    Pending->Raster.DepthWrite  = GL_TRUE;
+    memcpy(Pending->Raster.Viewport, GlobalGLState.Current.Raster.Viewport, sizeof(Pending->Raster.Viewport));
+}
+
+inline void GLStateRequest(u32 Category)
+{
+    ++GlobalGLState.Frame.Requested[Category];
+}
+
+inline void GLStateIssue(u32 Category)
+{
+    ++GlobalGLState.Frame.Issued[Category];
+}
+
+// Calls the cache can't filter (draws, uploads) still go in the counts
+inline void GLStateCount(u32 Category, u32 Count = 1)
+{
+    GlobalGLState.Frame.Requested[Category] += Count;
+    GlobalGLState.Frame.Issued[Category]    += Count;
+}
+
+// Draw state - recorded now, applied by GLStateFlush
+void GLStateUseProgram(GLuint Program)
+{
+    GLStateRequest(GL_CALL_PROGRAM);
+    GlobalGLState.Pending.Program = Program;
+}
+
+void GLStateBindVertexArray(GLuint VertexArray)
+{
+    GLStateRequest(GL_CALL_VERTEX_ARRAY);
+    GlobalGLState.Pending.VertexArray = VertexArray;
+}
+
+void GLStateBindTexture(u32 Unit, GLuint Texture)
+{
+    Assert(Unit < GL_STATE_TEXTURE_UNITS, "Renderer: Texture unit out of range!");
+    GLStateRequest(GL_CALL_TEXTURE);
+    GlobalGLState.Pending.Textures[Unit] = Texture;
+}
+
+void GLStateSetPolygonMode(GLenum Mode)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GlobalGLState.Pending.Raster.PolygonMode = Mode;
+}
+
+void GLStateSetViewport(GLint X, GLint Y, GLint Width, GLint Height)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GLint *Viewport = GlobalGLState.Pending.Raster.Viewport;
+    Viewport[0] = X;
+    Viewport[1] = Y;
+    Viewport[2] = Width;
+    Viewport[3] = Height;
+}
+
+// GL_NONE turns the test (and with it depth writes) off
+void GLStateSetDepth(GLenum Func, bool Write)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GlobalGLState.Pending.Raster.DepthFunc  = Func;
+    GlobalGLState.Pending.Raster.DepthWrite = Write ? GL_TRUE : GL_FALSE;
+}
+
+void GLStateSetBlend(GLenum Source, GLenum Dest)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GlobalGLState.Pending.Raster.BlendSource    = Source;
+    GlobalGLState.Pending.Raster.BlendDest      = Dest;
+}
+
+void GLStateSetCull(GLenum Face)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GlobalGLState.Pending.Raster.CullFace = Face;
+}
+
+// Capability toggles issue only when crossing GL_NONE, the function/mode only when it differs
+void GLStateFlushCapability(GLenum Capability, GLenum Current, GLenum Pending)
+{
+    if((Current == GL_NONE) != (Pending == GL_NONE) || Current == GL_STATE_UNKNOWN)
+    {
+        (Pending == GL_NONE) ? glDisable(Capability) : glEnable(Capability);
+        GLStateIssue(GL_CALL_RASTER);
+    }
+}
+
+// Applies pending draw state that differs from GL's - call right before every draw
+void GLStateFlush()
+{
+    GL_DRAW_STATE *Current = &GlobalGLState.Current;
+    GL_DRAW_STATE *Pending = &GlobalGLState.Pending;
+    if(Pending->Program != Current->Program)
+    {
+        glUseProgram(Pending->Program);
+        GLStateIssue(GL_CALL_PROGRAM);
+    }
+    if(Pending->VertexArray != Current->VertexArray)
+    {
+        glBindVertexArray(Pending->VertexArray);
+        GLStateIssue(GL_CALL_VERTEX_ARRAY);
+    }
+    for(u32 i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+    {
+        if(Pending->Textures[i] != Current->Textures[i] && Pending->Textures[i] != GL_STATE_UNKNOWN)
+        {
+            glBindTextureUnit(i, Pending->Textures[i]);
+            GLStateIssue(GL_CALL_TEXTURE);
+        }
+    }
+
+    GL_RASTER_STATE *CurrentRaster = &Current->Raster;
+    GL_RASTER_STATE *PendingRaster = &Pending->Raster;
+    if(memcmp(CurrentRaster, PendingRaster, sizeof(GL_RASTER_STATE)) != 0)
+    {
+        if(PendingRaster->PolygonMode != CurrentRaster->PolygonMode)
+        {
+            glPolygonMode(GL_FRONT_AND_BACK, PendingRaster->PolygonMode);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+
+        GLStateFlushCapability(GL_CULL_FACE, CurrentRaster->CullFace, PendingRaster->CullFace);
+        if(PendingRaster->CullFace != GL_NONE && PendingRaster->CullFace != CurrentRaster->CullFace)
+        {
+            glCullFace(PendingRaster->CullFace);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+
+        GLStateFlushCapability(GL_DEPTH_TEST, CurrentRaster->DepthFunc, PendingRaster->DepthFunc);
+        if(PendingRaster->DepthFunc != GL_NONE && PendingRaster->DepthFunc != CurrentRaster->DepthFunc)
+        {
+            glDepthFunc(PendingRaster->DepthFunc);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+        if(PendingRaster->DepthWrite != CurrentRaster->DepthWrite)
+        {
+            glDepthMask(PendingRaster->DepthWrite);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+
+        GLStateFlushCapability(GL_BLEND, CurrentRaster->BlendSource, PendingRaster->BlendSource);
+        if(PendingRaster->BlendSource != GL_NONE && (PendingRaster->BlendSource != CurrentRaster->BlendSource || PendingRaster->BlendDest != CurrentRaster->BlendDest))
+        {
+            glBlendFunc(PendingRaster->BlendSource, PendingRaster->BlendDest);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+
+        if(PendingRaster->Viewport[2] >= 0 && memcmp(PendingRaster->Viewport, CurrentRaster->Viewport, sizeof(PendingRaster->Viewport)) != 0)
+        {
+            glViewport(PendingRaster->Viewport[0], PendingRaster->Viewport[1], PendingRaster->Viewport[2], PendingRaster->Viewport[3]);
+            GLStateIssue(GL_CALL_RASTER);
+        }
+    }
+    *Current = *Pending;
+}
+
+// Immediate - these change what the next upload or clear does
+void GLStateBindBuffer(GLenum Target, GLuint Buffer)
+{
+    GLStateRequest(GL_CALL_BUFFER);
+    u32 Slot = GL_BUFFER_SLOT_COUNT;
+    switch(Target)
+    {
+        case GL_DRAW_INDIRECT_BUFFER:   Slot = GL_BUFFER_SLOT_DRAW_INDIRECT;    break;
+        case GL_PIXEL_UNPACK_BUFFER:    Slot = GL_BUFFER_SLOT_PIXEL_UNPACK;     break;
+        case GL_ARRAY_BUFFER:           Slot = GL_BUFFER_SLOT_ARRAY;            break;
+    }
+    if(Slot == GL_BUFFER_SLOT_COUNT || GlobalGLState.Buffers[Slot] != Buffer)
+    {
+        glBindBuffer(Target, Buffer);
+        GLStateIssue(GL_CALL_BUFFER);
+        if(Slot < GL_BUFFER_SLOT_COUNT)
+        {
+            GlobalGLState.Buffers[Slot] = Buffer;
+        }
+    }
+}
+
+// GL_FRAMEBUFFER sets both read and draw
+void GLStateBindFramebuffer(GLenum Target, GLuint Framebuffer)
+{
+    GLStateRequest(GL_CALL_FRAMEBUFFER);
+    bool Read = (Target != GL_DRAW_FRAMEBUFFER);
+    bool Draw = (Target != GL_READ_FRAMEBUFFER);
+    if((Read && GlobalGLState.ReadFramebuffer != Framebuffer) || (Draw && GlobalGLState.DrawFramebuffer != Framebuffer))
+    {
+        glBindFramebuffer(Target, Framebuffer);
+        GLStateIssue(GL_CALL_FRAMEBUFFER);
+        GlobalGLState.ReadFramebuffer = Read ? Framebuffer : GlobalGLState.ReadFramebuffer;
+        GlobalGLState.DrawFramebuffer = Draw ? Framebuffer : GlobalGLState.DrawFramebuffer;
+    }
+}
+
+void GLStateSetClearColour(GLfloat R, GLfloat G, GLfloat B, GLfloat A)
+{
+    GLStateRequest(GL_CALL_RASTER);
+    GLfloat *Colour = GlobalGLState.ClearColour;
+    if(Colour[0] != R || Colour[1] != G || Colour[2] != B || Colour[3] != A)
+    {
+        glClearColor(R, G, B, A);
+        GLStateIssue(GL_CALL_RASTER);
+        Colour[0] = R;
+        Colour[1] = G;
+        Colour[2] = B;
+        Colour[3] = A;
+    }
+}
+
+void GLStateSetUnpackAlignment(GLint Alignment)
+{
+    GLStateRequest(GL_CALL_UPLOAD);
+    if(GlobalGLState.UnpackAlignment != Alignment)
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, Alignment);
+        GLStateIssue(GL_CALL_UPLOAD);
+        GlobalGLState.UnpackAlignment = Alignment;
+    }
+}
+
+// Deleting unbinds the texture from every unit and frees its name for reuse - forget it so a new texture that gets the
+// same name is still bound
+void GLStateDeleteTexture(GLuint Texture)
+{
+    for(u32 i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+    {
+        if(GlobalGLState.Current.Textures[i] == Texture)
+        {
+            GlobalGLState.Current.Textures[i] = 0;
+        }
+    }
+    glDeleteTextures(1, &Texture);
+}
+
+u32 GLCallTotal(u32 *Counts)
+{
+    u32 Result = 0;
+    for(u32 i = 0; i < GL_CALL_CATEGORY_COUNT; ++i)
+    {
+        Result += Counts[i];
+    }
+    return Result;
+}
+
+// Returns the frame's counts and starts the next - they also go to the profile capture as counter tracks
+GL_CALL_COUNTS GLStateFrameEnd()
+{
+    GL_CALL_COUNTS Result = GlobalGLState.Frame;
+    u32 Issued      = GLCallTotal(Result.Issued);
+    u32 Requested   = GLCallTotal(Result.Requested);
+    ProfilerWriteCounters("GL calls", GLCallCategoryNames, Result.Issued, GL_CALL_CATEGORY_COUNT);
+    ProfilerWriteCounter("GL calls dropped", (Requested > Issued) ? (f64) (Requested - Issued) : 0.0);
+
+    GlobalGLState.Frame = {};
+    return Result;
+}
+
+// Sort key layout (high to low):
+//   opaque and alpha tested: pass 4 | program 8 | texture 12 | vertex array 8 | depth 32
+//   translucent:             pass 4 | inverted depth 32 | program 8 | texture 12 | vertex array 8
+// Translucent packets have to blend back to front across the whole pass, so depth goes above state there. Texture is
+// whichever of the packet's textures tells its draws apart. Fields are truncated, so the key only orders packets -
+// submission compares the real state
+u64 RenderSortKey(u32 Pass, GLuint Program, GLuint Texture, GLuint VertexArray, f32 Depth)
+{
+    // Positive floats sort correctly as integers
+    u32 DepthBits = 0;
+    f32 ClampedDepth = (Depth > 0.0f) ? Depth : 0.0f;
+    memcpy(&DepthBits, &ClampedDepth, sizeof(DepthBits));
+
+    u64 State = ((u64) (Program & 0xFF) << 20) |
+                ((u64) (Texture & 0xFFF) << 8) |
+                ((u64) (VertexArray & 0xFF));
+
+    u64 Result = (u64) (Pass & 0xF) << 60;
+    if(Pass == RENDER_PASS_TRANSLUCENT)
+    {
+        Result |= ((u64) (~DepthBits) << 28) | State;
+    }
+    else
+    {
+        Result |= (State << 32) | (u64) DepthBits;
+    }
+    return Result;
+}
+
+void RenderQueueCreate(RENDER_QUEUE *Queue, MEMORY_ARENA *Arena)
+{
+    Queue->Packets = (RENDER_PACKET *) Arena->Alloc(sizeof(RENDER_PACKET) * RENDER_QUEUE_MAX_PACKETS, alignof(RENDER_PACKET));
+    Assert(Queue->Packets, "Renderer: Failed to allocate render queue!");
+
+    // Indirect commands are written straight into mapped memory
+    GLsizeiptr Size = sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND) * RENDER_QUEUE_MAX_PACKETS * RENDER_QUEUE_FRAMES_IN_FLIGHT;
+    GLbitfield MapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &Queue->IndirectBuffer);
+    glNamedBufferStorage(Queue->IndirectBuffer, Size, 0, MapFlags);
+    Queue->IndirectCommands = (DRAW_ELEMENTS_INDIRECT_COMMAND *) glMapNamedBufferRange(Queue->IndirectBuffer, 0, Size, MapFlags);
+    Assert(Queue->IndirectCommands, "Renderer: Failed to map indirect command buffer!");
+}
+
+// BaseInstance offsets every attribute with a divisor, so instance data can live in any region of its buffer
+void RenderQueuePushInstanced(RENDER_QUEUE *Queue, u64 SortKey, GLuint Program, GLuint Texture, GLuint Lightmap, GLuint VertexArray, u32 IndexCount, u32 FirstIndex,
+                              i32 BaseVertex, u32 InstanceCount, u32 BaseInstance)
+{
+    Assert(Queue->PacketCount < RENDER_QUEUE_MAX_PACKETS, "Renderer: Render queue is full!");
+
+    RENDER_PACKET *Packet   = &Queue->Packets[Queue->PacketCount++];
+    Packet->SortKey         = SortKey;
+    Packet->Program         = Program;
+    Packet->Texture         = Texture;
+    Packet->Lightmap        = Lightmap;
+    Packet->VertexArray     = VertexArray;
+    Packet->IndexCount      = IndexCount;
+    Packet->FirstIndex      = FirstIndex;
+    Packet->BaseVertex      = BaseVertex;
+    Packet->InstanceCount   = InstanceCount;
+    Packet->BaseInstance    = BaseInstance;
+}
+
+void RenderQueuePush(RENDER_QUEUE *Queue, u64 SortKey, GLuint Program, GLuint Texture, GLuint Lightmap, GLuint VertexArray, u32 IndexCount, u32 FirstIndex, i32 BaseVertex)
+{
+    RenderQueuePushInstanced(Queue, SortKey, Program, Texture, Lightmap, VertexArray, IndexCount, FirstIndex, BaseVertex, 1, 0);
+}
+
+// Region of the per-frame mapped buffers this frame writes - waits if the GPU is still reading it from three frames ago
+u32 RenderQueueAcquireRegion(RENDER_QUEUE *Queue)
+{
+    u32 Region = Queue->Frame % RENDER_QUEUE_FRAMES_IN_FLIGHT;
+    if(Queue->Fences[Region])
+    {
+        glClientWaitSync(Queue->Fences[Region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(Queue->Fences[Region]);
+        Queue->Fences[Region] = 0;
+    }
+    return Region;
+}
+
+// LSD radix sort on 8 bit digits, skipping digits every key shares. Result ends up in Queue->SortEntries
+void RenderQueueSort(RENDER_QUEUE *Queue)
+{
+    PROFILE_SCOPE("RenderQueueSort");
+    u32 Count = Queue->PacketCount;
+
+    // Sized to this frame's packets rather than the queue's capacity
+    VIRTUAL_ARENA *Frame    = MemoryFrame();
+    Queue->SortEntries      = (RENDER_SORT_ENTRY *) VirtualArenaAlloc(Frame, sizeof(RENDER_SORT_ENTRY) * Count, alignof(RENDER_SORT_ENTRY));
+    Queue->SortScratch      = (RENDER_SORT_ENTRY *) VirtualArenaAlloc(Frame, sizeof(RENDER_SORT_ENTRY) * Count, alignof(RENDER_SORT_ENTRY));
+    Assert(Queue->SortEntries && Queue->SortScratch, "Renderer: Frame arena is full!");
+
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Queue->SortEntries[i].Key   = Queue->Packets[i].SortKey;
+        Queue->SortEntries[i].Index = i;
+    }
+
+    for(u32 Shift = 0; Shift < 64; Shift += 8)
+    {
+        u32 Histogram[256] = {};
+        for(u32 i = 0; i < Count; ++i)
+        {
+            ++Histogram[(Queue->SortEntries[i].Key >> Shift) & 0xFF];
+        }
+
+        // Every key has the same digit - nothing to reorder
+        if(Count == 0 || Histogram[(Queue->SortEntries[0].Key >> Shift) & 0xFF] == Count)
+        {
+            continue;
+        }
+
+        u32 Offset = 0;
+        for(u32 i = 0; i < 256; ++i)
+        {
+            u32 Bucket = Histogram[i];
+            Histogram[i] = Offset;
+            Offset += Bucket;
+        }
+
+        for(u32 i = 0; i < Count; ++i)
+        {
+            RENDER_SORT_ENTRY Entry = Queue->SortEntries[i];
+            Queue->SortScratch[Histogram[(Entry.Key >> Shift) & 0xFF]++] = Entry;
+        }
+
+        RENDER_SORT_ENTRY *Swap = Queue->SortEntries;
+        Queue->SortEntries = Queue->SortScratch;
+        Queue->SortScratch = Swap;
+    }
+}
+
+// Raster state per pass, applied through the state cache whenever the sorted packets move to the next pass. Opaque
+// passes go front to back against the depth buffer, so anything hidden is rejected before shading. Translucent surfaces
+// are still hidden behind them but don't write depth, so they blend over each other instead. Everything is two sided,
+// like the software renderer
+typedef struct RENDER_PASS_STATE
+{
+    GLenum DepthFunc;
+    bool DepthWrite;
+    GLenum BlendSource;
+    GLenum BlendDest;
+    GLenum CullFace;
+} RENDER_PASS_STATE;
+
+static const RENDER_PASS_STATE RenderPassStates[RENDER_PASS_COUNT] =
+{
+    {GL_LESS, true, GL_NONE, GL_NONE, GL_NONE},
+    {GL_LESS, true, GL_NONE, GL_NONE, GL_NONE},
+    {GL_LESS, false, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_NONE},
+};
+
+void RenderPassSetState(u32 Pass)
+{
+    Assert(Pass < RENDER_PASS_COUNT, "Renderer: Sort key has no valid pass!");
+    const RENDER_PASS_STATE *State = &RenderPassStates[Pass];
+    GLStateSetDepth(State->DepthFunc, State->DepthWrite);
+    GLStateSetBlend(State->BlendSource, State->BlendDest);
+    GLStateSetCull(State->CullFace);
+}
+
+// Sorts the frame's packets and submits runs that share program/texture/vertex array as one multi-draw. State goes
+// through the GL state cache, so a run whose state matches the last frame's end costs no binds at all
+void RenderQueueSubmit(RENDER_QUEUE *Queue)
+{
+    PROFILE_SCOPE("RenderQueueSubmit");
+    PROFILE_GPU_SCOPE("GPU Draw");
+
+    RENDER_STATS Stats = {};
+    Stats.Packets = Queue->PacketCount;
+
+    // Region was used three frames ago - only waits if the GPU is that far behind
+    u32 Region = RenderQueueAcquireRegion(Queue);
+
+    RenderQueueSort(Queue);
+
+    u32 RegionBase = Region * RENDER_QUEUE_MAX_PACKETS;
+    DRAW_ELEMENTS_INDIRECT_COMMAND *Commands = Queue->IndirectCommands + RegionBase;
+    GLStateBindBuffer(GL_DRAW_INDIRECT_BUFFER, Queue->IndirectBuffer);
+
+    u32 CurrentPass             = RENDER_PASS_COUNT;
+    GLuint CurrentProgram       = 0;
+    GLuint CurrentTexture       = 0;
+    GLuint CurrentLightmap      = 0;
+    GLuint CurrentVertexArray   = 0;
+    u32 RunStart = 0;
+
+    for(u32 i = 0; i <= Queue->PacketCount; ++i)
+    {
+        RENDER_PACKET *Packet = (i < Queue->PacketCount) ? &Queue->Packets[Queue->SortEntries[i].Index] : 0;
+        u32 Pass = Packet ? (u32) (Packet->SortKey >> 60) : RENDER_PASS_COUNT;
+        bool StateChanged = !Packet || Pass != CurrentPass || Packet->Program != CurrentProgram || Packet->Texture != CurrentTexture ||
+                            Packet->Lightmap != CurrentLightmap || Packet->VertexArray != CurrentVertexArray;
+
+        // Flush the previous run
+        if(StateChanged && i > RunStart)
+        {
+            GLStateFlush();
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) (sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND) * (RegionBase + RunStart)), i - RunStart, 0);
+            GLStateCount(GL_CALL_DRAW);
+            ++Stats.DrawCalls;
+            RunStart = i;
+        }
+
+        if(!Packet)
+        {
+            break;
+        }
+
+        if(Pass != CurrentPass)
+        {
+            RenderPassSetState(Pass);
+            CurrentPass = Pass;
+        }
+        if(Packet->Program != CurrentProgram)
+        {
+            GLStateUseProgram(Packet->Program);
+            CurrentProgram = Packet->Program;
+            ++Stats.ProgramChanges;
+        }
+        if(Packet->Texture != CurrentTexture)
+        {
+            GLStateBindTexture(TEXTURE_UNIT_ALBEDO, Packet->Texture);
+            CurrentTexture = Packet->Texture;
+            ++Stats.TextureChanges;
+        }
+        if(Packet->Lightmap != CurrentLightmap)
+        {
+            GLStateBindTexture(TEXTURE_UNIT_LIGHTMAP, Packet->Lightmap);
+            CurrentLightmap = Packet->Lightmap;
+            ++Stats.TextureChanges;
+        }
+        if(Packet->VertexArray != CurrentVertexArray)
+        {
+            GLStateBindVertexArray(Packet->VertexArray);
+            CurrentVertexArray = Packet->VertexArray;
+            ++Stats.VertexArrayChanges;
+        }
+
+        DRAW_ELEMENTS_INDIRECT_COMMAND *Command = &Commands[i];
+        Command->Count          = Packet->IndexCount;
+        Command->InstanceCount  = Packet->InstanceCount;
+        Command->FirstIndex     = Packet->FirstIndex;
+        Command->BaseVertex     = Packet->BaseVertex;
+        Command->BaseInstance   = Packet->BaseInstance;
+    }
+
+    if(Stats.DrawCalls > 0)
+    {
+        Queue->Fences[Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    ++Queue->Frame;
+    Queue->PacketCount  = 0;
+    Queue->Stats        = Stats;
+}
+
+void FreeListInit(FREE_LIST *List, MEMORY_ARENA *Arena, u32 Capacity, u32 MaxBlocks)
+{
+    List->Blocks = (FREE_LIST_BLOCK *) Arena->Alloc(sizeof(FREE_LIST_BLOCK) * MaxBlocks, alignof(FREE_LIST_BLOCK));
+    Assert(List->Blocks, "Renderer: Failed to allocate free list!");
+    List->MaxBlocks     = MaxBlocks;
+    List->Capacity      = Capacity;
+    List->Used          = 0;
+    List->BlockCount    = 1;
+    List->Blocks[0].Offset  = 0;
+    List->Blocks[0].Count   = Capacity;
+}
+
+bool FreeListAlloc(FREE_LIST *List, u32 Count, u32 *Offset)
+{
+    for(u32 i = 0; i < List->BlockCount; ++i)
+    {
+        FREE_LIST_BLOCK *Block = &List->Blocks[i];
+        if(Block->Count >= Count)
+        {
+            *Offset = Block->Offset;
+            Block->Offset   += Count;
+            Block->Count    -= Count;
+
+            // Remove exhausted blocks
+            if(Block->Count == 0)
+            {
+                memmove(Block, Block + 1, sizeof(FREE_LIST_BLOCK) * (List->BlockCount - i - 1));
+                --List->BlockCount;
+            }
+
+            List->Used += Count;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FreeListFree(FREE_LIST *List, u32 Offset, u32 Count)
+{
+    // Find insertion point
+    u32 Index = 0;
+    while(Index < List->BlockCount && List->Blocks[Index].Offset < Offset)
+    {
+        ++Index;
+    }
+
+    bool MergePrevious  = (Index > 0 && (List->Blocks[Index - 1].Offset + List->Blocks[Index - 1].Count) == Offset);
+    bool MergeNext      = (Index < List->BlockCount && (Offset + Count) == List->Blocks[Index].Offset);
+
+    if(MergePrevious && MergeNext)
+    {
+        List->Blocks[Index - 1].Count += Count + List->Blocks[Index].Count;
+        memmove(&List->Blocks[Index], &List->Blocks[Index + 1], sizeof(FREE_LIST_BLOCK) * (List->BlockCount - Index - 1));
+        --List->BlockCount;
+    }
+    else if(MergePrevious)
+    {
+        List->Blocks[Index - 1].Count += Count;
+    }
+    else if(MergeNext)
+    {
+        List->Blocks[Index].Offset  = Offset;
+        List->Blocks[Index].Count   += Count;
+    }
+    else
+    {
+        Assert(List->BlockCount < List->MaxBlocks, "Renderer: Free list is too fragmented!");
+        memmove(&List->Blocks[Index + 1], &List->Blocks[Index], sizeof(FREE_LIST_BLOCK) * (List->BlockCount - Index));
+        List->Blocks[Index].Offset  = Offset;
+        List->Blocks[Index].Count   = Count;
+        ++List->BlockCount;
+    }
+
+    List->Used -= Count;
+}
+
+u16 PackHalf(f32 Value)
+{
+    u32 Bits = 0;
+    memcpy(&Bits, &Value, sizeof(Bits));
+
+    u32 Sign        = (Bits >> 16) & 0x8000;
+    i32 Exponent    = (i32) ((Bits >> 23) & 0xFF) - 127 + 15;
+    u32 Mantissa    = Bits & 0x7FFFFF;
+
+    // Flush denormals to zero and clamp to infinity - UVs never get near either
+    if(Exponent <= 0)
+    {
+        return (u16) Sign;
+    }
+    if(Exponent >= 31)
+    {
+        return (u16) (Sign | 0x7C00);
+    }
+
+    // Round to nearest - a carry out of the mantissa correctly bumps the exponent
+    return (u16) (Sign | (((u32) Exponent << 10) + ((Mantissa + 0x1000) >> 13)));
+}
+
+f32 UnpackHalf(u16 Value)
+{
+    u32 Sign        = (u32) (Value & 0x8000) << 16;
+    u32 Exponent    = (Value >> 10) & 0x1F;
+    u32 Mantissa    = Value & 0x3FF;
+
+    // Denormals were flushed on pack
+    u32 Bits = Sign;
+    if(Exponent == 31)
+    {
+        Bits |= 0x7F800000 | (Mantissa << 13);
+    }
+    else if(Exponent != 0)
+    {
+        Bits |= ((Exponent - 15 + 127) << 23) | (Mantissa << 13);
+    }
+
+    f32 Result = 0;
+    memcpy(&Result, &Bits, sizeof(Result));
+    return Result;
+}
+
+i16 PackSnorm16(f32 Value)
+{
+    Value = (Value < -1.0f) ? -1.0f : ((Value > 1.0f) ? 1.0f : Value);
+    return (i16) lrintf(Value * 32767.0f);
+}
+
+u16 PackUnorm16(f32 Value)
+{
+    Value = (Value < 0.0f) ? 0.0f : ((Value > 1.0f) ? 1.0f : Value);
+    return (u16) lrintf(Value * 65535.0f);
+}
+
+u32 PackSnorm1010102(f32 X, f32 Y, f32 Z)
+{
+    f32 Components[] = {X, Y, Z};
+    u32 Result = 0;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        f32 Value = Components[i];
+        Value = (Value < -1.0f) ? -1.0f : ((Value > 1.0f) ? 1.0f : Value);
+        Result |= ((u32) lrintf(Value * 511.0f) & 0x3FF) << (i * 10);
+    }
+    return Result;
+}
+
+VERTEX_PACKED PackVertex(MESH_POOL *Pool, V3 Position, V3 Normal, V2 UV, V2 LightmapUV)
+{
+    VERTEX_PACKED Result = {};
+    f32 InverseScale = 1.0f / Pool->PositionScale;
+    Result.Position[0]      = PackSnorm16(Position.X * InverseScale);
+    Result.Position[1]      = PackSnorm16(Position.Y * InverseScale);
+    Result.Position[2]      = PackSnorm16(Position.Z * InverseScale);
+    Result.Normal           = PackSnorm1010102(Normal.X, Normal.Y, Normal.Z);
+    Result.UV[0]            = PackHalf(UV.X);
+    Result.UV[1]            = PackHalf(UV.Y);
+    Result.LightmapUV[0]    = PackUnorm16(LightmapUV.X);
+    Result.LightmapUV[1]    = PackUnorm16(LightmapUV.Y);
+    return Result;
+}
+
+void MeshPoolCreate(MESH_POOL *Pool, MEMORY_ARENA *Arena, u32 MaxVertices, u32 MaxIndices, f32 PositionScale)
+{
+    Pool->PositionScale = PositionScale;
+    FreeListInit(&Pool->Vertices, Arena, MaxVertices, MESH_POOL_MAX_FREE_BLOCKS);
+    FreeListInit(&Pool->Indices, Arena, MaxIndices, MESH_POOL_MAX_FREE_BLOCKS);
+
+    // Immutable storage - sub-ranges are filled with glBufferSubData
+    glCreateBuffers(1, &Pool->VertexBuffer);
+    glCreateBuffers(1, &Pool->IndexBuffer);
+    glNamedBufferStorage(Pool->VertexBuffer, sizeof(VERTEX_PACKED) * MaxVertices, 0, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(Pool->IndexBuffer, sizeof(u32) * MaxIndices, 0, GL_DYNAMIC_STORAGE_BIT);
+
+    // Vertex format layer - separate from the buffer binding so every mesh shares one vertex array
+    // 0 - Position (quantized), 1 - Normal, 2 - UV, 3 - Lightmap UV
+    glCreateVertexArrays(1, &Pool->VertexArray);
+    glVertexArrayVertexBuffer(Pool->VertexArray, 0, Pool->VertexBuffer, 0, sizeof(VERTEX_PACKED));
+    glVertexArrayElementBuffer(Pool->VertexArray, Pool->IndexBuffer);
+
+    glVertexArrayAttribFormat(Pool->VertexArray, 0, 3, GL_SHORT, GL_TRUE, offsetof(VERTEX_PACKED, Position));
+    glVertexArrayAttribFormat(Pool->VertexArray, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(VERTEX_PACKED, Normal));
+    glVertexArrayAttribFormat(Pool->VertexArray, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(VERTEX_PACKED, UV));
+    glVertexArrayAttribFormat(Pool->VertexArray, 3, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(VERTEX_PACKED, LightmapUV));
+    for(u32 i = 0; i < 4; ++i)
+    {
+        glVertexArrayAttribBinding(Pool->VertexArray, i, 0);
+        glEnableVertexArrayAttrib(Pool->VertexArray, i);
+    }
+}
+
+// Keeps a CPU copy of everything uploaded from now on (software rendering, collision etc.)
+void MeshPoolCreateCpuCopy(MESH_POOL *Pool, MEMORY_ARENA *Arena)
+{
+    Pool->CpuVertices   = (VERTEX_PACKED *) Arena->Alloc(sizeof(VERTEX_PACKED) * Pool->Vertices.Capacity, 64);
+    Pool->CpuIndices    = (u32 *) Arena->Alloc(sizeof(u32) * Pool->Indices.Capacity, 64);
+    Assert(Pool->CpuVertices && Pool->CpuIndices, "Renderer: Failed to allocate mesh pool CPU copy!");
+}
+
+bool MeshPoolAlloc(MESH_POOL *Pool, u32 VertexCount, u32 IndexCount, MESH *Mesh)
+{
+    MESH Result = {};
+    Result.VertexCount  = VertexCount;
+    Result.IndexCount   = IndexCount;
+    if(!FreeListAlloc(&Pool->Vertices, VertexCount, &Result.BaseVertex))
+    {
+        return false;
+    }
+    if(!FreeListAlloc(&Pool->Indices, IndexCount, &Result.FirstIndex))
+    {
+        FreeListFree(&Pool->Vertices, Result.BaseVertex, VertexCount);
+        return false;
+    }
+
+    *Mesh = Result;
+    return true;
+}
+
+void MeshPoolUpload(MESH_POOL *Pool, MESH *Mesh, VERTEX_PACKED *Vertices, u32 *Indices)
+{
+    PROFILE_SCOPE("MeshPoolUpload");
+
+    // Indices are relative to the mesh - base vertex is applied at draw time
+    glNamedBufferSubData(Pool->VertexBuffer, sizeof(VERTEX_PACKED) * Mesh->BaseVertex, sizeof(VERTEX_PACKED) * Mesh->VertexCount, Vertices);
+    glNamedBufferSubData(Pool->IndexBuffer, sizeof(u32) * Mesh->FirstIndex, sizeof(u32) * Mesh->IndexCount, Indices);
+    Pool->BytesUploaded += sizeof(VERTEX_PACKED) * Mesh->VertexCount + sizeof(u32) * Mesh->IndexCount;
+
+    if(Pool->CpuVertices)
+    {
+        memcpy(Pool->CpuVertices + Mesh->BaseVertex, Vertices, sizeof(VERTEX_PACKED) * Mesh->VertexCount);
+        memcpy(Pool->CpuIndices + Mesh->FirstIndex, Indices, sizeof(u32) * Mesh->IndexCount);
+    }
+}
+
+void MeshPoolFree(MESH_POOL *Pool, MESH *Mesh)
+{
+    FreeListFree(&Pool->Vertices, Mesh->BaseVertex, Mesh->VertexCount);
+    FreeListFree(&Pool->Indices, Mesh->FirstIndex, Mesh->IndexCount);
+    *Mesh = {};
+}
+
+void RenderQueuePushMesh(RENDER_QUEUE *Queue, u64 SortKey, GLuint Program, GLuint Texture, GLuint Lightmap, MESH_POOL *Pool, MESH *Mesh)
+{
+    RenderQueuePush(Queue, SortKey, Program, Texture, Lightmap, Pool->VertexArray, Mesh->IndexCount, Mesh->FirstIndex, (i32) Mesh->BaseVertex);
+}
+
+// Right handed look-at with a GL (-1..1 depth) perspective projection, column major
+void RendererSetCamera(RENDERER *RenderInfo, V3 Position, V3 Target, f32 FieldOfView, f32 Near, f32 Far)
+{
+    // Camera basis - forward, right, up
+    f32 F[3] = {Target.X - Position.X, Target.Y - Position.Y, Target.Z - Position.Z};
+    f32 Length = sqrtf(F[0] * F[0] + F[1] * F[1] + F[2] * F[2]);
+    Length = (Length > 0.0f) ? Length : 1.0f;
+    F[0] /= Length; F[1] /= Length; F[2] /= Length;
+
+    // World up is +Y, switching to +Z when looking straight up or down
+    f32 Up[3] = {0.0f, 1.0f, 0.0f};
+    if(fabsf(F[1]) > 0.999f)
+    {
+        Up[1] = 0.0f;
+        Up[2] = 1.0f;
+    }
+    f32 R[3] = {F[1] * Up[2] - F[2] * Up[1], F[2] * Up[0] - F[0] * Up[2], F[0] * Up[1] - F[1] * Up[0]};
+    Length = sqrtf(R[0] * R[0] + R[1] * R[1] + R[2] * R[2]);
+    R[0] /= Length; R[1] /= Length; R[2] /= Length;
+    f32 U[3] = {R[1] * F[2] - R[2] * F[1], R[2] * F[0] - R[0] * F[2], R[0] * F[1] - R[1] * F[0]};
+
+    f32 Aspect  = (f32) RenderInfo->RenderDimensions.X / (f32) RenderInfo->RenderDimensions.Y;
+    f32 Y       = 1.0f / tanf(FieldOfView * 0.5f);
+    f32 X       = Y / Aspect;
+    f32 A       = (Far + Near) / (Near - Far);
+    f32 B       = (2.0f * Far * Near) / (Near - Far);
+    f32 TX      = -(R[0] * Position.X + R[1] * Position.Y + R[2] * Position.Z);
+    f32 TY      = -(U[0] * Position.X + U[1] * Position.Y + U[2] * Position.Z);
+    f32 TZ      = (F[0] * Position.X + F[1] * Position.Y + F[2] * Position.Z);
+
+    // Projection * view, written out directly
+    f32 Matrix[16] =
+    {
+        X * R[0],   Y * U[0],   -A * F[0],  F[0],
+        X * R[1],   Y * U[1],   -A * F[1],  F[1],
+        X * R[2],   Y * U[2],   -A * F[2],  F[2],
+        X * TX,     Y * TY,     A * TZ + B, -TZ,
+    };
+
+    // A still camera re-uploads nothing (the matrix fixes the right and up axes too)
+    u32 UniformCount = SHADER_PERMUTATION_COUNT + 3;
+    GlobalGLState.Frame.Requested[GL_CALL_UNIFORM] += UniformCount;
+    if(memcmp(Matrix, RenderInfo->ViewProjection, sizeof(Matrix)) == 0)
+    {
+        return;
+    }
+    memcpy(RenderInfo->ViewProjection, Matrix, sizeof(Matrix));
+    GlobalGLState.Frame.Issued[GL_CALL_UNIFORM] += UniformCount;
+
+    for(u32 i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+    {
+        glProgramUniformMatrix4fv(RenderInfo->ShaderPrograms[i], RenderInfo->ViewProjectionLocations[i], 1, GL_FALSE, Matrix);
+    }
+
+    // Sprites are expanded along the camera's right and up axes
+    glProgramUniformMatrix4fv(RenderInfo->ParticleProgram, RenderInfo->ParticleViewProjectionLocation, 1, GL_FALSE, Matrix);
+    glProgramUniform3f(RenderInfo->ParticleProgram, RenderInfo->ParticleCameraRightLocation, R[0], R[1], R[2]);
+    glProgramUniform3f(RenderInfo->ParticleProgram, RenderInfo->ParticleCameraUpLocation, U[0], U[1], U[2]);
+}
+
+void RenderTargetCreate(RENDER_TARGET *Target, V2U Dimensions)
+{
+    glCreateRenderbuffers(1, &Target->ColourBuffer);
+    glCreateRenderbuffers(1, &Target->DepthBuffer);
+    glNamedRenderbufferStorage(Target->ColourBuffer, GL_RGBA8, Dimensions.X, Dimensions.Y);
+    glNamedRenderbufferStorage(Target->DepthBuffer, GL_DEPTH24_STENCIL8, Dimensions.X, Dimensions.Y);
+
+    glCreateFramebuffers(1, &Target->Framebuffer);
+    glNamedFramebufferRenderbuffer(Target->Framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, Target->ColourBuffer);
+    glNamedFramebufferRenderbuffer(Target->Framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, Target->DepthBuffer);
+    Assert(glCheckNamedFramebufferStatus(Target->Framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "Renderer: Internal framebuffer is incomplete!");
+    Target->Dimensions = Dimensions;
+}
+
+// Dynamic resolution is off until enabled - benchmarks want a fixed pixel count
+void RendererSetDynamicResolution(RENDERER *RenderInfo, bool Enabled)
+{
+    RenderInfo->Resolution.Dynamic = Enabled;
+    if(!Enabled)
+    {
+        RenderInfo->Resolution.Scale    = 1.0f;
+        RenderInfo->Target.Dimensions   = RenderInfo->RenderDimensions;
+    }
+}
+
+// Everything up to RendererEndFrame draws into the internal target
+void RendererBeginFrame(RENDERER *RenderInfo)
+{
+    RENDER_RESOLUTION *Resolution = &RenderInfo->Resolution;
+    glQueryCounter(Resolution->Queries[(Resolution->Frame % RENDER_TIMER_FRAMES) * 2], GL_TIMESTAMP);
+
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, RenderInfo->Target.Framebuffer);
+    GLStateSetViewport(0, 0, RenderInfo->Target.Dimensions.X, RenderInfo->Target.Dimensions.Y);
+    GLStateSetClearColour(0.2f, 0.3f, 0.3f, 1.0f);
+
+    // Clears go through the depth mask - a frame that ended without depth writes would otherwise keep its depth
+    GLStateSetDepth(GL_LESS, true);
+    GLStateFlush();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLStateCount(GL_CALL_DRAW);
+}
+
+// Nearest neighbour upscale into Framebuffer (0 for the window), letterboxed to keep the internal aspect ratio.
+// Ends the frame's GL call counts too
+void RendererEndFrame(RENDERER *RenderInfo, GLuint Framebuffer, u32 Width, u32 Height)
+{
+    V2U Internal = RenderInfo->RenderDimensions;
+    u32 DestWidth   = Width;
+    u32 DestHeight  = Height;
+    if((u64) Width * Internal.Y > (u64) Height * Internal.X)
+    {
+        DestWidth = (u32) (((u64) Height * Internal.X) / Internal.Y);
+    }
+    else
+    {
+        DestHeight = (u32) (((u64) Width * Internal.Y) / Internal.X);
+    }
+    u32 X = (Width - DestWidth) / 2;
+    u32 Y = (Height - DestHeight) / 2;
+
+    // Named clear and blit - neither needs the destination bound
+    if(DestWidth != Width || DestHeight != Height)
+    {
+        GLfloat Black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        glClearNamedFramebufferfv(Framebuffer, GL_COLOR, 0, Black);
+        GLStateCount(GL_CALL_DRAW);
+    }
+    glBlitNamedFramebuffer(RenderInfo->Target.Framebuffer, Framebuffer, 0, 0, RenderInfo->Target.Dimensions.X, RenderInfo->Target.Dimensions.Y,
+                           X, Y, X + DestWidth, Y + DestHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GLStateCount(GL_CALL_DRAW);
+
+    RENDER_RESOLUTION *Resolution = &RenderInfo->Resolution;
+    glQueryCounter(Resolution->Queries[(Resolution->Frame % RENDER_TIMER_FRAMES) * 2 + 1], GL_TIMESTAMP);
+
+    RenderInfo->GLCalls = GLStateFrameEnd();
+}
+
+// Call once per frame after RendererEndFrame. Reads the GPU time from RENDER_TIMER_FRAMES ago and resizes the
+// internal target to keep it inside BudgetSeconds - fill cost follows pixel count, so each axis scales by the root
+void RendererUpdateResolution(RENDERER *RenderInfo, f64 BudgetSeconds)
+{
+    RENDER_RESOLUTION *Resolution = &RenderInfo->Resolution;
+    u64 Frame = Resolution->Frame++;
+    if(Frame + 1 < RENDER_TIMER_FRAMES)
+    {
+        return;
+    }
+
+    // Timings still in flight were rendered before the last change
+    if(Resolution->Cooldown > 0)
+    {
+        --Resolution->Cooldown;
+        return;
+    }
+
+    // Never wait on the GPU - a result that isn't ready is skipped
+    u32 Slot = (u32) ((Frame + 1) % RENDER_TIMER_FRAMES);
+    GLuint Available = 0;
+    glGetQueryObjectuiv(Resolution->Queries[Slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &Available);
+    if(!Available)
+    {
+        return;
+    }
+    GLuint64 Begin = 0, End = 0;
+    glGetQueryObjectui64v(Resolution->Queries[Slot * 2], GL_QUERY_RESULT, &Begin);
+    glGetQueryObjectui64v(Resolution->Queries[Slot * 2 + 1], GL_QUERY_RESULT, &End);
+    f64 Seconds = (End > Begin) ? (f64) (End - Begin) / 1000000000.0 : 0.0;
+    Resolution->GpuSeconds = (Resolution->GpuSeconds > 0.0) ? Resolution->GpuSeconds * 0.8 + Seconds * 0.2 : Seconds;
+
+    if(!Resolution->Dynamic)
+    {
+        return;
+    }
+
+    // Drop straight to the estimated scale when over budget, climb back slowly after a run of cheap frames
+    f64 Budget = BudgetSeconds * RENDER_RESOLUTION_HEADROOM;
+    f32 Scale = Resolution->Scale;
+    if(Resolution->GpuSeconds > Budget)
+    {
+        Scale = Scale * (f32) sqrt(Budget / Resolution->GpuSeconds);
+        Resolution->UnderBudget = 0;
+    }
+    else if(Resolution->GpuSeconds < Budget * 0.7 && ++Resolution->UnderBudget >= RENDER_RESOLUTION_RAISE_FRAMES)
+    {
+        Scale = Scale * 1.1f;
+        Resolution->UnderBudget = 0;
+    }
+    Scale = (Scale < RENDER_RESOLUTION_MIN_SCALE) ? RENDER_RESOLUTION_MIN_SCALE : ((Scale > 1.0f) ? 1.0f : Scale);
+
+    // Even sizes only, and ignore changes too small to matter
+    V2U Dimensions = {{(u32) (RenderInfo->RenderDimensions.X * Scale) & ~1u, (u32) (RenderInfo->RenderDimensions.Y * Scale) & ~1u}};
+    Dimensions.X = (Dimensions.X < 2) ? 2 : Dimensions.X;
+    Dimensions.Y = (Dimensions.Y < 2) ? 2 : Dimensions.Y;
+    if(fabsf(Scale - Resolution->Scale) >= 0.02f && (Dimensions.X != RenderInfo->Target.Dimensions.X || Dimensions.Y != RenderInfo->Target.Dimensions.Y))
+    {
+        Resolution->Scale               = Scale;
+        Resolution->Cooldown            = RENDER_TIMER_FRAMES;
+        Resolution->GpuSeconds          = 0.0;
+        RenderInfo->Target.Dimensions   = Dimensions;
+        ++Resolution->Changes;
+    }
+}
+
+RENDERER InitialiseRenderer(MEMORY_ARENA *Arena, V2U Dimensions, const char *ShaderCacheDirectory)
 {
     RENDERER RenderInfo         = {};
     RenderInfo.RenderDimensions = Dimensions;
-    RenderInfo.ShaderProgram    = CreateShaderProgram(Arena);
+
+    // Nothing is known about the context's state yet
+    GLStateInvalidate();
+
+    // Program binaries need at least one driver format
+    GLint BinaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &BinaryFormats);
+    RenderInfo.ShaderCache.Directory    = ShaderCacheDirectory;
+    RenderInfo.ShaderCache.Enabled      = (ShaderCacheDirectory && BinaryFormats > 0);
+
+    // Load shader sources once - every permutation is built from the same text, which is dropped once they're linked
+    MEMORY_SCRATCH Scratch;
+    GLchar *VertexCode      = (GLchar *) AssetLoadText(Scratch.Arena, "data/shaders/vertex.glsl");
+    GLchar *FragmentCode    = (GLchar *) AssetLoadText(Scratch.Arena, "data/shaders/fragment.glsl");
+    Assert(VertexCode && FragmentCode, "Shader: Failed to load shader sources!");
+
+    for(u32 i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+    {
+        RenderInfo.ShaderPrograms[i] = CreateShaderProgram(&RenderInfo.ShaderCache, i, VertexCode, FragmentCode);
+    }
+    RenderInfo.ShaderProgram = RenderInfo.ShaderPrograms[0];
+    RenderInfo.ParticleProgram = CreateShaderProgram(&RenderInfo.ShaderCache, SHADER_PARTICLE, VertexCode, FragmentCode);
+
+    // Shared geometry (1M vertices, 4M indices, positions quantized over +-256 units - enough for a compiled level)
+    MeshPoolCreate(&RenderInfo.MeshPool, Arena, 1 << 20, 1 << 22, 256.0f);
+    RenderInfo.VertexArrayObject = RenderInfo.MeshPool.VertexArray;
+    for(u32 i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+    {
+        glProgramUniform1f(RenderInfo.ShaderPrograms[i], glGetUniformLocation(RenderInfo.ShaderPrograms[i], "PositionScale"), RenderInfo.MeshPool.PositionScale);
+        RenderInfo.ViewProjectionLocations[i] = glGetUniformLocation(RenderInfo.ShaderPrograms[i], "ViewProjection");
+    }
+    glProgramUniform1f(RenderInfo.ParticleProgram, glGetUniformLocation(RenderInfo.ParticleProgram, "PositionScale"), RenderInfo.MeshPool.PositionScale);
+    RenderInfo.ParticleViewProjectionLocation   = glGetUniformLocation(RenderInfo.ParticleProgram, "ViewProjection");
+    RenderInfo.ParticleCameraRightLocation      = glGetUniformLocation(RenderInfo.ParticleProgram, "CameraRight");
+    RenderInfo.ParticleCameraUpLocation         = glGetUniformLocation(RenderInfo.ParticleProgram, "CameraUp");
+
+    RenderQueueCreate(&RenderInfo.Queue, Arena);
+
+    // Scene is drawn at RenderDimensions whatever the window size, then upscaled
+    RenderTargetCreate(&RenderInfo.Target, Dimensions);
+    RenderInfo.Resolution.Scale = 1.0f;
+    glGenQueries(ArrayCount(RenderInfo.Resolution.Queries), RenderInfo.Resolution.Queries);
+
     return RenderInfo;
 }
 
-void ConstructTriangle(RENDERER *RenderInfo)
+MESH ConstructTriangle(RENDERER *RenderInfo)
 {
     // Set Normalized Device Coordinates
-    f32 Vertices[] = {
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-        0.0f, 0.5f, 0.0f
-    };  
-
-    // Vertex arrays are used to store collections of attributes and their associated VBOs
-    GLuint VertexArrayObject;
-    glGenVertexArrays(1, &VertexArrayObject);
-
-    // Vertex buffers are large buffers used to send vertex data in batches (as is optimised for GPU memory fetchs)
-    // After generating with a unique ID, bind to an array buffer
-    GLuint VertexBufferObject;
-    glGenBuffers(1, &VertexBufferObject);
-    
-    // Bind and generate data
-    glBindVertexArray(VertexArrayObject);
-    glBindBuffer(GL_ARRAY_BUFFER, VertexBufferObject);
+    V3 Positions[] = {
+        {{-0.5f, -0.5f, 0.0f}},
+        {{0.5f, -0.5f, 0.0f}},
+        {{0.0f, 0.5f, 0.0f}}
+    };
+    u32 Indices[] = {
+        0, 1, 2
+    };
 
-    // Copy the vertex data to the bound buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices), Vertices, GL_STATIC_DRAW); // GL_STATIC_DRAW - Vertex data will rarely change every draw    
+    V3 Normal = {{0.0f, 0.0f, 1.0f}};
+    V2 UV[] = {
+        {{0.0f, 0.0f}},
+        {{1.0f, 0.0f}},
+        {{0.5f, 1.0f}}
+    };
 
-    // Specify how vertext data is interpreted:
-    // 0 - matches location (0) attribute in vertex shader code
-    // 3 - Size of vertex (v3)
-    // GL_FLOAT, GL_FALSE - Float values without any normalisation
-    // 0 - Offset in memory for each vertex in the buffer
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (sizeof(f32) * 3), (void *) 0);
-    glEnableVertexAttribArray(0); // Assign to previous VertexBufferObject (0)
+    // Pack into the shared vertex format
+    VERTEX_PACKED Vertices[ArrayCount(Positions)];
+    for(u32 i = 0; i < ArrayCount(Positions); ++i)
+    {
+        Vertices[i] = PackVertex(&RenderInfo->MeshPool, Positions[i], Normal, UV[i], UV[i]);
+    }
 
-    // Unbind VertexArrayObject
-    glBindVertexArray(0);   
+    // Sub-allocate from the pool - no per-mesh vertex arrays or buffers
+    MESH Result = {};
+    bool Allocated = MeshPoolAlloc(&RenderInfo->MeshPool, ArrayCount(Vertices), ArrayCount(Indices), &Result);
+    Assert(Allocated, "Renderer: Mesh pool is full!");
+    MeshPoolUpload(&RenderInfo->MeshPool, &Result, Vertices, Indices);
 
-    // Store render state
-    RenderInfo->VertexArrayObject = VertexArrayObject;  
+    return Result;
 }
 
-void ConstructQuad(RENDERER *RenderInfo)
+MESH ConstructQuad(RENDERER *RenderInfo)
 {
     // Set Normalized Device Coordinates
     // Use indices to specifiy the unique vertices in a quad (overlap means the number expands from 4 to 6 otherwise)
-    float Vertices[] = {
-        0.5f, 0.5f, 0.0f, // Top right
-        0.5f, -0.5f, 0.0f, // Bottom right
-        -0.5f, -0.5f, 0.0f, // Bottom left
-        -0.5f, 0.5f, 0.0f  // Top left 
+    V3 Positions[] = {
+        {{0.5f, 0.5f, 0.0f}},   // Top right
+        {{0.5f, -0.5f, 0.0f}},  // Bottom right
+        {{-0.5f, -0.5f, 0.0f}}, // Bottom left
+        {{-0.5f, 0.5f, 0.0f}}   // Top left 
     };
-    GLuint Indices[] = {
+    u32 Indices[] = {
         0, 1, 3,            // first triangle
         1, 2, 3             // second triangle
     };
 
-    // Generate vertex array
-    GLuint VertexArrayObject;
-    glGenVertexArrays(1, &VertexArrayObject);
-
-    // Generate vertex buffers including element buffers
-    GLuint VertexBufferObject;
-    GLuint ElementBufferObject;
-    glGenBuffers(1, &VertexBufferObject);
-    glGenBuffers(1, &ElementBufferObject);
-    
-    // Bind and generate data
-    glBindVertexArray(VertexArrayObject);
-    glBindBuffer(GL_ARRAY_BUFFER, VertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices), Vertices, GL_STATIC_DRAW);
-
-    // Bind element buffer using constructed VertexBufferObject
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices), Indices, GL_STATIC_DRAW);
-
-    // Specify how vertext data is interpreted:
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (sizeof(f32) * 3), (void *) 0);
-    glEnableVertexAttribArray(0);
-
-    // Unbind VertexArrayObject
-    glBindVertexArray(0);   
-
-    // Store render state
-    RenderInfo->VertexArrayObject = VertexArrayObject;  
-}
\ No newline at end of file
+    V3 Normal = {{0.0f, 0.0f, 1.0f}};
+    V2 UV[] = {
+        {{1.0f, 1.0f}},
+        {{1.0f, 0.0f}},
+        {{0.0f, 0.0f}},
+        {{0.0f, 1.0f}}
+    };
+
+    // Pack into the shared vertex format
+    VERTEX_PACKED Vertices[ArrayCount(Positions)];
+    for(u32 i = 0; i < ArrayCount(Positions); ++i)
+    {
+        Vertices[i] = PackVertex(&RenderInfo->MeshPool, Positions[i], Normal, UV[i], UV[i]);
+    }
+
+    // Sub-allocate from the pool - no per-mesh vertex arrays or buffers
+    MESH Result = {};
+    bool Allocated = MeshPoolAlloc(&RenderInfo->MeshPool, ArrayCount(Vertices), ArrayCount(Indices), &Result);
+    Assert(Allocated, "Renderer: Mesh pool is full!");
+    MeshPoolUpload(&RenderInfo->MeshPool, &Result, Vertices, Indices);
+
+    return Result;
+}
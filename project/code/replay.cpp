@@ -0,0 +1,272 @@
+// Input capture and replay
+// A frame is driven by two things from outside - the platform's input events and the frame interval fed to the
+// scheduler. Recording writes both to a compact binary log; replaying reads them back in place of the real ones, so
+// ticks, interpolation and simulation come out the same frame for frame however long the replayed frames take. That
+// lets a slow sequence from a playtest run headless and uncapped on another machine. Each recorded frame carries a
+// checksum of the simulation state so a replay that drifts (different level, changed simulation code) is caught.
+//
+// Log layout: REPLAY_HEADER, then per frame a REPLAY_FRAME followed by its INPUT_EVENTs
+
+#define REPLAY_MAGIC                0x594C5052 // 'RPLY'
+#define REPLAY_VERSION              1
+#define INPUT_MAX_EVENTS            32          // Per frame - any more are dropped
+#define INPUT_MAX_NANOSECONDS       1000000000  // Longer intervals only drop ticks in the scheduler anyway
+#define REPLAY_UNCLOSED             0xFFFFFFFF  // Frame count played from a log that was never closed
+#define REPLAY_FLUSH_NANOSECONDS    1000000000  // Recorded time between flushes - a crash loses at most this much
+
+typedef enum INPUT_EVENT_TYPE
+{
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+} INPUT_EVENT_TYPE;
+
+// Keys are the upper case character for letters and digits, so both platforms' logs mean the same thing
+typedef struct INPUT_EVENT
+{
+    u16 Type;
+    u16 Key;
+} INPUT_EVENT;
+
+typedef struct INPUT_FRAME
+{
+    u32 Nanoseconds;                // Frame interval the scheduler advances by
+    u32 EventCount;
+    INPUT_EVENT Events[INPUT_MAX_EVENTS];
+} INPUT_FRAME;
+
+typedef struct REPLAY_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u32 TickHz;
+    u32 RenderHz;
+    u32 FrameCount;                 // Zero until the recording is closed
+    u32 EventCount;
+} REPLAY_HEADER;
+
+typedef struct REPLAY_FRAME
+{
+    u32 Nanoseconds;
+    u32 EventCount;
+    u32 Checksum;                   // Simulation state after the frame's ticks
+} REPLAY_FRAME;
+
+typedef enum REPLAY_MODE
+{
+    REPLAY_OFF,
+    REPLAY_RECORD,
+    REPLAY_PLAY,
+} REPLAY_MODE;
+
+typedef struct REPLAY
+{
+    u32             Mode;
+    FILE            *File;
+    REPLAY_HEADER   Header;
+
+    // Recording - frame time written since the log was last flushed
+    u64             Unflushed;
+
+    // Playback - the frame last read, checked against the simulation when it ends
+    REPLAY_FRAME    Expected;
+    u32             Frame;
+    u32             Divergences;
+    u32             FirstDivergence;
+    bool            Truncated;
+
+    // Optional per-frame timings, CSV
+    FILE            *Timings;
+} REPLAY;
+
+void InputSetInterval(INPUT_FRAME *Input, u64 Nanoseconds)
+{
+    Input->Nanoseconds = (Nanoseconds > INPUT_MAX_NANOSECONDS) ? INPUT_MAX_NANOSECONDS : (u32) Nanoseconds;
+}
+
+f64 InputSeconds(INPUT_FRAME *Input)
+{
+    return (f64) Input->Nanoseconds / 1000000000.0;
+}
+
+void InputPush(INPUT_FRAME *Input, u32 Type, u32 Key)
+{
+    if(Input->EventCount < INPUT_MAX_EVENTS)
+    {
+        INPUT_EVENT *Event  = &Input->Events[Input->EventCount++];
+        Event->Type         = (u16) Type;
+        Event->Key          = (u16) Key;
+    }
+}
+
+bool InputKeyReleased(INPUT_FRAME *Input, u32 Key)
+{
+    for(u32 i = 0; i < Input->EventCount; ++i)
+    {
+        if(Input->Events[i].Type == INPUT_KEY_UP && Input->Events[i].Key == Key)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Header is rewritten with the counts on close
+bool ReplayRecord(REPLAY *Replay, const char *Path, u32 TickHz, u32 RenderHz)
+{
+    *Replay = {};
+    Replay->File = fopen(Path, "wb");
+    if(!Replay->File)
+    {
+        printf("Replay: Failed to create %s\n", Path);
+        return false;
+    }
+
+    Replay->Mode            = REPLAY_RECORD;
+    Replay->Header.Magic    = REPLAY_MAGIC;
+    Replay->Header.Version  = REPLAY_VERSION;
+    Replay->Header.TickHz   = TickHz;
+    Replay->Header.RenderHz = RenderHz;
+    fwrite(&Replay->Header, sizeof(Replay->Header), 1, Replay->File);
+    return true;
+}
+
+// Frames are read one at a time as the replay runs, so a log of any length costs nothing up front
+bool ReplayOpen(REPLAY *Replay, const char *Path)
+{
+    *Replay = {};
+    Replay->File = fopen(Path, "rb");
+    if(!Replay->File)
+    {
+        printf("Replay: Failed to open %s\n", Path);
+        return false;
+    }
+
+    REPLAY_HEADER *Header = &Replay->Header;
+    if(fread(Header, sizeof(*Header), 1, Replay->File) != 1 || Header->Magic != REPLAY_MAGIC || Header->Version != REPLAY_VERSION ||
+       Header->TickHz == 0 || Header->RenderHz == 0)
+    {
+        printf("Replay: %s is not a version %u replay\n", Path, REPLAY_VERSION);
+        fclose(Replay->File);
+        *Replay = {};
+        return false;
+    }
+    if(Header->FrameCount == 0)
+    {
+        // The recording never closed - play whatever frames made it to disk
+        printf("Replay: %s was not closed, replaying the frames it has\n", Path);
+        Header->FrameCount = REPLAY_UNCLOSED;
+    }
+
+    Replay->Mode = REPLAY_PLAY;
+    return true;
+}
+
+// Columns match for recordings and replays, so either can be diffed against the other
+bool ReplayWriteTimings(REPLAY *Replay, const char *Path)
+{
+    Replay->Timings = fopen(Path, "w");
+    if(!Replay->Timings)
+    {
+        printf("Replay: Failed to create %s\n", Path);
+        return false;
+    }
+    fprintf(Replay->Timings, "frame,interval_ms,ticks,work_ms,wait_ms,checksum\n");
+    return true;
+}
+
+// Replaces the live frame with the recorded one when playing - false once the log runs out
+bool ReplayBeginFrame(REPLAY *Replay, INPUT_FRAME *Input)
+{
+    if(Replay->Mode != REPLAY_PLAY)
+    {
+        return true;
+    }
+    if(Replay->Frame >= Replay->Header.FrameCount)
+    {
+        return false;
+    }
+
+    REPLAY_FRAME *Frame = &Replay->Expected;
+    bool Read = fread(Frame, sizeof(*Frame), 1, Replay->File) == 1 && Frame->EventCount <= INPUT_MAX_EVENTS &&
+                fread(Input->Events, sizeof(INPUT_EVENT), Frame->EventCount, Replay->File) == Frame->EventCount;
+    if(!Read)
+    {
+        // Fine for an unclosed recording, which just ends where the writes stopped
+        Replay->Truncated = (Replay->Header.FrameCount != REPLAY_UNCLOSED);
+        return false;
+    }
+
+    Input->Nanoseconds  = Frame->Nanoseconds;
+    Input->EventCount   = Frame->EventCount;
+    return true;
+}
+
+void ReplayEndFrame(REPLAY *Replay, INPUT_FRAME *Input, u32 Checksum, u32 Ticks, f64 WorkSeconds, f64 WaitSeconds)
+{
+    if(Replay->Mode == REPLAY_RECORD)
+    {
+        REPLAY_FRAME Frame  = {};
+        Frame.Nanoseconds   = Input->Nanoseconds;
+        Frame.EventCount    = Input->EventCount;
+        Frame.Checksum      = Checksum;
+        fwrite(&Frame, sizeof(Frame), 1, Replay->File);
+        fwrite(Input->Events, sizeof(INPUT_EVENT), Input->EventCount, Replay->File);
+        ++Replay->Header.FrameCount;
+        Replay->Header.EventCount += Input->EventCount;
+
+        // The header only gets its counts on close, so this is what a crashed session's replay has to go on
+        Replay->Unflushed += Input->Nanoseconds;
+        if(Replay->Unflushed >= REPLAY_FLUSH_NANOSECONDS)
+        {
+            fflush(Replay->File);
+            Replay->Unflushed = 0;
+        }
+    }
+    else if(Replay->Mode == REPLAY_PLAY && Checksum != Replay->Expected.Checksum)
+    {
+        if(Replay->Divergences++ == 0)
+        {
+            Replay->FirstDivergence = Replay->Frame;
+        }
+    }
+
+    if(Replay->Timings)
+    {
+        fprintf(Replay->Timings, "%u,%.4f,%u,%.4f,%.4f,%08x\n", Replay->Frame, InputSeconds(Input) * 1000.0, Ticks, WorkSeconds * 1000.0,
+                WaitSeconds * 1000.0, Checksum);
+    }
+    ++Replay->Frame;
+}
+
+void ReplayClose(REPLAY *Replay)
+{
+    if(Replay->Mode == REPLAY_RECORD)
+    {
+        fseek(Replay->File, 0, SEEK_SET);
+        fwrite(&Replay->Header, sizeof(Replay->Header), 1, Replay->File);
+        printf("Replay: Recorded %u frames, %u input events (%.1fKB)\n", Replay->Header.FrameCount, Replay->Header.EventCount,
+                (f64) (sizeof(REPLAY_HEADER) + sizeof(REPLAY_FRAME) * Replay->Header.FrameCount + sizeof(INPUT_EVENT) * Replay->Header.EventCount) / (f64) Kilobytes(1));
+    }
+    else if(Replay->Mode == REPLAY_PLAY)
+    {
+        printf("Replay: Played %u frames%s, ", Replay->Frame, Replay->Truncated ? " (log is truncated)" : "");
+        if(Replay->Divergences)
+        {
+            printf("simulation diverged on %u frames from frame %u\n", Replay->Divergences, Replay->FirstDivergence);
+        }
+        else
+        {
+            printf("simulation matched the recording\n");
+        }
+    }
+
+    if(Replay->File)
+    {
+        fclose(Replay->File);
+    }
+    if(Replay->Timings)
+    {
+        fclose(Replay->Timings);
+    }
+    *Replay = {};
+}
@@ -0,0 +1,191 @@
+// Frame scheduling
+// Simulation runs at a fixed tick decoupled from the render rate - each frame advances an accumulator, runs whole ticks
+// and leaves the remainder as an interpolation factor between the previous and current simulation states.
+// The platform layer waits out the rest of each frame: a coarse sleep for the remaining time minus the measured wake-up
+// slack, then a short spin to the deadline. Pacing reads the recent work-time history and drops the render rate to the
+// next divisor of the base rate while frames keep missing it, climbing back once there is headroom.
+
+#define FRAME_HISTORY_COUNT         128
+#define FRAME_MAX_TICKS             8           // Ticks per frame before simulation time is dropped (spiral of death)
+#define FRAME_MAX_DIVISOR           4           // 120Hz -> 60 -> 40 -> 30
+#define FRAME_PACING_INTERVAL       32          // Frames between pacing decisions
+#define FRAME_SLACK_MIN             0.0002
+#define FRAME_SLACK_MAX             0.004
+
+typedef struct FRAME_STATS
+{
+    u64 Frames;
+    u64 MissedFrames;
+    u64 Ticks;
+    u64 DroppedTicks;
+    u32 RateChanges;
+
+    f64 WorkSeconds;
+    f64 SleepSeconds;
+    f64 SpinSeconds;
+    f64 OversleepMax;
+
+    // Jitter - deviation of the frame interval from the target at the time
+    f64 DeviationSum;
+    f64 DeviationSquaredSum;
+    f64 DeviationMax;
+} FRAME_STATS;
+
+typedef struct FRAME_SCHEDULER
+{
+    f64         TickSeconds;
+    f64         BaseSeconds;
+    f64         TargetSeconds;
+    u32         Divisor;
+
+    f64         Accumulator;
+    f64         SleepSlack;         // Expected oversleep past the requested wake-up
+
+    f32         WorkHistory[FRAME_HISTORY_COUNT];
+    u32         HistoryCount;
+    u32         HistoryIndex;
+
+    FRAME_STATS Stats;
+} FRAME_SCHEDULER;
+
+void FrameSchedulerCreate(FRAME_SCHEDULER *Scheduler, u32 TickHz, u32 RenderHz)
+{
+    *Scheduler = {};
+    Scheduler->TickSeconds      = 1.0 / (f64) TickHz;
+    Scheduler->BaseSeconds      = 1.0 / (f64) RenderHz;
+    Scheduler->TargetSeconds    = Scheduler->BaseSeconds;
+    Scheduler->Divisor          = 1;
+    Scheduler->SleepSlack       = 0.001;
+}
+
+// Feeds the last frame interval into the accumulator, returns how many simulation ticks to run
+u32 FrameSchedulerAdvance(FRAME_SCHEDULER *Scheduler, f64 FrameSeconds)
+{
+    if(Scheduler->Stats.Frames > 0)
+    {
+        f64 Deviation = fabs(FrameSeconds - Scheduler->TargetSeconds);
+        Scheduler->Stats.DeviationSum        += Deviation;
+        Scheduler->Stats.DeviationSquaredSum += Deviation * Deviation;
+        Scheduler->Stats.DeviationMax         = (Deviation > Scheduler->Stats.DeviationMax) ? Deviation : Scheduler->Stats.DeviationMax;
+    }
+
+    Scheduler->Accumulator += FrameSeconds;
+    u32 Ticks = (u32) (Scheduler->Accumulator / Scheduler->TickSeconds);
+    if(Ticks > FRAME_MAX_TICKS)
+    {
+        Scheduler->Stats.DroppedTicks += Ticks - FRAME_MAX_TICKS;
+        Ticks = FRAME_MAX_TICKS;
+        Scheduler->Accumulator = Ticks * Scheduler->TickSeconds;
+    }
+    Scheduler->Accumulator -= Ticks * Scheduler->TickSeconds;
+    Scheduler->Stats.Ticks += Ticks;
+    return Ticks;
+}
+
+// 0 = previous simulation state, 1 = current
+f32 FrameSchedulerAlpha(FRAME_SCHEDULER *Scheduler)
+{
+    return (f32) (Scheduler->Accumulator / Scheduler->TickSeconds);
+}
+
+// How long to sleep with Remaining seconds left in the frame - the rest is spun
+f64 FrameSchedulerSleepSeconds(FRAME_SCHEDULER *Scheduler, f64 Remaining)
+{
+    f64 Result = Remaining - Scheduler->SleepSlack;
+    return (Result > 0) ? Result : 0;
+}
+
+void FrameSchedulerRecordSleep(FRAME_SCHEDULER *Scheduler, f64 Requested, f64 Actual)
+{
+    // Slack jumps straight up to any late wake-up and decays slowly back down
+    f64 Oversleep = Actual - Requested;
+    Oversleep = (Oversleep > 0) ? Oversleep : 0;
+    if(Oversleep > Scheduler->SleepSlack)
+    {
+        Scheduler->SleepSlack = Oversleep;
+    }
+    else
+    {
+        Scheduler->SleepSlack = Scheduler->SleepSlack * 0.95 + Oversleep * 0.05;
+    }
+    Scheduler->SleepSlack = (Scheduler->SleepSlack < FRAME_SLACK_MIN) ? FRAME_SLACK_MIN : ((Scheduler->SleepSlack > FRAME_SLACK_MAX) ? FRAME_SLACK_MAX : Scheduler->SleepSlack);
+
+    Scheduler->Stats.SleepSeconds += Actual;
+    Scheduler->Stats.OversleepMax = (Oversleep > Scheduler->Stats.OversleepMax) ? Oversleep : Scheduler->Stats.OversleepMax;
+}
+
+int FrameSchedulerCompare(const void *A, const void *B)
+{
+    f32 X = *(const f32 *) A;
+    f32 Y = *(const f32 *) B;
+    return (X > Y) - (X < Y);
+}
+
+// WorkSeconds is the frame's CPU work before waiting, SpinSeconds the time spent spinning after the sleep
+void FrameSchedulerEndFrame(FRAME_SCHEDULER *Scheduler, f64 WorkSeconds, f64 SpinSeconds)
+{
+    FRAME_STATS *Stats = &Scheduler->Stats;
+    ++Stats->Frames;
+    Stats->WorkSeconds += WorkSeconds;
+    Stats->SpinSeconds += SpinSeconds;
+    if(WorkSeconds > Scheduler->TargetSeconds)
+    {
+        ++Stats->MissedFrames;
+    }
+
+    Scheduler->WorkHistory[Scheduler->HistoryIndex] = (f32) WorkSeconds;
+    Scheduler->HistoryIndex = (Scheduler->HistoryIndex + 1) % FRAME_HISTORY_COUNT;
+    Scheduler->HistoryCount += (Scheduler->HistoryCount < FRAME_HISTORY_COUNT);
+    if(Scheduler->HistoryCount < FRAME_PACING_INTERVAL || (Stats->Frames % FRAME_PACING_INTERVAL) != 0)
+    {
+        return;
+    }
+
+    // Pace on the 95th percentile so a single hitch doesn't halve the frame rate
+    f32 Sorted[FRAME_HISTORY_COUNT];
+    memcpy(Sorted, Scheduler->WorkHistory, sizeof(f32) * Scheduler->HistoryCount);
+    qsort(Sorted, Scheduler->HistoryCount, sizeof(f32), FrameSchedulerCompare);
+    f64 Percentile = Sorted[(Scheduler->HistoryCount * 95) / 100];
+
+    u32 Divisor = Scheduler->Divisor;
+    if(Percentile > Scheduler->TargetSeconds * 0.95 && Divisor < FRAME_MAX_DIVISOR)
+    {
+        ++Divisor;
+    }
+    else if(Divisor > 1 && Percentile < Scheduler->BaseSeconds * (Divisor - 1) * 0.75)
+    {
+        --Divisor;
+    }
+
+    if(Divisor != Scheduler->Divisor)
+    {
+        Scheduler->Divisor          = Divisor;
+        Scheduler->TargetSeconds    = Scheduler->BaseSeconds * Divisor;
+        Scheduler->HistoryCount     = 0;
+        Scheduler->HistoryIndex     = 0;
+        ++Stats->RateChanges;
+    }
+}
+
+// CpuSeconds is process CPU time over the same WallSeconds - shows how much of a core waiting burns
+void FrameSchedulerPrintStats(FRAME_SCHEDULER *Scheduler, f64 WallSeconds, f64 CpuSeconds)
+{
+    FRAME_STATS *Stats = &Scheduler->Stats;
+    if(Stats->Frames < 2 || WallSeconds <= 0)
+    {
+        return;
+    }
+
+    f64 Intervals   = (f64) (Stats->Frames - 1);
+    f64 Mean        = Stats->DeviationSum / Intervals;
+    f64 Variance    = Stats->DeviationSquaredSum / Intervals - Mean * Mean;
+    printf("scheduler: %llu frames at %.1fHz (%u rate changes), %llu ticks (%llu dropped), %llu missed\n",
+            (unsigned long long) Stats->Frames, 1.0 / Scheduler->TargetSeconds, Stats->RateChanges,
+            (unsigned long long) Stats->Ticks, (unsigned long long) Stats->DroppedTicks, (unsigned long long) Stats->MissedFrames);
+    printf("scheduler: jitter avg %.3fms stddev %.3fms max %.3fms\toversleep max %.3fms (slack %.3fms)\n",
+            Mean * 1000.0, sqrt((Variance > 0) ? Variance : 0) * 1000.0, Stats->DeviationMax * 1000.0,
+            Stats->OversleepMax * 1000.0, Scheduler->SleepSlack * 1000.0);
+    printf("scheduler: CPU %.1f%% of a core\t[work %.1f%%, sleep %.1f%%, spin %.1f%% of wall time]\n",
+            100.0 * CpuSeconds / WallSeconds, 100.0 * Stats->WorkSeconds / WallSeconds,
+            100.0 * Stats->SleepSeconds / WallSeconds, 100.0 * Stats->SpinSeconds / WallSeconds);
+}
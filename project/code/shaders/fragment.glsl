@@ -0,0 +1,61 @@
+// Specify shader inputs
+in V4 VertexColour;
+out V4 FragmentColour;
+
+#ifdef LIGHTMAP
+in V2 LightmapUV;
+layout (binding = 2) uniform sampler2D Lightmap;
+#endif
+
+#ifdef PALETTE
+// Albedo holds 8-bit indices into the shared palette (see tools/texture_cooker.cpp) - indices can't be blended, so it's point sampled
+in V2 TextureUV;
+layout (binding = 0) uniform sampler2D Albedo;
+layout (binding = 1) uniform sampler2D Palette;
+#endif
+
+#ifdef PARTICLE
+in V2 SpriteUV;
+#endif
+
+#ifdef FOG
+uniform V4 FogColour = V4(0.2, 0.3, 0.3, 1.0);
+uniform V2 FogRange = V2(0.5, 1.0);
+#endif
+
+void main()
+{
+    // Output interpolated vertex colour
+    FragmentColour = VertexColour;
+
+#ifdef PALETTE
+    i32 Index = i32(texture(Albedo, TextureUV).r * 255.0 + 0.5);
+    FragmentColour = texelFetch(Palette, ivec2(Index, 0), 0);
+#endif
+
+#ifdef LIGHTMAP
+    FragmentColour.rgb *= texture(Lightmap, LightmapUV).rgb;
+#endif
+
+#ifdef PARTICLE
+    // Round sprites cut from the quad
+    V2 Offset = SpriteUV - V2(0.5);
+    if(dot(Offset, Offset) > 0.25)
+    {
+        discard;
+    }
+#endif
+
+#ifdef ALPHA_TEST
+    if(FragmentColour.a < 0.5)
+    {
+        discard;
+    }
+#endif
+
+#ifdef FOG
+    // Linear fog on window-space depth
+    f32 Fog = clamp((gl_FragCoord.z - FogRange.x) / (FogRange.y - FogRange.x), 0.0, 1.0);
+    FragmentColour.rgb = mix(FragmentColour.rgb, FogColour.rgb, Fog);
+#endif
+}
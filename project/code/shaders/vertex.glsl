@@ -1,12 +1,55 @@
-// Specify shader inputs
+// Specify shader inputs (packed vertex format - see VERTEX_PACKED)
 layout (location = 0) in V3 Position;
+layout (location = 1) in V4 Normal;
+layout (location = 2) in V2 UV;
 out V4 VertexColour;
 
+// Positions are quantized to snorm16 over the mesh pool range
+uniform f32 PositionScale = 1.0;
+
+// Identity until a camera is set - positions are then in world units
+uniform M4 ViewProjection = M4(1.0);
+
+#ifdef LIGHTMAP
+layout (location = 3) in V2 LightmapCoordinate;
+out V2 LightmapUV;
+#endif
+
+#ifdef PALETTE
+out V2 TextureUV;
+#endif
+
+#ifdef PARTICLE
+// Per instance (see particles.cpp) - centre and size, then an RGBA8 colour
+layout (location = 4) in V4 Instance;
+layout (location = 5) in V4 InstanceColour;
+uniform V3 CameraRight = V3(1.0, 0.0, 0.0);
+uniform V3 CameraUp = V3(0.0, 1.0, 0.0);
+out V2 SpriteUV;
+#endif
+
 void main()
 {
     // Set shader output with Position
-    gl_Position = V4(Position, 1.0);
+    gl_Position = ViewProjection * V4(Position * PositionScale, 1.0);
     
     // Set fragment shader colour
     VertexColour = V4(0.5, 0.0, 0.0, 1.0);
-}
\ No newline at end of file
+
+#ifdef LIGHTMAP
+    LightmapUV = LightmapCoordinate;
+#endif
+
+#ifdef PALETTE
+    TextureUV = UV;
+#endif
+
+#ifdef PARTICLE
+    // Quad corners are +-0.5 in X/Y - spread them along the camera axes so the sprite always faces the viewer
+    V3 Corner = Position * PositionScale;
+    V3 World = Instance.xyz + (CameraRight * Corner.x + CameraUp * Corner.y) * Instance.w;
+    gl_Position = ViewProjection * V4(World, 1.0);
+    VertexColour = InstanceColour;
+    SpriteUV = UV;
+#endif
+}
@@ -0,0 +1,57 @@
+// Simulation
+// Game state stepped at the scheduler's fixed tick. Rendering never reads the state directly - it reads
+// SimulationInterpolate(Previous, Current, Alpha) so motion stays smooth whatever the render rate.
+
+typedef struct SIMULATION_STATE
+{
+    u64 Tick;
+    V3  Centre;
+    V3  CameraPosition;
+    f32 CameraAngle;
+} SIMULATION_STATE;
+
+void SimulationCreate(SIMULATION_STATE *State, V3 Centre)
+{
+    *State = {};
+    State->Centre           = Centre;
+    State->CameraPosition   = Centre;
+}
+
+// Placeholder motion - the camera orbits the centre point
+void SimulationStep(SIMULATION_STATE *State, f32 TickSeconds)
+{
+    const f32 Radius        = 2.0f;
+    const f32 AngularSpeed  = 0.5f;
+
+    ++State->Tick;
+    State->CameraAngle += AngularSpeed * TickSeconds;
+    State->CameraPosition.X = State->Centre.X + cosf(State->CameraAngle) * Radius;
+    State->CameraPosition.Y = State->Centre.Y;
+    State->CameraPosition.Z = State->Centre.Z + sinf(State->CameraAngle) * Radius;
+}
+
+SIMULATION_STATE SimulationInterpolate(SIMULATION_STATE *Previous, SIMULATION_STATE *Current, f32 Alpha)
+{
+    SIMULATION_STATE Result = *Current;
+    Result.CameraAngle      = Previous->CameraAngle + (Current->CameraAngle - Previous->CameraAngle) * Alpha;
+    Result.CameraPosition.X = Previous->CameraPosition.X + (Current->CameraPosition.X - Previous->CameraPosition.X) * Alpha;
+    Result.CameraPosition.Y = Previous->CameraPosition.Y + (Current->CameraPosition.Y - Previous->CameraPosition.Y) * Alpha;
+    Result.CameraPosition.Z = Previous->CameraPosition.Z + (Current->CameraPosition.Z - Previous->CameraPosition.Z) * Alpha;
+    return Result;
+}
+
+// FNV-1a over the stepped fields (not the struct, its padding is undefined) - replays compare it frame by frame
+u32 SimulationChecksum(SIMULATION_STATE *State)
+{
+    f32 Fields[] = {State->CameraPosition.X, State->CameraPosition.Y, State->CameraPosition.Z, State->CameraAngle};
+    u8 Bytes[sizeof(u64) + sizeof(Fields)];
+    memcpy(Bytes, &State->Tick, sizeof(u64));
+    memcpy(Bytes + sizeof(u64), Fields, sizeof(Fields));
+
+    u32 Hash = 0x811C9DC5u;
+    for(u32 i = 0; i < sizeof(Bytes); ++i)
+    {
+        Hash = (Hash ^ Bytes[i]) * 0x01000193u;
+    }
+    return Hash;
+}
@@ -0,0 +1,922 @@
+// Software renderer
+// Tiled, binned CPU rasterizer that draws the same MESH_POOL geometry (through its CPU copy) as the OpenGL path.
+// Frames run in two parallel phases:
+//  1. Setup/bin - each thread transforms a contiguous slice of triangles and bins them into its own tile lists
+//  2. Raster    - threads pull whole tiles, walking every thread's list for that tile in submission order
+// If a thread's bins fill up, everything from the triangle that didn't fit onwards is drawn in another pass.
+// Span kernels are AVX2 (8 wide), SSE4.1 (4 wide) or scalar, selected at runtime. They evaluate every plane in the
+// same order and share the top-left fill rule, so they write the same pixels.
+#include <immintrin.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define SOFTWARE_TILE_SIZE      64
+#define SOFTWARE_MAX_THREADS    64
+#define SOFTWARE_MAX_DRAWS      16384
+
+typedef enum SOFTWARE_TEXTURE_MODE
+{
+    SOFTWARE_TEXTURE_NONE,
+    SOFTWARE_TEXTURE_AFFINE,        // PS1 style - interpolates UVs linearly in screen space
+    SOFTWARE_TEXTURE_PERSPECTIVE,
+} SOFTWARE_TEXTURE_MODE;
+
+typedef enum SOFTWARE_KERNEL
+{
+    SOFTWARE_KERNEL_SCALAR,
+    SOFTWARE_KERNEL_SSE4,
+    SOFTWARE_KERNEL_AVX2,
+} SOFTWARE_KERNEL;
+
+static const char *SoftwareKernelNames[] =
+{
+    "scalar",
+    "sse4.1",
+    "avx2",
+};
+
+// RGBA8, rows bottom-up (same layout as the OpenGL upload), power of two dimensions
+typedef struct SOFTWARE_TEXTURE
+{
+    u32 *Texels;
+    i32 Width;
+    i32 Height;
+} SOFTWARE_TEXTURE;
+
+typedef struct SOFTWARE_DRAW
+{
+    MESH Mesh;
+    f32 Transform[16];              // Column major, applied to pool positions
+    const SOFTWARE_TEXTURE *Texture;
+    u32 Colour;                     // Used when untextured
+    u32 TextureMode;
+} SOFTWARE_DRAW;
+
+// Plane equations in pixel space: Value(x, y) = X * x + Y * y + C
+typedef struct SOFTWARE_PLANE
+{
+    f32 X;
+    f32 Y;
+    f32 C;
+} SOFTWARE_PLANE;
+
+typedef struct SOFTWARE_TRIANGLE
+{
+    SOFTWARE_PLANE Edges[3];        // Positive inside
+    f32 Inside[3];                  // Smallest value that counts as inside - 0 if the edge owns pixels exactly on it
+    SOFTWARE_PLANE Depth;
+    SOFTWARE_PLANE InverseW;        // Perspective mode only
+    SOFTWARE_PLANE U;               // Divided by w in perspective mode
+    SOFTWARE_PLANE V;
+    i32 MinX;
+    i32 MinY;
+    i32 MaxX;                       // Exclusive
+    i32 MaxY;
+    u32 Draw;
+} SOFTWARE_TRIANGLE;
+
+typedef struct SOFTWARE_STATS
+{
+    u64 Triangles;                  // Submitted
+    u64 TrianglesBinned;            // Survived culling
+    u64 Pixels;                     // Written (passed coverage and depth)
+    u32 BinOverflows;               // Extra passes because a thread's bins filled up
+} SOFTWARE_STATS;
+
+struct SOFTWARE_RENDERER;
+typedef void SOFTWARE_JOB(SOFTWARE_RENDERER *Renderer, u32 ThreadIndex);
+
+typedef struct SOFTWARE_RENDERER
+{
+    // Output framebuffer - padded to whole tiles, rows bottom-up like glReadPixels
+    u32 *Colour;
+    f32 *Depth;
+    i32 Width;
+    i32 Height;
+    i32 Pitch;
+    i32 TilesX;
+    i32 TilesY;
+
+    MESH_POOL *Pool;
+    SOFTWARE_KERNEL Kernel;
+
+    // Draws for the current frame
+    SOFTWARE_DRAW *Draws;
+    u32 *DrawTriangleStart;         // Prefix sum of triangle counts
+    u32 DrawCount;
+
+    // Setup output - a pass covers [PassStart, PassEnd) of the frame's triangles
+    SOFTWARE_TRIANGLE *Triangles;
+    u32 TriangleCount;
+    u32 MaxTriangles;
+    u32 PassStart;
+    u32 PassEnd;
+
+    // Bins - per thread (tile, triangle) pairs, then counting sorted by tile
+    u32 *BinTiles[SOFTWARE_MAX_THREADS];
+    u32 *BinTriangles[SOFTWARE_MAX_THREADS];
+    u32 *BinSorted[SOFTWARE_MAX_THREADS];
+    u32 *BinOffsets[SOFTWARE_MAX_THREADS];      // TilesX * TilesY + 1 per thread
+    u32 BinCounts[SOFTWARE_MAX_THREADS];
+    u32 BinCapacity;
+
+    // Workers - thread 0 is the caller
+    std::thread Workers[SOFTWARE_MAX_THREADS];
+    u32 WorkerCount;
+    u32 ThreadCount;                // Active this frame, <= WorkerCount
+    std::mutex Lock;
+    std::condition_variable Start;
+    std::condition_variable Done;
+    SOFTWARE_JOB *Job;
+    u32 Generation;
+    u32 Pending;
+    bool Quit;
+
+    std::atomic<u32> NextTile;
+    u64 ThreadPixels[SOFTWARE_MAX_THREADS];
+    u64 ThreadTriangles[SOFTWARE_MAX_THREADS];
+    u32 ThreadFirst[SOFTWARE_MAX_THREADS];      // Slice each thread set up
+    u32 ThreadStop[SOFTWARE_MAX_THREADS];       // First triangle that didn't fit its bins, TriangleCount if all did
+
+    SOFTWARE_STATS Stats;
+} SOFTWARE_RENDERER;
+
+
+void SoftwareWorker(SOFTWARE_RENDERER *Renderer, u32 ThreadIndex)
+{
+    ProfilerSetThreadName("Software worker");
+    u32 Generation = 0;
+    while(true)
+    {
+        SOFTWARE_JOB *Job = 0;
+        {
+            std::unique_lock<std::mutex> Guard(Renderer->Lock);
+            Renderer->Start.wait(Guard, [Renderer, Generation] { return Renderer->Generation != Generation || Renderer->Quit; });
+            if(Renderer->Quit)
+            {
+                return;
+            }
+            Generation  = Renderer->Generation;
+            Job         = Renderer->Job;
+        }
+
+        if(ThreadIndex < Renderer->ThreadCount)
+        {
+            Job(Renderer, ThreadIndex);
+        }
+
+        std::lock_guard<std::mutex> Guard(Renderer->Lock);
+        if(--Renderer->Pending == 0)
+        {
+            Renderer->Done.notify_one();
+        }
+    }
+}
+
+// Runs Job on every active thread (including the caller as thread 0) and waits for all of them
+void SoftwareRunParallel(SOFTWARE_RENDERER *Renderer, SOFTWARE_JOB *Job)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Renderer->Lock);
+        Renderer->Job       = Job;
+        Renderer->Pending   = Renderer->WorkerCount - 1;
+        ++Renderer->Generation;
+    }
+    Renderer->Start.notify_all();
+
+    Job(Renderer, 0);
+
+    std::unique_lock<std::mutex> Guard(Renderer->Lock);
+    Renderer->Done.wait(Guard, [Renderer] { return Renderer->Pending == 0; });
+}
+
+SOFTWARE_KERNEL SoftwareDetectKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SOFTWARE_KERNEL_AVX2;
+    }
+    if(__builtin_cpu_supports("sse4.1"))
+    {
+        return SOFTWARE_KERNEL_SSE4;
+    }
+    return SOFTWARE_KERNEL_SCALAR;
+}
+
+// ThreadCount = 0 uses every hardware thread
+void SoftwareRendererCreate(SOFTWARE_RENDERER *Renderer, MEMORY_ARENA *Arena, MESH_POOL *Pool, i32 Width, i32 Height, u32 MaxTriangles, u32 ThreadCount)
+{
+    Assert(Pool->CpuVertices, "Software: Mesh pool has no CPU copy!");
+    Renderer->Pool      = Pool;
+    Renderer->Kernel    = SoftwareDetectKernel();
+
+    // Framebuffer
+    Renderer->Width     = Width;
+    Renderer->Height    = Height;
+    Renderer->TilesX    = (Width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    Renderer->TilesY    = (Height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    Renderer->Pitch     = Renderer->TilesX * SOFTWARE_TILE_SIZE;
+    size_t PixelCount   = (size_t) Renderer->Pitch * (Renderer->TilesY * SOFTWARE_TILE_SIZE);
+    Renderer->Colour    = (u32 *) Arena->Alloc(sizeof(u32) * PixelCount, 64);
+    Renderer->Depth     = (f32 *) Arena->Alloc(sizeof(f32) * PixelCount, 64);
+    Assert(Renderer->Colour && Renderer->Depth, "Software: Failed to allocate framebuffer!");
+
+    // Threads
+    if(ThreadCount == 0)
+    {
+        ThreadCount = std::thread::hardware_concurrency();
+    }
+    ThreadCount = (ThreadCount < 1) ? 1 : ((ThreadCount > SOFTWARE_MAX_THREADS) ? SOFTWARE_MAX_THREADS : ThreadCount);
+    Renderer->WorkerCount   = ThreadCount;
+    Renderer->ThreadCount   = ThreadCount;
+
+    // Triangles and draws
+    Renderer->MaxTriangles      = MaxTriangles;
+    Renderer->Triangles         = (SOFTWARE_TRIANGLE *) Arena->Alloc(sizeof(SOFTWARE_TRIANGLE) * MaxTriangles, 64);
+    Renderer->Draws             = (SOFTWARE_DRAW *) Arena->Alloc(sizeof(SOFTWARE_DRAW) * SOFTWARE_MAX_DRAWS, 64);
+    Renderer->DrawTriangleStart = (u32 *) Arena->Alloc(sizeof(u32) * (SOFTWARE_MAX_DRAWS + 1), 64);
+    Assert(Renderer->Triangles && Renderer->Draws && Renderer->DrawTriangleStart, "Software: Failed to allocate triangle setup!");
+
+    // Bins - sized for small triangles touching a few tiles on average
+    u32 TileCount = Renderer->TilesX * Renderer->TilesY;
+    Renderer->BinCapacity = ((MaxTriangles * 4) / ThreadCount) + TileCount;
+    for(u32 i = 0; i < ThreadCount; ++i)
+    {
+        Renderer->BinTiles[i]       = (u32 *) Arena->Alloc(sizeof(u32) * Renderer->BinCapacity, 64);
+        Renderer->BinTriangles[i]   = (u32 *) Arena->Alloc(sizeof(u32) * Renderer->BinCapacity, 64);
+        Renderer->BinSorted[i]      = (u32 *) Arena->Alloc(sizeof(u32) * Renderer->BinCapacity, 64);
+        Renderer->BinOffsets[i]     = (u32 *) Arena->Alloc(sizeof(u32) * (TileCount + 1), 64);
+        Assert(Renderer->BinTiles[i] && Renderer->BinTriangles[i] && Renderer->BinSorted[i] && Renderer->BinOffsets[i], "Software: Failed to allocate bins!");
+    }
+
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Renderer->Workers[i] = std::thread(SoftwareWorker, Renderer, i);
+    }
+}
+
+void SoftwareRendererDestroy(SOFTWARE_RENDERER *Renderer)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Renderer->Lock);
+        Renderer->Quit = true;
+    }
+    Renderer->Start.notify_all();
+    for(u32 i = 1; i < Renderer->WorkerCount; ++i)
+    {
+        Renderer->Workers[i].join();
+    }
+}
+
+// Active threads for following frames (scaling tests), clamped to the threads created
+void SoftwareRendererSetThreadCount(SOFTWARE_RENDERER *Renderer, u32 ThreadCount)
+{
+    Renderer->ThreadCount = (ThreadCount < 1) ? 1 : ((ThreadCount > Renderer->WorkerCount) ? Renderer->WorkerCount : ThreadCount);
+}
+
+void SoftwareRendererClear(SOFTWARE_RENDERER *Renderer, u32 Colour)
+{
+    size_t PixelCount = (size_t) Renderer->Pitch * (Renderer->TilesY * SOFTWARE_TILE_SIZE);
+    for(size_t i = 0; i < PixelCount; ++i)
+    {
+        Renderer->Colour[i] = Colour;
+        Renderer->Depth[i]  = 1.0f;
+    }
+}
+
+// Transform is column major (null = identity)
+void SoftwareRendererDraw(SOFTWARE_RENDERER *Renderer, MESH *Mesh, const f32 *Transform, const SOFTWARE_TEXTURE *Texture, u32 Colour, u32 TextureMode)
+{
+    Assert(Renderer->DrawCount < SOFTWARE_MAX_DRAWS, "Software: Too many draws!");
+
+    SOFTWARE_DRAW *Draw = &Renderer->Draws[Renderer->DrawCount++];
+    Draw->Mesh          = *Mesh;
+    Draw->Texture       = Texture;
+    Draw->Colour        = Colour;
+    Draw->TextureMode   = Texture ? TextureMode : SOFTWARE_TEXTURE_NONE;
+
+    static const f32 Identity[16] =
+    {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    };
+    memcpy(Draw->Transform, Transform ? Transform : Identity, sizeof(Draw->Transform));
+}
+
+SOFTWARE_PLANE SoftwarePlane(SOFTWARE_PLANE *Edges, f32 InverseArea, f32 A0, f32 A1, f32 A2)
+{
+    // A = A0 + (E1 * (A1 - A0) + E2 * (A2 - A0)) / Area, expanded into x/y/constant terms
+    f32 D1 = (A1 - A0) * InverseArea;
+    f32 D2 = (A2 - A0) * InverseArea;
+
+    SOFTWARE_PLANE Result = {};
+    Result.X = (Edges[1].X * D1) + (Edges[2].X * D2);
+    Result.Y = (Edges[1].Y * D1) + (Edges[2].Y * D2);
+    Result.C = A0 + (Edges[1].C * D1) + (Edges[2].C * D2);
+    return Result;
+}
+
+// Returns false for culled triangles (degenerate, behind the eye or off screen)
+bool SoftwareSetupTriangle(SOFTWARE_RENDERER *Renderer, SOFTWARE_DRAW *Draw, u32 DrawIndex, u32 Triangle, SOFTWARE_TRIANGLE *Result)
+{
+    MESH_POOL *Pool = Renderer->Pool;
+    u32 *Indices    = Pool->CpuIndices + Draw->Mesh.FirstIndex + (Triangle * 3);
+    const f32 *M    = Draw->Transform;
+
+    f32 X[3], Y[3], Z[3], W[3], U[3], V[3];
+    for(u32 i = 0; i < 3; ++i)
+    {
+        VERTEX_PACKED *Vertex = &Pool->CpuVertices[Draw->Mesh.BaseVertex + Indices[i]];
+        f32 Px = ((f32) Vertex->Position[0] / 32767.0f) * Pool->PositionScale;
+        f32 Py = ((f32) Vertex->Position[1] / 32767.0f) * Pool->PositionScale;
+        f32 Pz = ((f32) Vertex->Position[2] / 32767.0f) * Pool->PositionScale;
+
+        // Clip space
+        f32 Cx = M[0] * Px + M[4] * Py + M[8] * Pz + M[12];
+        f32 Cy = M[1] * Px + M[5] * Py + M[9] * Pz + M[13];
+        f32 Cz = M[2] * Px + M[6] * Py + M[10] * Pz + M[14];
+        f32 Cw = M[3] * Px + M[7] * Py + M[11] * Pz + M[15];
+
+        // No near plane clipping - triangles crossing the eye plane are dropped
+        if(Cw <= 1e-5f)
+        {
+            return false;
+        }
+
+        // Viewport (rows bottom-up, pixel centres at +0.5)
+        f32 InverseW = 1.0f / Cw;
+        X[i] = ((Cx * InverseW) * 0.5f + 0.5f) * (f32) Renderer->Width;
+        Y[i] = ((Cy * InverseW) * 0.5f + 0.5f) * (f32) Renderer->Height;
+        Z[i] = (Cz * InverseW) * 0.5f + 0.5f;
+        W[i] = InverseW;
+        U[i] = UnpackHalf(Vertex->UV[0]);
+        V[i] = UnpackHalf(Vertex->UV[1]);
+    }
+
+    // Edge functions, each opposite its vertex
+    SOFTWARE_PLANE *Edges = Result->Edges;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        u32 A = (i + 1) % 3;
+        u32 B = (i + 2) % 3;
+        Edges[i].X = Y[A] - Y[B];
+        Edges[i].Y = X[B] - X[A];
+        Edges[i].C = (X[A] * Y[B]) - (X[B] * Y[A]);
+    }
+
+    // Twice the signed area - flip back facing triangles so inside is always positive (no culling, matches GL defaults)
+    f32 Area = Edges[0].C + Edges[1].C + Edges[2].C;
+    if(fabsf(Area) < 1e-8f)
+    {
+        return false;
+    }
+    if(Area < 0)
+    {
+        for(u32 i = 0; i < 3; ++i)
+        {
+            Edges[i].X = -Edges[i].X;
+            Edges[i].Y = -Edges[i].Y;
+            Edges[i].C = -Edges[i].C;
+        }
+        Area = -Area;
+    }
+
+    // Left edges (inside to the right) and top edges (horizontal, inside below) own the pixels exactly on them. A
+    // neighbour's shared edge is the exact negation of this one, so only one of the two triangles draws those pixels.
+    // The others need a value above zero - at least the smallest denormal, which keeps it a single compare
+    for(u32 i = 0; i < 3; ++i)
+    {
+        Result->Inside[i] = ((Edges[i].X > 0) || (Edges[i].X == 0 && Edges[i].Y < 0)) ? 0.0f : __FLT_DENORM_MIN__;
+    }
+
+    // Bounds, clamped to the screen
+    f32 MinX = fminf(X[0], fminf(X[1], X[2]));
+    f32 MinY = fminf(Y[0], fminf(Y[1], Y[2]));
+    f32 MaxX = fmaxf(X[0], fmaxf(X[1], X[2]));
+    f32 MaxY = fmaxf(Y[0], fmaxf(Y[1], Y[2]));
+    Result->MinX = (MinX < 0) ? 0 : (i32) MinX;
+    Result->MinY = (MinY < 0) ? 0 : (i32) MinY;
+    Result->MaxX = (MaxX >= (f32) Renderer->Width) ? Renderer->Width : (i32) MaxX + 1;
+    Result->MaxY = (MaxY >= (f32) Renderer->Height) ? Renderer->Height : (i32) MaxY + 1;
+    if(Result->MinX >= Result->MaxX || Result->MinY >= Result->MaxY)
+    {
+        return false;
+    }
+
+    // Attribute planes
+    f32 InverseArea     = 1.0f / Area;
+    Result->Depth       = SoftwarePlane(Edges, InverseArea, Z[0], Z[1], Z[2]);
+    if(Draw->TextureMode == SOFTWARE_TEXTURE_PERSPECTIVE)
+    {
+        Result->InverseW    = SoftwarePlane(Edges, InverseArea, W[0], W[1], W[2]);
+        Result->U           = SoftwarePlane(Edges, InverseArea, U[0] * W[0], U[1] * W[1], U[2] * W[2]);
+        Result->V           = SoftwarePlane(Edges, InverseArea, V[0] * W[0], V[1] * W[1], V[2] * W[2]);
+    }
+    else
+    {
+        Result->U           = SoftwarePlane(Edges, InverseArea, U[0], U[1], U[2]);
+        Result->V           = SoftwarePlane(Edges, InverseArea, V[0], V[1], V[2]);
+    }
+    Result->Draw = DrawIndex;
+
+    return true;
+}
+
+void SoftwareSetupJob(SOFTWARE_RENDERER *Renderer, u32 ThreadIndex)
+{
+    PROFILE_SCOPE("SoftwareSetupJob");
+    // Contiguous slice of the pass's triangles keeps per-thread bins in submission order
+    u32 Total   = Renderer->TriangleCount - Renderer->PassStart;
+    u32 First   = Renderer->PassStart + (u32) (((u64) Total * ThreadIndex) / Renderer->ThreadCount);
+    u32 Last    = Renderer->PassStart + (u32) (((u64) Total * (ThreadIndex + 1)) / Renderer->ThreadCount);
+
+    u32 *Tiles      = Renderer->BinTiles[ThreadIndex];
+    u32 *Triangles  = Renderer->BinTriangles[ThreadIndex];
+    u32 Count       = 0;
+    u32 Binned      = 0;
+    u32 Stop        = Renderer->TriangleCount;
+
+    // Find the draw containing the first triangle
+    u32 DrawIndex = 0;
+    while(DrawIndex + 1 < Renderer->DrawCount && Renderer->DrawTriangleStart[DrawIndex + 1] <= First)
+    {
+        ++DrawIndex;
+    }
+
+    for(u32 i = First; i < Last; ++i)
+    {
+        while(Renderer->DrawTriangleStart[DrawIndex + 1] <= i)
+        {
+            ++DrawIndex;
+        }
+
+        SOFTWARE_DRAW *Draw = &Renderer->Draws[DrawIndex];
+        SOFTWARE_TRIANGLE *Triangle = &Renderer->Triangles[i];
+        if(!SoftwareSetupTriangle(Renderer, Draw, DrawIndex, i - Renderer->DrawTriangleStart[DrawIndex], Triangle))
+        {
+            continue;
+        }
+
+        // Bin by bounding box - a triangle that doesn't fit whole waits for the next pass along with everything after
+        // it. Capacity covers every tile, so the first triangle of a slice always fits
+        i32 TileMinX = Triangle->MinX / SOFTWARE_TILE_SIZE;
+        i32 TileMinY = Triangle->MinY / SOFTWARE_TILE_SIZE;
+        i32 TileMaxX = (Triangle->MaxX - 1) / SOFTWARE_TILE_SIZE;
+        i32 TileMaxY = (Triangle->MaxY - 1) / SOFTWARE_TILE_SIZE;
+        u32 TileTotal = (u32) ((TileMaxX - TileMinX + 1) * (TileMaxY - TileMinY + 1));
+        if(Count + TileTotal > Renderer->BinCapacity)
+        {
+            Stop = i;
+            break;
+        }
+        for(i32 TileY = TileMinY; TileY <= TileMaxY; ++TileY)
+        {
+            for(i32 TileX = TileMinX; TileX <= TileMaxX; ++TileX)
+            {
+                Tiles[Count]        = (TileY * Renderer->TilesX) + TileX;
+                Triangles[Count]    = i;
+                ++Count;
+            }
+        }
+        ++Binned;
+    }
+
+    // Counting sort by tile (stable, so triangles stay in order within each tile)
+    u32 TileCount = Renderer->TilesX * Renderer->TilesY;
+    u32 *Offsets = Renderer->BinOffsets[ThreadIndex];
+    memset(Offsets, 0, sizeof(u32) * (TileCount + 1));
+    for(u32 i = 0; i < Count; ++i)
+    {
+        ++Offsets[Tiles[i] + 1];
+    }
+    for(u32 i = 0; i < TileCount; ++i)
+    {
+        Offsets[i + 1] += Offsets[i];
+    }
+
+    u32 *Sorted = Renderer->BinSorted[ThreadIndex];
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Sorted[Offsets[Tiles[i]]++] = Triangles[i];
+    }
+
+    // Restore bucket starts (each offset was advanced to the next bucket's start)
+    for(u32 i = TileCount; i > 0; --i)
+    {
+        Offsets[i] = Offsets[i - 1];
+    }
+    Offsets[0] = 0;
+
+    Renderer->BinCounts[ThreadIndex]        = Count;
+    Renderer->ThreadTriangles[ThreadIndex]  = Binned;
+    Renderer->ThreadFirst[ThreadIndex]      = First;
+    Renderer->ThreadStop[ThreadIndex]       = Stop;
+}
+
+inline u32 SoftwareSample(const SOFTWARE_TEXTURE *Texture, f32 U, f32 V)
+{
+    // Nearest, wrapping
+    i32 X = (i32) floorf(U * (f32) Texture->Width) & (Texture->Width - 1);
+    i32 Y = (i32) floorf(V * (f32) Texture->Height) & (Texture->Height - 1);
+    return Texture->Texels[(Y * Texture->Width) + X];
+}
+
+// Every kernel evaluates a plane as X * x added to a per-row Y * y + C. Separate statements, so the compiler can't
+// fuse one kernel's multiply-add when it doesn't fuse the others'
+inline f32 SoftwarePlaneRow(const SOFTWARE_PLANE *Plane, f32 Py)
+{
+    f32 Step = Plane->Y * Py;
+    return Step + Plane->C;
+}
+
+inline f32 SoftwarePlaneAt(const SOFTWARE_PLANE *Plane, f32 Row, f32 Px)
+{
+    f32 Step = Plane->X * Px;
+    return Step + Row;
+}
+
+inline bool SoftwareEdgeInside(SOFTWARE_TRIANGLE *Triangle, u32 Edge, f32 Row, f32 Px)
+{
+    return SoftwarePlaneAt(&Triangle->Edges[Edge], Row, Px) >= Triangle->Inside[Edge];
+}
+
+// Reference kernel - one pixel at a time
+u64 SoftwareRasterScalar(SOFTWARE_RENDERER *Renderer, SOFTWARE_TRIANGLE *Triangle, SOFTWARE_DRAW *Draw, i32 X0, i32 Y0, i32 X1, i32 Y1)
+{
+    u64 Pixels = 0;
+    for(i32 Y = Y0; Y < Y1; ++Y)
+    {
+        u32 *ColourRow  = Renderer->Colour + ((size_t) Y * Renderer->Pitch);
+        f32 *DepthRow   = Renderer->Depth + ((size_t) Y * Renderer->Pitch);
+        f32 Py          = (f32) Y + 0.5f;
+
+        // Row constants
+        SOFTWARE_PLANE *E = Triangle->Edges;
+        f32 E0Row   = SoftwarePlaneRow(&E[0], Py);
+        f32 E1Row   = SoftwarePlaneRow(&E[1], Py);
+        f32 E2Row   = SoftwarePlaneRow(&E[2], Py);
+        f32 ZRow    = SoftwarePlaneRow(&Triangle->Depth, Py);
+
+        for(i32 X = X0; X < X1; ++X)
+        {
+            f32 Px = (f32) X + 0.5f;
+            if(!SoftwareEdgeInside(Triangle, 0, E0Row, Px) || !SoftwareEdgeInside(Triangle, 1, E1Row, Px) || !SoftwareEdgeInside(Triangle, 2, E2Row, Px))
+            {
+                continue;
+            }
+
+            // Less-equal so coplanar draws resolve in submission order, like the GL path
+            f32 Z = SoftwarePlaneAt(&Triangle->Depth, ZRow, Px);
+            if(!(Z <= DepthRow[X]))
+            {
+                continue;
+            }
+            DepthRow[X] = Z;
+
+            u32 Colour = Draw->Colour;
+            if(Draw->TextureMode != SOFTWARE_TEXTURE_NONE)
+            {
+                f32 U = SoftwarePlaneAt(&Triangle->U, SoftwarePlaneRow(&Triangle->U, Py), Px);
+                f32 V = SoftwarePlaneAt(&Triangle->V, SoftwarePlaneRow(&Triangle->V, Py), Px);
+                if(Draw->TextureMode == SOFTWARE_TEXTURE_PERSPECTIVE)
+                {
+                    f32 InverseW = SoftwarePlaneAt(&Triangle->InverseW, SoftwarePlaneRow(&Triangle->InverseW, Py), Px);
+                    U = U / InverseW;
+                    V = V / InverseW;
+                }
+                Colour = SoftwareSample(Draw->Texture, U, V);
+            }
+            ColourRow[X] = Colour;
+            ++Pixels;
+        }
+    }
+    return Pixels;
+}
+
+__attribute__((target("sse4.1")))
+u64 SoftwareRasterSSE4(SOFTWARE_RENDERER *Renderer, SOFTWARE_TRIANGLE *Triangle, SOFTWARE_DRAW *Draw, i32 X0, i32 Y0, i32 X1, i32 Y1)
+{
+    u64 Pixels = 0;
+    i32 FirstX = X0;
+    X0 &= ~3;
+
+    SOFTWARE_PLANE *E = Triangle->Edges;
+    __m128 Offsets  = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128i Lanes   = _mm_setr_epi32(0, 1, 2, 3);
+    __m128 Inside0  = _mm_set1_ps(Triangle->Inside[0]);
+    __m128 Inside1  = _mm_set1_ps(Triangle->Inside[1]);
+    __m128 Inside2  = _mm_set1_ps(Triangle->Inside[2]);
+    __m128 TextureWidth     = _mm_set1_ps((f32) (Draw->Texture ? Draw->Texture->Width : 0));
+    __m128 TextureHeight    = _mm_set1_ps((f32) (Draw->Texture ? Draw->Texture->Height : 0));
+    __m128i WidthMask       = _mm_set1_epi32(Draw->Texture ? Draw->Texture->Width - 1 : 0);
+    __m128i HeightMask      = _mm_set1_epi32(Draw->Texture ? Draw->Texture->Height - 1 : 0);
+
+    for(i32 Y = Y0; Y < Y1; ++Y)
+    {
+        u32 *ColourRow  = Renderer->Colour + ((size_t) Y * Renderer->Pitch);
+        f32 *DepthRow   = Renderer->Depth + ((size_t) Y * Renderer->Pitch);
+        f32 Py          = (f32) Y + 0.5f;
+
+        // Row constants
+        __m128 E0Row    = _mm_set1_ps(SoftwarePlaneRow(&E[0], Py));
+        __m128 E1Row    = _mm_set1_ps(SoftwarePlaneRow(&E[1], Py));
+        __m128 E2Row    = _mm_set1_ps(SoftwarePlaneRow(&E[2], Py));
+        __m128 ZRow     = _mm_set1_ps(SoftwarePlaneRow(&Triangle->Depth, Py));
+
+        for(i32 X = X0; X < X1; X += 4)
+        {
+            __m128 Px = _mm_add_ps(_mm_set1_ps((f32) X), Offsets);
+            __m128 E0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(E[0].X), Px), E0Row);
+            __m128 E1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(E[1].X), Px), E1Row);
+            __m128 E2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(E[2].X), Px), E2Row);
+            __m128 Inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E0, Inside0), _mm_cmpge_ps(E1, Inside1)), _mm_cmpge_ps(E2, Inside2));
+
+            // Lanes either side of the span are left alone, like the scalar kernel
+            if(X < FirstX || X + 4 > X1)
+            {
+                __m128i Column  = _mm_add_epi32(_mm_set1_epi32(X), Lanes);
+                __m128i Columns = _mm_and_si128(_mm_cmpgt_epi32(Column, _mm_set1_epi32(FirstX - 1)), _mm_cmplt_epi32(Column, _mm_set1_epi32(X1)));
+                Inside = _mm_and_ps(Inside, _mm_castsi128_ps(Columns));
+            }
+            if(!_mm_movemask_ps(Inside))
+            {
+                continue;
+            }
+
+            __m128 Z        = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Triangle->Depth.X), Px), ZRow);
+            __m128 Depth    = _mm_load_ps(DepthRow + X);
+            __m128 Mask     = _mm_and_ps(Inside, _mm_cmple_ps(Z, Depth));
+            i32 Bits        = _mm_movemask_ps(Mask);
+            if(!Bits)
+            {
+                continue;
+            }
+            _mm_store_ps(DepthRow + X, _mm_blendv_ps(Depth, Z, Mask));
+
+            __m128i Colour = _mm_set1_epi32((i32) Draw->Colour);
+            if(Draw->TextureMode != SOFTWARE_TEXTURE_NONE)
+            {
+                __m128 U = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Triangle->U.X), Px), _mm_set1_ps(SoftwarePlaneRow(&Triangle->U, Py)));
+                __m128 V = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Triangle->V.X), Px), _mm_set1_ps(SoftwarePlaneRow(&Triangle->V, Py)));
+                if(Draw->TextureMode == SOFTWARE_TEXTURE_PERSPECTIVE)
+                {
+                    __m128 InverseW = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Triangle->InverseW.X), Px), _mm_set1_ps(SoftwarePlaneRow(&Triangle->InverseW, Py)));
+                    U = _mm_div_ps(U, InverseW);
+                    V = _mm_div_ps(V, InverseW);
+                }
+                __m128i TexelX = _mm_and_si128(_mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(U, TextureWidth))), WidthMask);
+                __m128i TexelY = _mm_and_si128(_mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(V, TextureHeight))), HeightMask);
+                __m128i Index  = _mm_add_epi32(_mm_mullo_epi32(TexelY, _mm_add_epi32(WidthMask, _mm_set1_epi32(1))), TexelX);
+
+                // No gather before AVX2
+                alignas(16) i32 Indices[4];
+                _mm_store_si128((__m128i *) Indices, Index);
+                const u32 *Texels = Draw->Texture->Texels;
+                Colour = _mm_setr_epi32((i32) Texels[Indices[0]], (i32) Texels[Indices[1]], (i32) Texels[Indices[2]], (i32) Texels[Indices[3]]);
+            }
+
+            __m128i Existing = _mm_load_si128((__m128i *) (ColourRow + X));
+            _mm_store_si128((__m128i *) (ColourRow + X), _mm_blendv_epi8(Existing, Colour, _mm_castps_si128(Mask)));
+            Pixels += __builtin_popcount(Bits);
+        }
+    }
+    return Pixels;
+}
+
+__attribute__((target("avx2")))
+u64 SoftwareRasterAVX2(SOFTWARE_RENDERER *Renderer, SOFTWARE_TRIANGLE *Triangle, SOFTWARE_DRAW *Draw, i32 X0, i32 Y0, i32 X1, i32 Y1)
+{
+    u64 Pixels = 0;
+    i32 FirstX = X0;
+    X0 &= ~7;
+
+    SOFTWARE_PLANE *E = Triangle->Edges;
+    __m256 Offsets  = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    __m256i Lanes   = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 Inside0  = _mm256_set1_ps(Triangle->Inside[0]);
+    __m256 Inside1  = _mm256_set1_ps(Triangle->Inside[1]);
+    __m256 Inside2  = _mm256_set1_ps(Triangle->Inside[2]);
+    __m256 TextureWidth     = _mm256_set1_ps((f32) (Draw->Texture ? Draw->Texture->Width : 0));
+    __m256 TextureHeight    = _mm256_set1_ps((f32) (Draw->Texture ? Draw->Texture->Height : 0));
+    __m256i WidthMask       = _mm256_set1_epi32(Draw->Texture ? Draw->Texture->Width - 1 : 0);
+    __m256i HeightMask      = _mm256_set1_epi32(Draw->Texture ? Draw->Texture->Height - 1 : 0);
+
+    for(i32 Y = Y0; Y < Y1; ++Y)
+    {
+        u32 *ColourRow  = Renderer->Colour + ((size_t) Y * Renderer->Pitch);
+        f32 *DepthRow   = Renderer->Depth + ((size_t) Y * Renderer->Pitch);
+        f32 Py          = (f32) Y + 0.5f;
+
+        // Row constants
+        __m256 E0Row    = _mm256_set1_ps(SoftwarePlaneRow(&E[0], Py));
+        __m256 E1Row    = _mm256_set1_ps(SoftwarePlaneRow(&E[1], Py));
+        __m256 E2Row    = _mm256_set1_ps(SoftwarePlaneRow(&E[2], Py));
+        __m256 ZRow     = _mm256_set1_ps(SoftwarePlaneRow(&Triangle->Depth, Py));
+
+        for(i32 X = X0; X < X1; X += 8)
+        {
+            __m256 Px = _mm256_add_ps(_mm256_set1_ps((f32) X), Offsets);
+            __m256 E0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[0].X), Px), E0Row);
+            __m256 E1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[1].X), Px), E1Row);
+            __m256 E2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(E[2].X), Px), E2Row);
+            __m256 Inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(E0, Inside0, _CMP_GE_OQ), _mm256_cmp_ps(E1, Inside1, _CMP_GE_OQ)), _mm256_cmp_ps(E2, Inside2, _CMP_GE_OQ));
+
+            // Lanes either side of the span are left alone, like the scalar kernel
+            if(X < FirstX || X + 8 > X1)
+            {
+                __m256i Column  = _mm256_add_epi32(_mm256_set1_epi32(X), Lanes);
+                __m256i Columns = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(FirstX), Column), _mm256_cmpgt_epi32(_mm256_set1_epi32(X1), Column));
+                Inside = _mm256_and_ps(Inside, _mm256_castsi256_ps(Columns));
+            }
+            if(!_mm256_movemask_ps(Inside))
+            {
+                continue;
+            }
+
+            __m256 Z        = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Triangle->Depth.X), Px), ZRow);
+            __m256 Depth    = _mm256_load_ps(DepthRow + X);
+            __m256 Mask     = _mm256_and_ps(Inside, _mm256_cmp_ps(Z, Depth, _CMP_LE_OQ));
+            i32 Bits        = _mm256_movemask_ps(Mask);
+            if(!Bits)
+            {
+                continue;
+            }
+            __m256i IntegerMask = _mm256_castps_si256(Mask);
+            _mm256_maskstore_ps(DepthRow + X, IntegerMask, Z);
+
+            __m256i Colour = _mm256_set1_epi32((i32) Draw->Colour);
+            if(Draw->TextureMode != SOFTWARE_TEXTURE_NONE)
+            {
+                __m256 U = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Triangle->U.X), Px), _mm256_set1_ps(SoftwarePlaneRow(&Triangle->U, Py)));
+                __m256 V = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Triangle->V.X), Px), _mm256_set1_ps(SoftwarePlaneRow(&Triangle->V, Py)));
+                if(Draw->TextureMode == SOFTWARE_TEXTURE_PERSPECTIVE)
+                {
+                    __m256 InverseW = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Triangle->InverseW.X), Px), _mm256_set1_ps(SoftwarePlaneRow(&Triangle->InverseW, Py)));
+                    U = _mm256_div_ps(U, InverseW);
+                    V = _mm256_div_ps(V, InverseW);
+                }
+                __m256i TexelX = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(U, TextureWidth))), WidthMask);
+                __m256i TexelY = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(V, TextureHeight))), HeightMask);
+                __m256i Index  = _mm256_add_epi32(_mm256_mullo_epi32(TexelY, _mm256_add_epi32(WidthMask, _mm256_set1_epi32(1))), TexelX);
+
+                // Gather only the covered lanes
+                Colour = _mm256_mask_i32gather_epi32(Colour, (const int *) Draw->Texture->Texels, Index, IntegerMask, 4);
+            }
+
+            _mm256_maskstore_epi32((int *) (ColourRow + X), IntegerMask, Colour);
+            Pixels += __builtin_popcount(Bits);
+        }
+    }
+    return Pixels;
+}
+
+void SoftwareRasterJob(SOFTWARE_RENDERER *Renderer, u32 ThreadIndex)
+{
+    PROFILE_SCOPE("SoftwareRasterJob");
+    u64 Pixels = 0;
+    u32 TileCount = Renderer->TilesX * Renderer->TilesY;
+
+    while(true)
+    {
+        u32 Tile = Renderer->NextTile.fetch_add(1, std::memory_order_relaxed);
+        if(Tile >= TileCount)
+        {
+            break;
+        }
+
+        i32 TileX0 = (Tile % Renderer->TilesX) * SOFTWARE_TILE_SIZE;
+        i32 TileY0 = (Tile / Renderer->TilesX) * SOFTWARE_TILE_SIZE;
+
+        // Each setup thread's bin holds a later slice of the submission, so walk them in order - up to the end of
+        // the pass, anything binned past it is drawn by the next one
+        for(u32 Bin = 0; Bin < Renderer->ThreadCount; ++Bin)
+        {
+            u32 *Offsets = Renderer->BinOffsets[Bin];
+            for(u32 i = Offsets[Tile]; i < Offsets[Tile + 1]; ++i)
+            {
+                u32 Index = Renderer->BinSorted[Bin][i];
+                if(Index >= Renderer->PassEnd)
+                {
+                    break;
+                }
+                SOFTWARE_TRIANGLE *Triangle = &Renderer->Triangles[Index];
+                SOFTWARE_DRAW *Draw = &Renderer->Draws[Triangle->Draw];
+
+                i32 X0 = (Triangle->MinX > TileX0) ? Triangle->MinX : TileX0;
+                i32 Y0 = (Triangle->MinY > TileY0) ? Triangle->MinY : TileY0;
+                i32 X1 = (Triangle->MaxX < TileX0 + SOFTWARE_TILE_SIZE) ? Triangle->MaxX : TileX0 + SOFTWARE_TILE_SIZE;
+                i32 Y1 = (Triangle->MaxY < TileY0 + SOFTWARE_TILE_SIZE) ? Triangle->MaxY : TileY0 + SOFTWARE_TILE_SIZE;
+
+                switch(Renderer->Kernel)
+                {
+                    case SOFTWARE_KERNEL_AVX2:
+                    {
+                        Pixels += SoftwareRasterAVX2(Renderer, Triangle, Draw, X0, Y0, X1, Y1);
+                        break;
+                    }
+                    case SOFTWARE_KERNEL_SSE4:
+                    {
+                        Pixels += SoftwareRasterSSE4(Renderer, Triangle, Draw, X0, Y0, X1, Y1);
+                        break;
+                    }
+                    default:
+                    {
+                        Pixels += SoftwareRasterScalar(Renderer, Triangle, Draw, X0, Y0, X1, Y1);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    Renderer->ThreadPixels[ThreadIndex] = Pixels;
+}
+
+// Draws everything queued since the last flush
+void SoftwareRendererFlush(SOFTWARE_RENDERER *Renderer)
+{
+    // Triangle ranges per draw
+    u32 Total = 0;
+    for(u32 i = 0; i < Renderer->DrawCount; ++i)
+    {
+        Renderer->DrawTriangleStart[i] = Total;
+        Total += Renderer->Draws[i].Mesh.IndexCount / 3;
+    }
+    Renderer->DrawTriangleStart[Renderer->DrawCount] = Total;
+    Assert(Total <= Renderer->MaxTriangles, "Software: Too many triangles!");
+    Renderer->TriangleCount = Total;
+
+    SOFTWARE_STATS Stats = {};
+    Stats.Triangles = Total;
+
+    Renderer->PassStart = 0;
+    while(Renderer->PassStart < Total)
+    {
+        SoftwareRunParallel(Renderer, SoftwareSetupJob);
+
+        // The pass ends at the first triangle a thread couldn't bin - slices are in order, so threads before the first
+        // one that overflowed binned all of theirs and threads after it only hold triangles past it
+        Renderer->PassEnd = Total;
+        for(u32 i = 0; i < Renderer->ThreadCount; ++i)
+        {
+            if(Renderer->ThreadStop[i] < Renderer->PassEnd)
+            {
+                Renderer->PassEnd = Renderer->ThreadStop[i];
+            }
+        }
+
+        Renderer->NextTile = 0;
+        SoftwareRunParallel(Renderer, SoftwareRasterJob);
+
+        for(u32 i = 0; i < Renderer->ThreadCount; ++i)
+        {
+            Stats.TrianglesBinned   += (Renderer->ThreadFirst[i] < Renderer->PassEnd) ? Renderer->ThreadTriangles[i] : 0;
+            Stats.Pixels            += Renderer->ThreadPixels[i];
+        }
+        Stats.BinOverflows += (Renderer->PassEnd < Total);
+        Renderer->PassStart = Renderer->PassEnd;
+    }
+
+    Renderer->DrawCount = 0;
+    Renderer->Stats     = Stats;
+}
+
+// Uncompressed 32-bit TGA (bottom-up, so rows go out as stored) for thumbnails and automated capture
+bool SoftwareRendererWriteTGA(SOFTWARE_RENDERER *Renderer, const char *Path)
+{
+    FILE *File = fopen(Path, "wb");
+    if(!File)
+    {
+        return false;
+    }
+
+    u8 Header[18] = {};
+    Header[2]   = 2;                                // Uncompressed true colour
+    Header[12]  = (u8) (Renderer->Width & 0xFF);
+    Header[13]  = (u8) (Renderer->Width >> 8);
+    Header[14]  = (u8) (Renderer->Height & 0xFF);
+    Header[15]  = (u8) (Renderer->Height >> 8);
+    Header[16]  = 32;
+    Header[17]  = 8;                                // 8 alpha bits, bottom-left origin
+    fwrite(Header, sizeof(Header), 1, File);
+
+    // RGBA -> BGRA
+    for(i32 Y = 0; Y < Renderer->Height; ++Y)
+    {
+        u32 *Row = Renderer->Colour + ((size_t) Y * Renderer->Pitch);
+        for(i32 X = 0; X < Renderer->Width; ++X)
+        {
+            u32 Pixel = Row[X];
+            u8 BGRA[4] = {(u8) (Pixel >> 16), (u8) (Pixel >> 8), (u8) Pixel, (u8) (Pixel >> 24)};
+            fwrite(BGRA, sizeof(BGRA), 1, File);
+        }
+    }
+
+    fclose(File);
+    return true;
+}
@@ -0,0 +1,614 @@
+// Texture streaming
+// Requests are decoded as jobs into fixed-size staging slots carved from an arena - cooked textures (cooked_texture.h)
+// are read in as is, TGAs are decoded directly by tga.cpp and anything else goes through stb_image - then uploaded
+// level by level on the main thread through a persistently mapped pixel buffer with a per-frame byte budget. A decode is
+// only started once a staging slot is free, so uploads throttle decoding without ever blocking a worker.
+// Handles resolve to a placeholder texture until the texture is fully resident.
+#include <mutex>
+#include "cooked_texture.h"
+
+#define TEXTURE_STREAMER_MAX_TEXTURES       1024
+#define TEXTURE_STREAMER_FRAMES_IN_FLIGHT   3
+#define TEXTURE_STREAMER_MAX_PATH           256
+
+typedef enum TEXTURE_STATE
+{
+    TEXTURE_STATE_EMPTY,
+    TEXTURE_STATE_QUEUED,       // Waiting for a staging slot
+    TEXTURE_STATE_DECODING,     // Job running
+    TEXTURE_STATE_DECODED,      // Pixels in staging memory, waiting for upload budget
+    TEXTURE_STATE_RESIDENT,     // Fully uploaded
+    TEXTURE_STATE_FAILED,       // Keeps the placeholder
+} TEXTURE_STATE;
+
+typedef struct TEXTURE_HANDLE
+{
+    u32 Index;
+} TEXTURE_HANDLE;
+
+typedef struct STREAMED_TEXTURE
+{
+    char Path[TEXTURE_STREAMER_MAX_PATH];
+    u32 State;
+    GLuint Handle;
+    i32 Width;
+    i32 Height;
+    u32 Format;                 // COOKED_FORMAT - decoded images are always RGBA8
+    u32 LevelCount;
+
+    // Staging slot holding rows already flipped to bottom-up for OpenGL - RGBA8 pixels, or the whole cooked file
+    u8 *Staging;
+    u32 StagingSlot;
+    COOKED_TEXTURE_HEADER *Cooked;
+    u32 Level;
+    i32 RowsUploaded;           // Rows of blocks in the current level
+} STREAMED_TEXTURE;
+
+typedef struct TEXTURE_STREAMER_SETTINGS
+{
+    u32 StagingSlotCount;
+    size_t StagingSlotSize;     // Largest decoded image (Width * Height * 4)
+    size_t UploadBudget;        // Bytes copied to the pixel buffer per frame
+} TEXTURE_STREAMER_SETTINGS;
+
+typedef struct TEXTURE_STREAMER
+{
+    // Decode jobs
+    JOB_SYSTEM *Jobs;
+    JOB_COUNTER Decoding;
+    std::mutex Lock;
+
+    // Textures
+    STREAMED_TEXTURE *Textures;
+    u32 TextureCount;
+
+    // Request (main only) and completion (job -> main) rings of texture indices
+    u32 *Requests;
+    u32 RequestRead;
+    u32 RequestWrite;
+    u32 *Completed;
+    u32 CompletedRead;
+    u32 CompletedWrite;
+
+    // Staging memory
+    u8 *StagingMemory;
+    size_t StagingSlotSize;
+    u32 *FreeSlots;
+    u32 FreeSlotCount;
+
+    // Persistently mapped upload ring, one region per frame in flight
+    GLuint PixelBuffer;
+    u8 *PixelBufferMemory;
+    size_t UploadBudget;
+    GLsync Fences[TEXTURE_STREAMER_FRAMES_IN_FLIGHT];
+    u32 Frame;
+
+    GLuint Placeholder;
+
+    // Shared by every palettized texture
+    GLuint Palette;
+    u64 PaletteHash;
+
+    // Stats
+    u32 PendingCount;
+    u32 ResidentCount;
+    u64 BytesUploaded;
+    u64 VramBytes;
+} TEXTURE_STREAMER;
+
+// OpenGL formats for each COOKED_FORMAT - palette indices are a single red channel, block formats have no pixel format
+static const GLenum CookedInternalFormats[COOKED_FORMAT_COUNT] =
+{
+    GL_RGBA8,
+    GL_R8,
+    GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+    GL_COMPRESSED_RGBA_BPTC_UNORM,
+};
+
+static const GLenum CookedPixelFormats[COOKED_FORMAT_COUNT] =
+{
+    GL_RGBA,
+    GL_RED,
+    0,
+    0,
+};
+
+
+typedef struct TEXTURE_DECODE_JOB
+{
+    TEXTURE_STREAMER *Streamer;
+    u32 Index;
+} TEXTURE_DECODE_JOB;
+
+// Cooked textures are read straight into the staging slot, header included - there's nothing to decode.
+// Returns false if the file isn't a cooked texture.
+bool TextureStreamerLoadCooked(TEXTURE_STREAMER *Streamer, STREAMED_TEXTURE *Texture, u32 *State)
+{
+    ASSET File = {};
+    if(!AssetOpen(&File, Texture->Path))
+    {
+        return false;
+    }
+
+    // Magic first, from just the start of the file - anything else goes on to the image decoder whatever its size
+    COOKED_TEXTURE_HEADER *Header = (COOKED_TEXTURE_HEADER *) Texture->Staging;
+    size_t FileSize = File.Size;
+    if(!AssetPeek(&File, Header, sizeof(COOKED_TEXTURE_HEADER), Streamer->StagingSlotSize) || Header->Magic != COOKED_TEXTURE_MAGIC)
+    {
+        AssetClose(&File);
+        return false;
+    }
+
+    // Then the whole file goes into staging in one read (or one decompress from the archive)
+    if(FileSize > Streamer->StagingSlotSize)
+    {
+        printf("Textures: %s exceeds staging slot size!\n", Texture->Path);
+        *State = TEXTURE_STATE_FAILED;
+        AssetClose(&File);
+        return true;
+    }
+    bool Read = AssetRead(&File, Header);
+    AssetClose(&File);
+    if(!Read)
+    {
+        printf("Textures: Failed to read %s!\n", Texture->Path);
+        *State = TEXTURE_STATE_FAILED;
+        return true;
+    }
+
+    bool Valid = Header->Version == COOKED_TEXTURE_VERSION && Header->Format < COOKED_FORMAT_COUNT &&
+                 Header->LevelCount > 0 && Header->LevelCount <= COOKED_TEXTURE_MAX_LEVELS;
+    for(u32 i = 0; Valid && i < Header->LevelCount; ++i)
+    {
+        COOKED_TEXTURE_LEVEL *Level = &Header->Levels[i];
+        Valid = Level->Size == CookedLevelBytes(Header->Format, Level->Width, Level->Height) && (u64) Level->Offset + Level->Size <= Header->DataSize;
+    }
+    if(Valid && Header->Format == COOKED_FORMAT_PALETTE8)
+    {
+        Valid = (u64) Header->PaletteOffset + COOKED_PALETTE_SIZE <= Header->DataSize;
+    }
+
+    if(!Valid)
+    {
+        printf("Textures: %s is not a supported cooked texture!\n", Texture->Path);
+        *State = TEXTURE_STATE_FAILED;
+    }
+    else if(sizeof(COOKED_TEXTURE_HEADER) + (size_t) Header->DataSize > FileSize)
+    {
+        printf("Textures: %s is truncated!\n", Texture->Path);
+        *State = TEXTURE_STATE_FAILED;
+    }
+    else
+    {
+        Texture->Width      = (i32) Header->Width;
+        Texture->Height     = (i32) Header->Height;
+        Texture->Format     = Header->Format;
+        Texture->LevelCount = Header->LevelCount;
+        Texture->Cooked     = Header;
+    }
+    return true;
+}
+
+// Images are decoded to RGBA8 - TGAs straight into the staging slot, anything else through stb
+u32 TextureStreamerDecodeImage(TEXTURE_STREAMER *Streamer, STREAMED_TEXTURE *Texture)
+{
+    // The file is read into this worker's scratch stack and decoded from memory
+    MEMORY_SCRATCH Scratch;
+    size_t FileSize = 0;
+    u8 *File = AssetLoad(Scratch.Arena, Texture->Path, &FileSize);
+
+    u32 State = TEXTURE_STATE_DECODED;
+    Texture->Format     = COOKED_FORMAT_RGBA8;
+    Texture->LevelCount = 1;
+    TGA_INFO Tga = {};
+    if(File && TgaParseHeader(File, FileSize, &Tga))
+    {
+        // Fast path - straight into the staging slot, already bottom-up
+        Texture->Width  = Tga.Width;
+        Texture->Height = Tga.Height;
+        if((size_t) Tga.Width * (size_t) Tga.Height * 4 > Streamer->StagingSlotSize)
+        {
+            printf("Textures: %s (%dx%d) exceeds staging slot size!\n", Texture->Path, Texture->Width, Texture->Height);
+            State = TEXTURE_STATE_FAILED;
+        }
+        else if(!TgaDecode(File, FileSize, &Tga, (u32 *) Texture->Staging))
+        {
+            printf("Textures: %s is truncated!\n", Texture->Path);
+            State = TEXTURE_STATE_FAILED;
+        }
+    }
+    else
+    {
+        // Everything else goes through stb, which allocates its own buffer
+        i32 Channels = 0;
+        u8 *Pixels = File ? stbi_load_from_memory(File, (i32) FileSize, &Texture->Width, &Texture->Height, &Channels, 4) : 0;
+        size_t Size = (size_t) Texture->Width * (size_t) Texture->Height * 4;
+
+        if(!Pixels)
+        {
+            printf("Textures: Failed to decode %s!\n", Texture->Path);
+            State = TEXTURE_STATE_FAILED;
+        }
+        else if(Size > Streamer->StagingSlotSize)
+        {
+            printf("Textures: %s (%dx%d) exceeds staging slot size!\n", Texture->Path, Texture->Width, Texture->Height);
+            State = TEXTURE_STATE_FAILED;
+        }
+
+        if(State == TEXTURE_STATE_DECODED)
+        {
+            // Copy rows in reverse - flips to OpenGL's bottom-up origin without a separate pass
+            size_t RowSize = (size_t) Texture->Width * 4;
+            for(i32 Row = 0; Row < Texture->Height; ++Row)
+            {
+                memcpy(Texture->Staging + (Row * RowSize), Pixels + ((Texture->Height - 1 - Row) * RowSize), RowSize);
+            }
+        }
+
+        if(Pixels)
+        {
+            stbi_image_free(Pixels);
+        }
+    }
+    return State;
+}
+
+// Job - the staging slot was assigned when the job was started
+void TextureStreamerDecode(void *Data)
+{
+    PROFILE_SCOPE("TextureStreamerDecode");
+    TEXTURE_STREAMER *Streamer  = ((TEXTURE_DECODE_JOB *) Data)->Streamer;
+    u32 Index                   = ((TEXTURE_DECODE_JOB *) Data)->Index;
+    STREAMED_TEXTURE *Texture   = &Streamer->Textures[Index];
+
+    u32 State = TEXTURE_STATE_DECODED;
+    if(!TextureStreamerLoadCooked(Streamer, Texture, &State))
+    {
+        State = TextureStreamerDecodeImage(Streamer, Texture);
+    }
+
+    // Hand back to the main thread
+    std::lock_guard<std::mutex> Guard(Streamer->Lock);
+    Texture->State = State;
+    Streamer->Completed[Streamer->CompletedWrite++ % TEXTURE_STREAMER_MAX_TEXTURES] = Index;
+}
+
+void TextureStreamerCreate(TEXTURE_STREAMER *Streamer, MEMORY_ARENA *Arena, JOB_SYSTEM *Jobs, TEXTURE_STREAMER_SETTINGS Settings)
+{
+    Streamer->Jobs = Jobs;
+
+    // Arrays
+    Streamer->Textures      = (STREAMED_TEXTURE *) Arena->Alloc(sizeof(STREAMED_TEXTURE) * TEXTURE_STREAMER_MAX_TEXTURES, alignof(STREAMED_TEXTURE));
+    Streamer->Requests      = (u32 *) Arena->Alloc(sizeof(u32) * TEXTURE_STREAMER_MAX_TEXTURES, alignof(u32));
+    Streamer->Completed     = (u32 *) Arena->Alloc(sizeof(u32) * TEXTURE_STREAMER_MAX_TEXTURES, alignof(u32));
+    Assert(Streamer->Textures && Streamer->Requests && Streamer->Completed, "Textures: Failed to allocate streamer arrays!");
+
+    // Staging slots
+    Streamer->StagingSlotSize   = Settings.StagingSlotSize;
+    Streamer->StagingMemory     = (u8 *) Arena->Alloc(Settings.StagingSlotSize * Settings.StagingSlotCount, 64);
+    Streamer->FreeSlots         = (u32 *) Arena->Alloc(sizeof(u32) * Settings.StagingSlotCount, alignof(u32));
+    Assert(Streamer->StagingMemory && Streamer->FreeSlots, "Textures: Failed to allocate staging memory!");
+    for(u32 i = 0; i < Settings.StagingSlotCount; ++i)
+    {
+        Streamer->FreeSlots[Streamer->FreeSlotCount++] = i;
+    }
+
+    // Upload ring - persistently mapped so the main thread only ever memcpys into it
+    Streamer->UploadBudget = Settings.UploadBudget;
+    GLbitfield MapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &Streamer->PixelBuffer);
+    glNamedBufferStorage(Streamer->PixelBuffer, Streamer->UploadBudget * TEXTURE_STREAMER_FRAMES_IN_FLIGHT, 0, MapFlags);
+    Streamer->PixelBufferMemory = (u8 *) glMapNamedBufferRange(Streamer->PixelBuffer, 0, Streamer->UploadBudget * TEXTURE_STREAMER_FRAMES_IN_FLIGHT, MapFlags);
+    Assert(Streamer->PixelBufferMemory, "Textures: Failed to map pixel buffer!");
+
+    // Magenta/black checkerboard placeholder
+    u32 Checker[] =
+    {
+        0xFFFF00FF, 0xFF000000,
+        0xFF000000, 0xFFFF00FF,
+    };
+    glCreateTextures(GL_TEXTURE_2D, 1, &Streamer->Placeholder);
+    glTextureStorage2D(Streamer->Placeholder, 1, GL_RGBA8, 2, 2);
+    glTextureParameteri(Streamer->Placeholder, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(Streamer->Placeholder, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTextureSubImage2D(Streamer->Placeholder, 0, 0, 0, 2, 2, GL_RGBA, GL_UNSIGNED_BYTE, Checker);
+}
+
+void TextureStreamerDestroy(TEXTURE_STREAMER *Streamer)
+{
+    // Decodes in flight write into staging memory - let them finish
+    JobWait(Streamer->Jobs, &Streamer->Decoding);
+
+    for(u32 i = 0; i < Streamer->TextureCount; ++i)
+    {
+        if(Streamer->Textures[i].Handle)
+        {
+            glDeleteTextures(1, &Streamer->Textures[i].Handle);
+        }
+    }
+
+    for(u32 i = 0; i < TEXTURE_STREAMER_FRAMES_IN_FLIGHT; ++i)
+    {
+        if(Streamer->Fences[i])
+        {
+            glDeleteSync(Streamer->Fences[i]);
+        }
+    }
+
+    glUnmapNamedBuffer(Streamer->PixelBuffer);
+    glDeleteBuffers(1, &Streamer->PixelBuffer);
+    glDeleteTextures(1, &Streamer->Placeholder);
+    if(Streamer->Palette)
+    {
+        glDeleteTextures(1, &Streamer->Palette);
+    }
+}
+
+TEXTURE_HANDLE TextureStreamerRequest(TEXTURE_STREAMER *Streamer, const char *Path)
+{
+    Assert(Streamer->TextureCount < TEXTURE_STREAMER_MAX_TEXTURES, "Textures: Too many streamed textures!");
+
+    TEXTURE_HANDLE Result = {};
+    Result.Index = Streamer->TextureCount++;
+
+    STREAMED_TEXTURE *Texture = &Streamer->Textures[Result.Index];
+    *Texture = {};
+    FormatString(sizeof(Texture->Path), Texture->Path, "%s", Path);
+
+    Texture->State = TEXTURE_STATE_QUEUED;
+    Streamer->Requests[Streamer->RequestWrite++ % TEXTURE_STREAMER_MAX_TEXTURES] = Result.Index;
+    ++Streamer->PendingCount;
+    return Result;
+}
+
+GLuint TextureStreamerGetHandle(TEXTURE_STREAMER *Streamer, TEXTURE_HANDLE Handle)
+{
+    // Decode jobs write State under the lock - everything else that touches it is on this thread
+    STREAMED_TEXTURE *Texture = &Streamer->Textures[Handle.Index];
+    std::lock_guard<std::mutex> Guard(Streamer->Lock);
+    return (Texture->State == TEXTURE_STATE_RESIDENT) ? Texture->Handle : Streamer->Placeholder;
+}
+
+// Permutation bits a draw of the texture needs - palettized textures hold indices that only mean anything through the
+// palette. Zero until resident, since the placeholder is plain RGBA8
+u32 TextureStreamerPermutation(TEXTURE_STREAMER *Streamer, TEXTURE_HANDLE Handle)
+{
+    STREAMED_TEXTURE *Texture = &Streamer->Textures[Handle.Index];
+    std::lock_guard<std::mutex> Guard(Streamer->Lock);
+    bool Palettized = (Texture->State == TEXTURE_STATE_RESIDENT && Texture->Format == COOKED_FORMAT_PALETTE8);
+    return Palettized ? SHADER_PALETTE : 0;
+}
+
+// Dimensions of the level being uploaded and where its texels are in staging
+COOKED_TEXTURE_LEVEL TextureStreamerLevel(STREAMED_TEXTURE *Texture, u8 **Texels)
+{
+    if(Texture->Cooked)
+    {
+        COOKED_TEXTURE_LEVEL Result = Texture->Cooked->Levels[Texture->Level];
+        *Texels = (u8 *) (Texture->Cooked + 1) + Result.Offset;
+        return Result;
+    }
+
+    COOKED_TEXTURE_LEVEL Result = {};
+    Result.Width    = (u32) Texture->Width;
+    Result.Height   = (u32) Texture->Height;
+    Result.Size     = Result.Width * Result.Height * 4;
+    *Texels = Texture->Staging;
+    return Result;
+}
+
+// Palettized textures all index one palette (see tools/texture_cooker.cpp), so the first one loaded provides it.
+// Returns false for a texture cooked against any other palette - its indices would pick the wrong colours
+bool TextureStreamerBindPalette(TEXTURE_STREAMER *Streamer, STREAMED_TEXTURE *Texture)
+{
+    if(Streamer->Palette)
+    {
+        if(Texture->Cooked->PaletteHash != Streamer->PaletteHash)
+        {
+            printf("Textures: %s was cooked against a different palette!\n", Texture->Path);
+            return false;
+        }
+        return true;
+    }
+
+    // Uploaded from staging directly - the pixel buffer is only for budgeted uploads
+    glCreateTextures(GL_TEXTURE_2D, 1, &Streamer->Palette);
+    glTextureStorage2D(Streamer->Palette, 1, GL_RGBA8, 256, 1);
+    glTextureParameteri(Streamer->Palette, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(Streamer->Palette, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTextureSubImage2D(Streamer->Palette, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, (u8 *) (Texture->Cooked + 1) + Texture->Cooked->PaletteOffset);
+    GLStateCount(GL_CALL_UPLOAD);
+    GLStateBindTexture(TEXTURE_UNIT_PALETTE, Streamer->Palette);
+    Streamer->PaletteHash = Texture->Cooked->PaletteHash;
+    return true;
+}
+
+// Immutable storage for every level, sampled with mips when there are any
+void TextureStreamerCreateTexture(TEXTURE_STREAMER *Streamer, STREAMED_TEXTURE *Texture)
+{
+    bool Palettized = (Texture->Format == COOKED_FORMAT_PALETTE8);
+    bool Mipmapped  = (Texture->LevelCount > 1);
+    GLint MinFilter = Palettized ? (Mipmapped ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST) : (Mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &Texture->Handle);
+    glTextureStorage2D(Texture->Handle, Texture->LevelCount, CookedInternalFormats[Texture->Format], Texture->Width, Texture->Height);
+    glTextureParameteri(Texture->Handle, GL_TEXTURE_MIN_FILTER, MinFilter);
+    glTextureParameteri(Texture->Handle, GL_TEXTURE_MAG_FILTER, Palettized ? GL_NEAREST : GL_LINEAR);
+    glTextureParameteri(Texture->Handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(Texture->Handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if(Texture->Cooked)
+    {
+        for(u32 i = 0; i < Texture->LevelCount; ++i)
+        {
+            Streamer->VramBytes += Texture->Cooked->Levels[i].Size;
+        }
+    }
+    else
+    {
+        Streamer->VramBytes += (u64) Texture->Width * (u64) Texture->Height * 4;
+    }
+}
+
+// Call once per frame from the thread that owns the OpenGL context
+void TextureStreamerUpdate(TEXTURE_STREAMER *Streamer)
+{
+    PROFILE_SCOPE("TextureStreamerUpdate");
+    PROFILE_GPU_SCOPE("GPU Texture upload");
+
+    // Start a decode for each request that can get a staging slot
+    while(Streamer->RequestRead != Streamer->RequestWrite && Streamer->FreeSlotCount > 0)
+    {
+        u32 Index = Streamer->Requests[Streamer->RequestRead++ % TEXTURE_STREAMER_MAX_TEXTURES];
+        STREAMED_TEXTURE *Texture = &Streamer->Textures[Index];
+        Texture->StagingSlot    = Streamer->FreeSlots[--Streamer->FreeSlotCount];
+        Texture->Staging        = Streamer->StagingMemory + (Texture->StagingSlot * Streamer->StagingSlotSize);
+        Texture->Cooked         = 0;
+        Texture->Level          = 0;
+        Texture->RowsUploaded   = 0;
+        Texture->State          = TEXTURE_STATE_DECODING;
+
+        TEXTURE_DECODE_JOB *Job = (TEXTURE_DECODE_JOB *) JobAlloc(Streamer->Jobs, sizeof(TEXTURE_DECODE_JOB));
+        Job->Streamer   = Streamer;
+        Job->Index      = Index;
+        JobRunBackground(Streamer->Jobs, TextureStreamerDecode, Job, &Streamer->Decoding);
+    }
+
+    u32 Region = Streamer->Frame % TEXTURE_STREAMER_FRAMES_IN_FLIGHT;
+
+    // Never stall - if the GPU is still reading this region then skip uploads this frame
+    if(Streamer->Fences[Region])
+    {
+        GLenum Status = glClientWaitSync(Streamer->Fences[Region], 0, 0);
+        if(Status == GL_TIMEOUT_EXPIRED)
+        {
+            return;
+        }
+        glDeleteSync(Streamer->Fences[Region]);
+        Streamer->Fences[Region] = 0;
+    }
+
+    size_t RegionOffset = Region * Streamer->UploadBudget;
+    size_t Used = 0;
+    bool Uploaded = false;
+
+    while(true)
+    {
+        // Peek the oldest completed decode
+        u32 Index = 0;
+        {
+            std::lock_guard<std::mutex> Guard(Streamer->Lock);
+            if(Streamer->CompletedRead == Streamer->CompletedWrite)
+            {
+                break;
+            }
+            Index = Streamer->Completed[Streamer->CompletedRead % TEXTURE_STREAMER_MAX_TEXTURES];
+        }
+
+        STREAMED_TEXTURE *Texture = &Streamer->Textures[Index];
+        u8 *Texels = 0;
+        COOKED_TEXTURE_LEVEL Level = {};
+        u32 BlockSize   = CookedBlockSize(Texture->Format);
+        size_t RowSize  = 0;
+        if(Texture->State == TEXTURE_STATE_DECODED)
+        {
+            Level   = TextureStreamerLevel(Texture, &Texels);
+            RowSize = CookedRowBytes(Texture->Format, Level.Width);
+        }
+        if(Texture->State == TEXTURE_STATE_DECODED && RowSize > Streamer->UploadBudget)
+        {
+            // A single row doesn't fit in the whole budget - would never make progress
+            printf("Textures: %s row exceeds upload budget!\n", Texture->Path);
+            Texture->State = TEXTURE_STATE_FAILED;
+        }
+        if(Texture->State == TEXTURE_STATE_DECODED && Texture->Format == COOKED_FORMAT_PALETTE8 && !Texture->Handle && !TextureStreamerBindPalette(Streamer, Texture))
+        {
+            Texture->State = TEXTURE_STATE_FAILED;
+        }
+
+        if(Texture->State == TEXTURE_STATE_DECODED)
+        {
+            // Rows of 4x4 blocks for compressed formats, texel rows otherwise
+            i32 LevelRows = (i32) ((Level.Height + BlockSize - 1) / BlockSize);
+            size_t Remaining = (Used < Streamer->UploadBudget) ? (Streamer->UploadBudget - Used) : 0;
+            i32 RowsAvailable = (i32) (Remaining / RowSize);
+            i32 RowsRemaining = LevelRows - Texture->RowsUploaded;
+            i32 Rows = (RowsAvailable < RowsRemaining) ? RowsAvailable : RowsRemaining;
+            if(Rows <= 0)
+            {
+                // Budget spent - large textures continue next frame
+                break;
+            }
+
+            if(!Texture->Handle)
+            {
+                TextureStreamerCreateTexture(Streamer, Texture);
+            }
+
+            // Only bound once something is uploaded - idle frames make no GL calls. Palette index rows aren't 4 byte multiples
+            GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, Streamer->PixelBuffer);
+            GLStateSetUnpackAlignment(1);
+
+            // Copy into this frame's region and source the upload from the buffer offset
+            size_t Bytes    = (size_t) Rows * RowSize;
+            i32 Y           = Texture->RowsUploaded * (i32) BlockSize;
+            i32 Height      = ((i32) Level.Height - Y < Rows * (i32) BlockSize) ? (i32) Level.Height - Y : Rows * (i32) BlockSize;
+            void *Offset    = (void *) (RegionOffset + Used);
+            memcpy(Streamer->PixelBufferMemory + RegionOffset + Used, Texels + (Texture->RowsUploaded * RowSize), Bytes);
+            if(BlockSize > 1)
+            {
+                glCompressedTextureSubImage2D(Texture->Handle, Texture->Level, 0, Y, Level.Width, Height, CookedInternalFormats[Texture->Format], (GLsizei) Bytes, Offset);
+            }
+            else
+            {
+                glTextureSubImage2D(Texture->Handle, Texture->Level, 0, Y, Level.Width, Height, CookedPixelFormats[Texture->Format], GL_UNSIGNED_BYTE, Offset);
+            }
+
+            GLStateCount(GL_CALL_UPLOAD);
+
+            // Keep offsets aligned for the next upload
+            Used += (Bytes + 63) & ~(size_t) 63;
+            Texture->RowsUploaded += Rows;
+            Streamer->BytesUploaded += Bytes;
+            Uploaded = true;
+
+            if(Texture->RowsUploaded < LevelRows)
+            {
+                break;
+            }
+
+            // Next level goes in with whatever budget is left
+            Texture->RowsUploaded = 0;
+            if(++Texture->Level < Texture->LevelCount)
+            {
+                continue;
+            }
+            Texture->State = TEXTURE_STATE_RESIDENT;
+            ++Streamer->ResidentCount;
+        }
+
+        // Release the staging slot and pop
+        {
+            std::lock_guard<std::mutex> Guard(Streamer->Lock);
+            if(Texture->Staging)
+            {
+                Streamer->FreeSlots[Streamer->FreeSlotCount++] = Texture->StagingSlot;
+                Texture->Staging = 0;
+                Texture->Cooked = 0;
+            }
+            ++Streamer->CompletedRead;
+        }
+        --Streamer->PendingCount;
+    }
+
+    // Loads outside the streamer upload from client memory
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if(Uploaded)
+    {
+        Streamer->Fences[Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    ++Streamer->Frame;
+}
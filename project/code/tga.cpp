@@ -0,0 +1,328 @@
+// TGA loader
+// Fast path for the textures we ship - true colour (24/32 bit) and greyscale (8 bit), raw or RLE. Pixels are decoded
+// straight into the caller's buffer as RGBA8 in OpenGL's bottom-up row order; top-left origin files are handled by
+// walking output rows in reverse, never by a flip pass. Swizzles are AVX2, SSSE3 or scalar, selected at runtime.
+// Anything else (colour mapped, 16 bit, right-to-left) is rejected by TgaParseHeader so callers can fall back to stb_image.
+#include <immintrin.h>
+
+#define TGA_HEADER_SIZE 18
+
+typedef enum TGA_IMAGE_TYPE
+{
+    TGA_IMAGE_TRUE_COLOUR       = 2,
+    TGA_IMAGE_GREYSCALE         = 3,
+    TGA_IMAGE_RLE_TRUE_COLOUR   = 10,
+    TGA_IMAGE_RLE_GREYSCALE     = 11,
+} TGA_IMAGE_TYPE;
+
+typedef enum TGA_KERNEL
+{
+    TGA_KERNEL_SCALAR,
+    TGA_KERNEL_SSSE3,
+    TGA_KERNEL_AVX2,
+} TGA_KERNEL;
+
+typedef struct TGA_INFO
+{
+    i32 Width;
+    i32 Height;
+    u32 BytesPerPixel;
+    bool Compressed;
+    bool TopDown;
+    size_t DataOffset;
+} TGA_INFO;
+
+// Converts Count source pixels to RGBA8, reading exactly Count * BytesPerPixel bytes
+typedef void TGA_SWIZZLE(const u8 *Source, u32 *Dest, u32 Count);
+
+typedef struct TGA_KERNELS
+{
+    TGA_KERNEL Kernel;
+    TGA_SWIZZLE *Swizzle[5];    // By bytes per pixel
+} TGA_KERNELS;
+
+static const char *TgaKernelNames[] = {"scalar", "SSSE3", "AVX2"};
+
+inline u32 TgaPixel(const u8 *Source, u32 BytesPerPixel)
+{
+    switch(BytesPerPixel)
+    {
+        case 1: return 0xFF000000 | (Source[0] << 16) | (Source[0] << 8) | Source[0];
+        case 3: return 0xFF000000 | (Source[0] << 16) | (Source[1] << 8) | Source[2];
+        default: return ((u32) Source[3] << 24) | (Source[0] << 16) | (Source[1] << 8) | Source[2];
+    }
+}
+
+void TgaSwizzleGreyScalar(const u8 *Source, u32 *Dest, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Dest[i] = TgaPixel(Source + i, 1);
+    }
+}
+
+void TgaSwizzleBGRScalar(const u8 *Source, u32 *Dest, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Dest[i] = TgaPixel(Source + i * 3, 3);
+    }
+}
+
+void TgaSwizzleBGRAScalar(const u8 *Source, u32 *Dest, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i)
+    {
+        Dest[i] = TgaPixel(Source + i * 4, 4);
+    }
+}
+
+__attribute__((target("ssse3")))
+void TgaSwizzleGreySSSE3(const u8 *Source, u32 *Dest, u32 Count)
+{
+    // 16 grey bytes -> 4 x 4 RGBA pixels
+    __m128i Alpha = _mm_set1_epi32((i32) 0xFF000000);
+    __m128i Masks[4];
+    for(i32 j = 0; j < 4; ++j)
+    {
+        char B = (char) (j * 4);
+        Masks[j] = _mm_setr_epi8(B, B, B, -1, B + 1, B + 1, B + 1, -1, B + 2, B + 2, B + 2, -1, B + 3, B + 3, B + 3, -1);
+    }
+
+    u32 i = 0;
+    for(; i + 16 <= Count; i += 16)
+    {
+        __m128i Grey = _mm_loadu_si128((const __m128i *) (Source + i));
+        for(i32 j = 0; j < 4; ++j)
+        {
+            _mm_storeu_si128((__m128i *) (Dest + i + j * 4), _mm_or_si128(_mm_shuffle_epi8(Grey, Masks[j]), Alpha));
+        }
+    }
+    TgaSwizzleGreyScalar(Source + i, Dest + i, Count - i);
+}
+
+__attribute__((target("ssse3")))
+void TgaSwizzleBGRSSSE3(const u8 *Source, u32 *Dest, u32 Count)
+{
+    // 12 bytes -> 4 pixels, the load reads 16 so stop while 6 pixels are left
+    __m128i Mask  = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    __m128i Alpha = _mm_set1_epi32((i32) 0xFF000000);
+
+    u32 i = 0;
+    for(; i + 6 <= Count; i += 4)
+    {
+        __m128i BGR = _mm_loadu_si128((const __m128i *) (Source + i * 3));
+        _mm_storeu_si128((__m128i *) (Dest + i), _mm_or_si128(_mm_shuffle_epi8(BGR, Mask), Alpha));
+    }
+    TgaSwizzleBGRScalar(Source + i * 3, Dest + i, Count - i);
+}
+
+__attribute__((target("ssse3")))
+void TgaSwizzleBGRASSSE3(const u8 *Source, u32 *Dest, u32 Count)
+{
+    __m128i Mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        __m128i BGRA = _mm_loadu_si128((const __m128i *) (Source + i * 4));
+        _mm_storeu_si128((__m128i *) (Dest + i), _mm_shuffle_epi8(BGRA, Mask));
+    }
+    TgaSwizzleBGRAScalar(Source + i * 4, Dest + i, Count - i);
+}
+
+__attribute__((target("avx2")))
+void TgaSwizzleBGRAVX2(const u8 *Source, u32 *Dest, u32 Count)
+{
+    // 24 bytes -> 8 pixels, loaded as two 12 byte halves so each lane shuffles like the SSSE3 path.
+    // The second load reads 16, so stop while 10 pixels are left
+    __m256i Mask  = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                     2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    __m256i Alpha = _mm256_set1_epi32((i32) 0xFF000000);
+
+    u32 i = 0;
+    for(; i + 10 <= Count; i += 8)
+    {
+        __m128i Low = _mm_loadu_si128((const __m128i *) (Source + i * 3));
+        __m128i High = _mm_loadu_si128((const __m128i *) (Source + i * 3 + 12));
+        __m256i BGR = _mm256_inserti128_si256(_mm256_castsi128_si256(Low), High, 1);
+        _mm256_storeu_si256((__m256i *) (Dest + i), _mm256_or_si256(_mm256_shuffle_epi8(BGR, Mask), Alpha));
+    }
+    TgaSwizzleBGRSSSE3(Source + i * 3, Dest + i, Count - i);
+}
+
+__attribute__((target("avx2")))
+void TgaSwizzleBGRAAVX2(const u8 *Source, u32 *Dest, u32 Count)
+{
+    __m256i Mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    u32 i = 0;
+    for(; i + 8 <= Count; i += 8)
+    {
+        __m256i BGRA = _mm256_loadu_si256((const __m256i *) (Source + i * 4));
+        _mm256_storeu_si256((__m256i *) (Dest + i), _mm256_shuffle_epi8(BGRA, Mask));
+    }
+    TgaSwizzleBGRASSSE3(Source + i * 4, Dest + i, Count - i);
+}
+
+// Kernel sets fall back a level for formats without a wider version
+TGA_KERNELS TgaSelectKernels(TGA_KERNEL Kernel)
+{
+    TGA_KERNELS Result = {};
+    Result.Kernel       = Kernel;
+    Result.Swizzle[1]   = (Kernel >= TGA_KERNEL_SSSE3) ? TgaSwizzleGreySSSE3 : TgaSwizzleGreyScalar;
+    Result.Swizzle[3]   = (Kernel == TGA_KERNEL_AVX2) ? TgaSwizzleBGRAVX2 : ((Kernel == TGA_KERNEL_SSSE3) ? TgaSwizzleBGRSSSE3 : TgaSwizzleBGRScalar);
+    Result.Swizzle[4]   = (Kernel == TGA_KERNEL_AVX2) ? TgaSwizzleBGRAAVX2 : ((Kernel == TGA_KERNEL_SSSE3) ? TgaSwizzleBGRASSSE3 : TgaSwizzleBGRAScalar);
+    return Result;
+}
+
+TGA_KERNEL TgaDetectKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return TGA_KERNEL_AVX2;
+    }
+    if(__builtin_cpu_supports("ssse3"))
+    {
+        return TGA_KERNEL_SSSE3;
+    }
+    return TGA_KERNEL_SCALAR;
+}
+
+// Detected once, on first use from any thread
+TGA_KERNELS *TgaGetKernels()
+{
+    static TGA_KERNELS Kernels = TgaSelectKernels(TgaDetectKernel());
+    return &Kernels;
+}
+
+// RLE runs - SSE2 is always there on x64
+inline void TgaFill(u32 *Dest, u32 Pixel, u32 Count)
+{
+    __m128i Value = _mm_set1_epi32((i32) Pixel);
+    u32 i = 0;
+    for(; i + 4 <= Count; i += 4)
+    {
+        _mm_storeu_si128((__m128i *) (Dest + i), Value);
+    }
+    for(; i < Count; ++i)
+    {
+        Dest[i] = Pixel;
+    }
+}
+
+// False if Data isn't a TGA this loader handles
+bool TgaParseHeader(const u8 *Data, size_t Size, TGA_INFO *Info)
+{
+    if(Size < TGA_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    u32 IdLength        = Data[0];
+    u32 ColourMapType   = Data[1];
+    u32 ImageType       = Data[2];
+    i32 Width           = Data[12] | (Data[13] << 8);
+    i32 Height          = Data[14] | (Data[15] << 8);
+    u32 PixelDepth      = Data[16];
+    u32 Descriptor      = Data[17];
+
+    bool Greyscale  = (ImageType == TGA_IMAGE_GREYSCALE || ImageType == TGA_IMAGE_RLE_GREYSCALE);
+    bool TrueColour = (ImageType == TGA_IMAGE_TRUE_COLOUR || ImageType == TGA_IMAGE_RLE_TRUE_COLOUR);
+    if(ColourMapType != 0 || (!Greyscale && !TrueColour) || Width == 0 || Height == 0 || (Descriptor & 0x10))
+    {
+        return false;
+    }
+    if((Greyscale && PixelDepth != 8) || (TrueColour && PixelDepth != 24 && PixelDepth != 32))
+    {
+        return false;
+    }
+
+    *Info               = {};
+    Info->Width         = Width;
+    Info->Height        = Height;
+    Info->BytesPerPixel = PixelDepth / 8;
+    Info->Compressed    = (ImageType == TGA_IMAGE_RLE_TRUE_COLOUR || ImageType == TGA_IMAGE_RLE_GREYSCALE);
+    Info->TopDown       = (Descriptor & 0x20) != 0;
+    Info->DataOffset    = TGA_HEADER_SIZE + IdLength;
+    return Info->DataOffset <= Size;
+}
+
+// Writes Width * Height RGBA8 pixels to Output, bottom row first. False if the pixel data is truncated
+bool TgaDecode(const u8 *Data, size_t Size, TGA_INFO *Info, u32 *Output)
+{
+    PROFILE_SCOPE("TgaDecode");
+    TGA_SWIZZLE *Swizzle    = TgaGetKernels()->Swizzle[Info->BytesPerPixel];
+    u32 Width               = (u32) Info->Width;
+    u32 Height              = (u32) Info->Height;
+    u32 BytesPerPixel       = Info->BytesPerPixel;
+    const u8 *Source        = Data + Info->DataOffset;
+    const u8 *End           = Data + Size;
+
+    // TGA rows are bottom-up unless the descriptor says otherwise
+    u32 RowStep     = Info->TopDown ? (u32) -1 : 1;
+    u32 Row         = Info->TopDown ? Height - 1 : 0;
+
+    if(!Info->Compressed)
+    {
+        if((size_t) (End - Source) < (size_t) Width * Height * BytesPerPixel)
+        {
+            return false;
+        }
+        for(u32 i = 0; i < Height; ++i, Row += RowStep)
+        {
+            Swizzle(Source, Output + (size_t) Row * Width, Width);
+            Source += Width * BytesPerPixel;
+        }
+        return true;
+    }
+
+    // Packets can run across rows
+    u32 RowsLeft    = Height;
+    u32 X           = 0;
+    u32 *Dest       = Output + (size_t) Row * Width;
+    while(RowsLeft > 0)
+    {
+        if(Source >= End)
+        {
+            return false;
+        }
+        u32 Header  = *Source++;
+        u32 Count   = (Header & 0x7F) + 1;
+        bool Run    = (Header & 0x80) != 0;
+
+        size_t PacketBytes = Run ? BytesPerPixel : (size_t) Count * BytesPerPixel;
+        if((size_t) (End - Source) < PacketBytes)
+        {
+            return false;
+        }
+        u32 Pixel = Run ? TgaPixel(Source, BytesPerPixel) : 0;
+
+        while(Count > 0 && RowsLeft > 0)
+        {
+            u32 Span = (Count < Width - X) ? Count : Width - X;
+            if(Run)
+            {
+                TgaFill(Dest + X, Pixel, Span);
+            }
+            else
+            {
+                Swizzle(Source, Dest + X, Span);
+                Source += Span * BytesPerPixel;
+            }
+
+            X       += Span;
+            Count   -= Span;
+            if(X == Width && --RowsLeft > 0)
+            {
+                X       = 0;
+                Row     += RowStep;
+                Dest    = Output + (size_t) Row * Width;
+            }
+        }
+        Source += Run ? BytesPerPixel : Count * BytesPerPixel;
+    }
+    return true;
+}
@@ -0,0 +1,1597 @@
+// BSP level compiler
+// Brushes -> CSG -> solid-leaf BSP -> portals -> outside fill -> potentially visible sets -> level file (see level.h)
+//
+// Usage:
+//   bsp_compiler input.map output.lvl [--threads N] [--scaling]
+//   bsp_compiler --generate RoomsX RoomsZ output.map
+//
+// Map format (text, one entry per line, # comments):
+//   start X Y Z                   - a point inside the playable space, used for leak detection
+//   brush                         - convex solid made from the following outward facing planes
+//   plane NX NY NZ D              - Dot(N, P) = D
+//   end
+//   light X Y Z R G B RADIUS      - point light, only used by tools/lightmap_baker.cpp
+
+// CRT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Threading and timing
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// Core
+#include "../core/core.h"
+#include "../level.h"
+
+#define BSP_EPSILON             0.01
+#define BSP_NORMAL_EPSILON      0.00001
+#define BSP_MAX_POINTS          64
+#define BSP_WORLD_MARGIN        64.0
+#define BSP_MAX_FLOW_DEPTH      64
+#define BSP_MAX_THREADS         64
+#define BSP_UV_SCALE            0.25
+
+typedef struct V3D
+{
+    f64 X, Y, Z;
+} V3D;
+
+inline V3D operator+(V3D A, V3D B) { return {A.X + B.X, A.Y + B.Y, A.Z + B.Z}; }
+inline V3D operator-(V3D A, V3D B) { return {A.X - B.X, A.Y - B.Y, A.Z - B.Z}; }
+inline V3D operator*(V3D A, f64 S) { return {A.X * S, A.Y * S, A.Z * S}; }
+inline f64 Dot(V3D A, V3D B) { return A.X * B.X + A.Y * B.Y + A.Z * B.Z; }
+inline V3D Cross(V3D A, V3D B) { return {A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X}; }
+inline f64 Length(V3D A) { return sqrt(Dot(A, A)); }
+inline V3D MinV3D(V3D A, V3D B) { return {fmin(A.X, B.X), fmin(A.Y, B.Y), fmin(A.Z, B.Z)}; }
+inline V3D MaxV3D(V3D A, V3D B) { return {fmax(A.X, B.X), fmax(A.Y, B.Y), fmax(A.Z, B.Z)}; }
+
+// Growable array - pointers into it are invalidated by Push
+template<typename T>
+struct BUFFER
+{
+    T   *Data;
+    u32 Count;
+    u32 Capacity;
+
+    T *Push()
+    {
+        if(Count == Capacity)
+        {
+            Capacity    = Capacity ? Capacity * 2 : 64;
+            Data        = (T *) realloc(Data, sizeof(T) * Capacity);
+            Assert(Data, "BSP: Out of memory!");
+        }
+        T *Result = &Data[Count++];
+        memset((void *) Result, 0, sizeof(T));
+        return Result;
+    }
+
+    T &operator[](u32 Index)
+    {
+        return Data[Index];
+    }
+
+    void Free()
+    {
+        free(Data);
+        Data        = 0;
+        Count       = 0;
+        Capacity    = 0;
+    }
+};
+
+typedef struct WINDING
+{
+    u32 Count;
+    V3D Points[BSP_MAX_POINTS];
+} WINDING;
+
+// Stored in pairs - Plane ^ 1 is the same plane facing the other way
+typedef struct BSP_PLANE
+{
+    V3D Normal;
+    f64 Distance;
+} BSP_PLANE;
+
+typedef enum WINDING_SIDE
+{
+    SIDE_FRONT,
+    SIDE_BACK,
+    SIDE_ON,
+    SIDE_CROSS,
+} WINDING_SIDE;
+
+typedef struct BSP_BRUSH
+{
+    u32 FirstSide;
+    u32 SideCount;
+    V3D Min;
+    V3D Max;
+} BSP_BRUSH;
+
+typedef struct BSP_FACE
+{
+    WINDING Winding;
+    u32     Plane;
+    u32     Brush;
+} BSP_FACE;
+
+typedef struct BSP_NODE
+{
+    u32 Plane;
+    i32 Children[2];
+    u32 FirstFace;
+    u32 FaceCount;
+} BSP_NODE;
+
+typedef struct BSP_LEAF
+{
+    u32 Flags;
+    bool Outside;
+    u32 FirstPortal;
+    u32 PortalCount;
+    u32 FirstIndex;
+    u32 IndexCount;
+    V3D Min;
+    V3D Max;
+} BSP_LEAF;
+
+// Plane faces from Leaves[1] into Leaves[0]
+typedef struct BSP_PORTAL
+{
+    WINDING Winding;
+    u32     Plane;
+    u32     Leaves[2];
+} BSP_PORTAL;
+
+typedef struct BSP_FRAGMENT
+{
+    WINDING Winding;
+    i32     Leaf;
+    u32     Plane;
+} BSP_FRAGMENT;
+
+typedef struct BSP_COMPILER
+{
+    BUFFER<BSP_PLANE>       Planes;
+    BUFFER<u32>             BrushSides;
+    BUFFER<BSP_BRUSH>       Brushes;
+    BUFFER<BSP_FACE>        Faces;
+    BUFFER<u32>             NodeFaces;
+    BUFFER<BSP_NODE>        Nodes;
+    BUFFER<BSP_LEAF>        Leaves;
+    BUFFER<BSP_PORTAL>      Portals;
+    BUFFER<u32>             LeafPortals;
+    BUFFER<LEVEL_VERTEX>    Vertices;
+    BUFFER<u32>             Indices;
+
+    V3D                     Min;
+    V3D                     Max;
+    V3D                     Start;
+    bool                    HasStart;
+
+    // PVS - one uncompressed row per leaf
+    u32                     RowBytes;
+    u8                      *Visibility;
+    std::atomic<u32>        NextLeaf;
+} BSP_COMPILER;
+
+f64 SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - Start).count();
+}
+
+
+// Planes
+u32 FindPlane(BSP_COMPILER *Compiler, V3D Normal, f64 Distance)
+{
+    f64 InverseLength = 1.0 / Length(Normal);
+    Normal      = Normal * InverseLength;
+    Distance    *= InverseLength;
+
+    for(u32 i = 0; i < Compiler->Planes.Count; ++i)
+    {
+        BSP_PLANE *Plane = &Compiler->Planes[i];
+        if(fabs(Plane->Normal.X - Normal.X) < BSP_NORMAL_EPSILON && fabs(Plane->Normal.Y - Normal.Y) < BSP_NORMAL_EPSILON &&
+           fabs(Plane->Normal.Z - Normal.Z) < BSP_NORMAL_EPSILON && fabs(Plane->Distance - Distance) < BSP_EPSILON)
+        {
+            return i;
+        }
+    }
+
+    u32 Result = Compiler->Planes.Count;
+    *Compiler->Planes.Push() = {Normal, Distance};
+    *Compiler->Planes.Push() = {Normal * -1.0, -Distance};
+    return Result;
+}
+
+
+// Windings
+WINDING BaseWinding(BSP_PLANE *Plane, f64 Size)
+{
+    // Pick an up vector away from the major axis
+    V3D Up = {0, 0, 1};
+    if(fabs(Plane->Normal.Z) >= fabs(Plane->Normal.X) && fabs(Plane->Normal.Z) >= fabs(Plane->Normal.Y))
+    {
+        Up = {1, 0, 0};
+    }
+    Up = Up - Plane->Normal * Dot(Up, Plane->Normal);
+    Up = Up * (1.0 / Length(Up));
+    V3D Right   = Cross(Up, Plane->Normal);
+    V3D Origin  = Plane->Normal * Plane->Distance;
+
+    WINDING Result      = {};
+    Result.Count        = 4;
+    Result.Points[0]    = Origin - Right * Size + Up * Size;
+    Result.Points[1]    = Origin + Right * Size + Up * Size;
+    Result.Points[2]    = Origin + Right * Size - Up * Size;
+    Result.Points[3]    = Origin - Right * Size - Up * Size;
+
+    // Counter-clockwise when viewed from the front
+    if(Dot(Cross(Result.Points[1] - Result.Points[0], Result.Points[2] - Result.Points[0]), Plane->Normal) < 0)
+    {
+        V3D Swap            = Result.Points[1];
+        Result.Points[1]    = Result.Points[3];
+        Result.Points[3]    = Swap;
+    }
+
+    return Result;
+}
+
+WINDING_SIDE ClassifyWinding(WINDING *Winding, BSP_PLANE *Plane)
+{
+    bool Front  = false;
+    bool Back   = false;
+    for(u32 i = 0; i < Winding->Count; ++i)
+    {
+        f64 Distance = Dot(Winding->Points[i], Plane->Normal) - Plane->Distance;
+        Front   |= (Distance > BSP_EPSILON);
+        Back    |= (Distance < -BSP_EPSILON);
+    }
+
+    if(Front && Back)
+    {
+        return SIDE_CROSS;
+    }
+    if(Front)
+    {
+        return SIDE_FRONT;
+    }
+    if(Back)
+    {
+        return SIDE_BACK;
+    }
+    return SIDE_ON;
+}
+
+// Either output can be null, degenerate results come back with a count of 0
+void SplitWinding(WINDING *Winding, BSP_PLANE *Plane, WINDING *Front, WINDING *Back)
+{
+    f64 Distances[BSP_MAX_POINTS];
+    i32 Sides[BSP_MAX_POINTS];
+    for(u32 i = 0; i < Winding->Count; ++i)
+    {
+        Distances[i]    = Dot(Winding->Points[i], Plane->Normal) - Plane->Distance;
+        Sides[i]        = (Distances[i] > BSP_EPSILON) ? SIDE_FRONT : ((Distances[i] < -BSP_EPSILON) ? SIDE_BACK : SIDE_ON);
+    }
+
+    WINDING NewFront    = {};
+    WINDING NewBack     = {};
+    for(u32 i = 0; i < Winding->Count; ++i)
+    {
+        V3D Point = Winding->Points[i];
+        Assert(NewFront.Count < BSP_MAX_POINTS - 1 && NewBack.Count < BSP_MAX_POINTS - 1, "BSP: Winding point overflow!");
+
+        if(Sides[i] == SIDE_ON)
+        {
+            NewFront.Points[NewFront.Count++]   = Point;
+            NewBack.Points[NewBack.Count++]     = Point;
+            continue;
+        }
+        if(Sides[i] == SIDE_FRONT)
+        {
+            NewFront.Points[NewFront.Count++]   = Point;
+        }
+        else
+        {
+            NewBack.Points[NewBack.Count++]     = Point;
+        }
+
+        u32 Next = (i + 1) % Winding->Count;
+        if(Sides[Next] == SIDE_ON || Sides[Next] == Sides[i])
+        {
+            continue;
+        }
+
+        // Snap axial planes exactly to avoid drift
+        f64 T   = Distances[i] / (Distances[i] - Distances[Next]);
+        V3D Mid = Point + (Winding->Points[Next] - Point) * T;
+        f64 *Components         = &Mid.X;
+        const f64 *NormalAxes   = &Plane->Normal.X;
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            if(NormalAxes[Axis] == 1.0)
+            {
+                Components[Axis] = Plane->Distance;
+            }
+            else if(NormalAxes[Axis] == -1.0)
+            {
+                Components[Axis] = -Plane->Distance;
+            }
+        }
+
+        NewFront.Points[NewFront.Count++]   = Mid;
+        NewBack.Points[NewBack.Count++]     = Mid;
+    }
+
+    if(Front)
+    {
+        *Front          = NewFront;
+        Front->Count    = (NewFront.Count >= 3) ? NewFront.Count : 0;
+    }
+    if(Back)
+    {
+        *Back           = NewBack;
+        Back->Count     = (NewBack.Count >= 3) ? NewBack.Count : 0;
+    }
+}
+
+void ClipWinding(WINDING *Winding, BSP_PLANE *Plane)
+{
+    SplitWinding(Winding, Plane, Winding, 0);
+}
+
+V3D WindingCentre(WINDING *Winding)
+{
+    V3D Result = {};
+    for(u32 i = 0; i < Winding->Count; ++i)
+    {
+        Result = Result + Winding->Points[i];
+    }
+    return Result * (1.0 / Winding->Count);
+}
+
+
+// Map input
+void AddBoxBrush(FILE *File, V3D Min, V3D Max)
+{
+    fprintf(File, "brush\n");
+    fprintf(File, "plane 1 0 0 %g\nplane -1 0 0 %g\n", Max.X, -Min.X);
+    fprintf(File, "plane 0 1 0 %g\nplane 0 -1 0 %g\n", Max.Y, -Min.Y);
+    fprintf(File, "plane 0 0 1 %g\nplane 0 0 -1 %g\n", Max.Z, -Min.Z);
+    fprintf(File, "end\n");
+}
+
+// Grid of rooms with a doorway in every internal wall and a pillar in some rooms - Y is up
+bool GenerateMap(const char *Path, u32 RoomsX, u32 RoomsZ)
+{
+    FILE *File = fopen(Path, "w");
+    if(!File)
+    {
+        return false;
+    }
+
+    const f64 Size = 8.0, Height = 4.0, Wall = 0.25, Door = 1.0, DoorHeight = 3.0;
+    f64 SizeX = RoomsX * Size;
+    f64 SizeZ = RoomsZ * Size;
+
+    fprintf(File, "# Generated %ux%u rooms\n", RoomsX, RoomsZ);
+    fprintf(File, "start %g %g %g\n", Size * 0.5, Height * 0.5, Size * 0.5);
+
+    // Floor and ceiling
+    AddBoxBrush(File, {-Wall, -Wall, -Wall}, {SizeX + Wall, 0, SizeZ + Wall});
+    AddBoxBrush(File, {-Wall, Height, -Wall}, {SizeX + Wall, Height + Wall, SizeZ + Wall});
+
+    // Walls along Z at every X grid line, and along X at every Z grid line - corners overlap and are merged by CSG
+    for(u32 Axis = 0; Axis < 2; ++Axis)
+    {
+        u32 Lines   = (Axis == 0) ? RoomsX : RoomsZ;
+        u32 Cells   = (Axis == 0) ? RoomsZ : RoomsX;
+        for(u32 Line = 0; Line <= Lines; ++Line)
+        {
+            for(u32 Cell = 0; Cell < Cells; ++Cell)
+            {
+                f64 Across  = Line * Size;
+                f64 Start   = Cell * Size;
+                f64 End     = Start + Size;
+                f64 Middle  = Start + Size * 0.5;
+                bool Outer  = (Line == 0 || Line == Lines);
+
+                f64 Spans[3][4] = {};
+                u32 SpanCount   = 0;
+                if(Outer)
+                {
+                    Spans[SpanCount][0] = Start;        Spans[SpanCount][1] = End;          Spans[SpanCount][2] = 0;            Spans[SpanCount++][3] = Height;
+                }
+                else
+                {
+                    Spans[SpanCount][0] = Start;        Spans[SpanCount][1] = Middle - Door; Spans[SpanCount][2] = 0;           Spans[SpanCount++][3] = Height;
+                    Spans[SpanCount][0] = Middle + Door; Spans[SpanCount][1] = End;          Spans[SpanCount][2] = 0;           Spans[SpanCount++][3] = Height;
+                    Spans[SpanCount][0] = Middle - Door; Spans[SpanCount][1] = Middle + Door; Spans[SpanCount][2] = DoorHeight; Spans[SpanCount++][3] = Height;
+                }
+
+                for(u32 i = 0; i < SpanCount; ++i)
+                {
+                    if(Axis == 0)
+                    {
+                        AddBoxBrush(File, {Across - Wall, Spans[i][2], Spans[i][0] - Wall}, {Across + Wall, Spans[i][3], Spans[i][1] + Wall});
+                    }
+                    else
+                    {
+                        AddBoxBrush(File, {Spans[i][0] - Wall, Spans[i][2], Across - Wall}, {Spans[i][1] + Wall, Spans[i][3], Across + Wall});
+                    }
+                }
+            }
+        }
+    }
+
+    // A light in a corner of every room, clear of the pillars
+    for(u32 X = 0; X < RoomsX; ++X)
+    {
+        for(u32 Z = 0; Z < RoomsZ; ++Z)
+        {
+            fprintf(File, "light %g %g %g 1 0.9 0.7 12\n", (X + 0.3) * Size, Height - 0.5, (Z + 0.3) * Size);
+        }
+    }
+
+    // Pillars
+    for(u32 X = 0; X < RoomsX; ++X)
+    {
+        for(u32 Z = 0; Z < RoomsZ; ++Z)
+        {
+            if((X * 7 + Z * 3) % 4 == 1)
+            {
+                V3D Centre = {(X + 0.5) * Size, 0, (Z + 0.5) * Size};
+                AddBoxBrush(File, {Centre.X - 0.75, 0, Centre.Z - 0.75}, {Centre.X + 0.75, Height, Centre.Z + 0.75});
+            }
+        }
+    }
+
+    fclose(File);
+    return true;
+}
+
+bool LoadMap(BSP_COMPILER *Compiler, const char *Path)
+{
+    FILE *File = fopen(Path, "r");
+    if(!File)
+    {
+        return false;
+    }
+
+    char Line[256];
+    BSP_BRUSH *Brush = 0;
+    u32 LineNumber = 0;
+    bool Result = true;
+    while(fgets(Line, sizeof(Line), File))
+    {
+        ++LineNumber;
+        f64 X, Y, Z, D;
+        if(Line[0] == '#' || Line[0] == '\n')
+        {
+            continue;
+        }
+        else if(sscanf(Line, " start %lf %lf %lf", &X, &Y, &Z) == 3)
+        {
+            Compiler->Start     = {X, Y, Z};
+            Compiler->HasStart  = true;
+        }
+        else if(strncmp(Line, "brush", 5) == 0)
+        {
+            Brush               = Compiler->Brushes.Push();
+            Brush->FirstSide    = Compiler->BrushSides.Count;
+        }
+        else if(Brush && sscanf(Line, " plane %lf %lf %lf %lf", &X, &Y, &Z, &D) == 4)
+        {
+            *Compiler->BrushSides.Push() = FindPlane(Compiler, {X, Y, Z}, D);
+            ++Brush->SideCount;
+        }
+        else if(Brush && strncmp(Line, "end", 3) == 0)
+        {
+            Brush = 0;
+        }
+        else if(!Brush && strncmp(Line, "light", 5) == 0)
+        {
+            // Baked later
+        }
+        else
+        {
+            printf("BSP: %s(%u): Unrecognised line: %s", Path, LineNumber, Line);
+            Result = false;
+            break;
+        }
+    }
+
+    fclose(File);
+    return Result;
+}
+
+
+// Brush faces and CSG
+void MakeBrushFaces(BSP_COMPILER *Compiler, BUFFER<BSP_FACE> *Faces)
+{
+    Compiler->Min = {1e30, 1e30, 1e30};
+    Compiler->Max = {-1e30, -1e30, -1e30};
+
+    for(u32 BrushIndex = 0; BrushIndex < Compiler->Brushes.Count; ++BrushIndex)
+    {
+        BSP_BRUSH *Brush    = &Compiler->Brushes[BrushIndex];
+        Brush->Min          = {1e30, 1e30, 1e30};
+        Brush->Max          = {-1e30, -1e30, -1e30};
+
+        for(u32 i = 0; i < Brush->SideCount; ++i)
+        {
+            u32 Plane       = Compiler->BrushSides[Brush->FirstSide + i];
+            WINDING Winding = BaseWinding(&Compiler->Planes[Plane], 1e5);
+            for(u32 j = 0; j < Brush->SideCount && Winding.Count; ++j)
+            {
+                if(j != i)
+                {
+                    // Keep the part behind every other side
+                    ClipWinding(&Winding, &Compiler->Planes[Compiler->BrushSides[Brush->FirstSide + j] ^ 1]);
+                }
+            }
+            if(!Winding.Count)
+            {
+                continue;
+            }
+
+            for(u32 j = 0; j < Winding.Count; ++j)
+            {
+                Brush->Min = MinV3D(Brush->Min, Winding.Points[j]);
+                Brush->Max = MaxV3D(Brush->Max, Winding.Points[j]);
+            }
+
+            BSP_FACE *Face  = Faces->Push();
+            Face->Winding   = Winding;
+            Face->Plane     = Plane;
+            Face->Brush     = BrushIndex;
+        }
+
+        Compiler->Min = MinV3D(Compiler->Min, Brush->Min);
+        Compiler->Max = MaxV3D(Compiler->Max, Brush->Max);
+    }
+}
+
+// Adds the parts of Winding outside of Brush to the face list
+void ChopFaceByBrush(BSP_COMPILER *Compiler, BSP_FACE *Face, u32 BrushIndex, BUFFER<BSP_FACE> *Output)
+{
+    BSP_BRUSH *Brush    = &Compiler->Brushes[BrushIndex];
+    WINDING Remaining   = Face->Winding;
+
+    for(u32 i = 0; i < Brush->SideCount; ++i)
+    {
+        u32 Plane = Compiler->BrushSides[Brush->FirstSide + i];
+        WINDING_SIDE Side = ClassifyWinding(&Remaining, &Compiler->Planes[Plane]);
+
+        // Coincident faces facing the same way - keep the one from the earlier brush
+        // Back to back faces are hidden and fall through as inside
+        if(Side == SIDE_ON && Plane == Face->Plane)
+        {
+            Side = (Face->Brush < BrushIndex) ? SIDE_FRONT : SIDE_BACK;
+        }
+        else if(Side == SIDE_ON)
+        {
+            Side = SIDE_BACK;
+        }
+
+        if(Side == SIDE_FRONT)
+        {
+            BSP_FACE Outside = *Face;
+            Outside.Winding = Remaining;
+            *Output->Push() = Outside;
+            return;
+        }
+        if(Side == SIDE_CROSS)
+        {
+            BSP_FACE Outside = *Face;
+            SplitWinding(&Remaining, &Compiler->Planes[Plane], &Outside.Winding, &Remaining);
+            if(Outside.Winding.Count)
+            {
+                *Output->Push() = Outside;
+            }
+            if(!Remaining.Count)
+            {
+                return;
+            }
+        }
+    }
+
+    // Whatever is left is inside the brush
+}
+
+bool BoundsOverlap(BSP_BRUSH *A, BSP_BRUSH *B)
+{
+    return (A->Min.X <= B->Max.X + BSP_EPSILON && A->Max.X >= B->Min.X - BSP_EPSILON &&
+            A->Min.Y <= B->Max.Y + BSP_EPSILON && A->Max.Y >= B->Min.Y - BSP_EPSILON &&
+            A->Min.Z <= B->Max.Z + BSP_EPSILON && A->Max.Z >= B->Min.Z - BSP_EPSILON);
+}
+
+void BuildFaces(BSP_COMPILER *Compiler)
+{
+    BUFFER<BSP_FACE> BrushFaces = {};
+    BUFFER<BSP_FACE> Current    = {};
+    BUFFER<BSP_FACE> Next       = {};
+    MakeBrushFaces(Compiler, &BrushFaces);
+
+    // Remove everything inside another brush, only testing brushes that touch the face's own
+    for(u32 i = 0; i < BrushFaces.Count; ++i)
+    {
+        Current.Count = 0;
+        *Current.Push() = BrushFaces[i];
+
+        BSP_BRUSH *Owner = &Compiler->Brushes[BrushFaces[i].Brush];
+        for(u32 BrushIndex = 0; BrushIndex < Compiler->Brushes.Count && Current.Count; ++BrushIndex)
+        {
+            if(BrushIndex == BrushFaces[i].Brush || !BoundsOverlap(Owner, &Compiler->Brushes[BrushIndex]))
+            {
+                continue;
+            }
+
+            Next.Count = 0;
+            for(u32 j = 0; j < Current.Count; ++j)
+            {
+                ChopFaceByBrush(Compiler, &Current[j], BrushIndex, &Next);
+            }
+
+            BUFFER<BSP_FACE> Swap = Current;
+            Current = Next;
+            Next    = Swap;
+        }
+
+        for(u32 j = 0; j < Current.Count; ++j)
+        {
+            *Compiler->Faces.Push() = Current[j];
+        }
+    }
+
+    printf("CSG: %u brushes, %u brush faces -> %u visible faces\n", Compiler->Brushes.Count, BrushFaces.Count, Compiler->Faces.Count);
+    BrushFaces.Free();
+    Current.Free();
+    Next.Free();
+}
+
+
+// Tree
+i32 NewLeaf(BSP_COMPILER *Compiler, u32 Flags)
+{
+    BSP_LEAF *Leaf  = Compiler->Leaves.Push();
+    Leaf->Flags     = Flags;
+    Leaf->Min       = {1e30, 1e30, 1e30};
+    Leaf->Max       = {-1e30, -1e30, -1e30};
+    return -(i32) Compiler->Leaves.Count;
+}
+
+u32 ChooseSplitter(BSP_COMPILER *Compiler, u32 *Faces, u32 Count)
+{
+    // Sample candidates on big lists, scoring splits heavily against balance
+    u32 Step        = (Count > 64) ? Count / 64 : 1;
+    u32 Best        = 0;
+    i64 BestScore   = INT64_MAX;
+    for(u32 Candidate = 0; Candidate < Count; Candidate += Step)
+    {
+        BSP_PLANE *Plane = &Compiler->Planes[Compiler->Faces[Faces[Candidate]].Plane];
+        i64 Front = 0, Back = 0, Splits = 0;
+        for(u32 i = 0; i < Count; ++i)
+        {
+            switch(ClassifyWinding(&Compiler->Faces[Faces[i]].Winding, Plane))
+            {
+                case SIDE_FRONT:    ++Front; break;
+                case SIDE_BACK:     ++Back; break;
+                case SIDE_CROSS:    ++Splits; break;
+                default:            break;
+            }
+        }
+
+        // Axial planes make cleaner portals
+        i64 Score = Splits * 8 + llabs(Front - Back);
+        if(fabs(Plane->Normal.X) != 1.0 && fabs(Plane->Normal.Y) != 1.0 && fabs(Plane->Normal.Z) != 1.0)
+        {
+            Score += 4;
+        }
+        if(Score < BestScore)
+        {
+            BestScore   = Score;
+            Best        = Candidate;
+        }
+    }
+
+    return Best;
+}
+
+// Faces point out of solid space, so running out of faces on the front is empty space and on the back is solid
+i32 BuildTree(BSP_COMPILER *Compiler, u32 *Faces, u32 Count)
+{
+    u32 Splitter    = ChooseSplitter(Compiler, Faces, Count);
+    u32 Plane       = Compiler->Faces[Faces[Splitter]].Plane;
+
+    u32 NodeIndex   = Compiler->Nodes.Count;
+    Compiler->Nodes.Push()->Plane = Plane;
+
+    u32 *Front      = (u32 *) malloc(sizeof(u32) * Count * 2);
+    u32 *Back       = Front + Count;
+    u32 FrontCount  = 0;
+    u32 BackCount   = 0;
+    u32 FirstFace   = Compiler->NodeFaces.Count;
+
+    for(u32 i = 0; i < Count; ++i)
+    {
+        u32 FaceIndex = Faces[i];
+        switch(ClassifyWinding(&Compiler->Faces[FaceIndex].Winding, &Compiler->Planes[Plane]))
+        {
+            case SIDE_ON:
+            {
+                *Compiler->NodeFaces.Push() = FaceIndex;
+            } break;
+            case SIDE_FRONT:
+            {
+                Front[FrontCount++] = FaceIndex;
+            } break;
+            case SIDE_BACK:
+            {
+                Back[BackCount++] = FaceIndex;
+            } break;
+            case SIDE_CROSS:
+            {
+                BSP_FACE FrontFace  = Compiler->Faces[FaceIndex];
+                BSP_FACE BackFace   = FrontFace;
+                SplitWinding(&Compiler->Faces[FaceIndex].Winding, &Compiler->Planes[Plane], &FrontFace.Winding, &BackFace.Winding);
+                if(FrontFace.Winding.Count)
+                {
+                    Front[FrontCount++] = Compiler->Faces.Count;
+                    *Compiler->Faces.Push() = FrontFace;
+                }
+                if(BackFace.Winding.Count)
+                {
+                    Back[BackCount++] = Compiler->Faces.Count;
+                    *Compiler->Faces.Push() = BackFace;
+                }
+            } break;
+        }
+    }
+
+    // Node faces must be contiguous, so they are claimed before recursing
+    Compiler->Nodes[NodeIndex].FirstFace = FirstFace;
+    Compiler->Nodes[NodeIndex].FaceCount = Compiler->NodeFaces.Count - FirstFace;
+
+    i32 FrontChild  = FrontCount ? BuildTree(Compiler, Front, FrontCount) : NewLeaf(Compiler, 0);
+    i32 BackChild   = BackCount ? BuildTree(Compiler, Back, BackCount) : NewLeaf(Compiler, LEVEL_LEAF_SOLID);
+    Compiler->Nodes[NodeIndex].Children[0] = FrontChild;
+    Compiler->Nodes[NodeIndex].Children[1] = BackChild;
+
+    free(Front);
+    return (i32) NodeIndex;
+}
+
+i32 FindLeaf(BSP_COMPILER *Compiler, V3D Point)
+{
+    i32 Child = 0;
+    while(Child >= 0)
+    {
+        BSP_NODE *Node      = &Compiler->Nodes[Child];
+        BSP_PLANE *Plane    = &Compiler->Planes[Node->Plane];
+        Child = Node->Children[(Dot(Plane->Normal, Point) - Plane->Distance >= 0) ? 0 : 1];
+    }
+    return -Child - 1;
+}
+
+// Pushes a winding down to the leaves it touches
+// Facing decides which side a coplanar winding belongs to - it points into the space the winding borders
+void DistributeWinding(BSP_COMPILER *Compiler, i32 Child, WINDING *Winding, V3D Facing, u32 Plane, BUFFER<BSP_FRAGMENT> *Output)
+{
+    if(Child < 0)
+    {
+        BSP_FRAGMENT *Fragment  = Output->Push();
+        Fragment->Winding       = *Winding;
+        Fragment->Leaf          = -Child - 1;
+        Fragment->Plane         = Plane;
+        return;
+    }
+
+    BSP_NODE *Node          = &Compiler->Nodes[Child];
+    BSP_PLANE *NodePlane    = &Compiler->Planes[Node->Plane];
+    i32 Front = Node->Children[0];
+    i32 Back  = Node->Children[1];
+    switch(ClassifyWinding(Winding, NodePlane))
+    {
+        case SIDE_ON:
+        {
+            DistributeWinding(Compiler, (Dot(NodePlane->Normal, Facing) > 0) ? Front : Back, Winding, Facing, Plane, Output);
+        } break;
+        case SIDE_FRONT:
+        {
+            DistributeWinding(Compiler, Front, Winding, Facing, Plane, Output);
+        } break;
+        case SIDE_BACK:
+        {
+            DistributeWinding(Compiler, Back, Winding, Facing, Plane, Output);
+        } break;
+        case SIDE_CROSS:
+        {
+            WINDING *Split = (WINDING *) malloc(sizeof(WINDING) * 2);
+            SplitWinding(Winding, NodePlane, &Split[0], &Split[1]);
+            if(Split[0].Count)
+            {
+                DistributeWinding(Compiler, Front, &Split[0], Facing, Plane, Output);
+            }
+            if(Split[1].Count)
+            {
+                DistributeWinding(Compiler, Back, &Split[1], Facing, Plane, Output);
+            }
+            free(Split);
+        } break;
+    }
+}
+
+
+// Portals
+void BuildPortals(BSP_COMPILER *Compiler, i32 NodeIndex, u32 *Path, u32 Depth, BUFFER<BSP_FRAGMENT> *Front, BUFFER<BSP_FRAGMENT> *Back)
+{
+    BSP_NODE Node       = Compiler->Nodes[NodeIndex];
+    BSP_PLANE *Plane    = &Compiler->Planes[Node.Plane];
+
+    // Node plane bounded by every ancestor split (and the world box at the root of the path)
+    WINDING Winding = BaseWinding(Plane, 1e5);
+    for(u32 i = 0; i < Depth && Winding.Count; ++i)
+    {
+        ClipWinding(&Winding, &Compiler->Planes[Path[i]]);
+    }
+
+    if(Winding.Count)
+    {
+        Front->Count = 0;
+        DistributeWinding(Compiler, Node.Children[0], &Winding, Plane->Normal, Node.Plane, Front);
+        for(u32 i = 0; i < Front->Count; ++i)
+        {
+            BSP_FRAGMENT FrontFragment = (*Front)[i];
+            if(Compiler->Leaves[FrontFragment.Leaf].Flags & LEVEL_LEAF_SOLID)
+            {
+                continue;
+            }
+
+            Back->Count = 0;
+            DistributeWinding(Compiler, Node.Children[1], &FrontFragment.Winding, Plane->Normal * -1.0, Node.Plane, Back);
+            for(u32 j = 0; j < Back->Count; ++j)
+            {
+                BSP_FRAGMENT *BackFragment = &(*Back)[j];
+                if(Compiler->Leaves[BackFragment->Leaf].Flags & LEVEL_LEAF_SOLID)
+                {
+                    continue;
+                }
+
+                BSP_PORTAL *Portal  = Compiler->Portals.Push();
+                Portal->Winding     = BackFragment->Winding;
+                Portal->Plane       = Node.Plane;
+                Portal->Leaves[0]   = FrontFragment.Leaf;
+                Portal->Leaves[1]   = BackFragment->Leaf;
+            }
+        }
+    }
+
+    for(u32 Side = 0; Side < 2; ++Side)
+    {
+        if(Node.Children[Side] >= 0)
+        {
+            Path[Depth] = Node.Plane ^ Side;
+            BuildPortals(Compiler, Node.Children[Side], Path, Depth + 1, Front, Back);
+        }
+    }
+}
+
+void Portalize(BSP_COMPILER *Compiler)
+{
+    // Path starts with the inward facing world box planes so the outside leaves are closed too
+    V3D Min = Compiler->Min - V3D{BSP_WORLD_MARGIN, BSP_WORLD_MARGIN, BSP_WORLD_MARGIN};
+    V3D Max = Compiler->Max + V3D{BSP_WORLD_MARGIN, BSP_WORLD_MARGIN, BSP_WORLD_MARGIN};
+    u32 *Path = (u32 *) malloc(sizeof(u32) * (Compiler->Nodes.Count + 6));
+    Path[0] = FindPlane(Compiler, {1, 0, 0}, Min.X);
+    Path[1] = FindPlane(Compiler, {-1, 0, 0}, -Max.X);
+    Path[2] = FindPlane(Compiler, {0, 1, 0}, Min.Y);
+    Path[3] = FindPlane(Compiler, {0, -1, 0}, -Max.Y);
+    Path[4] = FindPlane(Compiler, {0, 0, 1}, Min.Z);
+    Path[5] = FindPlane(Compiler, {0, 0, -1}, -Max.Z);
+
+    BUFFER<BSP_FRAGMENT> Front  = {};
+    BUFFER<BSP_FRAGMENT> Back   = {};
+    BuildPortals(Compiler, 0, Path, 6, &Front, &Back);
+    Front.Free();
+    Back.Free();
+    free(Path);
+
+    // Leaf -> portal lists and leaf bounds from the portals
+    for(u32 i = 0; i < Compiler->Portals.Count; ++i)
+    {
+        BSP_PORTAL *Portal = &Compiler->Portals[i];
+        for(u32 Side = 0; Side < 2; ++Side)
+        {
+            BSP_LEAF *Leaf = &Compiler->Leaves[Portal->Leaves[Side]];
+            ++Leaf->PortalCount;
+            for(u32 j = 0; j < Portal->Winding.Count; ++j)
+            {
+                Leaf->Min = MinV3D(Leaf->Min, Portal->Winding.Points[j]);
+                Leaf->Max = MaxV3D(Leaf->Max, Portal->Winding.Points[j]);
+            }
+        }
+    }
+
+    u32 Offset = 0;
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        Compiler->Leaves[i].FirstPortal = Offset;
+        Offset += Compiler->Leaves[i].PortalCount;
+        Compiler->Leaves[i].PortalCount = 0;
+    }
+
+    Compiler->LeafPortals.Count = 0;
+    for(u32 i = 0; i < Offset; ++i)
+    {
+        Compiler->LeafPortals.Push();
+    }
+    for(u32 i = 0; i < Compiler->Portals.Count; ++i)
+    {
+        for(u32 Side = 0; Side < 2; ++Side)
+        {
+            BSP_LEAF *Leaf = &Compiler->Leaves[Compiler->Portals[i].Leaves[Side]];
+            Compiler->LeafPortals[Leaf->FirstPortal + Leaf->PortalCount++] = i;
+        }
+    }
+}
+
+// Floods from outside the map - any empty leaf reached can never be seen from inside and is made solid
+// Returns false if the flood reached the start point (the map has a leak)
+bool FillOutside(BSP_COMPILER *Compiler)
+{
+    V3D Outside = Compiler->Max + V3D{BSP_WORLD_MARGIN * 0.5, BSP_WORLD_MARGIN * 0.5, BSP_WORLD_MARGIN * 0.5};
+    u32 *Stack  = (u32 *) malloc(sizeof(u32) * Compiler->Leaves.Count);
+    u32 Count   = 0;
+
+    u32 First = FindLeaf(Compiler, Outside);
+    Compiler->Leaves[First].Outside = true;
+    Stack[Count++] = First;
+    while(Count)
+    {
+        BSP_LEAF *Leaf = &Compiler->Leaves[Stack[--Count]];
+        for(u32 i = 0; i < Leaf->PortalCount; ++i)
+        {
+            BSP_PORTAL *Portal  = &Compiler->Portals[Compiler->LeafPortals[Leaf->FirstPortal + i]];
+            u32 Other           = (&Compiler->Leaves[Portal->Leaves[0]] == Leaf) ? Portal->Leaves[1] : Portal->Leaves[0];
+            if(!Compiler->Leaves[Other].Outside)
+            {
+                Compiler->Leaves[Other].Outside = true;
+                Stack[Count++] = Other;
+            }
+        }
+    }
+    free(Stack);
+
+    if(Compiler->HasStart && Compiler->Leaves[FindLeaf(Compiler, Compiler->Start)].Outside)
+    {
+        // Leave the outside alone so the map still compiles, just without useful visibility
+        for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+        {
+            Compiler->Leaves[i].Outside = false;
+        }
+        return false;
+    }
+
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        if(Compiler->Leaves[i].Outside)
+        {
+            Compiler->Leaves[i].Flags |= LEVEL_LEAF_SOLID;
+        }
+    }
+    return true;
+}
+
+
+// Geometry
+void AddWindingTriangles(BSP_COMPILER *Compiler, WINDING *Winding, BSP_PLANE *Plane)
+{
+    // Planar UVs from the dominant axis
+    u32 Axis = 0;
+    if(fabs(Plane->Normal.Y) > fabs(Plane->Normal.X))
+    {
+        Axis = 1;
+    }
+    if(fabs(Plane->Normal.Z) > fabs((&Plane->Normal.X)[Axis]))
+    {
+        Axis = 2;
+    }
+    u32 U = (Axis == 0) ? 2 : 0;
+    u32 V = (Axis == 1) ? 2 : 1;
+
+    u32 BaseVertex = Compiler->Vertices.Count;
+    for(u32 i = 0; i < Winding->Count; ++i)
+    {
+        const f64 *Point        = &Winding->Points[i].X;
+        LEVEL_VERTEX *Vertex    = Compiler->Vertices.Push();
+        Vertex->Position[0]     = (f32) Point[0];
+        Vertex->Position[1]     = (f32) Point[1];
+        Vertex->Position[2]     = (f32) Point[2];
+        Vertex->Normal[0]       = (f32) Plane->Normal.X;
+        Vertex->Normal[1]       = (f32) Plane->Normal.Y;
+        Vertex->Normal[2]       = (f32) Plane->Normal.Z;
+        Vertex->UV[0]           = (f32) (Point[U] * BSP_UV_SCALE);
+        Vertex->UV[1]           = (f32) (Point[V] * BSP_UV_SCALE);
+    }
+
+    for(u32 i = 2; i < Winding->Count; ++i)
+    {
+        *Compiler->Indices.Push() = BaseVertex;
+        *Compiler->Indices.Push() = BaseVertex + i - 1;
+        *Compiler->Indices.Push() = BaseVertex + i;
+    }
+}
+
+// Splits each node face into the leaves in front of it, then emits triangles grouped by leaf
+void BuildLeafGeometry(BSP_COMPILER *Compiler)
+{
+    BUFFER<BSP_FRAGMENT> Fragments = {};
+    for(u32 NodeIndex = 0; NodeIndex < Compiler->Nodes.Count; ++NodeIndex)
+    {
+        BSP_NODE *Node = &Compiler->Nodes[NodeIndex];
+        for(u32 i = 0; i < Node->FaceCount; ++i)
+        {
+            BSP_FACE *Face  = &Compiler->Faces[Compiler->NodeFaces[Node->FirstFace + i]];
+            i32 Child       = Node->Children[(Face->Plane == Node->Plane) ? 0 : 1];
+            DistributeWinding(Compiler, Child, &Face->Winding, Compiler->Planes[Face->Plane].Normal, Face->Plane, &Fragments);
+        }
+    }
+
+    // Counting sort by leaf
+    u32 *Offsets = (u32 *) calloc(Compiler->Leaves.Count + 1, sizeof(u32));
+    for(u32 i = 0; i < Fragments.Count; ++i)
+    {
+        ++Offsets[Fragments[i].Leaf + 1];
+    }
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        Offsets[i + 1] += Offsets[i];
+    }
+    u32 *Order = (u32 *) malloc(sizeof(u32) * (Fragments.Count + 1));
+    for(u32 i = 0; i < Fragments.Count; ++i)
+    {
+        Order[Offsets[Fragments[i].Leaf]++] = i;
+    }
+
+    u32 Cursor = 0;
+    for(u32 LeafIndex = 0; LeafIndex < Compiler->Leaves.Count; ++LeafIndex)
+    {
+        BSP_LEAF *Leaf      = &Compiler->Leaves[LeafIndex];
+        Leaf->FirstIndex    = Compiler->Indices.Count;
+        for(; Cursor < Fragments.Count && Fragments[Order[Cursor]].Leaf == (i32) LeafIndex; ++Cursor)
+        {
+            // Faces that only border solid or outside space are never seen
+            if(!(Leaf->Flags & LEVEL_LEAF_SOLID))
+            {
+                BSP_FRAGMENT *Fragment = &Fragments[Order[Cursor]];
+                AddWindingTriangles(Compiler, &Fragment->Winding, &Compiler->Planes[Fragment->Plane]);
+            }
+        }
+        Leaf->IndexCount = Compiler->Indices.Count - Leaf->FirstIndex;
+    }
+
+    free(Order);
+    free(Offsets);
+    Fragments.Free();
+}
+
+
+// Visibility
+// Conservative portal flow - a leaf is visible from the source portal if some line passes through the source and every
+// portal on the way to it. Each step clips the next portal to the planes separating the source from the portal before
+// it, and clips the source to what could still see through the new portal. Clipping only ever removes parts no line
+// can reach, so the PVS can over-report but never miss a leaf.
+typedef struct BSP_FLOW
+{
+    WINDING     Source;             // Part of the source portal that can see this far
+    WINDING     Pass;               // Part of the last portal visible through everything before it
+    BSP_PLANE   PassPlane;          // Facing into the leaf the pass portal leads to
+} BSP_FLOW;
+
+inline void MarkLeaf(u8 *Row, u32 LeafIndex)
+{
+    Row[LeafIndex >> 3] |= (u8) (1 << (LeafIndex & 7));
+}
+
+// Clips Target to the planes through an edge of Source and a point of Pass that have all of Source on one side and all
+// of Pass on the other - no line from Source through Pass leaves them. Flip keeps the side Source is on instead
+void ClipToSeparators(WINDING *Source, WINDING *Pass, WINDING *Target, bool Flip)
+{
+    for(u32 i = 0; i < Source->Count && Target->Count; ++i)
+    {
+        u32 Next    = (i + 1) % Source->Count;
+        V3D Edge    = Source->Points[Next] - Source->Points[i];
+        for(u32 j = 0; j < Pass->Count && Target->Count; ++j)
+        {
+            V3D Normal  = Cross(Edge, Pass->Points[j] - Source->Points[i]);
+            f64 Size    = Length(Normal);
+            if(Size < BSP_NORMAL_EPSILON)
+            {
+                continue;
+            }
+
+            BSP_PLANE Plane = {};
+            Plane.Normal    = Normal * (1.0 / Size);
+            Plane.Distance  = Dot(Pass->Points[j], Plane.Normal);
+
+            // Face the plane away from the source - skip it if the source lies in it
+            u32 k = 0;
+            for(; k < Source->Count; ++k)
+            {
+                if(k == i || k == Next)
+                {
+                    continue;
+                }
+                f64 Distance = Dot(Source->Points[k], Plane.Normal) - Plane.Distance;
+                if(Distance < -BSP_EPSILON)
+                {
+                    break;
+                }
+                if(Distance > BSP_EPSILON)
+                {
+                    Plane.Normal    = Plane.Normal * -1.0;
+                    Plane.Distance  = -Plane.Distance;
+                    break;
+                }
+            }
+            if(k == Source->Count)
+            {
+                continue;
+            }
+
+            // Only a separator if the whole pass portal is in front, and not all of it in the plane
+            bool Separates  = true;
+            bool Front      = false;
+            for(k = 0; k < Pass->Count && Separates; ++k)
+            {
+                f64 Distance = Dot(Pass->Points[k], Plane.Normal) - Plane.Distance;
+                Separates   = (Distance >= -BSP_EPSILON);
+                Front       |= (Distance > BSP_EPSILON);
+            }
+            if(!Separates || !Front)
+            {
+                continue;
+            }
+
+            if(Flip)
+            {
+                Plane.Normal    = Plane.Normal * -1.0;
+                Plane.Distance  = -Plane.Distance;
+            }
+            ClipWinding(Target, &Plane);
+        }
+    }
+}
+
+// Past the stack limit there's nothing left to clip against - everything is visible
+void MarkAllLeaves(BSP_COMPILER *Compiler, u8 *Row)
+{
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        if(!(Compiler->Leaves[i].Flags & LEVEL_LEAF_SOLID))
+        {
+            MarkLeaf(Row, i);
+        }
+    }
+}
+
+// Prev is null while still in the leaf on the other side of the source portal, which is always visible
+void FlowThroughLeaf(BSP_COMPILER *Compiler, BSP_PLANE *SourcePlane, u32 LeafIndex, BSP_FLOW *Prev, WINDING *Source, u32 *Stack, u32 Depth, u8 *Row)
+{
+    if(Depth >= BSP_MAX_FLOW_DEPTH)
+    {
+        MarkAllLeaves(Compiler, Row);
+        return;
+    }
+
+    BSP_LEAF *Leaf = &Compiler->Leaves[LeafIndex];
+    for(u32 i = 0; i < Leaf->PortalCount; ++i)
+    {
+        BSP_PORTAL *Portal  = &Compiler->Portals[Compiler->LeafPortals[Leaf->FirstPortal + i]];
+        u32 Side            = (Portal->Leaves[0] == LeafIndex) ? 0 : 1;
+        u32 Other           = Portal->Leaves[Side ^ 1];
+        if(Compiler->Leaves[Other].Flags & LEVEL_LEAF_SOLID)
+        {
+            continue;
+        }
+
+        bool OnStack = false;
+        for(u32 j = 0; j < Depth; ++j)
+        {
+            OnStack |= (Stack[j] == Other);
+        }
+        if(OnStack)
+        {
+            continue;
+        }
+
+        // Only the parts of the new portal beyond the source, seen from the parts of the source behind the new portal
+        BSP_FLOW Flow   = {};
+        Flow.PassPlane  = Compiler->Planes[Portal->Plane ^ Side ^ 1];
+        Flow.Pass       = Portal->Winding;
+        ClipWinding(&Flow.Pass, SourcePlane);
+        if(!Flow.Pass.Count)
+        {
+            continue;
+        }
+
+        BSP_PLANE Back  = Compiler->Planes[Portal->Plane ^ Side];
+        Flow.Source     = *Source;
+        ClipWinding(&Flow.Source, &Back);
+        if(!Flow.Source.Count)
+        {
+            continue;
+        }
+
+        if(Prev)
+        {
+            ClipWinding(&Flow.Pass, &Prev->PassPlane);
+            if(Flow.Pass.Count)
+            {
+                ClipToSeparators(&Flow.Source, &Prev->Pass, &Flow.Pass, false);
+            }
+            if(Flow.Pass.Count)
+            {
+                ClipToSeparators(&Prev->Pass, &Flow.Source, &Flow.Pass, true);
+            }
+            if(!Flow.Pass.Count)
+            {
+                continue;
+            }
+        }
+
+        MarkLeaf(Row, Other);
+        Stack[Depth] = Other;
+        FlowThroughLeaf(Compiler, SourcePlane, Other, &Flow, &Flow.Source, Stack, Depth + 1, Row);
+    }
+}
+
+// Everything visible from anywhere in the leaf is visible through one of its portals
+void LeafVisibility(BSP_COMPILER *Compiler, u32 LeafIndex)
+{
+    u8 *Row         = Compiler->Visibility + (size_t) LeafIndex * Compiler->RowBytes;
+    BSP_LEAF *Leaf  = &Compiler->Leaves[LeafIndex];
+    MarkLeaf(Row, LeafIndex);
+
+    u32 Stack[BSP_MAX_FLOW_DEPTH];
+    Stack[0] = LeafIndex;
+    for(u32 i = 0; i < Leaf->PortalCount; ++i)
+    {
+        BSP_PORTAL *Portal  = &Compiler->Portals[Compiler->LeafPortals[Leaf->FirstPortal + i]];
+        u32 Side            = (Portal->Leaves[0] == LeafIndex) ? 0 : 1;
+        u32 Other           = Portal->Leaves[Side ^ 1];
+        if(Compiler->Leaves[Other].Flags & LEVEL_LEAF_SOLID)
+        {
+            continue;
+        }
+
+        BSP_PLANE SourcePlane = Compiler->Planes[Portal->Plane ^ Side ^ 1];
+        MarkLeaf(Row, Other);
+        Stack[1] = Other;
+        FlowThroughLeaf(Compiler, &SourcePlane, Other, 0, &Portal->Winding, Stack, 2, Row);
+    }
+}
+
+void VisibilityWorker(BSP_COMPILER *Compiler)
+{
+    for(;;)
+    {
+        u32 LeafIndex = Compiler->NextLeaf.fetch_add(1);
+        if(LeafIndex >= Compiler->Leaves.Count)
+        {
+            break;
+        }
+        if(!(Compiler->Leaves[LeafIndex].Flags & LEVEL_LEAF_SOLID))
+        {
+            LeafVisibility(Compiler, LeafIndex);
+        }
+    }
+}
+
+f64 BuildVisibility(BSP_COMPILER *Compiler, u32 ThreadCount)
+{
+    auto Start = std::chrono::steady_clock::now();
+
+    Compiler->RowBytes = (Compiler->Leaves.Count + 7) / 8;
+    free(Compiler->Visibility);
+    Compiler->Visibility = (u8 *) calloc((size_t) Compiler->RowBytes * Compiler->Leaves.Count, 1);
+    Compiler->NextLeaf = 0;
+
+    // Leaves are pulled from a shared counter, each thread only writes its own rows
+    std::thread Threads[BSP_MAX_THREADS];
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i] = std::thread(VisibilityWorker, Compiler);
+    }
+    VisibilityWorker(Compiler);
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i].join();
+    }
+
+    // Flow from either end can disagree at the epsilons - if A sees B then B sees A
+    for(u32 A = 0; A < Compiler->Leaves.Count; ++A)
+    {
+        u8 *RowA = Compiler->Visibility + (size_t) A * Compiler->RowBytes;
+        for(u32 B = A + 1; B < Compiler->Leaves.Count; ++B)
+        {
+            u8 *RowB = Compiler->Visibility + (size_t) B * Compiler->RowBytes;
+            bool Visible = (RowA[B >> 3] & (1 << (B & 7))) || (RowB[A >> 3] & (1 << (A & 7)));
+            if(Visible)
+            {
+                RowA[B >> 3] |= (u8) (1 << (B & 7));
+                RowB[A >> 3] |= (u8) (1 << (A & 7));
+            }
+        }
+    }
+
+    return SecondsSince(Start);
+}
+
+u32 CompressRow(u8 *Row, u32 RowBytes, u8 *Output)
+{
+    u32 Written = 0;
+    for(u32 i = 0; i < RowBytes; ++i)
+    {
+        if(Row[i])
+        {
+            Output[Written++] = Row[i];
+            continue;
+        }
+
+        u32 Run = 1;
+        while(i + 1 < RowBytes && !Row[i + 1] && Run < 255)
+        {
+            ++Run;
+            ++i;
+        }
+        Output[Written++] = 0;
+        Output[Written++] = (u8) Run;
+    }
+    return Written;
+}
+
+
+// Output
+bool WriteLevel(BSP_COMPILER *Compiler, const char *Path, u32 *VisibilityBytes)
+{
+    LEVEL_HEADER Header = {};
+    Header.Magic        = LEVEL_MAGIC;
+    Header.Version      = LEVEL_VERSION;
+    Header.PlaneCount   = Compiler->Planes.Count;
+    Header.NodeCount    = Compiler->Nodes.Count;
+    Header.LeafCount    = Compiler->Leaves.Count;
+    Header.VertexCount  = Compiler->Vertices.Count;
+    Header.IndexCount   = Compiler->Indices.Count;
+
+    // Compressed rows are at most 1.5x the raw size (every other byte zero)
+    u8 *Compressed = (u8 *) malloc((size_t) Compiler->RowBytes * Compiler->Leaves.Count * 2 + 16);
+    LEVEL_LEAF *Leaves = (LEVEL_LEAF *) calloc(Compiler->Leaves.Count, sizeof(LEVEL_LEAF));
+    u32 CompressedSize = 0;
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        BSP_LEAF *Leaf          = &Compiler->Leaves[i];
+        LEVEL_LEAF *Output      = &Leaves[i];
+        Output->Flags           = Leaf->Flags;
+        Output->FirstIndex      = Leaf->FirstIndex;
+        Output->IndexCount      = Leaf->IndexCount;
+        Output->VisibilityOffset = LEVEL_NO_VISIBILITY;
+        if(!(Leaf->Flags & LEVEL_LEAF_SOLID))
+        {
+            Output->VisibilityOffset = CompressedSize;
+            CompressedSize += CompressRow(Compiler->Visibility + (size_t) i * Compiler->RowBytes, Compiler->RowBytes, Compressed + CompressedSize);
+        }
+        if(Leaf->PortalCount)
+        {
+            const f64 *Min = &Leaf->Min.X;
+            const f64 *Max = &Leaf->Max.X;
+            for(u32 Axis = 0; Axis < 3; ++Axis)
+            {
+                Output->Min[Axis] = (f32) Min[Axis];
+                Output->Max[Axis] = (f32) Max[Axis];
+            }
+        }
+    }
+    Header.VisibilityBytes  = CompressedSize;
+    *VisibilityBytes        = CompressedSize;
+
+    LEVEL_PLANE *Planes = (LEVEL_PLANE *) malloc(sizeof(LEVEL_PLANE) * Compiler->Planes.Count);
+    for(u32 i = 0; i < Compiler->Planes.Count; ++i)
+    {
+        Planes[i].Normal[0] = (f32) Compiler->Planes[i].Normal.X;
+        Planes[i].Normal[1] = (f32) Compiler->Planes[i].Normal.Y;
+        Planes[i].Normal[2] = (f32) Compiler->Planes[i].Normal.Z;
+        Planes[i].Distance  = (f32) Compiler->Planes[i].Distance;
+    }
+
+    LEVEL_NODE *Nodes = (LEVEL_NODE *) malloc(sizeof(LEVEL_NODE) * Compiler->Nodes.Count);
+    for(u32 i = 0; i < Compiler->Nodes.Count; ++i)
+    {
+        Nodes[i].Plane          = Compiler->Nodes[i].Plane;
+        Nodes[i].Children[0]    = Compiler->Nodes[i].Children[0];
+        Nodes[i].Children[1]    = Compiler->Nodes[i].Children[1];
+    }
+
+    // Sections are laid out in header order, 16 byte aligned
+    u32 Offset = (sizeof(LEVEL_HEADER) + 15) & ~15u;
+    u32 *Offsets[]      = {&Header.PlaneOffset, &Header.NodeOffset, &Header.LeafOffset, &Header.VertexOffset, &Header.IndexOffset, &Header.VisibilityOffset};
+    const void *Data[]  = {Planes, Nodes, Leaves, Compiler->Vertices.Data, Compiler->Indices.Data, Compressed};
+    u32 Sizes[]         = {(u32) sizeof(LEVEL_PLANE) * Header.PlaneCount, (u32) sizeof(LEVEL_NODE) * Header.NodeCount, (u32) sizeof(LEVEL_LEAF) * Header.LeafCount,
+                           (u32) sizeof(LEVEL_VERTEX) * Header.VertexCount, (u32) sizeof(u32) * Header.IndexCount, CompressedSize};
+    for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+    {
+        *Offsets[i] = Offset;
+        Offset = (Offset + Sizes[i] + 15) & ~15u;
+    }
+
+    bool Result = false;
+    FILE *File = fopen(Path, "wb");
+    if(File)
+    {
+        static const u8 Padding[16] = {};
+        fwrite(&Header, sizeof(Header), 1, File);
+        fwrite(Padding, 1, *Offsets[0] - sizeof(Header), File);
+        for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+        {
+            fwrite(Data[i], 1, Sizes[i], File);
+            fwrite(Padding, 1, ((Sizes[i] + 15) & ~15u) - Sizes[i], File);
+        }
+        Result = (ferror(File) == 0);
+        fclose(File);
+    }
+
+    free(Nodes);
+    free(Planes);
+    free(Leaves);
+    free(Compressed);
+    return Result;
+}
+
+void PrintVisibilityStats(BSP_COMPILER *Compiler)
+{
+    u32 EmptyLeaves         = 0;
+    u64 VisibleLeaves       = 0;
+    u64 VisibleTriangles    = 0;
+    u64 TotalTriangles      = Compiler->Indices.Count / 3;
+    for(u32 A = 0; A < Compiler->Leaves.Count; ++A)
+    {
+        if(Compiler->Leaves[A].Flags & LEVEL_LEAF_SOLID)
+        {
+            continue;
+        }
+
+        ++EmptyLeaves;
+        u8 *Row = Compiler->Visibility + (size_t) A * Compiler->RowBytes;
+        for(u32 B = 0; B < Compiler->Leaves.Count; ++B)
+        {
+            if(Row[B >> 3] & (1 << (B & 7)))
+            {
+                ++VisibleLeaves;
+                VisibleTriangles += Compiler->Leaves[B].IndexCount / 3;
+            }
+        }
+    }
+
+    if(EmptyLeaves && TotalTriangles)
+    {
+        f64 AverageTriangles = (f64) VisibleTriangles / EmptyLeaves;
+        printf("PVS: %.1f of %u leaves visible on average, %.0f of %llu triangles (%.1f%% culled)\n",
+               (f64) VisibleLeaves / EmptyLeaves, EmptyLeaves, AverageTriangles, (unsigned long long) TotalTriangles,
+               100.0 * (1.0 - AverageTriangles / TotalTriangles));
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc == 5 && strcmp(argv[1], "--generate") == 0)
+    {
+        u32 RoomsX = (u32) atoi(argv[2]);
+        u32 RoomsZ = (u32) atoi(argv[3]);
+        if(!RoomsX || !RoomsZ || !GenerateMap(argv[4], RoomsX, RoomsZ))
+        {
+            printf("BSP: Failed to generate %s\n", argv[4]);
+            return 1;
+        }
+        printf("BSP: Generated %ux%u rooms into %s\n", RoomsX, RoomsZ, argv[4]);
+        return 0;
+    }
+
+    if(argc < 3)
+    {
+        printf("Usage: bsp_compiler input.map output.lvl [--threads N] [--scaling]\n");
+        printf("       bsp_compiler --generate RoomsX RoomsZ output.map\n");
+        return 1;
+    }
+
+    u32 ThreadCount = std::thread::hardware_concurrency();
+    bool Scaling    = false;
+    for(int i = 3; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            ThreadCount = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--scaling") == 0)
+        {
+            Scaling = true;
+        }
+    }
+    ThreadCount = (ThreadCount < 1) ? 1 : ((ThreadCount > BSP_MAX_THREADS) ? BSP_MAX_THREADS : ThreadCount);
+
+    BSP_COMPILER *Compiler = new BSP_COMPILER();
+    auto Start = std::chrono::steady_clock::now();
+
+    if(!LoadMap(Compiler, argv[1]))
+    {
+        printf("BSP: Failed to load %s\n", argv[1]);
+        return 1;
+    }
+    if(!Compiler->Brushes.Count)
+    {
+        printf("BSP: %s has no brushes\n", argv[1]);
+        return 1;
+    }
+
+    auto Stage = std::chrono::steady_clock::now();
+    BuildFaces(Compiler);
+    printf("CSG: %.3fs\n", SecondsSince(Stage));
+
+    Stage = std::chrono::steady_clock::now();
+    u32 *Faces = (u32 *) malloc(sizeof(u32) * Compiler->Faces.Count);
+    for(u32 i = 0; i < Compiler->Faces.Count; ++i)
+    {
+        Faces[i] = i;
+    }
+    BuildTree(Compiler, Faces, Compiler->Faces.Count);
+    free(Faces);
+    printf("BSP: %u nodes, %u leaves, %u planes in %.3fs\n", Compiler->Nodes.Count, Compiler->Leaves.Count, Compiler->Planes.Count, SecondsSince(Stage));
+
+    Stage = std::chrono::steady_clock::now();
+    Portalize(Compiler);
+    bool Sealed = FillOutside(Compiler);
+    u32 EmptyLeaves = 0;
+    for(u32 i = 0; i < Compiler->Leaves.Count; ++i)
+    {
+        EmptyLeaves += !(Compiler->Leaves[i].Flags & LEVEL_LEAF_SOLID);
+    }
+    printf("Portals: %u portals, %u empty leaves in %.3fs\n", Compiler->Portals.Count, EmptyLeaves, SecondsSince(Stage));
+    if(!Sealed)
+    {
+        printf("Portals: WARNING - map leaks, the start point can be reached from outside\n");
+    }
+
+    BuildLeafGeometry(Compiler);
+    printf("Geometry: %u vertices, %u triangles\n", Compiler->Vertices.Count, Compiler->Indices.Count / 3);
+
+    // Compile time against core count - the PVS pass is the only parallel stage
+    if(Scaling)
+    {
+        f64 Baseline = 0;
+        for(u32 Threads = 1; Threads <= ThreadCount; Threads *= 2)
+        {
+            f64 Seconds = BuildVisibility(Compiler, Threads);
+            Baseline    = (Threads == 1) ? Seconds : Baseline;
+            printf("PVS: %2u threads %.3fs (%.2fx)\n", Threads, Seconds, Baseline / Seconds);
+        }
+    }
+    f64 VisibilitySeconds = BuildVisibility(Compiler, ThreadCount);
+    printf("PVS: %u threads %.3fs\n", ThreadCount, VisibilitySeconds);
+    PrintVisibilityStats(Compiler);
+
+    u32 VisibilityBytes = 0;
+    if(!WriteLevel(Compiler, argv[2], &VisibilityBytes))
+    {
+        printf("BSP: Failed to write %s\n", argv[2]);
+        return 1;
+    }
+    printf("BSP: Wrote %s (PVS %u bytes compressed from %u) in %.3fs total\n", argv[2], VisibilityBytes, Compiler->RowBytes * EmptyLeaves, SecondsSince(Start));
+
+    return 0;
+}
@@ -0,0 +1,1336 @@
+// Lightmap baker
+// Compiled level + map lights -> one chart per face -> shelf packed atlas -> direct light and radiosity bounces traced
+// against a SIMD BVH4 -> level file with lightmap UVs and an RGBA8 atlas (see level.h)
+//
+// Usage:
+//   lightmap_baker input.lvl input.map output.lvl [--threads N] [--density TexelsPerUnit] [--bounces N] [--samples N] [--scaling]
+//
+// Lights come from the map's light lines. Surfaces have no material data, so every bounce uses a flat grey albedo.
+
+// CRT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+// SIMD
+#include <immintrin.h>
+
+// Threading, timing and sorting
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// Core
+#include "../core/core.h"
+#include "../level.h"
+
+#define BAKER_MAX_THREADS       64
+#define BAKER_MAX_ATLAS         4096
+#define BAKER_MAX_POINTS        64      // Matches the compiler's winding limit
+#define BAKER_LEAF_SIZE         4       // Triangles per BVH leaf - one TRIANGLE4
+#define BAKER_SAH_BINS          16
+#define BAKER_STACK_SIZE        256
+#define BAKER_TEXEL_CHUNK       64      // Texels per work item
+#define BAKER_SURFACE_OFFSET    0.01f   // Sample points sit this far off the surface to avoid self shadowing
+#define BAKER_EDGE_INSET        0.01f   // Border texels are clamped this far inside their polygon
+#define BAKER_ALBEDO            0.5f
+
+typedef struct V3F
+{
+    f32 X, Y, Z;
+} V3F;
+
+inline V3F operator+(V3F A, V3F B) { return {A.X + B.X, A.Y + B.Y, A.Z + B.Z}; }
+inline V3F operator-(V3F A, V3F B) { return {A.X - B.X, A.Y - B.Y, A.Z - B.Z}; }
+inline V3F operator*(V3F A, f32 S) { return {A.X * S, A.Y * S, A.Z * S}; }
+inline V3F operator*(V3F A, V3F B) { return {A.X * B.X, A.Y * B.Y, A.Z * B.Z}; }
+inline f32 Dot(V3F A, V3F B) { return A.X * B.X + A.Y * B.Y + A.Z * B.Z; }
+inline V3F Cross(V3F A, V3F B) { return {A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X}; }
+inline V3F Normalize(V3F A) { return A * (1.0f / sqrtf(Dot(A, A))); }
+inline V3F MinV3F(V3F A, V3F B) { return {fminf(A.X, B.X), fminf(A.Y, B.Y), fminf(A.Z, B.Z)}; }
+inline V3F MaxV3F(V3F A, V3F B) { return {fmaxf(A.X, B.X), fmaxf(A.Y, B.Y), fmaxf(A.Z, B.Z)}; }
+inline V3F LoadV3F(const f32 *Values) { return {Values[0], Values[1], Values[2]}; }
+
+// Growable array - pointers into it are invalidated by Push
+template<typename T>
+struct BUFFER
+{
+    T   *Data;
+    u32 Count;
+    u32 Capacity;
+
+    T *Push()
+    {
+        if(Count == Capacity)
+        {
+            Capacity    = Capacity ? Capacity * 2 : 64;
+            Data        = (T *) realloc(Data, sizeof(T) * Capacity);
+            Assert(Data, "Baker: Out of memory!");
+        }
+        T *Result = &Data[Count++];
+        memset((void *) Result, 0, sizeof(T));
+        return Result;
+    }
+
+    T &operator[](u32 Index)
+    {
+        return Data[Index];
+    }
+
+    void Free()
+    {
+        free(Data);
+        Data        = 0;
+        Count       = 0;
+        Capacity    = 0;
+    }
+};
+
+typedef struct LIGHT
+{
+    V3F Position;
+    V3F Colour;
+    f32 Radius;
+} LIGHT;
+
+// One convex face - the compiler emits each winding as a fan over its own run of vertices
+typedef struct CHART
+{
+    u32 FirstVertex;
+    u32 VertexCount;
+    V3F Normal;
+    V3F AxisU;
+    V3F AxisV;
+    f32 MinU;
+    f32 MinV;
+    u32 Width;          // Texels, including a one texel border on every side
+    u32 Height;
+    u32 X;              // Atlas position
+    u32 Y;
+} CHART;
+
+typedef struct TEXEL
+{
+    V3F Position;       // Already offset off the surface
+    V3F Normal;
+    u32 Atlas;          // Y * AtlasWidth + X
+} TEXEL;
+
+// Binary SAH tree, only used while building - collapsed into BVH4_NODEs for tracing
+typedef struct BVH_BUILD_NODE
+{
+    V3F Min;
+    V3F Max;
+    u32 Children[2];
+    u32 First;          // Leaves only
+    u32 Count;          // 0 for interior nodes
+} BVH_BUILD_NODE;
+
+// Four children tested at once - lanes past ChildCount are masked off
+typedef struct BVH4_NODE
+{
+    __m128 Min[3];
+    __m128 Max[3];
+    i32 Children[4];    // >= 0 nodes, < 0 triangle blocks (-(Block + 1))
+    u32 ChildCount;
+} BVH4_NODE;
+
+// Four triangles in SoA form for Moller-Trumbore - unused lanes are degenerate and never hit
+typedef struct TRIANGLE4
+{
+    __m128 Vertex[3];
+    __m128 Edge1[3];
+    __m128 Edge2[3];
+    u32 Triangles[4];
+} TRIANGLE4;
+
+typedef struct RAY4
+{
+    __m128 Origin[3];
+    __m128 Direction[3];
+    __m128 InverseDirection[3];
+} RAY4;
+
+typedef struct RAY_HIT
+{
+    u32 Triangle;
+    f32 U;
+    f32 V;
+    f32 Distance;
+} RAY_HIT;
+
+typedef struct BAKER
+{
+    // Input level, used in place
+    u8                  *File;
+    size_t              FileSize;
+    LEVEL_HEADER        *Header;
+    LEVEL_VERTEX        *Vertices;      // Copy - lightmap UVs are written here
+    u32                 *Indices;
+    u32                 TriangleCount;
+    V3F                 *TriangleNormals;
+    BUFFER<LIGHT>       Lights;
+
+    // Acceleration structure
+    BUFFER<BVH_BUILD_NODE> BuildNodes;
+    u32                 *BuildTriangles;
+    BUFFER<BVH4_NODE>   Nodes;
+    BUFFER<TRIANGLE4>   Blocks;
+    i32                 Root;
+
+    // Atlas for the current density
+    BUFFER<CHART>       Charts;
+    BUFFER<TEXEL>       Texels;
+    u32                 AtlasWidth;
+    u32                 AtlasHeight;
+    f32                 Density;
+    V3F                 *Previous;      // Last pass, sampled by the next bounce
+    V3F                 *Current;
+    V3F                 *Total;
+
+    // Bake settings and work distribution
+    u32                 Bounces;
+    u32                 Samples;
+    u32                 Pass;           // 0 is direct light, then one per bounce
+    std::atomic<u32>    NextTexel;
+    std::atomic<u64>    RayCount;
+} BAKER;
+
+typedef struct BAKE_TIMES
+{
+    f64 Direct;
+    f64 Bounces;
+    u64 DirectRays;
+    u64 BounceRays;
+} BAKE_TIMES;
+
+f64 SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - Start).count();
+}
+
+// Deterministic per texel and sample, so a bake is identical at any thread count
+inline u32 Hash(u32 Value)
+{
+    Value ^= Value >> 16;
+    Value *= 0x7FEB352D;
+    Value ^= Value >> 15;
+    Value *= 0x846CA68B;
+    Value ^= Value >> 16;
+    return Value;
+}
+
+inline f32 RandomUnit(u32 Seed)
+{
+    return (f32) (Hash(Seed) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Orthonormal U and V for a plane normal
+void TangentBasis(V3F Normal, V3F *AxisU, V3F *AxisV)
+{
+    V3F Helper  = (fabsf(Normal.Y) < 0.9f) ? V3F{0, 1, 0} : V3F{1, 0, 0};
+    *AxisU      = Normalize(Cross(Helper, Normal));
+    *AxisV      = Cross(Normal, *AxisU);
+}
+
+bool LoadLevel(BAKER *Baker, const char *Path)
+{
+    FILE *File = fopen(Path, "rb");
+    if(!File)
+    {
+        return false;
+    }
+    fseek(File, 0, SEEK_END);
+    Baker->FileSize = (size_t) ftell(File);
+    fseek(File, 0, SEEK_SET);
+    Baker->File = (u8 *) malloc(Baker->FileSize);
+    bool Read = Baker->File && Baker->FileSize >= sizeof(LEVEL_HEADER) && fread(Baker->File, 1, Baker->FileSize, File) == Baker->FileSize;
+    fclose(File);
+    if(!Read)
+    {
+        return false;
+    }
+
+    LEVEL_HEADER *Header = (LEVEL_HEADER *) Baker->File;
+    if(Header->Magic != LEVEL_MAGIC || Header->Version != LEVEL_VERSION)
+    {
+        printf("Baker: %s is not a version %u level\n", Path, LEVEL_VERSION);
+        return false;
+    }
+
+    // Any existing lightmap is replaced, so it isn't checked
+    u32 Offsets[]   = {Header->PlaneOffset, Header->NodeOffset, Header->LeafOffset, Header->VertexOffset, Header->IndexOffset, Header->VisibilityOffset};
+    u64 Sizes[]     = {(u64) sizeof(LEVEL_PLANE) * Header->PlaneCount, (u64) sizeof(LEVEL_NODE) * Header->NodeCount, (u64) sizeof(LEVEL_LEAF) * Header->LeafCount,
+                       (u64) sizeof(LEVEL_VERTEX) * Header->VertexCount, (u64) sizeof(u32) * Header->IndexCount, Header->VisibilityBytes};
+    for(u32 i = 0; i < ArrayCount(Offsets); ++i)
+    {
+        if((u64) Offsets[i] + Sizes[i] > Baker->FileSize)
+        {
+            printf("Baker: %s is truncated\n", Path);
+            return false;
+        }
+    }
+
+    Baker->Header           = Header;
+    Baker->Indices          = (u32 *) (Baker->File + Header->IndexOffset);
+    Baker->TriangleCount    = Header->IndexCount / 3;
+    Baker->Vertices         = (LEVEL_VERTEX *) malloc(sizeof(LEVEL_VERTEX) * Header->VertexCount + 1);
+    memcpy(Baker->Vertices, Baker->File + Header->VertexOffset, sizeof(LEVEL_VERTEX) * Header->VertexCount);
+
+    Baker->TriangleNormals = (V3F *) malloc(sizeof(V3F) * Baker->TriangleCount + 1);
+    for(u32 i = 0; i < Baker->TriangleCount; ++i)
+    {
+        Baker->TriangleNormals[i] = LoadV3F(Baker->Vertices[Baker->Indices[i * 3]].Normal);
+    }
+    return true;
+}
+
+bool LoadLights(BAKER *Baker, const char *Path)
+{
+    FILE *File = fopen(Path, "r");
+    if(!File)
+    {
+        return false;
+    }
+
+    // Everything but lights was consumed by the compiler
+    char Line[256];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        f32 X, Y, Z, R, G, B, Radius;
+        if(sscanf(Line, " light %f %f %f %f %f %f %f", &X, &Y, &Z, &R, &G, &B, &Radius) == 7 && Radius > 0)
+        {
+            LIGHT *Light    = Baker->Lights.Push();
+            Light->Position = {X, Y, Z};
+            Light->Colour   = {R, G, B};
+            Light->Radius   = Radius;
+        }
+    }
+
+    fclose(File);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BVH
+
+f32 SurfaceArea(V3F Min, V3F Max)
+{
+    V3F Size = Max - Min;
+    return 2.0f * (Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X);
+}
+
+void TriangleBounds(BAKER *Baker, u32 Triangle, V3F *Min, V3F *Max)
+{
+    const u32 *Index = &Baker->Indices[Triangle * 3];
+    V3F A = LoadV3F(Baker->Vertices[Index[0]].Position);
+    V3F B = LoadV3F(Baker->Vertices[Index[1]].Position);
+    V3F C = LoadV3F(Baker->Vertices[Index[2]].Position);
+    *Min = MinV3F(A, MinV3F(B, C));
+    *Max = MaxV3F(A, MaxV3F(B, C));
+}
+
+// Binned SAH over triangle centroids, splitting until leaves fit in one TRIANGLE4
+u32 BuildBinaryNode(BAKER *Baker, V3F *Centroids, u32 First, u32 Count)
+{
+    u32 NodeIndex = Baker->BuildNodes.Count;
+    Baker->BuildNodes.Push();
+
+    u32 *Triangles  = Baker->BuildTriangles + First;
+    V3F Min         = {FLT_MAX, FLT_MAX, FLT_MAX};
+    V3F Max         = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    V3F CentroidMin = Min;
+    V3F CentroidMax = Max;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        V3F TriangleMin, TriangleMax;
+        TriangleBounds(Baker, Triangles[i], &TriangleMin, &TriangleMax);
+        Min         = MinV3F(Min, TriangleMin);
+        Max         = MaxV3F(Max, TriangleMax);
+        CentroidMin = MinV3F(CentroidMin, Centroids[Triangles[i]]);
+        CentroidMax = MaxV3F(CentroidMax, Centroids[Triangles[i]]);
+    }
+    Baker->BuildNodes[NodeIndex].Min = Min;
+    Baker->BuildNodes[NodeIndex].Max = Max;
+
+    if(Count <= BAKER_LEAF_SIZE)
+    {
+        Baker->BuildNodes[NodeIndex].First = First;
+        Baker->BuildNodes[NodeIndex].Count = Count;
+        return NodeIndex;
+    }
+
+    // Widest centroid axis
+    V3F Extent  = CentroidMax - CentroidMin;
+    u32 Axis    = (Extent.Y > Extent.X) ? 1 : 0;
+    Axis        = (Extent.Z > (&Extent.X)[Axis]) ? 2 : Axis;
+    f32 AxisMin = (&CentroidMin.X)[Axis];
+    f32 AxisExtent = (&Extent.X)[Axis];
+
+    u32 Split = Count / 2;
+    if(AxisExtent > 0)
+    {
+        u32 BinCounts[BAKER_SAH_BINS] = {};
+        V3F BinMin[BAKER_SAH_BINS];
+        V3F BinMax[BAKER_SAH_BINS];
+        for(u32 i = 0; i < BAKER_SAH_BINS; ++i)
+        {
+            BinMin[i] = {FLT_MAX, FLT_MAX, FLT_MAX};
+            BinMax[i] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        }
+
+        f32 BinScale = BAKER_SAH_BINS / AxisExtent;
+        for(u32 i = 0; i < Count; ++i)
+        {
+            u32 Bin = (u32) (((&Centroids[Triangles[i]].X)[Axis] - AxisMin) * BinScale);
+            Bin     = (Bin >= BAKER_SAH_BINS) ? BAKER_SAH_BINS - 1 : Bin;
+            V3F TriangleMin, TriangleMax;
+            TriangleBounds(Baker, Triangles[i], &TriangleMin, &TriangleMax);
+            ++BinCounts[Bin];
+            BinMin[Bin] = MinV3F(BinMin[Bin], TriangleMin);
+            BinMax[Bin] = MaxV3F(BinMax[Bin], TriangleMax);
+        }
+
+        // Sweep from the right for suffix areas, then from the left to score each plane
+        f32 RightArea[BAKER_SAH_BINS];
+        u32 RightCount[BAKER_SAH_BINS];
+        V3F SweepMin = {FLT_MAX, FLT_MAX, FLT_MAX};
+        V3F SweepMax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        u32 Sum = 0;
+        for(u32 i = BAKER_SAH_BINS - 1; i > 0; --i)
+        {
+            SweepMin        = MinV3F(SweepMin, BinMin[i]);
+            SweepMax        = MaxV3F(SweepMax, BinMax[i]);
+            Sum            += BinCounts[i];
+            RightArea[i]    = Sum ? SurfaceArea(SweepMin, SweepMax) : 0;
+            RightCount[i]   = Sum;
+        }
+
+        f32 BestCost    = FLT_MAX;
+        u32 BestPlane   = 0;
+        SweepMin        = {FLT_MAX, FLT_MAX, FLT_MAX};
+        SweepMax        = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        Sum             = 0;
+        for(u32 i = 1; i < BAKER_SAH_BINS; ++i)
+        {
+            SweepMin    = MinV3F(SweepMin, BinMin[i - 1]);
+            SweepMax    = MaxV3F(SweepMax, BinMax[i - 1]);
+            Sum        += BinCounts[i - 1];
+            if(!Sum || !RightCount[i])
+            {
+                continue;
+            }
+            f32 Cost = SurfaceArea(SweepMin, SweepMax) * Sum + RightArea[i] * RightCount[i];
+            if(Cost < BestCost)
+            {
+                BestCost    = Cost;
+                BestPlane   = i;
+            }
+        }
+
+        if(BestPlane)
+        {
+            u32 *Left   = Triangles;
+            u32 *Right  = Triangles + Count;
+            while(Left < Right)
+            {
+                u32 Bin = (u32) (((&Centroids[*Left].X)[Axis] - AxisMin) * BinScale);
+                Bin     = (Bin >= BAKER_SAH_BINS) ? BAKER_SAH_BINS - 1 : Bin;
+                if(Bin < BestPlane)
+                {
+                    ++Left;
+                }
+                else
+                {
+                    u32 Swap    = *Left;
+                    *Left       = *--Right;
+                    *Right      = Swap;
+                }
+            }
+            Split = (u32) (Left - Triangles);
+        }
+    }
+
+    // Everything in one bin (or stacked centroids) - median split on the axis instead
+    if(Split == 0 || Split == Count || AxisExtent <= 0)
+    {
+        Split = Count / 2;
+        std::nth_element(Triangles, Triangles + Split, Triangles + Count, [Centroids, Axis](u32 A, u32 B)
+        {
+            return (&Centroids[A].X)[Axis] < (&Centroids[B].X)[Axis];
+        });
+    }
+
+    u32 Left    = BuildBinaryNode(Baker, Centroids, First, Split);
+    u32 Right   = BuildBinaryNode(Baker, Centroids, First + Split, Count - Split);
+    Baker->BuildNodes[NodeIndex].Children[0] = Left;
+    Baker->BuildNodes[NodeIndex].Children[1] = Right;
+    return NodeIndex;
+}
+
+i32 MakeTriangleBlock(BAKER *Baker, BVH_BUILD_NODE *Leaf)
+{
+    TRIANGLE4 Block = {};
+    for(u32 Lane = 0; Lane < 4; ++Lane)
+    {
+        Block.Triangles[Lane] = 0xFFFFFFFF;
+    }
+
+    f32 Values[9][4] = {};
+    for(u32 Lane = 0; Lane < Leaf->Count; ++Lane)
+    {
+        u32 Triangle    = Baker->BuildTriangles[Leaf->First + Lane];
+        const u32 *Index = &Baker->Indices[Triangle * 3];
+        V3F A           = LoadV3F(Baker->Vertices[Index[0]].Position);
+        V3F Edge1       = LoadV3F(Baker->Vertices[Index[1]].Position) - A;
+        V3F Edge2       = LoadV3F(Baker->Vertices[Index[2]].Position) - A;
+        const f32 *Sources[] = {&A.X, &Edge1.X, &Edge2.X};
+        for(u32 i = 0; i < 9; ++i)
+        {
+            Values[i][Lane] = Sources[i / 3][i % 3];
+        }
+        Block.Triangles[Lane] = Triangle;
+    }
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        Block.Vertex[Axis]  = _mm_loadu_ps(Values[Axis]);
+        Block.Edge1[Axis]   = _mm_loadu_ps(Values[3 + Axis]);
+        Block.Edge2[Axis]   = _mm_loadu_ps(Values[6 + Axis]);
+    }
+
+    *Baker->Blocks.Push() = Block;
+    return -(i32) Baker->Blocks.Count;
+}
+
+// Pulls grandchildren up into a four wide node, always opening the largest interior child first
+i32 CollapseNode(BAKER *Baker, u32 BuildIndex)
+{
+    BVH_BUILD_NODE *Node = &Baker->BuildNodes[BuildIndex];
+    if(Node->Count)
+    {
+        return MakeTriangleBlock(Baker, Node);
+    }
+
+    u32 Children[4] = {Node->Children[0], Node->Children[1]};
+    u32 ChildCount  = 2;
+    while(ChildCount < 4)
+    {
+        i32 Largest     = -1;
+        f32 LargestArea = -1.0f;
+        for(u32 i = 0; i < ChildCount; ++i)
+        {
+            BVH_BUILD_NODE *Child = &Baker->BuildNodes[Children[i]];
+            f32 Area = SurfaceArea(Child->Min, Child->Max);
+            if(!Child->Count && Area > LargestArea)
+            {
+                Largest     = (i32) i;
+                LargestArea = Area;
+            }
+        }
+        if(Largest < 0)
+        {
+            break;
+        }
+        BVH_BUILD_NODE *Open    = &Baker->BuildNodes[Children[Largest]];
+        Children[Largest]       = Open->Children[0];
+        Children[ChildCount++]  = Open->Children[1];
+    }
+
+    // Children are built first - Push can move the node array
+    i32 Encoded[4] = {};
+    for(u32 i = 0; i < ChildCount; ++i)
+    {
+        Encoded[i] = CollapseNode(Baker, Children[i]);
+    }
+
+    f32 Bounds[6][4] = {};
+    for(u32 i = 0; i < ChildCount; ++i)
+    {
+        BVH_BUILD_NODE *Child = &Baker->BuildNodes[Children[i]];
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            Bounds[Axis][i]     = (&Child->Min.X)[Axis];
+            Bounds[3 + Axis][i] = (&Child->Max.X)[Axis];
+        }
+    }
+
+    i32 Result = (i32) Baker->Nodes.Count;
+    BVH4_NODE *Output = Baker->Nodes.Push();
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        Output->Min[Axis] = _mm_loadu_ps(Bounds[Axis]);
+        Output->Max[Axis] = _mm_loadu_ps(Bounds[3 + Axis]);
+    }
+    memcpy(Output->Children, Encoded, sizeof(Encoded));
+    Output->ChildCount = ChildCount;
+    return Result;
+}
+
+// A leaf with no triangles would read as an interior node to CollapseNode, so an empty level is refused here
+bool BuildBVH(BAKER *Baker)
+{
+    if(!Baker->TriangleCount)
+    {
+        printf("Baker: No triangles to build a BVH over\n");
+        return false;
+    }
+
+    V3F *Centroids          = (V3F *) malloc(sizeof(V3F) * Baker->TriangleCount + 1);
+    Baker->BuildTriangles   = (u32 *) malloc(sizeof(u32) * Baker->TriangleCount + 1);
+    for(u32 i = 0; i < Baker->TriangleCount; ++i)
+    {
+        V3F Min, Max;
+        TriangleBounds(Baker, i, &Min, &Max);
+        Centroids[i]                = (Min + Max) * 0.5f;
+        Baker->BuildTriangles[i]    = i;
+    }
+
+    u32 Root        = BuildBinaryNode(Baker, Centroids, 0, Baker->TriangleCount);
+    Baker->Root     = CollapseNode(Baker, Root);
+
+    free(Centroids);
+    return true;
+}
+
+inline RAY4 MakeRay4(V3F Origin, V3F Direction)
+{
+    // Keep the slab test free of 0 * inf
+    f32 Components[] = {Direction.X, Direction.Y, Direction.Z};
+    for(u32 i = 0; i < 3; ++i)
+    {
+        Components[i] = (fabsf(Components[i]) < 1e-8f) ? copysignf(1e-8f, Components[i]) : Components[i];
+    }
+
+    RAY4 Ray;
+    const f32 *Start = &Origin.X;
+    const f32 *Facing = &Direction.X;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        Ray.Origin[i]           = _mm_set1_ps(Start[i]);
+        Ray.Direction[i]        = _mm_set1_ps(Facing[i]);
+        Ray.InverseDirection[i] = _mm_set1_ps(1.0f / Components[i]);
+    }
+    return Ray;
+}
+
+// Entry distances for the four child boxes, returns a mask of the ones hit before MaxDistance
+inline u32 IntersectNode(BVH4_NODE *Node, RAY4 *Ray, f32 MaxDistance, __m128 *Near)
+{
+    __m128 Enter    = _mm_setzero_ps();
+    __m128 Exit     = _mm_set1_ps(MaxDistance);
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        __m128 T0   = _mm_mul_ps(_mm_sub_ps(Node->Min[Axis], Ray->Origin[Axis]), Ray->InverseDirection[Axis]);
+        __m128 T1   = _mm_mul_ps(_mm_sub_ps(Node->Max[Axis], Ray->Origin[Axis]), Ray->InverseDirection[Axis]);
+        Enter       = _mm_max_ps(Enter, _mm_min_ps(T0, T1));
+        Exit        = _mm_min_ps(Exit, _mm_max_ps(T0, T1));
+    }
+    *Near = Enter;
+    return (u32) _mm_movemask_ps(_mm_cmple_ps(Enter, Exit)) & ((1u << Node->ChildCount) - 1);
+}
+
+// Moller-Trumbore against four triangles, returns a mask of lanes hit before MaxDistance
+inline u32 IntersectTriangles(TRIANGLE4 *Block, RAY4 *Ray, f32 MaxDistance, __m128 *Distance, __m128 *U, __m128 *V)
+{
+    // P = D x E2
+    __m128 PX = _mm_sub_ps(_mm_mul_ps(Ray->Direction[1], Block->Edge2[2]), _mm_mul_ps(Ray->Direction[2], Block->Edge2[1]));
+    __m128 PY = _mm_sub_ps(_mm_mul_ps(Ray->Direction[2], Block->Edge2[0]), _mm_mul_ps(Ray->Direction[0], Block->Edge2[2]));
+    __m128 PZ = _mm_sub_ps(_mm_mul_ps(Ray->Direction[0], Block->Edge2[1]), _mm_mul_ps(Ray->Direction[1], Block->Edge2[0]));
+    __m128 Determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Block->Edge1[0], PX), _mm_mul_ps(Block->Edge1[1], PY)), _mm_mul_ps(Block->Edge1[2], PZ));
+    __m128 Inverse = _mm_div_ps(_mm_set1_ps(1.0f), Determinant);
+
+    __m128 TX = _mm_sub_ps(Ray->Origin[0], Block->Vertex[0]);
+    __m128 TY = _mm_sub_ps(Ray->Origin[1], Block->Vertex[1]);
+    __m128 TZ = _mm_sub_ps(Ray->Origin[2], Block->Vertex[2]);
+    *U = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(TX, PX), _mm_mul_ps(TY, PY)), _mm_mul_ps(TZ, PZ)), Inverse);
+
+    // Q = T x E1
+    __m128 QX = _mm_sub_ps(_mm_mul_ps(TY, Block->Edge1[2]), _mm_mul_ps(TZ, Block->Edge1[1]));
+    __m128 QY = _mm_sub_ps(_mm_mul_ps(TZ, Block->Edge1[0]), _mm_mul_ps(TX, Block->Edge1[2]));
+    __m128 QZ = _mm_sub_ps(_mm_mul_ps(TX, Block->Edge1[1]), _mm_mul_ps(TY, Block->Edge1[0]));
+    *V = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Ray->Direction[0], QX), _mm_mul_ps(Ray->Direction[1], QY)), _mm_mul_ps(Ray->Direction[2], QZ)), Inverse);
+    *Distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Block->Edge2[0], QX), _mm_mul_ps(Block->Edge2[1], QY)), _mm_mul_ps(Block->Edge2[2], QZ)), Inverse);
+
+    // Degenerate lanes have a zero determinant, so every comparison against their NaNs fails
+    __m128 Zero = _mm_setzero_ps();
+    __m128 Mask = _mm_cmpge_ps(*U, Zero);
+    Mask = _mm_and_ps(Mask, _mm_cmpge_ps(*V, Zero));
+    Mask = _mm_and_ps(Mask, _mm_cmple_ps(_mm_add_ps(*U, *V), _mm_set1_ps(1.0f)));
+    Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(*Distance, _mm_set1_ps(1e-4f)));
+    Mask = _mm_and_ps(Mask, _mm_cmplt_ps(*Distance, _mm_set1_ps(MaxDistance)));
+    return (u32) _mm_movemask_ps(Mask);
+}
+
+// Nearest hit, children visited front to back and skipped once they start past the current hit
+bool TraceClosest(BAKER *Baker, V3F Origin, V3F Direction, RAY_HIT *Hit)
+{
+    RAY4 Ray            = MakeRay4(Origin, Direction);
+    f32 MaxDistance     = FLT_MAX;
+    bool Result         = false;
+
+    i32 Stack[BAKER_STACK_SIZE];
+    f32 StackNear[BAKER_STACK_SIZE];
+    u32 StackCount      = 1;
+    Stack[0]            = Baker->Root;
+    StackNear[0]        = 0;
+    while(StackCount)
+    {
+        --StackCount;
+        i32 Child = Stack[StackCount];
+        if(StackNear[StackCount] > MaxDistance)
+        {
+            continue;
+        }
+
+        if(Child < 0)
+        {
+            __m128 Distance, U, V;
+            u32 Mask = IntersectTriangles(&Baker->Blocks[(u32) (-Child - 1)], &Ray, MaxDistance, &Distance, &U, &V);
+            if(Mask)
+            {
+                alignas(16) f32 Distances[4], Us[4], Vs[4];
+                _mm_store_ps(Distances, Distance);
+                _mm_store_ps(Us, U);
+                _mm_store_ps(Vs, V);
+                for(u32 Lane = 0; Lane < 4; ++Lane)
+                {
+                    if((Mask & (1 << Lane)) && Distances[Lane] < MaxDistance)
+                    {
+                        MaxDistance     = Distances[Lane];
+                        Hit->Triangle   = Baker->Blocks[(u32) (-Child - 1)].Triangles[Lane];
+                        Hit->U          = Us[Lane];
+                        Hit->V          = Vs[Lane];
+                        Hit->Distance   = Distances[Lane];
+                        Result          = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        BVH4_NODE *Node = &Baker->Nodes[(u32) Child];
+        __m128 Near;
+        u32 Mask = IntersectNode(Node, &Ray, MaxDistance, &Near);
+        if(!Mask)
+        {
+            continue;
+        }
+
+        // Insertion sort the hit children far to near, so the nearest is popped first
+        alignas(16) f32 Nears[4];
+        _mm_store_ps(Nears, Near);
+        u32 First = StackCount;
+        for(u32 Lane = 0; Lane < 4; ++Lane)
+        {
+            if(!(Mask & (1 << Lane)))
+            {
+                continue;
+            }
+            u32 Slot = StackCount++;
+            while(Slot > First && StackNear[Slot - 1] < Nears[Lane])
+            {
+                Stack[Slot]     = Stack[Slot - 1];
+                StackNear[Slot] = StackNear[Slot - 1];
+                --Slot;
+            }
+            Stack[Slot]     = Node->Children[Lane];
+            StackNear[Slot] = Nears[Lane];
+        }
+    }
+
+    return Result;
+}
+
+// Shadow rays - any hit will do
+bool TraceOccluded(BAKER *Baker, V3F Origin, V3F Direction, f32 MaxDistance)
+{
+    RAY4 Ray = MakeRay4(Origin, Direction);
+
+    i32 Stack[BAKER_STACK_SIZE];
+    u32 StackCount  = 1;
+    Stack[0]        = Baker->Root;
+    while(StackCount)
+    {
+        i32 Child = Stack[--StackCount];
+        if(Child < 0)
+        {
+            __m128 Distance, U, V;
+            if(IntersectTriangles(&Baker->Blocks[(u32) (-Child - 1)], &Ray, MaxDistance, &Distance, &U, &V))
+            {
+                return true;
+            }
+            continue;
+        }
+
+        BVH4_NODE *Node = &Baker->Nodes[(u32) Child];
+        __m128 Near;
+        u32 Mask = IntersectNode(Node, &Ray, MaxDistance, &Near);
+        for(u32 Lane = 0; Lane < 4; ++Lane)
+        {
+            if(Mask & (1 << Lane))
+            {
+                Stack[StackCount++] = Node->Children[Lane];
+            }
+        }
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Atlas
+
+// Chart corners in plane space, in winding order
+void ChartPolygon(BAKER *Baker, CHART *Chart, f32 *U, f32 *V)
+{
+    for(u32 i = 0; i < Chart->VertexCount; ++i)
+    {
+        V3F Position = LoadV3F(Baker->Vertices[Chart->FirstVertex + i].Position);
+        U[i] = Dot(Position, Chart->AxisU);
+        V[i] = Dot(Position, Chart->AxisV);
+    }
+}
+
+void BuildCharts(BAKER *Baker, f32 Density)
+{
+    Baker->Charts.Count = 0;
+    for(u32 Triangle = 0; Triangle < Baker->TriangleCount; ++Triangle)
+    {
+        const u32 *Index = &Baker->Indices[Triangle * 3];
+        CHART *Chart = Baker->Charts.Count ? &Baker->Charts[Baker->Charts.Count - 1] : 0;
+        if(!Chart || Chart->FirstVertex != Index[0])
+        {
+            Chart               = Baker->Charts.Push();
+            Chart->FirstVertex  = Index[0];
+            Chart->Normal       = LoadV3F(Baker->Vertices[Index[0]].Normal);
+            TangentBasis(Chart->Normal, &Chart->AxisU, &Chart->AxisV);
+        }
+        u32 Last = (Index[1] > Index[2]) ? Index[1] : Index[2];
+        Chart->VertexCount = (Last - Chart->FirstVertex + 1 > Chart->VertexCount) ? Last - Chart->FirstVertex + 1 : Chart->VertexCount;
+    }
+
+    for(u32 i = 0; i < Baker->Charts.Count; ++i)
+    {
+        CHART *Chart = &Baker->Charts[i];
+        f32 U[BAKER_MAX_POINTS], V[BAKER_MAX_POINTS];
+        ChartPolygon(Baker, Chart, U, V);
+        f32 MaxU = -FLT_MAX, MaxV = -FLT_MAX;
+        Chart->MinU = FLT_MAX;
+        Chart->MinV = FLT_MAX;
+        for(u32 Point = 0; Point < Chart->VertexCount; ++Point)
+        {
+            Chart->MinU = fminf(Chart->MinU, U[Point]);
+            Chart->MinV = fminf(Chart->MinV, V[Point]);
+            MaxU        = fmaxf(MaxU, U[Point]);
+            MaxV        = fmaxf(MaxV, V[Point]);
+        }
+        Chart->Width    = (u32) ceilf((MaxU - Chart->MinU) * Density) + 2;
+        Chart->Height   = (u32) ceilf((MaxV - Chart->MinV) * Density) + 2;
+    }
+}
+
+// Shelf packing, tallest first - returns false if the charts don't fit in the largest atlas
+bool PackCharts(BAKER *Baker)
+{
+    u32 *Order  = (u32 *) malloc(sizeof(u32) * Baker->Charts.Count + 1);
+    u64 Area    = 0;
+    u32 Widest  = 1;
+    for(u32 i = 0; i < Baker->Charts.Count; ++i)
+    {
+        Order[i]    = i;
+        Area       += (u64) Baker->Charts[i].Width * Baker->Charts[i].Height;
+        Widest      = (Baker->Charts[i].Width > Widest) ? Baker->Charts[i].Width : Widest;
+    }
+    std::sort(Order, Order + Baker->Charts.Count, [Baker](u32 A, u32 B)
+    {
+        return Baker->Charts[A].Height > Baker->Charts[B].Height;
+    });
+
+    // Start near square and widen until the shelves stop running taller than the atlas is wide
+    u32 Width = 1;
+    while(Width < BAKER_MAX_ATLAS && ((u64) Width * Width < Area || Width < Widest))
+    {
+        Width *= 2;
+    }
+
+    bool Result = false;
+    while(Widest <= Width)
+    {
+        u32 X = 0, Y = 0, ShelfHeight = 0;
+        for(u32 i = 0; i < Baker->Charts.Count; ++i)
+        {
+            CHART *Chart = &Baker->Charts[Order[i]];
+            if(X + Chart->Width > Width)
+            {
+                Y          += ShelfHeight;
+                X           = 0;
+                ShelfHeight = 0;
+            }
+            Chart->X        = X;
+            Chart->Y        = Y;
+            X              += Chart->Width;
+            ShelfHeight     = (Chart->Height > ShelfHeight) ? Chart->Height : ShelfHeight;
+        }
+
+        u32 Height = (Y + ShelfHeight + 3) & ~3u;
+        if(Height <= Width || (Width == BAKER_MAX_ATLAS && Height <= BAKER_MAX_ATLAS))
+        {
+            Baker->AtlasWidth   = Width;
+            Baker->AtlasHeight  = Height ? Height : 4;
+            Result              = true;
+            break;
+        }
+        if(Width == BAKER_MAX_ATLAS)
+        {
+            break;
+        }
+        Width *= 2;
+    }
+
+    free(Order);
+    return Result;
+}
+
+// Closest point on a convex polygon's boundary, then pulled slightly towards its centre
+void ClampToPolygon(f32 *U, f32 *V, u32 Count, f32 *PointU, f32 *PointV)
+{
+    f32 Area = 0, CentreU = 0, CentreV = 0;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        u32 Next = (i + 1) % Count;
+        Area    += U[i] * V[Next] - U[Next] * V[i];
+        CentreU += U[i];
+        CentreV += V[i];
+    }
+    CentreU /= (f32) Count;
+    CentreV /= (f32) Count;
+    f32 Winding = (Area >= 0) ? 1.0f : -1.0f;
+
+    bool Inside = true;
+    f32 BestDistance = FLT_MAX, BestU = *PointU, BestV = *PointV;
+    for(u32 i = 0; i < Count; ++i)
+    {
+        u32 Next    = (i + 1) % Count;
+        f32 EdgeU   = U[Next] - U[i];
+        f32 EdgeV   = V[Next] - V[i];
+        f32 ToU     = *PointU - U[i];
+        f32 ToV     = *PointV - V[i];
+        if((EdgeU * ToV - EdgeV * ToU) * Winding < 0)
+        {
+            Inside = false;
+        }
+
+        f32 Length  = EdgeU * EdgeU + EdgeV * EdgeV;
+        f32 T       = (Length > 0) ? (ToU * EdgeU + ToV * EdgeV) / Length : 0;
+        T           = (T < 0) ? 0 : ((T > 1) ? 1 : T);
+        f32 DeltaU  = U[i] + EdgeU * T - *PointU;
+        f32 DeltaV  = V[i] + EdgeV * T - *PointV;
+        f32 Distance = DeltaU * DeltaU + DeltaV * DeltaV;
+        if(Distance < BestDistance)
+        {
+            BestDistance    = Distance;
+            BestU           = U[i] + EdgeU * T;
+            BestV           = V[i] + EdgeV * T;
+        }
+    }
+    if(Inside)
+    {
+        return;
+    }
+
+    f32 ToCentreU   = CentreU - BestU;
+    f32 ToCentreV   = CentreV - BestV;
+    f32 Length      = sqrtf(ToCentreU * ToCentreU + ToCentreV * ToCentreV);
+    f32 Inset       = (Length > BAKER_EDGE_INSET) ? BAKER_EDGE_INSET / Length : 0.5f;
+    *PointU         = BestU + ToCentreU * Inset;
+    *PointV         = BestV + ToCentreV * Inset;
+}
+
+// Lightmap UVs for every chart vertex, and a world space sample point for every chart texel (borders included)
+void BuildTexels(BAKER *Baker, f32 Density)
+{
+    Baker->Texels.Count = 0;
+    for(u32 i = 0; i < Baker->Charts.Count; ++i)
+    {
+        CHART *Chart = &Baker->Charts[i];
+        f32 U[BAKER_MAX_POINTS], V[BAKER_MAX_POINTS];
+        ChartPolygon(Baker, Chart, U, V);
+
+        for(u32 Point = 0; Point < Chart->VertexCount; ++Point)
+        {
+            LEVEL_VERTEX *Vertex    = &Baker->Vertices[Chart->FirstVertex + Point];
+            Vertex->LightmapUV[0]   = (Chart->X + (U[Point] - Chart->MinU) * Density + 1.0f) / (f32) Baker->AtlasWidth;
+            Vertex->LightmapUV[1]   = (Chart->Y + (V[Point] - Chart->MinV) * Density + 1.0f) / (f32) Baker->AtlasHeight;
+        }
+
+        // Plane space back to world space through the first corner
+        V3F Corner = LoadV3F(Baker->Vertices[Chart->FirstVertex].Position);
+        for(u32 Y = 0; Y < Chart->Height; ++Y)
+        {
+            for(u32 X = 0; X < Chart->Width; ++X)
+            {
+                f32 PointU = Chart->MinU + ((f32) X - 0.5f) / Density;
+                f32 PointV = Chart->MinV + ((f32) Y - 0.5f) / Density;
+                ClampToPolygon(U, V, Chart->VertexCount, &PointU, &PointV);
+
+                TEXEL *Texel    = Baker->Texels.Push();
+                Texel->Position = Corner + Chart->AxisU * (PointU - U[0]) + Chart->AxisV * (PointV - V[0]) + Chart->Normal * BAKER_SURFACE_OFFSET;
+                Texel->Normal   = Chart->Normal;
+                Texel->Atlas    = (Chart->Y + Y) * Baker->AtlasWidth + Chart->X + X;
+            }
+        }
+    }
+}
+
+// Charts, packing and sample points - lowers the density until the atlas fits
+f32 BuildAtlas(BAKER *Baker, f32 Density)
+{
+    for(;;)
+    {
+        BuildCharts(Baker, Density);
+        if(PackCharts(Baker))
+        {
+            break;
+        }
+        Density *= 0.75f;
+    }
+    BuildTexels(Baker, Density);
+    Baker->Density = Density;
+
+    size_t Bytes = sizeof(V3F) * Baker->AtlasWidth * Baker->AtlasHeight;
+    free(Baker->Previous);
+    free(Baker->Current);
+    free(Baker->Total);
+    Baker->Previous = (V3F *) calloc(1, Bytes);
+    Baker->Current  = (V3F *) calloc(1, Bytes);
+    Baker->Total    = (V3F *) calloc(1, Bytes);
+    Assert(Baker->Previous && Baker->Current && Baker->Total, "Baker: Failed to allocate atlas!");
+    return Density;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Lighting
+
+V3F DirectLight(BAKER *Baker, TEXEL *Texel, u64 *Rays)
+{
+    V3F Result = {};
+    for(u32 i = 0; i < Baker->Lights.Count; ++i)
+    {
+        LIGHT *Light    = &Baker->Lights[i];
+        V3F ToLight     = Light->Position - Texel->Position;
+        f32 Distance    = sqrtf(Dot(ToLight, ToLight));
+        if(Distance >= Light->Radius || Distance <= 0)
+        {
+            continue;
+        }
+        ToLight = ToLight * (1.0f / Distance);
+        f32 Facing = Dot(Texel->Normal, ToLight);
+        if(Facing <= 0)
+        {
+            continue;
+        }
+
+        ++*Rays;
+        if(!TraceOccluded(Baker, Texel->Position, ToLight, Distance))
+        {
+            Result = Result + Light->Colour * (Facing * (1.0f - Distance / Light->Radius));
+        }
+    }
+    return Result;
+}
+
+// Irradiance from the previous pass - cosine weighted, so the estimate is just the mean of what the rays see
+V3F GatherLight(BAKER *Baker, TEXEL *Texel, u32 TexelIndex, u64 *Rays)
+{
+    V3F AxisU, AxisV;
+    TangentBasis(Texel->Normal, &AxisU, &AxisV);
+
+    V3F Result  = {};
+    u32 Seed    = Hash(TexelIndex * 0x9E3779B9u + Baker->Pass * 0x85EBCA6Bu);
+    for(u32 Sample = 0; Sample < Baker->Samples; ++Sample)
+    {
+        f32 Angle       = 6.2831853f * RandomUnit(Seed + Sample * 2);
+        f32 Radius2     = RandomUnit(Seed + Sample * 2 + 1);
+        f32 Radius      = sqrtf(Radius2);
+        V3F Direction   = AxisU * (cosf(Angle) * Radius) + AxisV * (sinf(Angle) * Radius) + Texel->Normal * sqrtf(1.0f - Radius2);
+
+        RAY_HIT Hit;
+        if(!TraceClosest(Baker, Texel->Position, Direction, &Hit) || Dot(Baker->TriangleNormals[Hit.Triangle], Direction) >= 0)
+        {
+            continue;
+        }
+
+        // Nearest texel under the hit's interpolated lightmap UV
+        const u32 *Index    = &Baker->Indices[Hit.Triangle * 3];
+        const f32 *A        = Baker->Vertices[Index[0]].LightmapUV;
+        const f32 *B        = Baker->Vertices[Index[1]].LightmapUV;
+        const f32 *C        = Baker->Vertices[Index[2]].LightmapUV;
+        f32 W               = 1.0f - Hit.U - Hit.V;
+        i32 X               = (i32) ((A[0] * W + B[0] * Hit.U + C[0] * Hit.V) * Baker->AtlasWidth);
+        i32 Y               = (i32) ((A[1] * W + B[1] * Hit.U + C[1] * Hit.V) * Baker->AtlasHeight);
+        X = (X < 0) ? 0 : ((X >= (i32) Baker->AtlasWidth) ? (i32) Baker->AtlasWidth - 1 : X);
+        Y = (Y < 0) ? 0 : ((Y >= (i32) Baker->AtlasHeight) ? (i32) Baker->AtlasHeight - 1 : Y);
+        Result = Result + Baker->Previous[(u32) Y * Baker->AtlasWidth + (u32) X];
+    }
+    *Rays += Baker->Samples;
+
+    return Result * (BAKER_ALBEDO / (f32) Baker->Samples);
+}
+
+void BakeWorker(BAKER *Baker)
+{
+    u64 Rays = 0;
+    for(;;)
+    {
+        u32 First = Baker->NextTexel.fetch_add(BAKER_TEXEL_CHUNK);
+        if(First >= Baker->Texels.Count)
+        {
+            break;
+        }
+        u32 Last = (First + BAKER_TEXEL_CHUNK < Baker->Texels.Count) ? First + BAKER_TEXEL_CHUNK : Baker->Texels.Count;
+
+        // Each atlas texel belongs to one chart texel, so threads never write the same entry
+        for(u32 i = First; i < Last; ++i)
+        {
+            TEXEL *Texel    = &Baker->Texels[i];
+            V3F Light       = (Baker->Pass == 0) ? DirectLight(Baker, Texel, &Rays) : GatherLight(Baker, Texel, i, &Rays);
+            Baker->Current[Texel->Atlas]    = Light;
+            Baker->Total[Texel->Atlas]      = Baker->Total[Texel->Atlas] + Light;
+        }
+    }
+    Baker->RayCount += Rays;
+}
+
+f64 BakePass(BAKER *Baker, u32 ThreadCount, u32 Pass, u64 *Rays)
+{
+    auto Start = std::chrono::steady_clock::now();
+
+    Baker->Pass         = Pass;
+    Baker->NextTexel    = 0;
+    Baker->RayCount     = 0;
+
+    std::thread Threads[BAKER_MAX_THREADS];
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i] = std::thread(BakeWorker, Baker);
+    }
+    BakeWorker(Baker);
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i].join();
+    }
+
+    // This pass is what the next bounce sees
+    V3F *Swap           = Baker->Previous;
+    Baker->Previous     = Baker->Current;
+    Baker->Current      = Swap;
+
+    *Rays = Baker->RayCount;
+    return SecondsSince(Start);
+}
+
+void Bake(BAKER *Baker, u32 ThreadCount, BAKE_TIMES *Times)
+{
+    *Times = {};
+    size_t Bytes = sizeof(V3F) * Baker->AtlasWidth * Baker->AtlasHeight;
+    memset(Baker->Previous, 0, Bytes);
+    memset(Baker->Total, 0, Bytes);
+
+    Times->Direct = BakePass(Baker, ThreadCount, 0, &Times->DirectRays);
+    for(u32 Bounce = 1; Bounce <= Baker->Bounces; ++Bounce)
+    {
+        u64 Rays = 0;
+        Times->Bounces      += BakePass(Baker, ThreadCount, Bounce, &Rays);
+        Times->BounceRays   += Rays;
+    }
+}
+
+void PrintBake(const char *Label, BAKER *Baker, u32 ThreadCount, BAKE_TIMES *Times)
+{
+    f64 Seconds = Times->Direct + Times->Bounces;
+    printf("%s: %5.2f texels/unit %8u texels %2u threads - direct %.3fs, %u bounces %.3fs, %.3fs total (%.2fM rays/s)\n", Label,
+            Baker->Density, Baker->Texels.Count, ThreadCount, Times->Direct, Baker->Bounces, Times->Bounces, Seconds,
+            (f64) (Times->DirectRays + Times->BounceRays) / (Seconds * 1000000.0));
+}
+
+bool WriteLevel(BAKER *Baker, const char *Path)
+{
+    LEVEL_HEADER Header     = *Baker->Header;
+    Header.LightmapWidth    = Baker->AtlasWidth;
+    Header.LightmapHeight   = Baker->AtlasHeight;
+
+    // Linear RGBA8, first row is V = 0 like the rest of the GL texture data
+    u32 TexelCount = Baker->AtlasWidth * Baker->AtlasHeight;
+    u8 *Lightmap = (u8 *) malloc((size_t) TexelCount * 4);
+    for(u32 i = 0; i < TexelCount; ++i)
+    {
+        const f32 *Light = &Baker->Total[i].X;
+        for(u32 Channel = 0; Channel < 3; ++Channel)
+        {
+            f32 Value = (Light[Channel] > 1.0f) ? 1.0f : Light[Channel];
+            Lightmap[i * 4 + Channel] = (u8) lrintf(Value * 255.0f);
+        }
+        Lightmap[i * 4 + 3] = 255;
+    }
+
+    // Same layout as the compiler writes, with the lightmap appended
+    u32 Offset = (sizeof(LEVEL_HEADER) + 15) & ~15u;
+    u32 *Offsets[]      = {&Header.PlaneOffset, &Header.NodeOffset, &Header.LeafOffset, &Header.VertexOffset, &Header.IndexOffset, &Header.VisibilityOffset,
+                           &Header.LightmapOffset};
+    const void *Data[]  = {Baker->File + Baker->Header->PlaneOffset, Baker->File + Baker->Header->NodeOffset, Baker->File + Baker->Header->LeafOffset,
+                           Baker->Vertices, Baker->Indices, Baker->File + Baker->Header->VisibilityOffset, Lightmap};
+    u32 Sizes[]         = {(u32) sizeof(LEVEL_PLANE) * Header.PlaneCount, (u32) sizeof(LEVEL_NODE) * Header.NodeCount, (u32) sizeof(LEVEL_LEAF) * Header.LeafCount,
+                           (u32) sizeof(LEVEL_VERTEX) * Header.VertexCount, (u32) sizeof(u32) * Header.IndexCount, Header.VisibilityBytes, TexelCount * 4};
+    for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+    {
+        *Offsets[i] = Offset;
+        Offset = (Offset + Sizes[i] + 15) & ~15u;
+    }
+
+    bool Result = false;
+    FILE *File = fopen(Path, "wb");
+    if(File)
+    {
+        static const u8 Padding[16] = {};
+        fwrite(&Header, sizeof(Header), 1, File);
+        fwrite(Padding, 1, *Offsets[0] - sizeof(Header), File);
+        for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+        {
+            fwrite(Data[i], 1, Sizes[i], File);
+            fwrite(Padding, 1, ((Sizes[i] + 15) & ~15u) - Sizes[i], File);
+        }
+        Result = (ferror(File) == 0);
+        fclose(File);
+    }
+
+    free(Lightmap);
+    return Result;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 4)
+    {
+        printf("Usage: lightmap_baker input.lvl input.map output.lvl [--threads N] [--density TexelsPerUnit] [--bounces N] [--samples N] [--scaling]\n");
+        return 1;
+    }
+
+    u32 ThreadCount = std::thread::hardware_concurrency();
+    f32 Density     = 2.0f;
+    u32 Bounces     = 2;
+    u32 Samples     = 32;
+    bool Scaling    = false;
+    for(int i = 4; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            ThreadCount = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--density") == 0 && i + 1 < argc)
+        {
+            Density = (f32) atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--bounces") == 0 && i + 1 < argc)
+        {
+            Bounces = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            Samples = (u32) atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--scaling") == 0)
+        {
+            Scaling = true;
+        }
+    }
+    ThreadCount = (ThreadCount < 1) ? 1 : ((ThreadCount > BAKER_MAX_THREADS) ? BAKER_MAX_THREADS : ThreadCount);
+    Density     = (Density > 0) ? Density : 2.0f;
+    Samples     = Samples ? Samples : 1;
+
+    BAKER *Baker    = new BAKER();
+    Baker->Bounces  = Bounces;
+    Baker->Samples  = Samples;
+    auto Start      = std::chrono::steady_clock::now();
+
+    if(!LoadLevel(Baker, argv[1]))
+    {
+        printf("Baker: Failed to load %s\n", argv[1]);
+        return 1;
+    }
+    if(!LoadLights(Baker, argv[2]))
+    {
+        printf("Baker: Failed to load %s\n", argv[2]);
+        return 1;
+    }
+    if(!Baker->TriangleCount)
+    {
+        printf("Baker: %s has no geometry\n", argv[1]);
+        return 1;
+    }
+    if(!Baker->Lights.Count)
+    {
+        printf("Baker: WARNING - %s has no lights, the lightmap will be black\n", argv[2]);
+    }
+
+    auto Stage = std::chrono::steady_clock::now();
+    if(!BuildBVH(Baker))
+    {
+        return 1;
+    }
+    printf("BVH: %u triangles, %u nodes, %u leaves in %.3fs\n", Baker->TriangleCount, Baker->Nodes.Count, Baker->Blocks.Count, SecondsSince(Stage));
+
+    BAKE_TIMES Times = {};
+
+    // Bake time against texel density and core count
+    if(Scaling)
+    {
+        f32 Scales[] = {0.5f, 1.0f, 2.0f};
+        for(u32 i = 0; i < ArrayCount(Scales); ++i)
+        {
+            BuildAtlas(Baker, Density * Scales[i]);
+            Bake(Baker, ThreadCount, &Times);
+            PrintBake("Density", Baker, ThreadCount, &Times);
+        }
+
+        BuildAtlas(Baker, Density);
+        f64 Baseline = 0;
+        for(u32 Threads = 1; Threads <= ThreadCount; Threads *= 2)
+        {
+            Bake(Baker, Threads, &Times);
+            f64 Seconds = Times.Direct + Times.Bounces;
+            Baseline    = (Threads == 1) ? Seconds : Baseline;
+            printf("Threads: %2u threads %.3fs (%.2fx, %.2fM rays/s)\n", Threads, Seconds, Baseline / Seconds,
+                    (f64) (Times.DirectRays + Times.BounceRays) / (Seconds * 1000000.0));
+        }
+    }
+
+    Stage = std::chrono::steady_clock::now();
+    f32 Requested = Density;
+    Density = BuildAtlas(Baker, Density);
+    u64 UsedTexels = Baker->Texels.Count;
+    printf("Atlas: %u charts in %ux%u (%.1f%% used) in %.3fs\n", Baker->Charts.Count, Baker->AtlasWidth, Baker->AtlasHeight,
+            100.0 * (f64) UsedTexels / ((f64) Baker->AtlasWidth * Baker->AtlasHeight), SecondsSince(Stage));
+    if(Density < Requested)
+    {
+        printf("Atlas: WARNING - density lowered from %.2f to %.2f texels/unit to fit %ux%u\n", Requested, Density, BAKER_MAX_ATLAS, BAKER_MAX_ATLAS);
+    }
+
+    Bake(Baker, ThreadCount, &Times);
+    printf("Direct: %u lights, %.3fs (%.2fM rays/s)\n", Baker->Lights.Count, Times.Direct, (f64) Times.DirectRays / (Times.Direct * 1000000.0));
+    printf("Bounces: %u x %u samples, %.3fs (%.2fM rays/s)\n", Bounces, Samples, Times.Bounces,
+            Times.Bounces > 0 ? (f64) Times.BounceRays / (Times.Bounces * 1000000.0) : 0.0);
+    PrintBake("Bake", Baker, ThreadCount, &Times);
+
+    if(!WriteLevel(Baker, argv[3]))
+    {
+        printf("Baker: Failed to write %s\n", argv[3]);
+        return 1;
+    }
+    printf("Baker: Wrote %s (%ux%u lightmap, %u KB) in %.3fs total\n", argv[3], Baker->AtlasWidth, Baker->AtlasHeight,
+            Baker->AtlasWidth * Baker->AtlasHeight * 4 / 1024, SecondsSince(Start));
+
+    return 0;
+}
@@ -0,0 +1,358 @@
+// Pak builder
+// Loose files -> one archive the runtime memory maps (see pak.h). Entries are stored under the path they were given
+// ('\' written as '/'), so build from the directory the game runs in. With --compress each entry is split into LZ4
+// chunks and kept compressed only if that makes it smaller - stored entries are the ones the runtime can use in place.
+//
+// Usage:
+//   pak_builder output.pak input... [--compress]
+//
+// Every compressed entry is decompressed again with the runtime's decoder and compared before the archive is written.
+
+// CRT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Timing
+#include <chrono>
+
+// Core
+#include "../core/core.h"
+#include "../pak.h"
+
+#define BUILDER_MAX_INPUTS      4096
+#define LZ4_HASH_BITS           16
+#define LZ4_MIN_MATCH           4
+#define LZ4_MAX_OFFSET          65535
+#define LZ4_LAST_LITERALS       5       // The format ends every block with at least this many literals
+#define LZ4_MATCH_LIMIT         12      // and no match may start closer than this to the end
+
+typedef struct BUILDER_ENTRY
+{
+    const char *Path;
+    u8 *Data;                   // Uncompressed, or null when the file couldn't be read
+    u8 *Stored;                 // What goes in the archive - Data itself when stored
+    PAK_ENTRY Entry;
+} BUILDER_ENTRY;
+
+static u8 *LoadFile(const char *Path, u64 *Size)
+{
+    FILE *File = fopen(Path, "rb");
+    if(!File)
+    {
+        return 0;
+    }
+    fseek(File, 0, SEEK_END);
+    *Size = (u64) ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    u8 *Result = (u8 *) malloc(*Size + 1);
+    if(Result && fread(Result, 1, *Size, File) != *Size)
+    {
+        free(Result);
+        Result = 0;
+    }
+    fclose(File);
+    return Result;
+}
+
+static inline u32 Read32(const u8 *Pointer)
+{
+    u32 Result;
+    memcpy(&Result, Pointer, sizeof(Result));
+    return Result;
+}
+
+static inline u32 Lz4Hash(u32 Sequence)
+{
+    return (Sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static u8 *Lz4WriteLength(u8 *Out, u64 Length)
+{
+    for(; Length >= 255; Length -= 255)
+    {
+        *Out++ = 255;
+    }
+    *Out++ = (u8) Length;
+    return Out;
+}
+
+static u8 *Lz4WriteSequence(u8 *Out, const u8 *Literals, u64 LiteralCount, u32 Offset, u64 MatchLength)
+{
+    u8 *Token = Out++;
+    *Token = (u8) ((LiteralCount >= 15 ? 15 : LiteralCount) << 4);
+    if(LiteralCount >= 15)
+    {
+        Out = Lz4WriteLength(Out, LiteralCount - 15);
+    }
+    memcpy(Out, Literals, LiteralCount);
+    Out += LiteralCount;
+
+    // Literals only - the end of the block
+    if(MatchLength == 0)
+    {
+        return Out;
+    }
+
+    *Out++ = (u8) (Offset & 0xFF);
+    *Out++ = (u8) (Offset >> 8);
+    u64 Length = MatchLength - LZ4_MIN_MATCH;
+    *Token |= (u8) (Length >= 15 ? 15 : Length);
+    if(Length >= 15)
+    {
+        Out = Lz4WriteLength(Out, Length - 15);
+    }
+    return Out;
+}
+
+// Greedy single probe compressor - fast rather than tight, the decoder is what matters at runtime.
+// Out needs Size + Size / 255 + 16 bytes. Returns the block size
+static u64 Lz4Compress(const u8 *Source, u64 Size, u8 *Out, u32 *Table)
+{
+    for(u32 i = 0; i < (1 << LZ4_HASH_BITS); ++i)
+    {
+        Table[i] = 0xFFFFFFFF;
+    }
+
+    u8 *Start           = Out;
+    u64 Anchor          = 0;
+    u64 Position        = 0;
+    u64 MatchLimit      = (Size > LZ4_MATCH_LIMIT) ? Size - LZ4_MATCH_LIMIT : 0;
+    u64 LengthLimit     = (Size > LZ4_LAST_LITERALS) ? Size - LZ4_LAST_LITERALS : 0;
+    while(Position < MatchLimit)
+    {
+        u32 Sequence    = Read32(Source + Position);
+        u32 Hash        = Lz4Hash(Sequence);
+        u32 Candidate   = Table[Hash];
+        Table[Hash]     = (u32) Position;
+        if(Candidate == 0xFFFFFFFF || Position - Candidate > LZ4_MAX_OFFSET || Read32(Source + Candidate) != Sequence)
+        {
+            ++Position;
+            continue;
+        }
+
+        u64 Length = LZ4_MIN_MATCH;
+        while(Position + Length < LengthLimit && Source[Candidate + Length] == Source[Position + Length])
+        {
+            ++Length;
+        }
+        Out = Lz4WriteSequence(Out, Source + Anchor, Position - Anchor, (u32) (Position - Candidate), Length);
+        Position += Length;
+        Anchor = Position;
+    }
+    Out = Lz4WriteSequence(Out, Source + Anchor, Size - Anchor, 0, 0);
+    return (u64) (Out - Start);
+}
+
+// Chunk table then blocks, chunks that don't shrink are copied. Returns the stored size
+static u64 CompressEntry(const u8 *Data, u64 Size, u8 *Stored, u32 *Table)
+{
+    u32 ChunkCount  = PakChunkCount(Size);
+    u32 *Chunks     = (u32 *) Stored;
+    u8 *Out         = Stored + (u64) ChunkCount * sizeof(u32);
+    for(u32 i = 0; i < ChunkCount; ++i)
+    {
+        const u8 *Chunk = Data + (u64) i * PAK_CHUNK_SIZE;
+        u64 ChunkSize   = (i + 1 < ChunkCount) ? PAK_CHUNK_SIZE : Size - (u64) i * PAK_CHUNK_SIZE;
+        u64 Bytes       = Lz4Compress(Chunk, ChunkSize, Out, Table);
+        if(Bytes >= ChunkSize)
+        {
+            memcpy(Out, Chunk, ChunkSize);
+            Bytes = ChunkSize | PAK_CHUNK_STORED;
+        }
+        Chunks[i] = (u32) Bytes;
+        Out += Bytes & ~PAK_CHUNK_STORED;
+    }
+    return (u64) (Out - Stored);
+}
+
+static u64 AlignUp(u64 Value)
+{
+    return (Value + PAK_ALIGNMENT - 1) & ~(u64) (PAK_ALIGNMENT - 1);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: pak_builder output.pak input... [--compress]\n");
+        return 1;
+    }
+
+    const char *OutputPath = argv[1];
+    const char *Inputs[BUILDER_MAX_INPUTS];
+    u32 InputCount  = 0;
+    bool Compress   = false;
+    for(int i = 2; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--compress") == 0)
+        {
+            Compress = true;
+        }
+        else if(InputCount < BUILDER_MAX_INPUTS)
+        {
+            Inputs[InputCount++] = argv[i];
+        }
+        else
+        {
+            printf("Builder: Too many inputs (max %u)\n", BUILDER_MAX_INPUTS);
+            return 1;
+        }
+    }
+    if(InputCount == 0)
+    {
+        printf("Builder: No inputs\n");
+        return 1;
+    }
+
+    auto StartTime = std::chrono::steady_clock::now();
+
+    // Hash table at twice the entry count keeps probes short
+    u32 SlotCount = 1;
+    while(SlotCount < InputCount * 2)
+    {
+        SlotCount <<= 1;
+    }
+    BUILDER_ENTRY *Entries  = (BUILDER_ENTRY *) calloc(InputCount, sizeof(BUILDER_ENTRY));
+    u32 *Slots              = (u32 *) malloc(sizeof(u32) * SlotCount);
+    u32 *Table              = (u32 *) malloc(sizeof(u32) << LZ4_HASH_BITS);
+    char *Names             = (char *) malloc((size_t) InputCount * PAK_MAX_PATH);
+    if(!Entries || !Slots || !Table || !Names)
+    {
+        printf("Builder: Failed to allocate tables\n");
+        return 1;
+    }
+    memset(Slots, 0xFF, sizeof(u32) * SlotCount);
+
+    // Load, name and hash every input
+    u64 NameBytes   = 0;
+    u64 TotalSize   = 0;
+    u64 TotalStored = 0;
+    u32 Compressed  = 0;
+    for(u32 i = 0; i < InputCount; ++i)
+    {
+        BUILDER_ENTRY *Entry = &Entries[i];
+        Entry->Path = Inputs[i];
+
+        size_t Length = strlen(Entry->Path);
+        if(Length + 1 > PAK_MAX_PATH)
+        {
+            printf("Builder: %s is longer than %u characters\n", Entry->Path, PAK_MAX_PATH - 1);
+            return 1;
+        }
+        char *Name = Names + NameBytes;
+        for(size_t c = 0; c <= Length; ++c)
+        {
+            Name[c] = (Entry->Path[c] == '\\') ? '/' : Entry->Path[c];
+        }
+        Entry->Entry.NameOffset = (u32) NameBytes;
+        Entry->Entry.Hash       = PakHashPath(Name);
+        NameBytes += Length + 1;
+
+        u32 Mask = SlotCount - 1;
+        u32 Slot = (u32) (Entry->Entry.Hash & Mask);
+        for(; Slots[Slot] != PAK_EMPTY_SLOT; Slot = (Slot + 1) & Mask)
+        {
+            BUILDER_ENTRY *Other = &Entries[Slots[Slot]];
+            if(Other->Entry.Hash == Entry->Entry.Hash && PakPathsMatch(Names + Other->Entry.NameOffset, Name))
+            {
+                printf("Builder: %s is listed twice\n", Name);
+                return 1;
+            }
+        }
+        Slots[Slot] = i;
+
+        u64 Size = 0;
+        Entry->Data = LoadFile(Entry->Path, &Size);
+        if(!Entry->Data)
+        {
+            printf("Builder: Failed to read %s\n", Entry->Path);
+            return 1;
+        }
+        Entry->Entry.Size       = Size;
+        Entry->Entry.StoredSize = Size;
+        Entry->Stored           = Entry->Data;
+
+        // Only keep the compressed form if it's smaller - a stored entry costs nothing to load
+        if(Compress && Size > 0)
+        {
+            u8 *Stored = (u8 *) malloc(Size + Size / 255 + 16 + sizeof(u32) * PakChunkCount(Size));
+            u64 StoredSize = Stored ? CompressEntry(Entry->Data, Size, Stored, Table) : Size;
+            if(StoredSize < Size)
+            {
+                u8 *Check = (u8 *) malloc(Size);
+                if(!Check || !PakDecompressEntry(Stored, StoredSize, Check, Size) || memcmp(Check, Entry->Data, Size) != 0)
+                {
+                    printf("Builder: %s failed to round trip through the decompressor\n", Entry->Path);
+                    return 1;
+                }
+                free(Check);
+
+                Entry->Stored           = Stored;
+                Entry->Entry.StoredSize = StoredSize;
+                Entry->Entry.Flags      |= PAK_ENTRY_COMPRESSED;
+                ++Compressed;
+            }
+            else
+            {
+                free(Stored);
+            }
+        }
+        TotalSize   += Entry->Entry.Size;
+        TotalStored += Entry->Entry.StoredSize;
+    }
+
+    // Layout - header, aligned entry data (each followed by at least one zero), then the table of contents
+    u64 Offset = AlignUp(sizeof(PAK_HEADER));
+    for(u32 i = 0; i < InputCount; ++i)
+    {
+        Entries[i].Entry.Offset = Offset;
+        Offset = AlignUp(Offset + Entries[i].Entry.StoredSize + 1);
+    }
+    PAK_HEADER Header   = {};
+    Header.Magic        = PAK_MAGIC;
+    Header.Version      = PAK_VERSION;
+    Header.EntryCount   = InputCount;
+    Header.SlotCount    = SlotCount;
+    Header.EntryOffset  = Offset;
+    Header.SlotOffset   = Header.EntryOffset + sizeof(PAK_ENTRY) * (u64) InputCount;
+    Header.NameOffset   = Header.SlotOffset + sizeof(u32) * (u64) SlotCount;
+    Header.NameBytes    = NameBytes;
+    Header.FileSize     = Header.NameOffset + NameBytes;
+
+    FILE *File = fopen(OutputPath, "wb");
+    if(!File)
+    {
+        printf("Builder: Failed to create %s\n", OutputPath);
+        return 1;
+    }
+    static const u8 Padding[PAK_ALIGNMENT] = {};
+    bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    u64 Position = sizeof(Header);
+    for(u32 i = 0; Written && i < InputCount; ++i)
+    {
+        PAK_ENTRY *Entry = &Entries[i].Entry;
+        Written = fwrite(Padding, 1, Entry->Offset - Position, File) == Entry->Offset - Position &&
+                  fwrite(Entries[i].Stored, 1, Entry->StoredSize, File) == Entry->StoredSize;
+        Position = Entry->Offset + Entry->StoredSize;
+    }
+    Written = Written && fwrite(Padding, 1, Header.EntryOffset - Position, File) == Header.EntryOffset - Position;
+    for(u32 i = 0; Written && i < InputCount; ++i)
+    {
+        Written = fwrite(&Entries[i].Entry, sizeof(PAK_ENTRY), 1, File) == 1;
+    }
+    Written = Written && fwrite(Slots, sizeof(u32), SlotCount, File) == SlotCount &&
+              fwrite(Names, 1, NameBytes, File) == NameBytes;
+    Written = (fclose(File) == 0) && Written;
+    if(!Written)
+    {
+        printf("Builder: Failed to write %s\n", OutputPath);
+        return 1;
+    }
+
+    f64 Seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("Builder: %s - %u entries (%u compressed), %.2fMB -> %.2fMB stored, %.2fMB archive, %.3fs\n", OutputPath, InputCount, Compressed,
+            (f64) TotalSize / (1024.0 * 1024.0), (f64) TotalStored / (1024.0 * 1024.0), (f64) Header.FileSize / (1024.0 * 1024.0), Seconds);
+    return 0;
+}
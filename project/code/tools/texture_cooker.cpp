@@ -0,0 +1,1151 @@
+// Texture cooker
+// Images -> gamma correct mip chain -> RGBA8, shared 256 colour palette, BC1 or BC7 -> GPU-ready blob (see cooked_texture.h)
+// Every texture in one run shares the same palette, so a single palette texture serves all of them at runtime.
+//
+// Usage:
+//   texture_cooker output_dir input... [--format rgba8|palette|bc1|bc7] [--filter box|kaiser] [--no-mips] [--threads N]
+//
+// Each input is written to output_dir/<name>.dtex and compared against the runtime's uncompressed, single level path.
+
+// CRT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// SIMD
+#include <immintrin.h>
+
+// Threading, timing and sorting
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// Core
+#include "../core/core.h"
+#include "../cooked_texture.h"
+
+// 3rd Party
+#define STB_IMAGE_IMPLEMENTATION
+#include "../external/stb_image.h"
+
+#define COOKER_MAX_THREADS      64
+#define COOKER_MAX_INPUTS       1024
+#define COOKER_KAISER_TAPS      8
+#define COOKER_KAISER_ALPHA     4.0
+#define COOKER_PALETTE_BITS     5       // Per channel precision of the palette histogram and lookup cache
+#define COOKER_KMEANS_PASSES    8
+#define COOKER_BC1_ALPHA_CUTOFF 128
+
+typedef enum COOKER_FILTER
+{
+    COOKER_FILTER_BOX,
+    COOKER_FILTER_KAISER,
+} COOKER_FILTER;
+
+static const char *CookedFormatNames[COOKED_FORMAT_COUNT] =
+{
+    "rgba8",
+    "palette",
+    "bc1",
+    "bc7",
+};
+
+// Linear light RGBA, one __m128 per texel
+typedef struct IMAGE
+{
+    __m128 *Texels;
+    u32 Width;
+    u32 Height;
+} IMAGE;
+
+// RGBA8 (sRGB encoded, bottom row first) ready for encoding
+typedef struct IMAGE_LEVEL
+{
+    u8 *Texels;
+    u32 Width;
+    u32 Height;
+} IMAGE_LEVEL;
+
+typedef struct COOKER_TEXTURE
+{
+    const char *Path;
+    IMAGE_LEVEL Levels[COOKED_TEXTURE_MAX_LEVELS];
+    u32 LevelCount;
+} COOKER_TEXTURE;
+
+// Palette entries in the same sRGB space the texels are stored in
+typedef struct COOKER_PALETTE
+{
+    u8 Colours[256][4];
+    u16 *Lookup;                // Histogram key -> palette index (0xFFFF until first used)
+    u64 Hash;
+} COOKER_PALETTE;
+
+typedef struct PALETTE_BIN
+{
+    f32 Colour[4];
+    u32 Count;
+} PALETTE_BIN;
+
+// Block compression of one level, block rows pulled from a shared counter
+typedef struct COMPRESS_JOB
+{
+    IMAGE_LEVEL *Level;
+    u32 Format;
+    u8 *Output;
+    u32 BlockRows;
+    std::atomic<u32> NextRow;
+    std::atomic<u64> SquaredError;
+} COMPRESS_JOB;
+
+static f32 SrgbToLinearTable[256];
+static u8 LinearToSrgbTable[4096];
+
+f64 SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - Start).count();
+}
+
+void BuildGammaTables()
+{
+    for(u32 i = 0; i < 256; ++i)
+    {
+        f64 Value = i / 255.0;
+        SrgbToLinearTable[i] = (f32) ((Value <= 0.04045) ? (Value / 12.92) : pow((Value + 0.055) / 1.055, 2.4));
+    }
+    for(u32 i = 0; i < 4096; ++i)
+    {
+        f64 Value = i / 4095.0;
+        f64 Srgb = (Value <= 0.0031308) ? (Value * 12.92) : (1.055 * pow(Value, 1.0 / 2.4) - 0.055);
+        LinearToSrgbTable[i] = (u8) (Srgb * 255.0 + 0.5);
+    }
+}
+
+IMAGE ImageCreate(u32 Width, u32 Height)
+{
+    IMAGE Result = {};
+    Result.Width    = Width;
+    Result.Height   = Height;
+    Result.Texels   = (__m128 *) _mm_malloc(sizeof(__m128) * Width * Height, 16);
+    return Result;
+}
+
+void ImageDestroy(IMAGE *Image)
+{
+    _mm_free(Image->Texels);
+    *Image = {};
+}
+
+bool ImageLoad(IMAGE *Image, const char *Path)
+{
+    i32 Width = 0;
+    i32 Height = 0;
+    i32 Channels = 0;
+    u8 *Pixels = stbi_load(Path, &Width, &Height, &Channels, 4);
+    if(!Pixels)
+    {
+        return false;
+    }
+
+    // Colour is filtered in linear light, alpha as is
+    *Image = ImageCreate((u32) Width, (u32) Height);
+    for(u32 i = 0; i < Image->Width * Image->Height; ++i)
+    {
+        u8 *Pixel = Pixels + (i * 4);
+        Image->Texels[i] = _mm_setr_ps(SrgbToLinearTable[Pixel[0]], SrgbToLinearTable[Pixel[1]], SrgbToLinearTable[Pixel[2]], Pixel[3] / 255.0f);
+    }
+    stbi_image_free(Pixels);
+    return true;
+}
+
+// Back to sRGB RGBA8, flipped to OpenGL's bottom-up origin
+void ImageStore(IMAGE *Image, IMAGE_LEVEL *Level)
+{
+    Level->Width    = Image->Width;
+    Level->Height   = Image->Height;
+    Level->Texels   = (u8 *) malloc((size_t) Image->Width * Image->Height * 4);
+
+    __m128 Zero     = _mm_setzero_ps();
+    __m128 One      = _mm_set1_ps(1.0f);
+    __m128 Scale    = _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f);
+    for(u32 Y = 0; Y < Image->Height; ++Y)
+    {
+        __m128 *Source  = Image->Texels + ((size_t) (Image->Height - 1 - Y) * Image->Width);
+        u8 *Dest        = Level->Texels + ((size_t) Y * Image->Width * 4);
+        for(u32 X = 0; X < Image->Width; ++X)
+        {
+            __m128i Quantized = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(Source[X], Zero), One), Scale));
+            alignas(16) i32 Values[4];
+            _mm_store_si128((__m128i *) Values, Quantized);
+            Dest[X * 4 + 0] = LinearToSrgbTable[Values[0]];
+            Dest[X * 4 + 1] = LinearToSrgbTable[Values[1]];
+            Dest[X * 4 + 2] = LinearToSrgbTable[Values[2]];
+            Dest[X * 4 + 3] = (u8) Values[3];
+        }
+    }
+}
+
+// 2x2 average - odd dimensions clamp the last row/column
+void DownsampleBox(IMAGE *Source, IMAGE *Dest)
+{
+    __m128 Quarter = _mm_set1_ps(0.25f);
+    for(u32 Y = 0; Y < Dest->Height; ++Y)
+    {
+        u32 Y0 = Y * 2;
+        u32 Y1 = (Y0 + 1 < Source->Height) ? Y0 + 1 : Y0;
+        __m128 *Row0 = Source->Texels + ((size_t) Y0 * Source->Width);
+        __m128 *Row1 = Source->Texels + ((size_t) Y1 * Source->Width);
+        for(u32 X = 0; X < Dest->Width; ++X)
+        {
+            u32 X0 = X * 2;
+            u32 X1 = (X0 + 1 < Source->Width) ? X0 + 1 : X0;
+            __m128 Sum = _mm_add_ps(_mm_add_ps(Row0[X0], Row0[X1]), _mm_add_ps(Row1[X0], Row1[X1]));
+            Dest->Texels[(size_t) Y * Dest->Width + X] = _mm_mul_ps(Sum, Quarter);
+        }
+    }
+}
+
+f64 BesselI0(f64 X)
+{
+    f64 Sum = 1.0;
+    f64 Term = 1.0;
+    for(u32 k = 1; k < 32; ++k)
+    {
+        Term *= (X * 0.5 / k) * (X * 0.5 / k);
+        Sum += Term;
+    }
+    return Sum;
+}
+
+// Kaiser windowed sinc for a 2:1 reduction - taps sit at half texel offsets either side of the destination centre
+void KaiserWeights(f32 *Weights)
+{
+    const f64 Pi = 3.14159265358979323846;
+    f64 Total = 0.0;
+    f64 Weight[COOKER_KAISER_TAPS];
+    for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+    {
+        f64 Distance    = (f64) i - (COOKER_KAISER_TAPS / 2) + 0.5;     // Source texels
+        f64 X           = Distance * 0.5;                               // Destination texels
+        f64 Sinc        = sin(Pi * X) / (Pi * X);
+        f64 R           = Distance / (COOKER_KAISER_TAPS / 2);
+        f64 Window      = BesselI0(COOKER_KAISER_ALPHA * sqrt(1.0 - R * R)) / BesselI0(COOKER_KAISER_ALPHA);
+        Weight[i]       = Sinc * Window;
+        Total          += Weight[i];
+    }
+    for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+    {
+        Weights[i] = (f32) (Weight[i] / Total);
+    }
+}
+
+// Separable - horizontal into Temp (Dest width, Source height), then vertical. Negative lobes are clamped each pass
+// so ringing doesn't build up down the chain.
+void DownsampleKaiser(IMAGE *Source, IMAGE *Dest, IMAGE *Temp, f32 *Weights)
+{
+    __m128 Zero = _mm_setzero_ps();
+    __m128 One  = _mm_set1_ps(1.0f);
+    __m128 Taps[COOKER_KAISER_TAPS];
+    for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+    {
+        Taps[i] = _mm_set1_ps(Weights[i]);
+    }
+
+    for(u32 Y = 0; Y < Source->Height; ++Y)
+    {
+        __m128 *Row = Source->Texels + ((size_t) Y * Source->Width);
+        for(u32 X = 0; X < Dest->Width; ++X)
+        {
+            __m128 Sum = Zero;
+            for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+            {
+                i32 Column = (i32) (X * 2 + i) - (COOKER_KAISER_TAPS / 2) + 1;
+                Column = (Column < 0) ? 0 : ((Column >= (i32) Source->Width) ? (i32) Source->Width - 1 : Column);
+                Sum = _mm_add_ps(Sum, _mm_mul_ps(Row[Column], Taps[i]));
+            }
+            Temp->Texels[(size_t) Y * Dest->Width + X] = _mm_min_ps(_mm_max_ps(Sum, Zero), One);
+        }
+    }
+
+    for(u32 Y = 0; Y < Dest->Height; ++Y)
+    {
+        __m128 *Rows[COOKER_KAISER_TAPS];
+        for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+        {
+            i32 Row = (i32) (Y * 2 + i) - (COOKER_KAISER_TAPS / 2) + 1;
+            Row = (Row < 0) ? 0 : ((Row >= (i32) Source->Height) ? (i32) Source->Height - 1 : Row);
+            Rows[i] = Temp->Texels + ((size_t) Row * Dest->Width);
+        }
+        for(u32 X = 0; X < Dest->Width; ++X)
+        {
+            __m128 Sum = Zero;
+            for(u32 i = 0; i < COOKER_KAISER_TAPS; ++i)
+            {
+                Sum = _mm_add_ps(Sum, _mm_mul_ps(Rows[i][X], Taps[i]));
+            }
+            Dest->Texels[(size_t) Y * Dest->Width + X] = _mm_min_ps(_mm_max_ps(Sum, Zero), One);
+        }
+    }
+}
+
+// Full chain down to 1x1 (or just the top level)
+void BuildMipChain(IMAGE *Image, COOKER_TEXTURE *Texture, COOKER_FILTER Filter, bool Mips)
+{
+    f32 Weights[COOKER_KAISER_TAPS];
+    KaiserWeights(Weights);
+
+    IMAGE Current = *Image;
+    ImageStore(&Current, &Texture->Levels[Texture->LevelCount++]);
+    while(Mips && (Current.Width > 1 || Current.Height > 1) && Texture->LevelCount < COOKED_TEXTURE_MAX_LEVELS)
+    {
+        u32 Width   = (Current.Width > 1) ? Current.Width / 2 : 1;
+        u32 Height  = (Current.Height > 1) ? Current.Height / 2 : 1;
+        IMAGE Next  = ImageCreate(Width, Height);
+        if(Filter == COOKER_FILTER_KAISER)
+        {
+            IMAGE Temp = ImageCreate(Width, Current.Height);
+            DownsampleKaiser(&Current, &Next, &Temp, Weights);
+            ImageDestroy(&Temp);
+        }
+        else
+        {
+            DownsampleBox(&Current, &Next);
+        }
+
+        ImageStore(&Next, &Texture->Levels[Texture->LevelCount++]);
+        if(Current.Texels != Image->Texels)
+        {
+            ImageDestroy(&Current);
+        }
+        Current = Next;
+    }
+    if(Current.Texels != Image->Texels)
+    {
+        ImageDestroy(&Current);
+    }
+}
+
+u32 PaletteKey(const u8 *Texel)
+{
+    const u32 Shift = 8 - COOKER_PALETTE_BITS;
+    return ((u32) (Texel[0] >> Shift) << (COOKER_PALETTE_BITS * 3)) |
+           ((u32) (Texel[1] >> Shift) << (COOKER_PALETTE_BITS * 2)) |
+           ((u32) (Texel[2] >> Shift) << COOKER_PALETTE_BITS) |
+           ((u32) (Texel[3] >> Shift));
+}
+
+u32 NearestPaletteEntry(COOKER_PALETTE *Palette, const f32 *Colour)
+{
+    u32 Result = 0;
+    f32 Best = 1e30f;
+    for(u32 i = 0; i < 256; ++i)
+    {
+        f32 Error = 0.0f;
+        for(u32 c = 0; c < 4; ++c)
+        {
+            f32 Delta = Colour[c] - Palette->Colours[i][c];
+            Error += Delta * Delta;
+        }
+        if(Error < Best)
+        {
+            Best    = Error;
+            Result  = i;
+        }
+    }
+    return Result;
+}
+
+// Widest channel of a median cut box (single bins can't be split)
+void MeasureBox(PALETTE_BIN *Bins, u32 Count, u32 *Channel, f32 *Widest)
+{
+    *Channel    = 0;
+    *Widest     = 0.0f;
+    for(u32 c = 0; c < 4 && Count > 1; ++c)
+    {
+        f32 Min = 255.0f;
+        f32 Max = 0.0f;
+        for(u32 i = 0; i < Count; ++i)
+        {
+            Min = fminf(Min, Bins[i].Colour[c]);
+            Max = fmaxf(Max, Bins[i].Colour[c]);
+        }
+        if(Max - Min > *Widest)
+        {
+            *Widest     = Max - Min;
+            *Channel    = c;
+        }
+    }
+}
+
+// Median cut over a histogram of every top level, then k-means to pull entries onto the actual colour clusters
+void BuildPalette(COOKER_PALETTE *Palette, COOKER_TEXTURE *Textures, u32 TextureCount)
+{
+    const u32 KeyCount = 1 << (COOKER_PALETTE_BITS * 4);
+    const u32 Shift = 8 - COOKER_PALETTE_BITS;
+    u32 *Histogram = (u32 *) calloc(KeyCount, sizeof(u32));
+    for(u32 t = 0; t < TextureCount; ++t)
+    {
+        IMAGE_LEVEL *Level = &Textures[t].Levels[0];
+        for(u32 i = 0; i < Level->Width * Level->Height; ++i)
+        {
+            ++Histogram[PaletteKey(Level->Texels + (i * 4))];
+        }
+    }
+
+    // Occupied bins, coloured by their centre
+    u32 BinCount = 0;
+    for(u32 Key = 0; Key < KeyCount; ++Key)
+    {
+        BinCount += (Histogram[Key] != 0);
+    }
+    PALETTE_BIN *Bins = (PALETTE_BIN *) malloc(sizeof(PALETTE_BIN) * BinCount);
+    u32 Mask = (1 << COOKER_PALETTE_BITS) - 1;
+    BinCount = 0;
+    for(u32 Key = 0; Key < KeyCount; ++Key)
+    {
+        if(Histogram[Key])
+        {
+            PALETTE_BIN *Bin = &Bins[BinCount++];
+            for(u32 c = 0; c < 4; ++c)
+            {
+                u32 Value = (Key >> (COOKER_PALETTE_BITS * (3 - c))) & Mask;
+                Bin->Colour[c] = (f32) ((Value << Shift) | (1 << (Shift - 1)));
+            }
+            Bin->Count = Histogram[Key];
+        }
+    }
+    free(Histogram);
+
+    // Split the box with the widest channel range at its weighted median until there are 256
+    u32 BoxFirst[256];
+    u32 BoxCount[256];
+    u32 BoxChannel[256];
+    f32 BoxWidest[256];
+    u32 Boxes = 1;
+    BoxFirst[0] = 0;
+    BoxCount[0] = BinCount;
+    MeasureBox(Bins + BoxFirst[0], BoxCount[0], &BoxChannel[0], &BoxWidest[0]);
+    while(Boxes < 256)
+    {
+        u32 Split = 0;
+        for(u32 b = 1; b < Boxes; ++b)
+        {
+            Split = (BoxWidest[b] > BoxWidest[Split]) ? b : Split;
+        }
+        if(BoxWidest[Split] == 0.0f)
+        {
+            break;
+        }
+        u32 Channel = BoxChannel[Split];
+
+        PALETTE_BIN *First = Bins + BoxFirst[Split];
+        std::sort(First, First + BoxCount[Split], [Channel](const PALETTE_BIN &A, const PALETTE_BIN &B) { return A.Colour[Channel] < B.Colour[Channel]; });
+        u64 Total = 0;
+        for(u32 i = 0; i < BoxCount[Split]; ++i)
+        {
+            Total += First[i].Count;
+        }
+        u64 Running = 0;
+        u32 Median = 1;
+        for(u32 i = 0; i < BoxCount[Split] - 1; ++i)
+        {
+            Running += First[i].Count;
+            Median = i + 1;
+            if(Running * 2 >= Total)
+            {
+                break;
+            }
+        }
+
+        BoxFirst[Boxes] = BoxFirst[Split] + Median;
+        BoxCount[Boxes] = BoxCount[Split] - Median;
+        BoxCount[Split] = Median;
+        MeasureBox(Bins + BoxFirst[Split], BoxCount[Split], &BoxChannel[Split], &BoxWidest[Split]);
+        MeasureBox(Bins + BoxFirst[Boxes], BoxCount[Boxes], &BoxChannel[Boxes], &BoxWidest[Boxes]);
+        ++Boxes;
+    }
+
+    // Seed with the box means (unused entries are black)
+    memset(Palette->Colours, 0, sizeof(Palette->Colours));
+    f64 (*Sums)[5] = (f64 (*)[5]) calloc(256, sizeof(f64) * 5);
+    for(u32 b = 0; b < Boxes; ++b)
+    {
+        for(u32 i = BoxFirst[b]; i < BoxFirst[b] + BoxCount[b]; ++i)
+        {
+            for(u32 c = 0; c < 4; ++c)
+            {
+                Sums[b][c] += (f64) Bins[i].Colour[c] * Bins[i].Count;
+            }
+            Sums[b][4] += Bins[i].Count;
+        }
+    }
+
+    for(u32 Pass = 0; Pass <= COOKER_KMEANS_PASSES; ++Pass)
+    {
+        for(u32 e = 0; e < 256; ++e)
+        {
+            if(Sums[e][4] > 0.0)
+            {
+                for(u32 c = 0; c < 4; ++c)
+                {
+                    Palette->Colours[e][c] = (u8) fmin(255.0, Sums[e][c] / Sums[e][4] + 0.5);
+                }
+            }
+        }
+        if(Pass == COOKER_KMEANS_PASSES)
+        {
+            break;
+        }
+
+        memset(Sums, 0, sizeof(f64) * 5 * 256);
+        for(u32 i = 0; i < BinCount; ++i)
+        {
+            u32 Entry = NearestPaletteEntry(Palette, Bins[i].Colour);
+            for(u32 c = 0; c < 4; ++c)
+            {
+                Sums[Entry][c] += (f64) Bins[i].Colour[c] * Bins[i].Count;
+            }
+            Sums[Entry][4] += Bins[i].Count;
+        }
+    }
+    free(Sums);
+    free(Bins);
+
+    // FNV-1a - the runtime checks textures agree on their palette
+    Palette->Hash = 0xCBF29CE484222325ULL;
+    for(u32 i = 0; i < sizeof(Palette->Colours); ++i)
+    {
+        Palette->Hash = (Palette->Hash ^ ((u8 *) Palette->Colours)[i]) * 0x100000001B3ULL;
+    }
+
+    Palette->Lookup = (u16 *) malloc(sizeof(u16) * KeyCount);
+    memset(Palette->Lookup, 0xFF, sizeof(u16) * KeyCount);
+}
+
+// Nearest colours are cached per histogram key - textures are mostly made of a few thousand of them
+u64 EncodePalette(COOKER_PALETTE *Palette, IMAGE_LEVEL *Level, u8 *Output)
+{
+    u64 SquaredError = 0;
+    for(u32 i = 0; i < Level->Width * Level->Height; ++i)
+    {
+        u8 *Texel = Level->Texels + (i * 4);
+        u32 Key = PaletteKey(Texel);
+        if(Palette->Lookup[Key] == 0xFFFF)
+        {
+            f32 Colour[4] = {(f32) Texel[0], (f32) Texel[1], (f32) Texel[2], (f32) Texel[3]};
+            Palette->Lookup[Key] = (u16) NearestPaletteEntry(Palette, Colour);
+        }
+        Output[i] = (u8) Palette->Lookup[Key];
+
+        for(u32 c = 0; c < 4; ++c)
+        {
+            i32 Delta = (i32) Texel[c] - (i32) Palette->Colours[Output[i]][c];
+            SquaredError += (u64) (Delta * Delta);
+        }
+    }
+    return SquaredError;
+}
+
+// 4x4 block with edge texels repeated past the level bounds
+void LoadBlock(IMAGE_LEVEL *Level, u32 BlockX, u32 BlockY, u8 Block[16][4], u32 *Valid)
+{
+    *Valid = 0;
+    for(u32 Y = 0; Y < 4; ++Y)
+    {
+        for(u32 X = 0; X < 4; ++X)
+        {
+            u32 SourceX = BlockX * 4 + X;
+            u32 SourceY = BlockY * 4 + Y;
+            if(SourceX < Level->Width && SourceY < Level->Height)
+            {
+                *Valid |= 1 << (Y * 4 + X);
+            }
+            SourceX = (SourceX < Level->Width) ? SourceX : Level->Width - 1;
+            SourceY = (SourceY < Level->Height) ? SourceY : Level->Height - 1;
+            memcpy(Block[Y * 4 + X], Level->Texels + (((size_t) SourceY * Level->Width + SourceX) * 4), 4);
+        }
+    }
+}
+
+// Mean and dominant axis of the block (power iteration on the covariance)
+void PrincipalAxis(u8 Block[16][4], u32 Channels, bool *Include, f32 *Mean, f32 *Axis)
+{
+    u32 Count = 0;
+    for(u32 c = 0; c < 4; ++c)
+    {
+        Mean[c] = 0.0f;
+        Axis[c] = (c < Channels) ? 1.0f : 0.0f;
+    }
+    for(u32 i = 0; i < 16; ++i)
+    {
+        if(Include[i])
+        {
+            for(u32 c = 0; c < Channels; ++c)
+            {
+                Mean[c] += Block[i][c];
+            }
+            ++Count;
+        }
+    }
+    for(u32 c = 0; c < Channels; ++c)
+    {
+        Mean[c] /= (f32) (Count ? Count : 1);
+    }
+
+    f32 Covariance[4][4] = {};
+    for(u32 i = 0; i < 16; ++i)
+    {
+        if(Include[i])
+        {
+            for(u32 a = 0; a < Channels; ++a)
+            {
+                for(u32 b = 0; b < Channels; ++b)
+                {
+                    Covariance[a][b] += (Block[i][a] - Mean[a]) * (Block[i][b] - Mean[b]);
+                }
+            }
+        }
+    }
+
+    for(u32 Iteration = 0; Iteration < 8; ++Iteration)
+    {
+        f32 Next[4] = {};
+        f32 Length = 0.0f;
+        for(u32 a = 0; a < Channels; ++a)
+        {
+            for(u32 b = 0; b < Channels; ++b)
+            {
+                Next[a] += Covariance[a][b] * Axis[b];
+            }
+            Length = fmaxf(Length, fabsf(Next[a]));
+        }
+        if(Length < 1e-6f)
+        {
+            break;
+        }
+        for(u32 a = 0; a < Channels; ++a)
+        {
+            Axis[a] = Next[a] / Length;
+        }
+    }
+}
+
+// Endpoints at the extremes of the block projected onto its principal axis
+void RangeFit(u8 Block[16][4], u32 Channels, bool *Include, f32 *Low, f32 *High)
+{
+    f32 Mean[4];
+    f32 Axis[4];
+    PrincipalAxis(Block, Channels, Include, Mean, Axis);
+
+    f32 AxisLength = 0.0f;
+    for(u32 c = 0; c < Channels; ++c)
+    {
+        AxisLength += Axis[c] * Axis[c];
+    }
+    AxisLength = (AxisLength > 0.0f) ? AxisLength : 1.0f;
+
+    f32 Min = 1e30f;
+    f32 Max = -1e30f;
+    for(u32 i = 0; i < 16; ++i)
+    {
+        if(Include[i])
+        {
+            f32 Projection = 0.0f;
+            for(u32 c = 0; c < Channels; ++c)
+            {
+                Projection += (Block[i][c] - Mean[c]) * Axis[c];
+            }
+            Min = fminf(Min, Projection);
+            Max = fmaxf(Max, Projection);
+        }
+    }
+    if(Min > Max)
+    {
+        Min = Max = 0.0f;
+    }
+
+    for(u32 c = 0; c < 4; ++c)
+    {
+        Low[c]  = (c < Channels) ? fminf(fmaxf(Mean[c] + Axis[c] * (Min / AxisLength), 0.0f), 255.0f) : 255.0f;
+        High[c] = (c < Channels) ? fminf(fmaxf(Mean[c] + Axis[c] * (Max / AxisLength), 0.0f), 255.0f) : 255.0f;
+    }
+}
+
+u16 Pack565(const f32 *Colour)
+{
+    u32 R = (u32) (Colour[0] * (31.0f / 255.0f) + 0.5f);
+    u32 G = (u32) (Colour[1] * (63.0f / 255.0f) + 0.5f);
+    u32 B = (u32) (Colour[2] * (31.0f / 255.0f) + 0.5f);
+    return (u16) ((R << 11) | (G << 5) | B);
+}
+
+void Unpack565(u16 Packed, i32 *Colour)
+{
+    i32 R = (Packed >> 11) & 31;
+    i32 G = (Packed >> 5) & 63;
+    i32 B = Packed & 31;
+    Colour[0] = (R << 3) | (R >> 2);
+    Colour[1] = (G << 2) | (G >> 4);
+    Colour[2] = (B << 3) | (B >> 2);
+    Colour[3] = 255;
+}
+
+// Four colour mode, or three colours + transparent black when any texel is cut out
+u64 EncodeBC1(u8 Block[16][4], u32 Valid, u8 *Output)
+{
+    bool Include[16];
+    bool Transparent = false;
+    for(u32 i = 0; i < 16; ++i)
+    {
+        Include[i] = (Block[i][3] >= COOKER_BC1_ALPHA_CUTOFF);
+        Transparent |= !Include[i];
+    }
+
+    f32 Low[4];
+    f32 High[4];
+    RangeFit(Block, 3, Include, Low, High);
+    u16 Colour0 = Pack565(High);
+    u16 Colour1 = Pack565(Low);
+    if((!Transparent && Colour0 < Colour1) || (Transparent && Colour0 > Colour1))
+    {
+        u16 Swap = Colour0;
+        Colour0 = Colour1;
+        Colour1 = Swap;
+    }
+
+    i32 Palette[4][4];
+    Unpack565(Colour0, Palette[0]);
+    Unpack565(Colour1, Palette[1]);
+    for(u32 c = 0; c < 3; ++c)
+    {
+        if(Colour0 > Colour1)
+        {
+            Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+            Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+        }
+        else
+        {
+            Palette[2][c] = (Palette[0][c] + Palette[1][c]) / 2;
+            Palette[3][c] = 0;
+        }
+    }
+    Palette[2][3] = 255;
+    Palette[3][3] = (Colour0 > Colour1) ? 255 : 0;
+    u32 PaletteCount = (Colour0 > Colour1) ? 4 : 3;
+
+    u32 Indices = 0;
+    u64 SquaredError = 0;
+    for(u32 i = 0; i < 16; ++i)
+    {
+        u32 Index = 3;
+        i32 Best = 0;
+        if(Include[i])
+        {
+            Best = 1 << 30;
+            for(u32 p = 0; p < PaletteCount; ++p)
+            {
+                i32 Error = 0;
+                for(u32 c = 0; c < 3; ++c)
+                {
+                    i32 Delta = Block[i][c] - Palette[p][c];
+                    Error += Delta * Delta;
+                }
+                if(Error < Best)
+                {
+                    Best    = Error;
+                    Index   = p;
+                }
+            }
+        }
+        else
+        {
+            for(u32 c = 0; c < 3; ++c)
+            {
+                Best += Block[i][c] * Block[i][c];
+            }
+        }
+        i32 AlphaDelta = Block[i][3] - Palette[Index][3];
+        Best += AlphaDelta * AlphaDelta;
+
+        Indices |= Index << (i * 2);
+        SquaredError += (Valid & (1 << i)) ? (u64) Best : 0;
+    }
+
+    Output[0] = (u8) Colour0;
+    Output[1] = (u8) (Colour0 >> 8);
+    Output[2] = (u8) Colour1;
+    Output[3] = (u8) (Colour1 >> 8);
+    memcpy(Output + 4, &Indices, 4);
+    return SquaredError;
+}
+
+void WriteBits(u8 *Output, u32 *Bit, u32 Value, u32 Count)
+{
+    for(u32 i = 0; i < Count; ++i, ++*Bit)
+    {
+        Output[*Bit >> 3] |= (u8) (((Value >> i) & 1) << (*Bit & 7));
+    }
+}
+
+// Mode 6 only - one RGBA line with 7.7.7.7 endpoints plus a p-bit each and 4 bit indices. All four p-bit combinations
+// are tried against the same range fit.
+u64 EncodeBC7(u8 Block[16][4], u32 Valid, u8 *Output)
+{
+    static const i32 Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    bool Include[16];
+    for(u32 i = 0; i < 16; ++i)
+    {
+        Include[i] = true;
+    }
+    f32 Low[4];
+    f32 High[4];
+    RangeFit(Block, 4, Include, Low, High);
+
+    u64 BestError = ~0ULL;
+    u32 BestEndpoints[2][4] = {};
+    u32 BestPBits[2] = {};
+    u32 BestIndices[16] = {};
+    for(u32 PBits = 0; PBits < 4; ++PBits)
+    {
+        u32 P[2] = {PBits & 1, PBits >> 1};
+        u32 Endpoints[2][4];
+        i32 Expanded[2][4];
+        for(u32 e = 0; e < 2; ++e)
+        {
+            f32 *Source = e ? High : Low;
+            for(u32 c = 0; c < 4; ++c)
+            {
+                i32 Value = (i32) floorf((Source[c] - P[e]) * 0.5f + 0.5f);
+                Value = (Value < 0) ? 0 : ((Value > 127) ? 127 : Value);
+                Endpoints[e][c] = (u32) Value;
+                Expanded[e][c]  = (Value << 1) | (i32) P[e];
+            }
+        }
+
+        i32 Palette[16][4];
+        for(u32 w = 0; w < 16; ++w)
+        {
+            for(u32 c = 0; c < 4; ++c)
+            {
+                Palette[w][c] = ((64 - Weights[w]) * Expanded[0][c] + Weights[w] * Expanded[1][c] + 32) >> 6;
+            }
+        }
+
+        u64 Error = 0;
+        u32 Indices[16];
+        for(u32 i = 0; i < 16; ++i)
+        {
+            i32 Best = 1 << 30;
+            for(u32 w = 0; w < 16; ++w)
+            {
+                i32 TexelError = 0;
+                for(u32 c = 0; c < 4; ++c)
+                {
+                    i32 Delta = Block[i][c] - Palette[w][c];
+                    TexelError += Delta * Delta;
+                }
+                if(TexelError < Best)
+                {
+                    Best        = TexelError;
+                    Indices[i]  = w;
+                }
+            }
+            Error += (Valid & (1 << i)) ? (u64) Best : 0;
+        }
+
+        if(Error < BestError)
+        {
+            BestError = Error;
+            memcpy(BestEndpoints, Endpoints, sizeof(Endpoints));
+            memcpy(BestPBits, P, sizeof(P));
+            memcpy(BestIndices, Indices, sizeof(Indices));
+        }
+    }
+
+    // The anchor index is stored without its top bit - swap the endpoints so it's clear
+    if(BestIndices[0] & 8)
+    {
+        for(u32 c = 0; c < 4; ++c)
+        {
+            u32 Swap = BestEndpoints[0][c];
+            BestEndpoints[0][c] = BestEndpoints[1][c];
+            BestEndpoints[1][c] = Swap;
+        }
+        u32 Swap = BestPBits[0];
+        BestPBits[0] = BestPBits[1];
+        BestPBits[1] = Swap;
+        for(u32 i = 0; i < 16; ++i)
+        {
+            BestIndices[i] = 15 - BestIndices[i];
+        }
+    }
+
+    memset(Output, 0, 16);
+    u32 Bit = 0;
+    WriteBits(Output, &Bit, 1 << 6, 7);
+    for(u32 c = 0; c < 4; ++c)
+    {
+        WriteBits(Output, &Bit, BestEndpoints[0][c], 7);
+        WriteBits(Output, &Bit, BestEndpoints[1][c], 7);
+    }
+    WriteBits(Output, &Bit, BestPBits[0], 1);
+    WriteBits(Output, &Bit, BestPBits[1], 1);
+    for(u32 i = 0; i < 16; ++i)
+    {
+        WriteBits(Output, &Bit, BestIndices[i], i ? 4 : 3);
+    }
+    return BestError;
+}
+
+void CompressWorker(COMPRESS_JOB *Job)
+{
+    u32 BlocksX     = (Job->Level->Width + 3) / 4;
+    u32 BlockBytes  = CookedBlockBytes(Job->Format);
+    u64 SquaredError = 0;
+    for(;;)
+    {
+        u32 Row = Job->NextRow.fetch_add(1);
+        if(Row >= Job->BlockRows)
+        {
+            break;
+        }
+        for(u32 X = 0; X < BlocksX; ++X)
+        {
+            u8 Block[16][4];
+            u32 Valid = 0;
+            LoadBlock(Job->Level, X, Row, Block, &Valid);
+            u8 *Output = Job->Output + ((size_t) Row * BlocksX + X) * BlockBytes;
+            SquaredError += (Job->Format == COOKED_FORMAT_BC7) ? EncodeBC7(Block, Valid, Output) : EncodeBC1(Block, Valid, Output);
+        }
+    }
+    Job->SquaredError += SquaredError;
+}
+
+u64 EncodeBlocks(IMAGE_LEVEL *Level, u32 Format, u8 *Output, u32 ThreadCount)
+{
+    COMPRESS_JOB Job;
+    Job.Level       = Level;
+    Job.Format      = Format;
+    Job.Output      = Output;
+    Job.BlockRows   = (Level->Height + 3) / 4;
+    Job.NextRow     = 0;
+    Job.SquaredError = 0;
+
+    std::thread Threads[COOKER_MAX_THREADS];
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i] = std::thread(CompressWorker, &Job);
+    }
+    CompressWorker(&Job);
+    for(u32 i = 1; i < ThreadCount; ++i)
+    {
+        Threads[i].join();
+    }
+    return Job.SquaredError;
+}
+
+f64 PSNR(u64 SquaredError, u64 Samples)
+{
+    if(SquaredError == 0)
+    {
+        return 99.0;
+    }
+    return 10.0 * log10((255.0 * 255.0) / ((f64) SquaredError / (f64) Samples));
+}
+
+bool WriteTexture(const char *Path, COOKED_TEXTURE_HEADER *Header, u8 *Data)
+{
+    FILE *File = fopen(Path, "wb");
+    if(!File)
+    {
+        return false;
+    }
+    bool Result = fwrite(Header, sizeof(*Header), 1, File) == 1 && fwrite(Data, 1, Header->DataSize, File) == Header->DataSize;
+    fclose(File);
+    return Result;
+}
+
+// Cooks one texture and prints its line of the report. Sizes are accumulated for the totals.
+bool CookTexture(COOKER_TEXTURE *Texture, u32 Format, COOKER_PALETTE *Palette, const char *OutputDirectory, u32 ThreadCount, u64 *RawBytes, u64 *CookedBytes)
+{
+    COOKED_TEXTURE_HEADER Header = {};
+    Header.Magic        = COOKED_TEXTURE_MAGIC;
+    Header.Version      = COOKED_TEXTURE_VERSION;
+    Header.Format       = Format;
+    Header.Width        = Texture->Levels[0].Width;
+    Header.Height       = Texture->Levels[0].Height;
+    Header.LevelCount   = Texture->LevelCount;
+    for(u32 i = 0; i < Texture->LevelCount; ++i)
+    {
+        COOKED_TEXTURE_LEVEL *Level = &Header.Levels[i];
+        Level->Width    = Texture->Levels[i].Width;
+        Level->Height   = Texture->Levels[i].Height;
+        Level->Offset   = Header.DataSize;
+        Level->Size     = CookedLevelBytes(Format, Level->Width, Level->Height);
+        Header.DataSize += (Level->Size + 15) & ~15u;
+    }
+    if(Format == COOKED_FORMAT_PALETTE8)
+    {
+        Header.PaletteOffset    = Header.DataSize;
+        Header.PaletteHash      = Palette->Hash;
+        Header.DataSize        += COOKED_PALETTE_SIZE;
+    }
+
+    // Error is measured on the top level against the uncompressed texels
+    u8 *Data = (u8 *) calloc(Header.DataSize, 1);
+    u64 SquaredError = 0;
+    for(u32 i = 0; i < Texture->LevelCount; ++i)
+    {
+        IMAGE_LEVEL *Level = &Texture->Levels[i];
+        u8 *Output = Data + Header.Levels[i].Offset;
+        u64 Error = 0;
+        switch(Format)
+        {
+            case COOKED_FORMAT_PALETTE8:    Error = EncodePalette(Palette, Level, Output); break;
+            case COOKED_FORMAT_BC1:
+            case COOKED_FORMAT_BC7:         Error = EncodeBlocks(Level, Format, Output, ThreadCount); break;
+            default:                        memcpy(Output, Level->Texels, Header.Levels[i].Size); break;
+        }
+        SquaredError = (i == 0) ? Error : SquaredError;
+    }
+    if(Format == COOKED_FORMAT_PALETTE8)
+    {
+        memcpy(Data + Header.PaletteOffset, Palette->Colours, COOKED_PALETTE_SIZE);
+    }
+
+    // output_dir/<name without directories or extension>.dtex
+    const char *Name = Texture->Path;
+    for(const char *Character = Texture->Path; *Character; ++Character)
+    {
+        Name = (*Character == '/' || *Character == '\\') ? Character + 1 : Name;
+    }
+    const char *Extension = strrchr(Name, '.');
+    i32 NameLength = Extension ? (i32) (Extension - Name) : (i32) strlen(Name);
+    char Path[512];
+    snprintf(Path, sizeof(Path), "%s/%.*s.dtex", OutputDirectory, NameLength, Name);
+
+    bool Result = WriteTexture(Path, &Header, Data);
+    free(Data);
+    if(!Result)
+    {
+        printf("Cooker: Failed to write %s\n", Path);
+        return false;
+    }
+
+    // The runtime's uncompressed path keeps a single RGBA8 level
+    u64 Raw = (u64) Header.Width * Header.Height * 4;
+    u64 Cooked = Header.DataSize;
+    *RawBytes += Raw;
+    *CookedBytes += Cooked;
+    printf("Cooker: %s %ux%u %s, %u levels, %.2fMB -> %.2fMB VRAM (%.2fx)",
+            Path, Header.Width, Header.Height, CookedFormatNames[Format], Header.LevelCount,
+            (f64) Raw / (f64) Megabytes(1), (f64) Cooked / (f64) Megabytes(1), (f64) Raw / (f64) Cooked);
+    if(Format != COOKED_FORMAT_RGBA8)
+    {
+        printf(", top level PSNR %.2fdB", PSNR(SquaredError, (u64) Header.Width * Header.Height * 4));
+    }
+    printf("\n");
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: texture_cooker output_dir input... [--format rgba8|palette|bc1|bc7] [--filter box|kaiser] [--no-mips] [--threads N]\n");
+        return 1;
+    }
+
+    const char *OutputDirectory = argv[1];
+    const char *Inputs[COOKER_MAX_INPUTS];
+    u32 InputCount      = 0;
+    u32 Format          = COOKED_FORMAT_BC7;
+    COOKER_FILTER Filter = COOKER_FILTER_KAISER;
+    bool Mips           = true;
+    u32 ThreadCount     = std::thread::hardware_concurrency();
+    for(int i = 2; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            ++i;
+            Format = COOKED_FORMAT_COUNT;
+            for(u32 f = 0; f < COOKED_FORMAT_COUNT; ++f)
+            {
+                Format = (strcmp(argv[i], CookedFormatNames[f]) == 0) ? f : Format;
+            }
+            if(Format == COOKED_FORMAT_COUNT)
+            {
+                printf("Cooker: Unknown format %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            Filter = (strcmp(argv[++i], "box") == 0) ? COOKER_FILTER_BOX : COOKER_FILTER_KAISER;
+        }
+        else if(strcmp(argv[i], "--no-mips") == 0)
+        {
+            Mips = false;
+        }
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            ThreadCount = (u32) atoi(argv[++i]);
+        }
+        else if(InputCount < COOKER_MAX_INPUTS)
+        {
+            Inputs[InputCount++] = argv[i];
+        }
+    }
+    ThreadCount = (ThreadCount < 1) ? 1 : ((ThreadCount > COOKER_MAX_THREADS) ? COOKER_MAX_THREADS : ThreadCount);
+    if(!InputCount)
+    {
+        printf("Cooker: No inputs\n");
+        return 1;
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    BuildGammaTables();
+
+    // Everything is loaded up front - the palette needs every texture before any can be written
+    COOKER_TEXTURE *Textures = (COOKER_TEXTURE *) calloc(InputCount, sizeof(COOKER_TEXTURE));
+    for(u32 i = 0; i < InputCount; ++i)
+    {
+        IMAGE Image = {};
+        if(!ImageLoad(&Image, Inputs[i]))
+        {
+            printf("Cooker: Failed to load %s\n", Inputs[i]);
+            return 1;
+        }
+        Textures[i].Path = Inputs[i];
+        BuildMipChain(&Image, &Textures[i], Filter, Mips);
+        ImageDestroy(&Image);
+    }
+    printf("Mips: %u textures (%s) in %.3fs\n", InputCount, (Filter == COOKER_FILTER_BOX) ? "box" : "kaiser", SecondsSince(Start));
+
+    COOKER_PALETTE Palette = {};
+    if(Format == COOKED_FORMAT_PALETTE8)
+    {
+        auto Stage = std::chrono::steady_clock::now();
+        BuildPalette(&Palette, Textures, InputCount);
+        printf("Palette: %016llx in %.3fs\n", (unsigned long long) Palette.Hash, SecondsSince(Stage));
+    }
+
+    auto Stage = std::chrono::steady_clock::now();
+    u64 RawBytes = 0;
+    u64 CookedBytes = 0;
+    for(u32 i = 0; i < InputCount; ++i)
+    {
+        if(!CookTexture(&Textures[i], Format, &Palette, OutputDirectory, ThreadCount, &RawBytes, &CookedBytes))
+        {
+            return 1;
+        }
+    }
+    printf("Cooker: %u textures, %.2fMB -> %.2fMB VRAM (%.2fx) encoded in %.3fs, %.3fs total\n", InputCount,
+            (f64) RawBytes / (f64) Megabytes(1), (f64) CookedBytes / (f64) Megabytes(1), (f64) RawBytes / (f64) CookedBytes,
+            SecondsSince(Stage), SecondsSince(Start));
+
+    return 0;
+}
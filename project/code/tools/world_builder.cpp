@@ -0,0 +1,547 @@
+// World builder
+// Compiled (and optionally baked) level -> streamed world (see world.h). Triangles are bucketed into a grid of chunks
+// in X/Z by centroid; each chunk gets its own vertices and a small atlas of just the lightmap charts its faces sample,
+// repacked the same way tools/lightmap_baker.cpp packs them, so the runtime can load and evict any chunk without the
+// rest of the world.
+// --tile repeats the level on a grid first, for worlds larger than any one compile.
+//
+// Usage:
+//   world_builder input.lvl output.wld [--chunk SIZE] [--tile X Z]
+//
+// Chunk files are written next to the world file as <name>_<x>_<z>.chk.
+
+// CRT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Timing and sorting
+#include <chrono>
+#include <algorithm>
+
+// Core
+#include "../core/core.h"
+#include "../world.h"
+
+#define WORLD_DEFAULT_CHUNK_SIZE    32.0f
+#define WORLD_MAX_TILES             64
+#define WORLD_LIGHTMAP_PADDING      1       // Texels kept around each chart's UV bounds for bilinear filtering
+#define WORLD_MAX_ATLAS             4096
+
+// One face's rectangle of the source atlas and where it lands in the chunk's atlas. Faces are triangle fans that
+// share their first vertex and nothing else, which is also how the baker charts them
+typedef struct WORLD_CHART
+{
+    u32 FirstVertex;            // Chunk vertices, contiguous
+    u32 VertexCount;
+    i32 Source[2];
+    u32 Size[2];
+    u32 Packed[2];
+} WORLD_CHART;
+
+typedef struct WORLD_BUILDER
+{
+    u8 *File;
+    size_t FileSize;
+    LEVEL_HEADER *Header;
+    LEVEL_VERTEX *Vertices;
+    u32 *Indices;
+    u8 *Lightmap;
+
+    // Level bounds, and the offset of each tile's copy
+    f32 Min[3];
+    f32 Max[3];
+    u32 TilesX;
+    u32 TilesZ;
+
+    // World grid
+    f32 ChunkSize;
+    f32 Origin[2];
+    u32 GridWidth;
+    u32 GridDepth;
+} WORLD_BUILDER;
+
+static bool LoadLevel(WORLD_BUILDER *Builder, const char *Path)
+{
+    FILE *File = fopen(Path, "rb");
+    if(!File)
+    {
+        return false;
+    }
+    fseek(File, 0, SEEK_END);
+    Builder->FileSize = (size_t) ftell(File);
+    fseek(File, 0, SEEK_SET);
+    Builder->File = (u8 *) malloc(Builder->FileSize);
+    bool Read = Builder->File && Builder->FileSize >= sizeof(LEVEL_HEADER) && fread(Builder->File, 1, Builder->FileSize, File) == Builder->FileSize;
+    fclose(File);
+    if(!Read)
+    {
+        return false;
+    }
+
+    LEVEL_HEADER *Header = (LEVEL_HEADER *) Builder->File;
+    if(Header->Magic != LEVEL_MAGIC || Header->Version != LEVEL_VERSION)
+    {
+        printf("World: %s is not a version %u level\n", Path, LEVEL_VERSION);
+        return false;
+    }
+
+    // The tree and visibility aren't carried over - chunks are culled by bounds
+    u32 Offsets[]   = {Header->VertexOffset, Header->IndexOffset, Header->LightmapOffset};
+    u64 Sizes[]     = {(u64) sizeof(LEVEL_VERTEX) * Header->VertexCount, (u64) sizeof(u32) * Header->IndexCount,
+                       (u64) Header->LightmapWidth * Header->LightmapHeight * 4};
+    for(u32 i = 0; i < ArrayCount(Offsets); ++i)
+    {
+        if((u64) Offsets[i] + Sizes[i] > Builder->FileSize)
+        {
+            printf("World: %s is truncated\n", Path);
+            return false;
+        }
+    }
+    if(Header->IndexCount == 0)
+    {
+        printf("World: %s has no geometry\n", Path);
+        return false;
+    }
+
+    Builder->Header     = Header;
+    Builder->Vertices   = (LEVEL_VERTEX *) (Builder->File + Header->VertexOffset);
+    Builder->Indices    = (u32 *) (Builder->File + Header->IndexOffset);
+    Builder->Lightmap   = (Header->LightmapWidth && Header->LightmapHeight) ? Builder->File + Header->LightmapOffset : 0;
+    for(u32 i = 0; i < Header->IndexCount; ++i)
+    {
+        if(Builder->Indices[i] >= Header->VertexCount)
+        {
+            printf("World: %s has an index out of range\n", Path);
+            return false;
+        }
+    }
+
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        Builder->Min[Axis] = Builder->Vertices[0].Position[Axis];
+        Builder->Max[Axis] = Builder->Vertices[0].Position[Axis];
+    }
+    for(u32 i = 1; i < Header->VertexCount; ++i)
+    {
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            Builder->Min[Axis] = fminf(Builder->Min[Axis], Builder->Vertices[i].Position[Axis]);
+            Builder->Max[Axis] = fmaxf(Builder->Max[Axis], Builder->Vertices[i].Position[Axis]);
+        }
+    }
+    return true;
+}
+
+// Tiles sit side by side, with the whole world centred on the origin in X/Z so it quantizes evenly
+static void TileOffset(WORLD_BUILDER *Builder, u32 Tile, f32 *X, f32 *Z)
+{
+    f32 Width   = Builder->Max[0] - Builder->Min[0];
+    f32 Depth   = Builder->Max[2] - Builder->Min[2];
+    *X = (f32) (Tile % Builder->TilesX) * Width - (f32) Builder->TilesX * Width * 0.5f - Builder->Min[0];
+    *Z = (f32) (Tile / Builder->TilesX) * Depth - (f32) Builder->TilesZ * Depth * 0.5f - Builder->Min[2];
+}
+
+static u32 ChunkCell(WORLD_BUILDER *Builder, u32 Tile, u32 Triangle)
+{
+    f32 OffsetX = 0;
+    f32 OffsetZ = 0;
+    TileOffset(Builder, Tile, &OffsetX, &OffsetZ);
+
+    f32 X = 0;
+    f32 Z = 0;
+    for(u32 i = 0; i < 3; ++i)
+    {
+        LEVEL_VERTEX *Vertex = &Builder->Vertices[Builder->Indices[Triangle * 3 + i]];
+        X += Vertex->Position[0];
+        Z += Vertex->Position[2];
+    }
+    i32 GridX = (i32) floorf((X / 3.0f + OffsetX - Builder->Origin[0]) / Builder->ChunkSize);
+    i32 GridZ = (i32) floorf((Z / 3.0f + OffsetZ - Builder->Origin[1]) / Builder->ChunkSize);
+    GridX = (GridX < 0) ? 0 : ((GridX >= (i32) Builder->GridWidth) ? (i32) Builder->GridWidth - 1 : GridX);
+    GridZ = (GridZ < 0) ? 0 : ((GridZ >= (i32) Builder->GridDepth) ? (i32) Builder->GridDepth - 1 : GridZ);
+    return (u32) GridZ * Builder->GridWidth + (u32) GridX;
+}
+
+// Shelf packing, tallest first, widening until the shelves stop running taller than the atlas is wide. Returns false
+// if the charts don't fit in the largest atlas
+static bool PackCharts(WORLD_CHART *Charts, u32 ChartCount, u32 *Order, u32 *AtlasWidth, u32 *AtlasHeight)
+{
+    u64 Area    = 0;
+    u32 Widest  = 1;
+    for(u32 i = 0; i < ChartCount; ++i)
+    {
+        Order[i]    = i;
+        Area       += (u64) Charts[i].Size[0] * Charts[i].Size[1];
+        Widest      = (Charts[i].Size[0] > Widest) ? Charts[i].Size[0] : Widest;
+    }
+    std::sort(Order, Order + ChartCount, [Charts](u32 A, u32 B)
+    {
+        return Charts[A].Size[1] > Charts[B].Size[1];
+    });
+
+    u32 Width = 1;
+    while(Width < WORLD_MAX_ATLAS && ((u64) Width * Width < Area || Width < Widest))
+    {
+        Width *= 2;
+    }
+
+    while(Widest <= Width)
+    {
+        u32 X = 0, Y = 0, ShelfHeight = 0;
+        for(u32 i = 0; i < ChartCount; ++i)
+        {
+            WORLD_CHART *Chart = &Charts[Order[i]];
+            if(X + Chart->Size[0] > Width)
+            {
+                Y          += ShelfHeight;
+                X           = 0;
+                ShelfHeight = 0;
+            }
+            Chart->Packed[0]    = X;
+            Chart->Packed[1]    = Y;
+            X                  += Chart->Size[0];
+            ShelfHeight         = (Chart->Size[1] > ShelfHeight) ? Chart->Size[1] : ShelfHeight;
+        }
+
+        u32 Height = (Y + ShelfHeight + 3) & ~3u;
+        if(Height <= Width || (Width == WORLD_MAX_ATLAS && Height <= WORLD_MAX_ATLAS))
+        {
+            *AtlasWidth     = Width;
+            *AtlasHeight    = Height ? Height : 4;
+            return true;
+        }
+        if(Width == WORLD_MAX_ATLAS)
+        {
+            break;
+        }
+        Width *= 2;
+    }
+    return false;
+}
+
+// Same layout rules as the level tools - 16 byte aligned sections
+static bool WriteChunk(const char *Path, WORLD_CHUNK_HEADER *Header, LEVEL_VERTEX *Vertices, u32 *Indices, u8 *Lightmap, u32 *FileSize)
+{
+    u32 Offset = (sizeof(WORLD_CHUNK_HEADER) + 15) & ~15u;
+    u32 *Offsets[]      = {&Header->VertexOffset, &Header->IndexOffset, &Header->LightmapOffset};
+    const void *Data[]  = {Vertices, Indices, Lightmap};
+    u32 Sizes[]         = {(u32) sizeof(LEVEL_VERTEX) * Header->VertexCount, (u32) sizeof(u32) * Header->IndexCount,
+                           Header->LightmapWidth * Header->LightmapHeight * 4};
+    for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+    {
+        *Offsets[i] = Offset;
+        Offset = (Offset + Sizes[i] + 15) & ~15u;
+    }
+    *FileSize = Offset;
+
+    bool Result = false;
+    FILE *File = fopen(Path, "wb");
+    if(File)
+    {
+        static const u8 Padding[16] = {};
+        fwrite(Header, sizeof(WORLD_CHUNK_HEADER), 1, File);
+        fwrite(Padding, 1, *Offsets[0] - sizeof(WORLD_CHUNK_HEADER), File);
+        for(u32 i = 0; i < ArrayCount(Sizes); ++i)
+        {
+            fwrite(Data[i], 1, Sizes[i], File);
+            fwrite(Padding, 1, ((Sizes[i] + 15) & ~15u) - Sizes[i], File);
+        }
+        Result = (ferror(File) == 0);
+        fclose(File);
+    }
+    return Result;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        printf("Usage: world_builder input.lvl output.wld [--chunk SIZE] [--tile X Z]\n");
+        return 1;
+    }
+
+    WORLD_BUILDER *Builder  = (WORLD_BUILDER *) calloc(1, sizeof(WORLD_BUILDER));
+    Builder->ChunkSize      = WORLD_DEFAULT_CHUNK_SIZE;
+    Builder->TilesX         = 1;
+    Builder->TilesZ         = 1;
+    for(int i = 3; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+        {
+            Builder->ChunkSize = (f32) atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--tile") == 0 && i + 2 < argc)
+        {
+            Builder->TilesX = (u32) atoi(argv[++i]);
+            Builder->TilesZ = (u32) atoi(argv[++i]);
+        }
+    }
+    Builder->ChunkSize  = (Builder->ChunkSize > 0) ? Builder->ChunkSize : WORLD_DEFAULT_CHUNK_SIZE;
+    Builder->TilesX     = (Builder->TilesX < 1) ? 1 : ((Builder->TilesX > WORLD_MAX_TILES) ? WORLD_MAX_TILES : Builder->TilesX);
+    Builder->TilesZ     = (Builder->TilesZ < 1) ? 1 : ((Builder->TilesZ > WORLD_MAX_TILES) ? WORLD_MAX_TILES : Builder->TilesZ);
+
+    auto StartTime = std::chrono::steady_clock::now();
+    if(!LoadLevel(Builder, argv[1]))
+    {
+        printf("World: Failed to load %s\n", argv[1]);
+        return 1;
+    }
+
+    // Chunk files go next to the world file, named after it
+    const char *OutputPath  = argv[2];
+    const char *Slash       = strrchr(OutputPath, '/');
+    const char *Backslash   = strrchr(OutputPath, '\\');
+    Slash = (Backslash > Slash) ? Backslash : Slash;
+    char Directory[512] = {};
+    char Name[WORLD_MAX_NAME] = {};
+    size_t DirectoryLength = Slash ? (size_t) (Slash - OutputPath + 1) : 0;
+    const char *FileName = OutputPath + DirectoryLength;
+    size_t NameLength = strcspn(FileName, ".");
+    if(DirectoryLength >= sizeof(Directory) || NameLength + 16 >= WORLD_MAX_NAME)
+    {
+        printf("World: Output path %s is too long\n", OutputPath);
+        return 1;
+    }
+    memcpy(Directory, OutputPath, DirectoryLength);
+    memcpy(Name, FileName, NameLength);
+
+    // Grid over every tile
+    u32 TileCount       = Builder->TilesX * Builder->TilesZ;
+    f32 Width           = Builder->Max[0] - Builder->Min[0];
+    f32 Depth           = Builder->Max[2] - Builder->Min[2];
+    Builder->Origin[0]  = -(f32) Builder->TilesX * Width * 0.5f;
+    Builder->Origin[1]  = -(f32) Builder->TilesZ * Depth * 0.5f;
+    Builder->GridWidth  = (u32) ceilf((f32) Builder->TilesX * Width / Builder->ChunkSize);
+    Builder->GridDepth  = (u32) ceilf((f32) Builder->TilesZ * Depth / Builder->ChunkSize);
+    Builder->GridWidth  = Builder->GridWidth ? Builder->GridWidth : 1;
+    Builder->GridDepth  = Builder->GridDepth ? Builder->GridDepth : 1;
+    u32 CellCount       = Builder->GridWidth * Builder->GridDepth;
+
+    // Counting sort of every tile's triangles by cell - tile order is kept within a cell
+    u32 TriangleCount   = Builder->Header->IndexCount / 3;
+    u64 Total           = (u64) TileCount * TriangleCount;
+    u32 *Cells          = (u32 *) malloc(sizeof(u32) * Total);
+    u32 *Order          = (u32 *) malloc(sizeof(u32) * Total);
+    u32 *Offsets        = (u32 *) calloc(CellCount + 1, sizeof(u32));
+    u32 *Remap          = (u32 *) malloc(sizeof(u32) * Builder->Header->VertexCount);
+    u32 *Stamps         = (u32 *) calloc(Builder->Header->VertexCount, sizeof(u32));
+    LEVEL_VERTEX *ChunkVertices = (LEVEL_VERTEX *) malloc(sizeof(LEVEL_VERTEX) * (u64) Builder->Header->VertexCount * TileCount);
+    u32 *ChunkIndices   = (u32 *) malloc(sizeof(u32) * Total * 3);
+    WORLD_CHART *Charts = (WORLD_CHART *) malloc(sizeof(WORLD_CHART) * Total);
+    u32 *ChartOrder     = (u32 *) malloc(sizeof(u32) * Total);
+    u8 *ChunkLightmap   = 0;
+    WORLD_CHUNK_INFO *Chunks = (WORLD_CHUNK_INFO *) calloc(CellCount, sizeof(WORLD_CHUNK_INFO));
+    if(!Cells || !Order || !Offsets || !Remap || !Stamps || !ChunkVertices || !ChunkIndices || !Charts || !ChartOrder || !Chunks)
+    {
+        printf("World: Failed to allocate chunk tables\n");
+        return 1;
+    }
+    for(u64 i = 0; i < Total; ++i)
+    {
+        Cells[i] = ChunkCell(Builder, (u32) (i / TriangleCount), (u32) (i % TriangleCount));
+        ++Offsets[Cells[i] + 1];
+    }
+    for(u32 i = 0; i < CellCount; ++i)
+    {
+        Offsets[i + 1] += Offsets[i];
+    }
+    for(u64 i = 0; i < Total; ++i)
+    {
+        Order[Offsets[Cells[i]]++] = (u32) i;
+    }
+
+    WORLD_HEADER Header = {};
+    Header.Magic        = WORLD_MAGIC;
+    Header.Version      = WORLD_VERSION;
+    Header.ChunkSize    = Builder->ChunkSize;
+    Header.GridWidth    = Builder->GridWidth;
+    Header.GridDepth    = Builder->GridDepth;
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        Header.Min[Axis] = INFINITY;
+        Header.Max[Axis] = -INFINITY;
+    }
+
+    u64 TotalBytes  = 0;
+    u32 Stamp       = 0;
+    u32 Cursor      = 0;
+    for(u32 Cell = 0; Cell < CellCount; ++Cell)
+    {
+        // Offsets now hold each cell's end
+        u32 End = Offsets[Cell];
+        if(Cursor == End)
+        {
+            continue;
+        }
+
+        WORLD_CHUNK_HEADER Chunk    = {};
+        WORLD_CHUNK_INFO *Info      = &Chunks[Header.ChunkCount];
+        Chunk.Magic                 = WORLD_CHUNK_MAGIC;
+        Chunk.Version               = WORLD_CHUNK_VERSION;
+        Info->GridX                 = Cell % Builder->GridWidth;
+        Info->GridZ                 = Cell / Builder->GridWidth;
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            Info->Min[Axis] = INFINITY;
+            Info->Max[Axis] = -INFINITY;
+        }
+
+        // Vertices are shared within a tile's copy only
+        u32 Tile = 0xFFFFFFFF;
+        f32 OffsetX = 0;
+        f32 OffsetZ = 0;
+        u32 ChartCount = 0;
+        for(; Cursor < End; ++Cursor)
+        {
+            u32 Triangle = Order[Cursor] % TriangleCount;
+            if(Order[Cursor] / TriangleCount != Tile)
+            {
+                Tile = Order[Cursor] / TriangleCount;
+                TileOffset(Builder, Tile, &OffsetX, &OffsetZ);
+                ++Stamp;
+            }
+
+            // A new first vertex starts a new face
+            u32 First = Builder->Indices[Triangle * 3];
+            if(Stamps[First] != Stamp)
+            {
+                WORLD_CHART *Chart  = &Charts[ChartCount++];
+                *Chart              = {};
+                Chart->FirstVertex  = Chunk.VertexCount;
+            }
+
+            for(u32 i = 0; i < 3; ++i)
+            {
+                u32 Index = Builder->Indices[Triangle * 3 + i];
+                if(Stamps[Index] != Stamp)
+                {
+                    Stamps[Index]           = Stamp;
+                    Remap[Index]            = Chunk.VertexCount;
+                    LEVEL_VERTEX *Vertex    = &ChunkVertices[Chunk.VertexCount++];
+                    *Vertex                 = Builder->Vertices[Index];
+                    Vertex->Position[0]     += OffsetX;
+                    Vertex->Position[2]     += OffsetZ;
+                    for(u32 Axis = 0; Axis < 3; ++Axis)
+                    {
+                        Info->Min[Axis] = fminf(Info->Min[Axis], Vertex->Position[Axis]);
+                        Info->Max[Axis] = fmaxf(Info->Max[Axis], Vertex->Position[Axis]);
+                    }
+                    ++Charts[ChartCount - 1].VertexCount;
+                }
+                ChunkIndices[Chunk.IndexCount++] = Remap[Index];
+            }
+        }
+
+        // Each face's texels (plus a border) are copied into the chunk's atlas and its UVs moved with them
+        if(Builder->Lightmap)
+        {
+            u32 AtlasSize[2] = {Builder->Header->LightmapWidth, Builder->Header->LightmapHeight};
+            for(u32 c = 0; c < ChartCount; ++c)
+            {
+                WORLD_CHART *Chart  = &Charts[c];
+                f32 Min[2]          = {1.0f, 1.0f};
+                f32 Max[2]          = {0.0f, 0.0f};
+                for(u32 i = 0; i < Chart->VertexCount; ++i)
+                {
+                    for(u32 Axis = 0; Axis < 2; ++Axis)
+                    {
+                        Min[Axis] = fminf(Min[Axis], ChunkVertices[Chart->FirstVertex + i].LightmapUV[Axis]);
+                        Max[Axis] = fmaxf(Max[Axis], ChunkVertices[Chart->FirstVertex + i].LightmapUV[Axis]);
+                    }
+                }
+                for(u32 Axis = 0; Axis < 2; ++Axis)
+                {
+                    i32 First   = (i32) floorf(Min[Axis] * (f32) AtlasSize[Axis]) - WORLD_LIGHTMAP_PADDING;
+                    i32 Last    = (i32) ceilf(Max[Axis] * (f32) AtlasSize[Axis]) + WORLD_LIGHTMAP_PADDING;
+                    First       = (First < 0) ? 0 : First;
+                    Last        = (Last > (i32) AtlasSize[Axis]) ? (i32) AtlasSize[Axis] : Last;
+                    Last        = (Last <= First) ? First + 1 : Last;
+                    Chart->Source[Axis] = First;
+                    Chart->Size[Axis]   = (u32) (Last - First);
+                }
+            }
+
+            if(!PackCharts(Charts, ChartCount, ChartOrder, &Chunk.LightmapWidth, &Chunk.LightmapHeight))
+            {
+                printf("World: Chunk %u, %u lightmap charts don't fit in a %ux%u atlas\n", Info->GridX, Info->GridZ, WORLD_MAX_ATLAS, WORLD_MAX_ATLAS);
+                return 1;
+            }
+            free(ChunkLightmap);
+            ChunkLightmap = (u8 *) calloc((size_t) Chunk.LightmapWidth * Chunk.LightmapHeight, 4);
+            if(!ChunkLightmap)
+            {
+                printf("World: Failed to allocate a %ux%u lightmap\n", Chunk.LightmapWidth, Chunk.LightmapHeight);
+                return 1;
+            }
+
+            for(u32 c = 0; c < ChartCount; ++c)
+            {
+                WORLD_CHART *Chart = &Charts[c];
+                for(u32 Row = 0; Row < Chart->Size[1]; ++Row)
+                {
+                    memcpy(ChunkLightmap + ((size_t) (Chart->Packed[1] + Row) * Chunk.LightmapWidth + Chart->Packed[0]) * 4,
+                           Builder->Lightmap + ((size_t) (Chart->Source[1] + Row) * AtlasSize[0] + Chart->Source[0]) * 4, (size_t) Chart->Size[0] * 4);
+                }
+
+                u32 ChunkSize[2] = {Chunk.LightmapWidth, Chunk.LightmapHeight};
+                for(u32 i = 0; i < Chart->VertexCount; ++i)
+                {
+                    f32 *UV = ChunkVertices[Chart->FirstVertex + i].LightmapUV;
+                    for(u32 Axis = 0; Axis < 2; ++Axis)
+                    {
+                        UV[Axis] = (UV[Axis] * (f32) AtlasSize[Axis] - (f32) Chart->Source[Axis] + (f32) Chart->Packed[Axis]) / (f32) ChunkSize[Axis];
+                    }
+                }
+            }
+        }
+
+        snprintf(Info->Name, sizeof(Info->Name), "%s_%u_%u.chk", Name, Info->GridX, Info->GridZ);
+        char ChunkPath[sizeof(Directory) + WORLD_MAX_NAME];
+        snprintf(ChunkPath, sizeof(ChunkPath), "%s%s", Directory, Info->Name);
+        if(!WriteChunk(ChunkPath, &Chunk, ChunkVertices, ChunkIndices, ChunkLightmap, &Info->FileSize))
+        {
+            printf("World: Failed to write %s\n", ChunkPath);
+            return 1;
+        }
+        Info->VertexCount       = Chunk.VertexCount;
+        Info->IndexCount        = Chunk.IndexCount;
+        Info->LightmapWidth     = Chunk.LightmapWidth;
+        Info->LightmapHeight    = Chunk.LightmapHeight;
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            Header.Min[Axis] = fminf(Header.Min[Axis], Info->Min[Axis]);
+            Header.Max[Axis] = fmaxf(Header.Max[Axis], Info->Max[Axis]);
+        }
+        Header.LargestChunk = (Info->FileSize > Header.LargestChunk) ? Info->FileSize : Header.LargestChunk;
+        TotalBytes += Info->FileSize;
+        ++Header.ChunkCount;
+    }
+
+    Header.ChunkOffset = (sizeof(WORLD_HEADER) + 15) & ~15u;
+    bool Written = false;
+    FILE *File = fopen(OutputPath, "wb");
+    if(File)
+    {
+        static const u8 Padding[16] = {};
+        fwrite(&Header, sizeof(Header), 1, File);
+        fwrite(Padding, 1, Header.ChunkOffset - sizeof(Header), File);
+        fwrite(Chunks, sizeof(WORLD_CHUNK_INFO), Header.ChunkCount, File);
+        Written = (ferror(File) == 0);
+        fclose(File);
+    }
+    if(!Written)
+    {
+        printf("World: Failed to write %s\n", OutputPath);
+        return 1;
+    }
+
+    f64 Seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("World: %s -> %s in %.3fs\n", argv[1], OutputPath, Seconds);
+    printf("World: %ux%u tiles, %u chunks on a %ux%u grid of %.1f units, %.1fx%.1f units\n", Builder->TilesX, Builder->TilesZ, Header.ChunkCount,
+            Builder->GridWidth, Builder->GridDepth, Builder->ChunkSize, Header.Max[0] - Header.Min[0], Header.Max[2] - Header.Min[2]);
+    printf("World: %llu triangles, %.2fMB of chunks (largest %.1fKB)\n", (unsigned long long) Total, (f64) TotalBytes / (1024.0 * 1024.0),
+            (f64) Header.LargestChunk / 1024.0);
+    return 0;
+}
@@ -7,24 +7,45 @@
 
 #include "core/core.h"
 
+// Win32
+#include <immintrin.h>
+
+// Older SDKs don't define the high resolution timer flag
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 // OpenGL
 #include <glew.h>
 #include <GL/gl.h>
 
-// 3rd Party
+// 3rd Party (heap hooks are in memory.cpp)
+void *MemoryHeapAlloc(size_t Size);
+void *MemoryHeapReAlloc(void *Pointer, size_t Size);
+void MemoryHeapFree(void *Pointer);
 #define STB_IMAGE_IMPLEMENTATION
-#define STBI_MALLOC(Size)               win32_Alloc(Size)
-#define STBI_REALLOC(Pointer, Size)     win32_ReAlloc(Pointer, Size)
-#define STBI_FREE(Pointer)              win32_Free(Pointer)
+#define STBI_MALLOC(Size)               MemoryHeapAlloc(Size)
+#define STBI_REALLOC(Pointer, Size)     MemoryHeapReAlloc(Pointer, Size)
+#define STBI_FREE(Pointer)              MemoryHeapFree(Pointer)
 #include "external/stb_image.h"
 
 // Source
+#include "profiler.cpp"
+#include "memory.cpp"
+#include "pak.cpp"
+#include "jobs.cpp"
+#include "maths.cpp"
 #include "renderer.cpp"
+#include "tga.cpp"
+#include "textures.cpp"
+#include "particles.cpp"
+#include "scheduler.cpp"
+#include "simulation.cpp"
+#include "replay.cpp"
 
 //Globals
 static bool                     GlobalRunning = false;
 static i64                      GlobalPerformanceCounterFrequency = 0;
-static GLuint                   GlobalTextureHandle = 0;
 static bool                     GlobalWireframe = false;
 
 // Structs
@@ -48,6 +69,58 @@ f32 win32_SecondsElapsed(LARGE_INTEGER Start, LARGE_INTEGER End)
     return Result;
 }
 
+// Process CPU time across all threads
+f64 win32_CpuSeconds()
+{
+    FILETIME Creation, Exit, Kernel, User;
+    GetProcessTimes(GetCurrentProcess(), &Creation, &Exit, &Kernel, &User);
+    u64 KernelTime  = ((u64) Kernel.dwHighDateTime << 32) | Kernel.dwLowDateTime;
+    u64 UserTime    = ((u64) User.dwHighDateTime << 32) | User.dwLowDateTime;
+    return (f64) (KernelTime + UserTime) / 10000000.0;
+}
+
+// Sleeps until just before the deadline, then spins the rest - returns seconds spent spinning
+// Timer is a high resolution waitable timer when available (Windows 10 1803+), otherwise Sleep at the 1ms timer period
+f64 win32_WaitForDeadline(FRAME_SCHEDULER *Scheduler, HANDLE Timer, LARGE_INTEGER Deadline)
+{
+    PROFILE_SCOPE("win32_WaitForDeadline");
+
+    LARGE_INTEGER Now = win32_WallClock();
+    if(Now.QuadPart >= Deadline.QuadPart)
+    {
+        return 0;
+    }
+
+    f64 SleepSeconds = FrameSchedulerSleepSeconds(Scheduler, win32_SecondsElapsed(Now, Deadline));
+    if(SleepSeconds > 0)
+    {
+        if(Timer)
+        {
+            // Relative due time in 100ns units
+            LARGE_INTEGER DueTime = {};
+            DueTime.QuadPart = -(i64) (SleepSeconds * 10000000.0);
+            SetWaitableTimer(Timer, &DueTime, 0, NULL, NULL, FALSE);
+            WaitForSingleObject(Timer, INFINITE);
+        }
+        else if(SleepSeconds >= 0.001)
+        {
+            Sleep((DWORD) (SleepSeconds * 1000.0));
+        }
+
+        LARGE_INTEGER Woken = win32_WallClock();
+        FrameSchedulerRecordSleep(Scheduler, SleepSeconds, win32_SecondsElapsed(Now, Woken));
+        Now = Woken;
+    }
+
+    LARGE_INTEGER SpinStart = Now;
+    while(Now.QuadPart < Deadline.QuadPart)
+    {
+        _mm_pause();
+        Now = win32_WallClock();
+    }
+    return win32_SecondsElapsed(SpinStart, Now);
+}
+
 LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
 {
     LRESULT Result = 0;
@@ -74,7 +147,8 @@ LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LPa
     return Result;
 }
 
-void win32_ProcessMessages()
+// Key changes go into the frame's input rather than straight to the game, so they can be recorded and replayed
+void win32_ProcessMessages(INPUT_FRAME *Input)
 {
     MSG Queue;
 
@@ -92,7 +166,8 @@ void win32_ProcessMessages()
                 GlobalRunning = false;
                 break;
             }     
-            // Virtual Keycode parsing
+            // Virtual Keycode parsing - letters and digits are their upper case character already
+            case WM_KEYDOWN:
             case WM_KEYUP:
             {
                 // Check key state
@@ -100,20 +175,10 @@ void win32_ProcessMessages()
                 bool WasDown            = ((Queue.lParam & (1 << 30)) != 0);
                 bool IsDown             = ((Queue.lParam & (1UL << 31)) == 0);
 
-                // Switch
+                // Switch - auto-repeat isn't a change
                 if(WasDown != IsDown)
                 {
-                    if(VKCode == 'W')
-                    {
-                        if(GlobalWireframe)
-                        {
-                            GlobalWireframe = false;
-                        }
-                        else
-                        {
-                            GlobalWireframe = true;
-                        }
-                    }                
+                    InputPush(Input, IsDown ? INPUT_KEY_DOWN : INPUT_KEY_UP, VKCode);
                 }
 
                 break;
@@ -179,79 +244,80 @@ void win32_InitOpenGL(HWND Window)
     }
 }
 
-typedef struct TEXTURE
+void win32_DisplayBuffer(HDC DeviceContext, i16 Width, i16 Height, RENDERER *RenderInfo, MESH *Mesh)
 {
-    i32 Width;
-    i32 Height;
-    i32 BitsPerPixel;
-    u8 *Data;
-} TEXTURE;
+    // Set polygonial mode - only reaches GL when it toggles
+    GLStateSetPolygonMode(GlobalWireframe ? GL_LINE : GL_FILL);
 
-void LoadTextureFromFile(const char *Path)
-{
-    TEXTURE Result = {};
-    stbi_set_flip_vertically_on_load(1);
-    Result.Data = stbi_load("texture1.tga", &Result.Width, &Result.Height, &Result.BitsPerPixel, 4);
-   
-    glGenTextures(1, &GlobalTextureHandle);
-    glBindTexture(GL_TEXTURE_2D, GlobalTextureHandle);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Result.Width, Result.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, Result.Data);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    if(Result.Data)
-    {
-        stbi_image_free(Result.Data);
-    }
-}
+    // Queue the quad, then sort and draw everything pushed this frame at the internal resolution
+    u64 SortKey = RenderSortKey(RENDER_PASS_OPAQUE, RenderInfo->ShaderProgram, 0, RenderInfo->VertexArrayObject, 0.0f);
+    RenderQueuePushMesh(&RenderInfo->Queue, SortKey, RenderInfo->ShaderProgram, 0, 0, &RenderInfo->MeshPool, Mesh);
+    RendererBeginFrame(RenderInfo);
+    RenderQueueSubmit(&RenderInfo->Queue);
+
+    // Upscale to whatever size the window is now
+    RendererEndFrame(RenderInfo, 0, Width, Height);
 
+    // Push rendered backbuffer
+    SwapBuffers(DeviceContext);
+}
 
-void win32_DisplayBuffer(HDC DeviceContext, i16 Width, i16 Height, RENDERER *RenderInfo)
+int main(int argc, char **argv)
 {
-    // Set polygonial mode
-    if(GlobalWireframe)
+    // Playtests record, build machines replay - the log carries the frame intervals and input, so a replay goes uncapped
+    const char *RecordPath = 0;
+    const char *ReplayPath = 0;
+    const char *TimingsPath = 0;
+    for(i32 i = 1; i < argc; ++i)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        if(strcmp(argv[i], "--record") == 0 && (i + 1) < argc)
+        {
+            RecordPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--replay") == 0 && (i + 1) < argc)
+        {
+            ReplayPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--timings") == 0 && (i + 1) < argc)
+        {
+            TimingsPath = argv[++i];
+        }
+        else
+        {
+            printf("usage: %s [--record PATH | --replay PATH] [--timings PATH]\n", argv[0]);
+            return 1;
+        }
     }
-    else
+    if(ReplayPath && RecordPath)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        printf("win32: --record and --replay can't be used together\n");
+        return 1;
     }
 
-    // Create OpenGL viewport
-    glViewport(0, 0, Width, Height);
-
-    // Render
-    // Set background colour
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);    
+    ProfilerInit();
+    ProfilerSetThreadName("Main");
 
-    // Vertex Shader
-    glUseProgram(RenderInfo->ShaderProgram);
-    glBindVertexArray(RenderInfo->VertexArrayObject);
-    // glDrawArrays(GL_TRIANGLES, 0, 3); // Drawing primitive, starting index of vertex array, how many vertices to draw
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    // Permanent, frame and scratch tiers - reservations only commit what gets used
+    MemoryInit(Megabytes(1024), Megabytes(64));
 
-    // Push rendered backbuffer
-    SwapBuffers(DeviceContext);
-}
-
-int main()
-{
-    // Create allocator
-    VIRTUAL_ALLOCATOR VirtualAlloctor = {};
-    VirtualAlloctor.Create(Megabytes(10));
-    
-    // Allocate memory arenas from virtual pages
+    // Subsystem arenas - each reserves far more than it needs, pages are only committed once they're used
     MEMORY_ARENA EngineArena = {};
-    void *EngineBlock = VirtualAlloctor.Alloc(Megabytes(10));
-    EngineArena.Init(EngineBlock, Megabytes(10));    
-    Assert(EngineBlock, "win32: Failed to create memory arena!");
+    MEMORY_ARENA TextureArena = {};
+    MEMORY_ARENA JobArena = {};
+    bool Allocated = MemoryReserveArena(&EngineArena, "Engine", Megabytes(1024)) &&
+                     MemoryReserveArena(&TextureArena, "Texture", Megabytes(1024)) &&
+                     MemoryReserveArena(&JobArena, "Jobs", Megabytes(256));
+    Assert(Allocated, "win32: Failed to create memory arenas!");
+
+    // Assets come from the archive when one has been built - loose files under data/ still override it
+    if(GetFileAttributesA("data.pak") != INVALID_FILE_ATTRIBUTES && AssetsMount("data.pak", true))
+    {
+        printf("win32: Mounted data.pak\t[%u entries]\n", GlobalAssets.Pak.Header->EntryCount);
+    }
+
+    // Every hardware thread, this one is worker 0
+    JOB_SYSTEM Jobs = {};
+    JobSystemCreate(&Jobs, &JobArena, 0, Kilobytes(256));
 
     //Create window and it's rendering handle
     WNDCLASSEX WindowClass = {sizeof(WNDCLASSEX), 
@@ -270,6 +336,7 @@ int main()
     {
         // Initialise OpenGL
         win32_InitOpenGL(WindowHandle);
+        ProfilerInitGpu();
 
         //Display window
         ShowWindow(WindowHandle, SW_SHOWDEFAULT);
@@ -284,90 +351,142 @@ int main()
             MonitorRefresh = DEFAULT_HZ;
         }
 
-        // Assets
-        // Load textures
-
-        // Create and link OpenGL renderer (compile shaders)
-        V2U RenderDimensions = {{DEFAULT_WIDTH, DEFAULT_HEIGHT}};
-        RENDERER RenderInfo = InitialiseRenderer(&EngineArena, RenderDimensions);
-        // ConstructTriangle(&RenderInfo);
-        ConstructQuad(&RenderInfo);
-
-        // Update rate
-        f32 TargetSecondsPerFrame = 1.0f / (f32) (MonitorRefresh);        
-
         //Start timings
         LARGE_INTEGER PerformanceCounterFrequencyResult;
         QueryPerformanceFrequency(&PerformanceCounterFrequencyResult);
         GlobalPerformanceCounterFrequency = PerformanceCounterFrequencyResult.QuadPart;
 
-        //Request 1ms period for timing functions
+        // Create and link OpenGL renderer (compile shaders, or load cached program binaries)
+        CreateDirectoryA("data/shaders/cache", NULL);
+        LARGE_INTEGER RendererCounter = win32_WallClock();
+        V2U RenderDimensions = {{DEFAULT_WIDTH, DEFAULT_HEIGHT}};
+        RENDERER RenderInfo = InitialiseRenderer(&EngineArena, RenderDimensions, "data/shaders/cache");
+        printf("win32: Renderer initialised in %fms\t[%u programs: %u cached, %u compiled, %u rejected]\n",
+                win32_SecondsElapsed(RendererCounter, win32_WallClock()) * 1000.0f, SHADER_PERMUTATION_COUNT + 1,
+                RenderInfo.ShaderCache.Hits, RenderInfo.ShaderCache.Misses, RenderInfo.ShaderCache.Rejected);
+        // ConstructTriangle(&RenderInfo);
+        MESH Quad = ConstructQuad(&RenderInfo);
+
+        // Assets
+        // Stream textures (12 staging slots - a 1024x1024 RGBA8 image or cooked mip chain each, 2MB uploaded per frame)
+        TEXTURE_STREAMER_SETTINGS StreamerSettings = {};
+        StreamerSettings.StagingSlotCount   = 12;
+        StreamerSettings.StagingSlotSize    = Megabytes(6);
+        StreamerSettings.UploadBudget       = Megabytes(2);
+        TEXTURE_STREAMER TextureStreamer = {};
+        TextureStreamerCreate(&TextureStreamer, &TextureArena, &Jobs, StreamerSettings);
+        TextureStreamerRequest(&TextureStreamer, "texture1.tga");
+
+        // Frame intervals and input come from the log when replaying
+        REPLAY Replay = {};
+        bool ReplayReady = (!ReplayPath || ReplayOpen(&Replay, ReplayPath)) && (!RecordPath || ReplayRecord(&Replay, RecordPath, 60, MonitorRefresh)) &&
+                           (!TimingsPath || ReplayWriteTimings(&Replay, TimingsPath));
+        bool Replaying = (Replay.Mode == REPLAY_PLAY);
+
+        // Fixed 60Hz simulation, rendering paced from the monitor refresh rate down - or at the recording's rates
+        FRAME_SCHEDULER Scheduler = {};
+        FrameSchedulerCreate(&Scheduler, Replaying ? Replay.Header.TickHz : 60, Replaying ? Replay.Header.RenderHz : MonitorRefresh);
+
+        // Trade internal resolution for the full refresh rate before the scheduler has to drop it - not when replaying,
+        // where every run has to render the same pixels to be comparable
+        RendererSetDynamicResolution(&RenderInfo, !Replaying);
+
+        // The camera orbits the quad - drawn from between the last two ticks so it moves smoothly at any refresh rate
+        SIMULATION_STATE Previous = {};
+        SIMULATION_STATE Current = {};
+        SimulationCreate(&Current, V3{});
+        Previous = Current;
+
+        //Request 1ms period for timing functions, and a high resolution timer to wait on
         UINT SchedulerPeriodInMS = 1;
         bool IsSleepGranular = (timeBeginPeriod(SchedulerPeriodInMS) == TIMERR_NOERROR);
+        HANDLE WaitTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
 
         //Start timings
-        LARGE_INTEGER LastCounter = win32_WallClock();
-        LARGE_INTEGER FlipWallClock = win32_WallClock();
-        u64 LastCycleCount = __rdtsc();
+        LARGE_INTEGER StartCounter = win32_WallClock();
+        f64 StartCpuSeconds = win32_CpuSeconds();
+        LARGE_INTEGER LastCounter = StartCounter;
+        LARGE_INTEGER Deadline = StartCounter;
 
         //Loop
-        GlobalRunning = true;
+        GlobalRunning = ReplayReady;
         while(GlobalRunning)
         {
+            LARGE_INTEGER FrameCounter = win32_WallClock();
+            INPUT_FRAME Input = {};
+            InputSetInterval(&Input, (u64) ((f64) (FrameCounter.QuadPart - LastCounter.QuadPart) * 1000000000.0 / (f64) GlobalPerformanceCounterFrequency));
+            LastCounter = FrameCounter;
+
             //Updates
-            //Process incoming mouse/keyboard messages, check for QUIT command
-            win32_ProcessMessages();
-            if(!GlobalRunning) break;
+            //Process incoming mouse/keyboard messages, check for QUIT command - a replay swaps in the recorded frame, but
+            //closing the window still ends it
+            win32_ProcessMessages(&Input);
+            if(!GlobalRunning || !ReplayBeginFrame(&Replay, &Input)) break;
+            if(InputKeyReleased(&Input, 'W'))
+            {
+                GlobalWireframe = !GlobalWireframe;
+            }
+            u32 Ticks = FrameSchedulerAdvance(&Scheduler, InputSeconds(&Input));
+
+            // Simulate
+            for(u32 i = 0; i < Ticks; ++i)
+            {
+                Previous = Current;
+                SimulationStep(&Current, (f32) Scheduler.TickSeconds);
+            }
+            SIMULATION_STATE Interpolated = SimulationInterpolate(&Previous, &Current, FrameSchedulerAlpha(&Scheduler));
+
+            // Upload any decoded textures within this frame's budget
+            MemoryFrameBegin();
+            TextureStreamerUpdate(&TextureStreamer);
 
             // Render
             // Get current window size and push the back buffer
+            RendererSetCamera(&RenderInfo, Interpolated.CameraPosition, Interpolated.Centre, 1.0f, 0.1f, 100.0f);
             WIN32_WINDOW_DIMENSIONS CurrentDimensions = win32_GetWindowDimensions(WindowHandle);
             HDC RenderContext = GetDC(WindowHandle);
-            win32_DisplayBuffer(RenderContext, CurrentDimensions.Width, CurrentDimensions.Height, &RenderInfo);
+            win32_DisplayBuffer(RenderContext, CurrentDimensions.Width, CurrentDimensions.Height, &RenderInfo, &Quad);
             ReleaseDC(WindowHandle, RenderContext);
+            RendererUpdateResolution(&RenderInfo, Scheduler.BaseSeconds);
+            MemoryFrameEnd();
+            f64 WorkSeconds = win32_SecondsElapsed(FrameCounter, win32_WallClock());
 
-            //End performance timings
-            FlipWallClock = win32_WallClock();
-            u64 EndCycleCount = __rdtsc();
-            LastCycleCount = EndCycleCount;
-
-            //Check rendering work elapsed and sleep if time remaining
-            LARGE_INTEGER WorkCounter = win32_WallClock();
-            f32 WorkSecondsElapsed = win32_SecondsElapsed(LastCounter, WorkCounter);
-            f32 SecondsElapsedForFrame = WorkSecondsElapsed;
-
-            //If the rendering finished under the target seconds, then sleep until the next update
-            if(SecondsElapsedForFrame < TargetSecondsPerFrame)
-            {                        
-                if(IsSleepGranular)
+            // Wait against an absolute deadline so error doesn't accumulate - restart it after a long stall
+            f64 SpinSeconds = 0;
+            if(!Replaying)
+            {
+                i64 TargetCounts = (i64) (Scheduler.TargetSeconds * (f64) GlobalPerformanceCounterFrequency);
+                Deadline.QuadPart += TargetCounts;
+                if(win32_WallClock().QuadPart > Deadline.QuadPart + TargetCounts)
                 {
-                    DWORD SleepTimeInMS = (DWORD)(1000.0f * (TargetSecondsPerFrame - SecondsElapsedForFrame));
-
-                    if(SleepTimeInMS > 0)
-                    {
-                        Sleep(SleepTimeInMS);
-                    }
-                }
-
-                while(SecondsElapsedForFrame < TargetSecondsPerFrame)
-                {                            
-                    SecondsElapsedForFrame = win32_SecondsElapsed(LastCounter, win32_WallClock());
+                    Deadline = win32_WallClock();
                 }
+                SpinSeconds = win32_WaitForDeadline(&Scheduler, WaitTimer, Deadline);
             }
+            FrameSchedulerEndFrame(&Scheduler, WorkSeconds, SpinSeconds);
+            ReplayEndFrame(&Replay, &Input, SimulationChecksum(&Current), Ticks, WorkSeconds, win32_SecondsElapsed(FrameCounter, win32_WallClock()) - WorkSeconds);
+            JobSystemUpdate(&Jobs);
+            ProfilerFrameEnd();
+        }
+        ReplayClose(&Replay);
 
-            else
-            {
-                f32 Difference = (SecondsElapsedForFrame - TargetSecondsPerFrame);
-                printf("win32: Missed frame rate!\tDifference: %File\t[Current: %File, Target: %File]\n", Difference, SecondsElapsedForFrame, TargetSecondsPerFrame);
-            } 
-
-            //Prepare timers before next loop
-            LARGE_INTEGER EndCounter = win32_WallClock();
-            LastCounter = EndCounter;         
+        FrameSchedulerPrintStats(&Scheduler, win32_SecondsElapsed(StartCounter, win32_WallClock()), win32_CpuSeconds() - StartCpuSeconds);
+        ProfilerPrintSummary(16);
+        ProfilerDestroy();
+        if(WaitTimer)
+        {
+            CloseHandle(WaitTimer);
+        }
+        if(IsSleepGranular)
+        {
+            timeEndPeriod(SchedulerPeriodInMS);
         }
 
         // Unload textures
-        // win32_Free(TextureFile.imageData);
+        TextureStreamerDestroy(&TextureStreamer);
+        AssetsPrintStats();
+        AssetsUnmount();
+        MemoryPrintSummary();
 
         DestroyWindow(WindowHandle);
         UnregisterClass(WindowClass.lpszClassName, WindowClass.hInstance);        
@@ -379,4 +498,6 @@ int main()
         printf("win32: Failed to create window!\n");
     }
 
+    JobSystemDestroy(&Jobs);
+    MemoryDestroy();
 }
\ No newline at end of file
@@ -0,0 +1,620 @@
+// Streaming world
+// Chunks of a world built by tools/world_builder.cpp are made resident around the camera under fixed budgets. Each
+// frame the residency manager ranks chunks by distance (chunks in view first), starts load jobs into a fixed set of CPU
+// load slots, uploads finished loads within a per-frame byte budget and evicts the least recently wanted chunks to stay
+// under the GPU budget. Reading, validating and packing a chunk all happen in background jobs, so the main thread never
+// waits on I/O - a chunk in view that isn't resident yet just isn't drawn that frame, and counts as a miss.
+#include <mutex>
+#include "world.h"
+
+#define WORLD_MAX_LOAD_SLOTS        64
+#define WORLD_MAX_PATH              256
+#define WORLD_OFFSCREEN_WEIGHT      4.0f        // Chunks out of view load as if they were this much further away
+
+typedef enum WORLD_CHUNK_STATE
+{
+    WORLD_CHUNK_UNLOADED,
+    WORLD_CHUNK_LOADING,        // Job reading into a load slot
+    WORLD_CHUNK_LOADED,         // Packed in its load slot, waiting for upload budget
+    WORLD_CHUNK_RESIDENT,
+    WORLD_CHUNK_FAILED,         // Never retried
+} WORLD_CHUNK_STATE;
+
+typedef struct WORLD_CHUNK
+{
+    WORLD_CHUNK_INFO *Info;
+    u32 State;                  // Main thread only - load jobs hand theirs back through WORLD::Completed
+    u64 GpuBytes;               // Known up front from the chunk table
+
+    // Load slot - vertices are always packed into it, indices and lightmap are used in place from the archive mapping
+    // when the chunk is stored uncompressed there
+    u32 Slot;
+    u8 *Staging;
+    VERTEX_PACKED *Vertices;
+    const u32 *Indices;
+    const u8 *Texels;
+    u64 RequestTicks;
+
+    MESH Mesh;
+    GLuint Lightmap;
+
+    // Ranking, refreshed every frame
+    f32 Distance;
+    bool InView;
+    u64 LastWanted;             // Frame
+} WORLD_CHUNK;
+
+typedef struct WORLD_COMPLETED_LOAD
+{
+    u32 Index;
+    u32 State;                  // WORLD_CHUNK_LOADED or WORLD_CHUNK_FAILED
+} WORLD_COMPLETED_LOAD;
+
+typedef struct WORLD_SETTINGS
+{
+    size_t CpuBudget;           // Load slots, each the size of the largest chunk file
+    u64 GpuBudget;              // Resident vertex, index and lightmap bytes
+    size_t UploadBudget;        // Per frame - one chunk always goes, however large
+    f32 StreamDistance;         // Chunks closer than this are wanted, and drawn once resident
+} WORLD_SETTINGS;
+
+typedef struct WORLD_STATS
+{
+    // This frame
+    u32 VisibleChunks;          // In view and within the stream distance
+    u32 DrawnChunks;
+    u32 Misses;
+    u32 TrianglesDrawn;
+
+    // Since load
+    u32 ResidentChunks;
+    u64 ResidentBytes;
+    u64 PeakResidentBytes;
+    u64 TotalMisses;
+    u64 TotalVisible;
+    u64 Loads;
+    u64 Evictions;
+    u64 Failures;
+    u64 BytesLoaded;            // Chunk files
+    f64 LatencyMicroseconds;    // Request to resident, summed over Loads
+    f64 MaxLatencyMicroseconds;
+} WORLD_STATS;
+
+typedef struct WORLD
+{
+    WORLD_HEADER *Header;
+    WORLD_CHUNK_INFO *Infos;
+    WORLD_CHUNK *Chunks;
+    char Directory[WORLD_MAX_PATH];
+    WORLD_SETTINGS Settings;
+    MESH_POOL *MeshPool;
+
+    // Load jobs, and the ring they hand finished chunks back through
+    JOB_SYSTEM *Jobs;
+    JOB_COUNTER Loading;
+    std::mutex Lock;
+    WORLD_COMPLETED_LOAD Completed[WORLD_MAX_LOAD_SLOTS];
+    u32 CompletedRead;
+    u32 CompletedWrite;
+
+    // CPU budget
+    u8 *SlotMemory;
+    size_t SlotSize;
+    u32 SlotCount;
+    u32 FreeSlots[WORLD_MAX_LOAD_SLOTS];
+    u32 FreeSlotCount;
+
+    // GPU bytes promised to chunks loading or waiting to upload
+    u64 ReservedBytes;
+
+    u64 Frame;
+    WORLD_STATS Stats;
+} WORLD;
+
+typedef struct WORLD_LOAD_JOB
+{
+    WORLD *World;
+    u32 Index;
+} WORLD_LOAD_JOB;
+
+// Chunk files are validated in full here - the main thread only uploads what a job says is good
+bool WorldReadChunk(WORLD *World, WORLD_CHUNK *Chunk)
+{
+    char Path[WORLD_MAX_PATH + WORLD_MAX_NAME];
+    FormatString(sizeof(Path), Path, "%s%s", World->Directory, Chunk->Info->Name);
+
+    ASSET File = {};
+    if(!AssetOpen(&File, Path))
+    {
+        printf("World: Failed to open %s\n", Path);
+        return false;
+    }
+    size_t Size = File.Size;
+    const u8 *Data = File.Mapped;
+    bool Read = Size >= sizeof(WORLD_CHUNK_HEADER) && Size <= World->SlotSize;
+    if(Read && !Data)
+    {
+        Read = AssetRead(&File, Chunk->Staging);
+        Data = Chunk->Staging;
+    }
+    AssetClose(&File);
+    if(!Read)
+    {
+        printf("World: Failed to read %s (%zu bytes, %zu byte load slots)\n", Path, Size, World->SlotSize);
+        return false;
+    }
+
+    // Counts have to match the table - budgets were worked out from it
+    WORLD_CHUNK_HEADER *Header  = (WORLD_CHUNK_HEADER *) Data;
+    WORLD_CHUNK_INFO *Info      = Chunk->Info;
+    bool Valid = Header->Magic == WORLD_CHUNK_MAGIC && Header->Version == WORLD_CHUNK_VERSION && Header->VertexCount == Info->VertexCount &&
+                 Header->IndexCount == Info->IndexCount && Header->LightmapWidth == Info->LightmapWidth && Header->LightmapHeight == Info->LightmapHeight &&
+                 (Header->VertexOffset & 15) == 0 && (Header->IndexOffset & 3) == 0 &&
+                 (u64) Header->VertexOffset + (u64) sizeof(LEVEL_VERTEX) * Header->VertexCount <= Size &&
+                 (u64) Header->IndexOffset + (u64) sizeof(u32) * Header->IndexCount <= Size &&
+                 (u64) Header->LightmapOffset + (u64) Header->LightmapWidth * Header->LightmapHeight * 4 <= Size;
+    const u32 *Indices = (const u32 *) (Data + Header->IndexOffset);
+    for(u32 i = 0; Valid && i < Header->IndexCount; ++i)
+    {
+        Valid = Indices[i] < Header->VertexCount;
+    }
+    if(!Valid)
+    {
+        printf("World: %s is not a version %u chunk, or doesn't match the world\n", Path, WORLD_CHUNK_VERSION);
+        return false;
+    }
+
+    // Packed at the same offset in the slot - in place when the file was read into it, which is safe because each
+    // packed vertex is half the size of the source vertex and only ever overwrites source vertices already read
+    const LEVEL_VERTEX *Source  = (const LEVEL_VERTEX *) (Data + Header->VertexOffset);
+    VERTEX_PACKED *Packed       = (VERTEX_PACKED *) (Chunk->Staging + Header->VertexOffset);
+    for(u32 i = 0; i < Header->VertexCount; ++i)
+    {
+        LEVEL_VERTEX Vertex = Source[i];
+        V3 Position = {{Vertex.Position[0], Vertex.Position[1], Vertex.Position[2]}};
+        V3 Normal   = {{Vertex.Normal[0], Vertex.Normal[1], Vertex.Normal[2]}};
+        V2 UV       = {{Vertex.UV[0], Vertex.UV[1]}};
+        V2 Lightmap = {{Vertex.LightmapUV[0], Vertex.LightmapUV[1]}};
+        Packed[i] = PackVertex(World->MeshPool, Position, Normal, UV, Lightmap);
+    }
+
+    Chunk->Vertices = Packed;
+    Chunk->Indices  = Indices;
+    Chunk->Texels   = Data + Header->LightmapOffset;
+    return true;
+}
+
+// Job - the load slot was assigned when the job was started
+void WorldLoadChunk(void *Data)
+{
+    PROFILE_SCOPE("WorldLoadChunk");
+    WORLD *World        = ((WORLD_LOAD_JOB *) Data)->World;
+    u32 Index           = ((WORLD_LOAD_JOB *) Data)->Index;
+    WORLD_CHUNK *Chunk  = &World->Chunks[Index];
+
+    WORLD_COMPLETED_LOAD Completed = {Index, WorldReadChunk(World, Chunk) ? (u32) WORLD_CHUNK_LOADED : (u32) WORLD_CHUNK_FAILED};
+
+    // Hand back to the main thread, which applies the state when it picks the load up
+    std::lock_guard<std::mutex> Guard(World->Lock);
+    World->Completed[World->CompletedWrite++ % WORLD_MAX_LOAD_SLOTS] = Completed;
+}
+
+// The chunk table stays resident - in place from the archive mapping when it's stored uncompressed there
+bool WorldLoad(WORLD *World, MEMORY_ARENA *Arena, RENDERER *RenderInfo, JOB_SYSTEM *Jobs, const char *Path, WORLD_SETTINGS Settings)
+{
+    ASSET File = {};
+    if(!AssetOpen(&File, Path))
+    {
+        printf("World: Failed to open %s\n", Path);
+        return false;
+    }
+    size_t Size = File.Size;
+    u8 *Data = (u8 *) File.Mapped;
+    bool Read = Size >= sizeof(WORLD_HEADER);
+    if(Read && !Data)
+    {
+        Data = (u8 *) Arena->Alloc(Size, 16);
+        Read = Data && AssetRead(&File, Data);
+    }
+    AssetClose(&File);
+    if(!Read)
+    {
+        printf("World: Failed to read %s\n", Path);
+        return false;
+    }
+
+    WORLD_HEADER *Header = (WORLD_HEADER *) Data;
+    if(Header->Magic != WORLD_MAGIC || Header->Version != WORLD_VERSION)
+    {
+        printf("World: %s is not a version %u world\n", Path, WORLD_VERSION);
+        return false;
+    }
+    if((u64) Header->ChunkOffset + (u64) sizeof(WORLD_CHUNK_INFO) * Header->ChunkCount > Size || Header->LargestChunk < sizeof(WORLD_CHUNK_HEADER))
+    {
+        printf("World: %s is truncated\n", Path);
+        return false;
+    }
+
+    // Chunks are packed into the shared pool, which only quantizes positions within +-PositionScale
+    f32 Limit = RenderInfo->MeshPool.PositionScale;
+    for(u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        if(Header->Min[Axis] < -Limit || Header->Max[Axis] > Limit)
+        {
+            printf("World: %s extends beyond the mesh pool's +-%.0f units\n", Path, Limit);
+            return false;
+        }
+    }
+
+    World->Header       = Header;
+    World->Infos        = (WORLD_CHUNK_INFO *) (Data + Header->ChunkOffset);
+    World->Settings     = Settings;
+    World->MeshPool     = &RenderInfo->MeshPool;
+    World->Jobs         = Jobs;
+
+    // Chunk names are relative to the world file
+    const char *Slash = strrchr(Path, '/');
+    size_t DirectoryLength = Slash ? (size_t) (Slash - Path + 1) : 0;
+    if(DirectoryLength >= sizeof(World->Directory))
+    {
+        printf("World: %s is too long a path\n", Path);
+        return false;
+    }
+    memcpy(World->Directory, Path, DirectoryLength);
+    World->Directory[DirectoryLength] = 0;
+
+    World->Chunks = (WORLD_CHUNK *) Arena->Alloc(sizeof(WORLD_CHUNK) * (Header->ChunkCount + 1), alignof(WORLD_CHUNK));
+    Assert(World->Chunks, "World: Failed to allocate chunks!");
+    for(u32 i = 0; i < Header->ChunkCount; ++i)
+    {
+        WORLD_CHUNK_INFO *Info  = &World->Infos[i];
+        WORLD_CHUNK *Chunk      = &World->Chunks[i];
+        *Chunk                  = {};
+        Chunk->Info             = Info;
+        Chunk->GpuBytes         = (u64) sizeof(VERTEX_PACKED) * Info->VertexCount + (u64) sizeof(u32) * Info->IndexCount +
+                                  (u64) Info->LightmapWidth * Info->LightmapHeight * 4;
+        if(!memchr(Info->Name, 0, WORLD_MAX_NAME) || Info->FileSize > Header->LargestChunk)
+        {
+            printf("World: %s has a bad entry for chunk %u\n", Path, i);
+            return false;
+        }
+    }
+
+    // As many slots as the CPU budget holds, but always at least one
+    World->SlotSize     = ((size_t) Header->LargestChunk + 63) & ~(size_t) 63;
+    World->SlotCount    = (u32) (Settings.CpuBudget / World->SlotSize);
+    World->SlotCount    = (World->SlotCount < 1) ? 1 : ((World->SlotCount > WORLD_MAX_LOAD_SLOTS) ? WORLD_MAX_LOAD_SLOTS : World->SlotCount);
+    World->SlotMemory   = (u8 *) Arena->Alloc(World->SlotSize * World->SlotCount, 64);
+    Assert(World->SlotMemory, "World: Failed to allocate load slots!");
+    for(u32 i = 0; i < World->SlotCount; ++i)
+    {
+        World->FreeSlots[World->FreeSlotCount++] = i;
+    }
+    return true;
+}
+
+void WorldEvictChunk(WORLD *World, WORLD_CHUNK *Chunk)
+{
+    MeshPoolFree(World->MeshPool, &Chunk->Mesh);
+    if(Chunk->Lightmap)
+    {
+        GLStateDeleteTexture(Chunk->Lightmap);
+        Chunk->Lightmap = 0;
+    }
+    Chunk->State = WORLD_CHUNK_UNLOADED;
+    World->Stats.ResidentBytes -= Chunk->GpuBytes;
+    --World->Stats.ResidentChunks;
+}
+
+// Evicts the least recently wanted resident chunk. False if every resident chunk is wanted this frame
+bool WorldEvictOne(WORLD *World)
+{
+    WORLD_CHUNK *Victim = 0;
+    for(u32 i = 0; i < World->Header->ChunkCount; ++i)
+    {
+        WORLD_CHUNK *Chunk = &World->Chunks[i];
+        if(Chunk->State == WORLD_CHUNK_RESIDENT && Chunk->LastWanted < World->Frame && (!Victim || Chunk->LastWanted < Victim->LastWanted))
+        {
+            Victim = Chunk;
+        }
+    }
+    if(!Victim)
+    {
+        return false;
+    }
+
+    WorldEvictChunk(World, Victim);
+    ++World->Stats.Evictions;
+    return true;
+}
+
+void WorldUnload(WORLD *World)
+{
+    if(World->Header)
+    {
+        // Loads in flight write into load slots - let them finish
+        JobWait(World->Jobs, &World->Loading);
+        for(u32 i = 0; i < World->Header->ChunkCount; ++i)
+        {
+            if(World->Chunks[i].State == WORLD_CHUNK_RESIDENT)
+            {
+                WorldEvictChunk(World, &World->Chunks[i]);
+            }
+        }
+    }
+    World->Header = 0;
+}
+
+// False if the mesh pool is full of chunks that are still wanted - the chunk waits in its slot until next frame
+bool WorldUploadChunk(WORLD *World, WORLD_CHUNK *Chunk)
+{
+    WORLD_CHUNK_INFO *Info = Chunk->Info;
+    while(!MeshPoolAlloc(World->MeshPool, Info->VertexCount, Info->IndexCount, &Chunk->Mesh))
+    {
+        // The pool is shared with everything else, so a budget that fits can still be fragmented
+        if(!WorldEvictOne(World))
+        {
+            return false;
+        }
+    }
+    MeshPoolUpload(World->MeshPool, &Chunk->Mesh, Chunk->Vertices, (u32 *) Chunk->Indices);
+    GLStateCount(GL_CALL_UPLOAD, 2);
+
+    // Filtered, and clamped so chart borders don't wrap across the atlas
+    if(Info->LightmapWidth && Info->LightmapHeight)
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &Chunk->Lightmap);
+        glTextureStorage2D(Chunk->Lightmap, 1, GL_RGBA8, Info->LightmapWidth, Info->LightmapHeight);
+        glTextureParameteri(Chunk->Lightmap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(Chunk->Lightmap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(Chunk->Lightmap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(Chunk->Lightmap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTextureSubImage2D(Chunk->Lightmap, 0, 0, 0, Info->LightmapWidth, Info->LightmapHeight, GL_RGBA, GL_UNSIGNED_BYTE, Chunk->Texels);
+        GLStateCount(GL_CALL_UPLOAD);
+    }
+    return true;
+}
+
+// Finished loads in completion order, until the frame's upload budget is spent
+void WorldUploadCompleted(WORLD *World)
+{
+    size_t Used = 0;
+    while(true)
+    {
+        // Peek the oldest finished load
+        WORLD_COMPLETED_LOAD Completed = {};
+        {
+            std::lock_guard<std::mutex> Guard(World->Lock);
+            if(World->CompletedRead == World->CompletedWrite)
+            {
+                break;
+            }
+            Completed = World->Completed[World->CompletedRead % WORLD_MAX_LOAD_SLOTS];
+        }
+
+        WORLD_CHUNK *Chunk = &World->Chunks[Completed.Index];
+        Chunk->State = Completed.State;
+        if(Chunk->State == WORLD_CHUNK_LOADED)
+        {
+            if(Used > 0 && Used + Chunk->GpuBytes > World->Settings.UploadBudget)
+            {
+                break;
+            }
+            if(!WorldUploadChunk(World, Chunk))
+            {
+                break;
+            }
+
+            f64 Latency = ProfilerTicksToMicroseconds(__rdtsc() - Chunk->RequestTicks);
+            WORLD_STATS *Stats          = &World->Stats;
+            Chunk->State                = WORLD_CHUNK_RESIDENT;
+            Used                       += Chunk->GpuBytes;
+            Stats->ResidentBytes       += Chunk->GpuBytes;
+            Stats->PeakResidentBytes    = (Stats->ResidentBytes > Stats->PeakResidentBytes) ? Stats->ResidentBytes : Stats->PeakResidentBytes;
+            Stats->BytesLoaded         += Chunk->Info->FileSize;
+            Stats->LatencyMicroseconds += Latency;
+            Stats->MaxLatencyMicroseconds = (Latency > Stats->MaxLatencyMicroseconds) ? Latency : Stats->MaxLatencyMicroseconds;
+            ++Stats->ResidentChunks;
+            ++Stats->Loads;
+        }
+        else
+        {
+            ++World->Stats.Failures;
+        }
+
+        // Release the load slot and the reservation, and pop
+        World->FreeSlots[World->FreeSlotCount++] = Chunk->Slot;
+        World->ReservedBytes -= Chunk->GpuBytes;
+        Chunk->Staging  = 0;
+        Chunk->Vertices = 0;
+        Chunk->Indices  = 0;
+        Chunk->Texels   = 0;
+        {
+            std::lock_guard<std::mutex> Guard(World->Lock);
+            ++World->CompletedRead;
+        }
+    }
+}
+
+// Starts a load if the GPU budget has room for it once resident, evicting chunks nobody wants to make some.
+// False if it doesn't fit
+bool WorldRequestChunk(WORLD *World, u32 Index)
+{
+    WORLD_CHUNK *Chunk = &World->Chunks[Index];
+    if(Chunk->GpuBytes > World->Settings.GpuBudget)
+    {
+        printf("World: %s needs %.2fMB, more than the whole GPU budget\n", Chunk->Info->Name, (f64) Chunk->GpuBytes / (f64) Megabytes(1));
+        Chunk->State = WORLD_CHUNK_FAILED;
+        ++World->Stats.Failures;
+        return true;
+    }
+    while(World->Stats.ResidentBytes + World->ReservedBytes + Chunk->GpuBytes > World->Settings.GpuBudget)
+    {
+        if(!WorldEvictOne(World))
+        {
+            return false;
+        }
+    }
+
+    Chunk->Slot         = World->FreeSlots[--World->FreeSlotCount];
+    Chunk->Staging      = World->SlotMemory + (Chunk->Slot * World->SlotSize);
+    Chunk->State        = WORLD_CHUNK_LOADING;
+    Chunk->RequestTicks = __rdtsc();
+    World->ReservedBytes += Chunk->GpuBytes;
+
+    WORLD_LOAD_JOB *Job = (WORLD_LOAD_JOB *) JobAlloc(World->Jobs, sizeof(WORLD_LOAD_JOB));
+    Job->World  = World;
+    Job->Index  = Index;
+    JobRunBackground(World->Jobs, WorldLoadChunk, Job, &World->Loading);
+    return true;
+}
+
+// Clip space planes straight from the view projection (Gribb/Hartmann) - a box is out if it's wholly behind any one.
+// Column major, so row R of the matrix is Matrix[R], Matrix[4 + R], Matrix[8 + R], Matrix[12 + R]
+bool WorldBoxInView(const f32 *Matrix, const f32 *Min, const f32 *Max)
+{
+    for(u32 Row = 0; Row < 3; ++Row)
+    {
+        for(f32 Sign = -1.0f; Sign <= 1.0f; Sign += 2.0f)
+        {
+            f32 Plane[4];
+            for(u32 Column = 0; Column < 4; ++Column)
+            {
+                Plane[Column] = Matrix[Column * 4 + 3] + Sign * Matrix[Column * 4 + Row];
+            }
+
+            // Corner furthest along the plane normal
+            f32 X = (Plane[0] >= 0.0f) ? Max[0] : Min[0];
+            f32 Y = (Plane[1] >= 0.0f) ? Max[1] : Min[1];
+            f32 Z = (Plane[2] >= 0.0f) ? Max[2] : Min[2];
+            if(Plane[0] * X + Plane[1] * Y + Plane[2] * Z + Plane[3] < 0.0f)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Call once per frame from the thread that owns the OpenGL context, after the camera is set. Ranks every chunk,
+// uploads finished loads, draws what's resident and in view, then starts loads for the closest missing chunks
+void WorldUpdate(WORLD *World, RENDERER *RenderInfo, V3 Camera)
+{
+    PROFILE_SCOPE("WorldUpdate");
+    ++World->Frame;
+
+    WORLD_STATS *Stats      = &World->Stats;
+    Stats->VisibleChunks    = 0;
+    Stats->DrawnChunks      = 0;
+    Stats->Misses           = 0;
+    Stats->TrianglesDrawn   = 0;
+
+    // Rank - wanted chunks are marked first so nothing wanted this frame gets evicted below
+    u32 Candidates[WORLD_MAX_LOAD_SLOTS];
+    f32 Keys[WORLD_MAX_LOAD_SLOTS];
+    u32 CandidateCount = 0;
+    f32 Camera3[3] = {Camera.X, Camera.Y, Camera.Z};
+    for(u32 i = 0; i < World->Header->ChunkCount; ++i)
+    {
+        WORLD_CHUNK *Chunk = &World->Chunks[i];
+        WORLD_CHUNK_INFO *Info = Chunk->Info;
+        f32 DistanceSquared = 0.0f;
+        for(u32 Axis = 0; Axis < 3; ++Axis)
+        {
+            f32 Outside = (Camera3[Axis] < Info->Min[Axis]) ? Info->Min[Axis] - Camera3[Axis] : ((Camera3[Axis] > Info->Max[Axis]) ? Camera3[Axis] - Info->Max[Axis] : 0.0f);
+            DistanceSquared += Outside * Outside;
+        }
+        Chunk->Distance = sqrtf(DistanceSquared);
+        Chunk->InView   = false;
+        if(Chunk->Distance > World->Settings.StreamDistance)
+        {
+            continue;
+        }
+        Chunk->LastWanted   = World->Frame;
+        Chunk->InView       = WorldBoxInView(RenderInfo->ViewProjection, Info->Min, Info->Max);
+
+        // Keep the best few missing chunks, sorted by key
+        if(Chunk->State != WORLD_CHUNK_UNLOADED)
+        {
+            continue;
+        }
+        f32 Key = Chunk->InView ? Chunk->Distance : Chunk->Distance * WORLD_OFFSCREEN_WEIGHT + World->Settings.StreamDistance;
+        u32 Slot = CandidateCount;
+        while(Slot > 0 && Keys[Slot - 1] > Key)
+        {
+            if(Slot < World->SlotCount)
+            {
+                Candidates[Slot]    = Candidates[Slot - 1];
+                Keys[Slot]          = Keys[Slot - 1];
+            }
+            --Slot;
+        }
+        if(Slot < World->SlotCount)
+        {
+            Candidates[Slot]    = i;
+            Keys[Slot]          = Key;
+            CandidateCount      += (CandidateCount < World->SlotCount);
+        }
+    }
+
+    // Upload before drawing so chunks that just finished show up this frame
+    {
+        PROFILE_SCOPE("WorldUpload");
+        WorldUploadCompleted(World);
+    }
+
+    // Draw - front to back within the stream distance
+    GLuint DefaultProgram   = RenderInfo->ShaderProgram;
+    GLuint LightmapProgram  = RenderInfo->ShaderPrograms[SHADER_LIGHTMAP];
+    for(u32 i = 0; i < World->Header->ChunkCount; ++i)
+    {
+        WORLD_CHUNK *Chunk = &World->Chunks[i];
+        if(!Chunk->InView)
+        {
+            continue;
+        }
+        ++Stats->VisibleChunks;
+        if(Chunk->State != WORLD_CHUNK_RESIDENT)
+        {
+            ++Stats->Misses;
+            continue;
+        }
+
+        GLuint Program  = Chunk->Lightmap ? LightmapProgram : DefaultProgram;
+        f32 Depth       = Chunk->Distance / World->Settings.StreamDistance;
+        u64 SortKey     = RenderSortKey(RENDER_PASS_OPAQUE, Program, Chunk->Lightmap, World->MeshPool->VertexArray, Depth);
+        RenderQueuePushMesh(&RenderInfo->Queue, SortKey, Program, 0, Chunk->Lightmap, World->MeshPool, &Chunk->Mesh);
+        ++Stats->DrawnChunks;
+        Stats->TrianglesDrawn += Chunk->Mesh.IndexCount / 3;
+    }
+    Stats->TotalVisible += Stats->VisibleChunks;
+    Stats->TotalMisses  += Stats->Misses;
+
+    // Load the closest missing chunks into whatever slots are free - stop at the first that the budget can't take
+    for(u32 i = 0; i < CandidateCount && World->FreeSlotCount > 0; ++i)
+    {
+        if(!WorldRequestChunk(World, Candidates[i]))
+        {
+            break;
+        }
+    }
+
+    static const char *Series[] = {"resident", "loading", "visible", "missed"};
+    u32 Values[] = {Stats->ResidentChunks, World->SlotCount - World->FreeSlotCount, Stats->VisibleChunks, Stats->Misses};
+    ProfilerWriteCounters("World chunks", Series, Values, ArrayCount(Values));
+    ProfilerWriteCounter("World resident MB", (f64) Stats->ResidentBytes / (f64) Megabytes(1));
+}
+
+void WorldPrintStats(WORLD *World)
+{
+    WORLD_STATS *Stats = &World->Stats;
+    f64 Misses = Stats->TotalVisible ? 100.0 * (f64) Stats->TotalMisses / (f64) Stats->TotalVisible : 0.0;
+    f64 Latency = Stats->Loads ? Stats->LatencyMicroseconds / (f64) Stats->Loads : 0.0;
+    printf("world: %u/%u chunks resident, %.2fMB (peak %.2fMB of %.2fMB GPU budget), %u x %.2fMB load slots\n", Stats->ResidentChunks, World->Header->ChunkCount,
+            (f64) Stats->ResidentBytes / (f64) Megabytes(1), (f64) Stats->PeakResidentBytes / (f64) Megabytes(1), (f64) World->Settings.GpuBudget / (f64) Megabytes(1),
+            World->SlotCount, (f64) World->SlotSize / (f64) Megabytes(1));
+    printf("world: %llu loads (%.2fMB read), %llu evictions, %llu failed, %llu misses (%.1f%% of visible chunks)\tload latency avg %.3fms max %.3fms\n",
+            (unsigned long long) Stats->Loads, (f64) Stats->BytesLoaded / (f64) Megabytes(1), (unsigned long long) Stats->Evictions,
+            (unsigned long long) Stats->Failures, (unsigned long long) Stats->TotalMisses, Misses, Latency / 1000.0, Stats->MaxLatencyMicroseconds / 1000.0);
+}
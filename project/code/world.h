@@ -0,0 +1,56 @@
+// Streamed world file format
+// Written offline by tools/world_builder.cpp and streamed at runtime by world.cpp. A world file is a table of chunks on
+// a grid in X/Z; each chunk is a separate file next to it holding that cell's geometry and its own piece of the lightmap,
+// so chunks load independently and a world never has to fit in memory at once. All offsets are bytes from the start of
+// their file.
+#pragma once
+#include "level.h"
+
+#define WORLD_MAGIC             0x444C5257 // 'WRLD'
+#define WORLD_VERSION           1
+#define WORLD_CHUNK_MAGIC       0x4B4E4843 // 'CHNK'
+#define WORLD_CHUNK_VERSION     1
+#define WORLD_MAX_NAME          64
+
+typedef struct WORLD_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u32 ChunkCount;
+    u32 ChunkOffset;
+    f32 ChunkSize;              // Grid cell size in X and Z
+    u32 GridWidth;
+    u32 GridDepth;
+    f32 Min[3];
+    f32 Max[3];
+    u32 LargestChunk;           // Bytes - the runtime sizes its load slots from this
+} WORLD_HEADER;
+
+// Everything the residency manager needs without touching the chunk file
+typedef struct WORLD_CHUNK_INFO
+{
+    u32 GridX;
+    u32 GridZ;
+    f32 Min[3];
+    f32 Max[3];
+    u32 FileSize;
+    u32 VertexCount;
+    u32 IndexCount;
+    u32 LightmapWidth;
+    u32 LightmapHeight;
+    char Name[WORLD_MAX_NAME];  // Relative to the world file's directory
+} WORLD_CHUNK_INFO;
+
+// Indices are relative to the chunk's vertices, lightmap UVs to the chunk's own RGBA8 lightmap (bottom row first)
+typedef struct WORLD_CHUNK_HEADER
+{
+    u32 Magic;
+    u32 Version;
+    u32 VertexCount;
+    u32 IndexCount;
+    u32 LightmapWidth;
+    u32 LightmapHeight;
+    u32 VertexOffset;           // LEVEL_VERTEX, 16 byte aligned
+    u32 IndexOffset;
+    u32 LightmapOffset;
+} WORLD_CHUNK_HEADER;